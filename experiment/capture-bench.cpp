@@ -0,0 +1,65 @@
+// Compares the latency of the first screenshot after startup with the
+// latency of the ones after it.
+// usage: capture_bench [width height [count]]
+#include "smv/client.hpp"
+#include "smv/record.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <future>
+#include <iostream>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+static auto screenshot(const smv::Region &region) -> std::chrono::microseconds
+{
+  std::promise<void> done;
+  auto               start = Clock::now();
+  smv::capture(smv::ScreenshotConfig { region },
+               smv::ScreenshotFormat::PPM,
+               [&done](smv::CaptureSource &) {
+    done.set_value();
+  });
+  done.get_future().wait();
+  return std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() -
+                                                               start);
+}
+
+auto main(int argc, char *argv[]) -> int
+{
+  auto width  = argc > 2 ? std::atoi(argv[1]) : 1280;
+  auto height = argc > 2 ? std::atoi(argv[2]) : 720;
+  auto count  = argc > 3 ? std::atoi(argv[3]) : 20;
+  auto region = smv::Region(width, height, 0, 0);
+
+  smv::init();
+  std::promise<smv::WarmUpReport> warm;
+  smv::warmUp([&warm](const smv::WarmUpReport &report) {
+    warm.set_value(report);
+  });
+  auto report = warm.get_future().get();
+  if (report.error) {
+    std::cerr << "warm-up failed: " << *report.error << '\n';
+    return EXIT_FAILURE;
+  }
+  std::cout << "warm-up:      " << report.total.count() << "us\n"
+            << "  prepare:    " << report.prepare.count() << "us\n"
+            << "  first grab: " << report.firstFrame.count() << "us\n"
+            << "  steady:     " << report.steadyFrame.count() << "us\n";
+
+  std::vector<std::chrono::microseconds> samples;
+  for (int i = 0; i < std::max(count, 2); i++) {
+    samples.push_back(screenshot(region));
+  }
+  auto first = samples.front();
+  std::sort(samples.begin() + 1, samples.end());
+  auto steady = samples[(samples.size() + 1) / 2];
+  std::cout << "screenshot " << width << "x" << height << '\n'
+            << "  first:      " << first.count() << "us\n"
+            << "  steady:     " << steady.count() << "us\n";
+
+  smv::deinit();
+  return EXIT_SUCCESS;
+}
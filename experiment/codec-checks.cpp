@@ -0,0 +1,799 @@
+// Round-trip checks for the self-contained codecs and kernels of smvnative:
+// each format is encoded and decoded again, or compared with a plain scalar
+// reference written from the spec.
+// usage: codec_checks
+#include "smv/audio_resampler.hpp"
+#include "smv/convert_yuv.hpp"
+#include "smv/matroska.hpp"
+#include "smv/ogg_opus.hpp"
+#include "smv/qoi.hpp"
+#include "smv/raw_recording.hpp"
+#include "smv/rtp_h264.hpp"
+#include "smv/scale.hpp"
+#include "smv/spsc_ring.hpp"
+#include "smv/tile_diff.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+namespace {
+  using smv::details::AudioResampler;
+  using smv::details::convertToYuv;
+  using smv::details::DirtyRect;
+  using smv::details::EncodedPacket;
+  using smv::details::FrameView;
+  using smv::details::H264Packetizer;
+  using smv::details::MatroskaTrack;
+  using smv::details::MatroskaWriter;
+  using smv::details::OggOpusWriter;
+  using smv::details::opusHead;
+  using smv::details::PixelLayout;
+  using smv::details::RawFrameType;
+  using smv::details::RawRecordingReader;
+  using smv::details::RawRecordingWriter;
+  using smv::details::scaleFrame;
+  using smv::details::SpscRing;
+  using smv::details::TileDiff;
+  using smv::details::VideoFrame;
+  using smv::details::YuvMatrix;
+  using smv::ScaleFilter;
+
+  int failures = 0;
+
+  void check(bool ok, const char *what)
+  {
+    if (!ok) {
+      std::cerr << "FAIL: " << what << '\n';
+      failures++;
+    }
+  }
+
+  auto noise(std::size_t size, uint32_t seed) -> std::vector<uint8_t>
+  {
+    std::mt19937         random(seed);
+    std::vector<uint8_t> bytes(size);
+    for (auto &byte : bytes) {
+      byte = static_cast<uint8_t>(random());
+    }
+    return bytes;
+  }
+
+  /**
+   * @brief decode a QOI image as the spec does, to RGBA
+   */
+  auto decodeQoi(const std::vector<uint8_t> &data, uint32_t &width)
+    -> std::vector<uint8_t>
+  {
+    auto read32 = [&data](std::size_t at) {
+      return static_cast<uint32_t>(data[at] << 24 | data[at + 1] << 16 |
+                                   data[at + 2] << 8 | data[at + 3]);
+    };
+    width       = read32(4);
+    auto height = read32(8);
+    std::vector<uint8_t> pixels;
+    uint8_t              index[64][4] = {};
+    uint8_t              px[4]        = { 0, 0, 0, 255 };
+    std::size_t          at           = 14;
+    int                  run          = 0;
+    for (std::size_t i = 0; i < std::size_t { width } * height; i++) {
+      if (run > 0) {
+        run--;
+      } else {
+        auto tag = data[at++];
+        if (tag == 0xFE) {
+          px[0] = data[at++], px[1] = data[at++], px[2] = data[at++];
+        } else if (tag == 0xFF) {
+          px[0] = data[at++], px[1] = data[at++], px[2] = data[at++];
+          px[3] = data[at++];
+        } else if ((tag & 0xC0) == 0x00) {
+          for (int c = 0; c < 4; c++) {
+            px[c] = index[tag][c];
+          }
+        } else if ((tag & 0xC0) == 0x40) {
+          px[0] += ((tag >> 4) & 3) - 2;
+          px[1] += ((tag >> 2) & 3) - 2;
+          px[2] += (tag & 3) - 2;
+        } else if ((tag & 0xC0) == 0x80) {
+          auto next = data[at++];
+          auto dg   = (tag & 0x3F) - 32;
+          px[0] += dg - 8 + ((next >> 4) & 0x0F);
+          px[1] += dg;
+          px[2] += dg - 8 + (next & 0x0F);
+        } else {
+          run = tag & 0x3F;
+        }
+        auto slot = (px[0] * 3 + px[1] * 5 + px[2] * 7 + px[3] * 11) % 64;
+        for (int c = 0; c < 4; c++) {
+          index[slot][c] = px[c];
+        }
+      }
+      pixels.insert(pixels.end(), px, px + 4);
+    }
+    return pixels;
+  }
+
+  void checkQoi()
+  {
+    // opaque black after another colour must not hit the zeroed index
+    std::vector<uint8_t> row { 255, 255, 255, 255, 0, 0, 0, 255,
+                               255, 255, 255, 255, 0, 0, 0, 255 };
+    uint32_t             width = 0;
+    auto encoded = smv::details::encodeQoi(row.data(), 4, 1, 4, 16);
+    check(decodeQoi(encoded, width) == row, "qoi: black and white row");
+
+    // runs, small and large differences, alpha changes
+    std::vector<uint8_t> image = noise(64 * 48 * 4, 1);
+    for (std::size_t i = 0; i < image.size() / 2; i++) {
+      image[i] = static_cast<uint8_t>(i / 97);
+    }
+    encoded = smv::details::encodeQoi(image.data(), 64, 48, 4, 64 * 4);
+    check(decodeQoi(encoded, width) == image, "qoi: rgba round trip");
+
+    // rgb, with padding at the end of each row
+    auto rgb  = noise(33 * 5 * 4, 2);
+    encoded   = smv::details::encodeQoi(rgb.data(), 33, 5, 3, 33 * 4);
+    auto back = decodeQoi(encoded, width);
+    bool same = true;
+    for (std::size_t y = 0; y < 5; y++) {
+      for (std::size_t x = 0; x < 33; x++) {
+        for (std::size_t c = 0; c < 3; c++) {
+          same &= back[(y * 33 + x) * 4 + c] == rgb[y * 33 * 4 + x * 3 + c];
+        }
+        same &= back[(y * 33 + x) * 4 + 3] == 255;
+      }
+    }
+    check(same, "qoi: rgb round trip");
+  }
+
+  /**
+   * @brief the CRC of an Ogg page, bit by bit as the spec describes it
+   */
+  auto oggCrc(const uint8_t *data, std::size_t size) -> uint32_t
+  {
+    uint32_t crc = 0;
+    for (std::size_t i = 0; i < size; i++) {
+      crc ^= static_cast<uint32_t>(data[i]) << 24;
+      for (int bit = 0; bit < 8; bit++) {
+        crc = (crc & 0x80000000U) ? (crc << 1) ^ 0x04C11DB7U : crc << 1;
+      }
+    }
+    return crc;
+  }
+
+  auto readLE(const uint8_t *data, std::size_t size) -> uint64_t
+  {
+    uint64_t value = 0;
+    for (std::size_t i = size; i > 0; i--) {
+      value = value << 8 | data[i - 1];
+    }
+    return value;
+  }
+
+  void checkOggOpus()
+  {
+    OggOpusWriter writer(2, 44'100, 312, 0x12345678);
+    auto          stream = writer.header();
+    // sizes on and around the 255 byte lacing boundary
+    std::vector<std::vector<uint8_t>> packets;
+    for (auto size : { 1, 254, 255, 256, 510, 700, 120 }) {
+      packets.push_back(noise(size, static_cast<uint32_t>(size)));
+    }
+    // 960 samples each, so that the writer starts a new page after a second
+    for (int i = 0; i < 60; i++) {
+      packets.push_back(noise(100 + i, 1000 + i));
+    }
+    for (const auto &packet : packets) {
+      auto pages = writer.add({ packet.data(), packet.size() }, 960);
+      stream.insert(stream.end(), pages.begin(), pages.end());
+    }
+    auto pages = writer.flush(true);
+    stream.insert(stream.end(), pages.begin(), pages.end());
+
+    // walk the pages, joining the packets back from their lacing
+    std::vector<std::vector<uint8_t>> read;
+    std::vector<uint8_t>              partial;
+    std::vector<uint64_t>             granules;
+    uint8_t                           lastFlags = 0;
+    std::size_t                       at        = 0;
+    bool                              valid     = true;
+    for (uint32_t sequence = 0; valid && at < stream.size(); sequence++) {
+      const auto *page = stream.data() + at;
+      if (at + 27 > stream.size() || std::memcmp(page, "OggS", 4) != 0) {
+        valid = false;
+        break;
+      }
+      std::size_t segments = page[26];
+      std::size_t size     = 0;
+      for (std::size_t i = 0; i < segments; i++) {
+        size += page[27 + i];
+      }
+      auto length = 27 + segments + size;
+      std::vector<uint8_t> copy(page, page + length);
+      std::fill(copy.begin() + 22, copy.begin() + 26, 0);
+      valid &= readLE(page + 22, 4) == oggCrc(copy.data(), copy.size());
+      valid &= readLE(page + 14, 4) == 0x12345678;
+      valid &= readLE(page + 18, 4) == sequence;
+      valid &= (page[5] & 0x02) == (sequence == 0 ? 0x02 : 0);
+      granules.push_back(readLE(page + 6, 8));
+      lastFlags = page[5];
+
+      const auto *body = page + 27 + segments;
+      for (std::size_t i = 0; i < segments; i++) {
+        partial.insert(partial.end(), body, body + page[27 + i]);
+        body += page[27 + i];
+        if (page[27 + i] < 255) {
+          read.push_back(std::move(partial));
+          partial.clear();
+        }
+      }
+      at += length;
+    }
+    check(valid && at == stream.size(), "ogg: pages and checksums");
+    check(lastFlags == 0x04, "ogg: end of stream flag");
+    check(read.size() == packets.size() + 2, "ogg: packet count");
+    if (read.size() != packets.size() + 2) {
+      return;
+    }
+    check(read[0] == opusHead(2, 44'100, 312), "ogg: OpusHead");
+    check(std::memcmp(read[1].data(), "OpusTags", 8) == 0, "ogg: OpusTags");
+    check(std::equal(packets.begin(), packets.end(), read.begin() + 2),
+          "ogg: packets round trip");
+    check(granules.size() > 3 && granules[0] == 0 && granules[1] == 0 &&
+            std::is_sorted(granules.begin(), granules.end()) &&
+            granules.back() == packets.size() * 960,
+          "ogg: granule positions");
+  }
+
+  /**
+   * @brief A minimal EBML reader, enough to walk what MatroskaWriter writes
+   */
+  struct Ebml
+  {
+    const std::vector<uint8_t> &data;
+    std::size_t                 at = 0;
+
+    auto length(uint8_t first) const -> std::size_t
+    {
+      std::size_t length = 1;
+      while (length <= 8 && (first & (0x80 >> (length - 1))) == 0) {
+        length++;
+      }
+      return length;
+    }
+
+    auto id() -> uint32_t
+    {
+      auto     size  = length(data[at]);
+      uint32_t value = 0;
+      for (std::size_t i = 0; i < size; i++) {
+        value = value << 8 | data[at++];
+      }
+      return value;
+    }
+
+    /**
+     * @return the size, or UINT64_MAX if it is unknown
+     */
+    auto size() -> uint64_t
+    {
+      auto     size    = length(data[at]);
+      uint64_t value   = data[at++] & (0xFF >> size);
+      bool     unknown = value == (0xFFU >> size);
+      for (std::size_t i = 1; i < size; i++) {
+        unknown &= data[at] == 0xFF;
+        value = value << 8 | data[at++];
+      }
+      return unknown ? UINT64_MAX : value;
+    }
+
+    auto uint(std::size_t size) -> uint64_t
+    {
+      uint64_t value = 0;
+      for (std::size_t i = 0; i < size; i++) {
+        value = value << 8 | data[at++];
+      }
+      return value;
+    }
+  };
+
+  void checkMatroska()
+  {
+    auto head = opusHead(2, 48'000, 312);
+    MatroskaWriter writer(
+      { MatroskaTrack { "V_MJPEG", {}, 64, 48 },
+        MatroskaTrack { "A_OPUS", head, 0, 0, 48'000, 2 } });
+    auto file = writer.header();
+
+    // 12 seconds of video at 10 fps and audio every 20 ms, in pts order
+    struct Block
+    {
+      uint64_t             track;
+      int64_t              ms;
+      bool                 keyframe;
+      std::vector<uint8_t> bytes;
+    };
+    std::vector<Block> blocks;
+    for (int64_t ms = 0; ms < 12'000; ms += 20) {
+      if (ms % 100 == 0) {
+        blocks.push_back({ 1, ms, ms % 1000 == 0, noise(200, ms) });
+      }
+      blocks.push_back({ 2, ms, true, noise(40, ms + 1) });
+    }
+    for (const auto &block : blocks) {
+      EncodedPacket packet;
+      packet.payload =
+        std::make_shared<const std::vector<uint8_t>>(block.bytes);
+      // an origin that is not zero, which the writer subtracts
+      packet.ptsUs    = 5'000'000 + block.ms * 1000;
+      packet.keyframe = block.keyframe;
+      auto cluster    = writer.add(block.track - 1, packet);
+      file.insert(file.end(), cluster.begin(), cluster.end());
+    }
+    auto cluster = writer.flush();
+    file.insert(file.end(), cluster.begin(), cluster.end());
+
+    Ebml ebml { file };
+    bool valid = ebml.id() == 0x1A45DFA3;
+    ebml.at += ebml.size();
+    valid &= ebml.id() == 0x18538067 && ebml.size() == UINT64_MAX;
+    std::vector<Block> read;
+    int                clusters = 0;
+    int                tracks   = 0;
+    while (valid && ebml.at < file.size()) {
+      auto id   = ebml.id();
+      auto size = ebml.size();
+      auto end  = ebml.at + size;
+      if (end > file.size()) {
+        valid = false;
+        break;
+      }
+      if (id == 0x1654AE6B) {
+        while (ebml.at < end) {
+          tracks += ebml.id() == 0xAE;
+          ebml.at += ebml.size();
+        }
+      } else if (id == 0x1F43B675) {
+        clusters++;
+        valid &= ebml.id() == 0xE7;
+        auto clusterMs = static_cast<int64_t>(ebml.uint(ebml.size()));
+        while (valid && ebml.at < end) {
+          valid &= ebml.id() == 0xA3;
+          auto blockEnd = ebml.size() + ebml.at;
+          auto track    = ebml.size();
+          auto relative = static_cast<int16_t>(ebml.uint(2));
+          auto flags    = file[ebml.at++];
+          read.push_back({ track,
+                           clusterMs + relative,
+                           (flags & 0x80) != 0,
+                           { file.begin() + static_cast<long>(ebml.at),
+                             file.begin() + static_cast<long>(blockEnd) } });
+          ebml.at = blockEnd;
+        }
+      }
+      ebml.at = end;
+    }
+    check(valid && ebml.at == file.size(), "matroska: element sizes");
+    check(tracks == 2, "matroska: track entries");
+    // a cluster spans at most 5 seconds
+    check(clusters == 3, "matroska: clusters");
+    bool same = read.size() == blocks.size();
+    for (std::size_t i = 0; same && i < read.size(); i++) {
+      same = read[i].track == blocks[i].track && read[i].ms == blocks[i].ms &&
+             read[i].keyframe == blocks[i].keyframe &&
+             read[i].bytes == blocks[i].bytes;
+    }
+    check(same, "matroska: blocks round trip");
+  }
+
+  void checkRtpH264()
+  {
+    // SPS, PPS and an IDR slice that needs fragmenting, with both start code
+    // lengths. No NAL contains a start code or ends with a zero
+    std::vector<std::vector<uint8_t>> nals { noise(20, 1),
+                                             noise(6, 2),
+                                             noise(3000, 3) };
+    nals[0][0] = 0x67, nals[1][0] = 0x68, nals[2][0] = 0x65;
+    std::vector<uint8_t> unit;
+    for (auto &nal : nals) {
+      std::replace(nal.begin(), nal.end(), uint8_t { 0 }, uint8_t { 1 });
+      unit.insert(unit.end(), { 0, 0 });
+      if (&nal == &nals[0]) {
+        unit.push_back(0);
+      }
+      unit.push_back(1);
+      unit.insert(unit.end(), nal.begin(), nal.end());
+    }
+
+    H264Packetizer packetizer(0xCAFEBABE, 500);
+    EncodedPacket  packet;
+    packet.payload = std::make_shared<const std::vector<uint8_t>>(unit);
+    packet.ptsUs   = 1'000'000;
+    bool     valid = true;
+    uint16_t first = 0;
+    // twice, as the second access unit reuses the buffer of the first
+    for (int round = 0; round < 2; round++) {
+      const auto &packets = packetizer.packetize(packet);
+      std::vector<std::vector<uint8_t>> read;
+      for (std::size_t i = 0; i < packets.size(); i++) {
+        const auto *rtp      = packets[i].data();
+        auto        sequence = static_cast<uint16_t>(rtp[2] << 8 | rtp[3]);
+        if (round == 0 && i == 0) {
+          first = sequence;
+        }
+        valid &= packets[i].size() <= 500 && rtp[0] == 0x80;
+        valid &= (rtp[1] & 0x7F) == H264Packetizer::PAYLOAD_TYPE;
+        valid &= ((rtp[1] & 0x80) != 0) == (i + 1 == packets.size());
+        valid &= sequence == static_cast<uint16_t>(
+                               first + round * packets.size() + i);
+        valid &= static_cast<uint32_t>(rtp[4] << 24 | rtp[5] << 16 |
+                                       rtp[6] << 8 | rtp[7]) == 90'000;
+        valid &= static_cast<uint32_t>(rtp[8] << 24 | rtp[9] << 16 |
+                                       rtp[10] << 8 | rtp[11]) == 0xCAFEBABE;
+        const auto *payload = rtp + H264Packetizer::HEADER_SIZE;
+        auto        size    = packets[i].size() - H264Packetizer::HEADER_SIZE;
+        if ((payload[0] & 0x1F) != 28) {
+          read.emplace_back(payload, payload + size);
+          continue;
+        }
+        // FU-A: rebuild the NAL header from the indicator and the FU header
+        if (payload[1] & 0x80) {
+          auto header = (payload[0] & 0xE0) | (payload[1] & 0x1F);
+          read.push_back({ static_cast<uint8_t>(header) });
+        }
+        read.back().insert(read.back().end(), payload + 2, payload + size);
+      }
+      check(valid, "rtp: headers");
+      check(read == nals, "rtp: NAL units round trip");
+    }
+  }
+
+  void checkAudioResampler()
+  {
+    constexpr uint32_t    IN = 44'100, OUT = 48'000, BLOCK = 441;
+    constexpr std::size_t BLOCKS = 100;
+    constexpr double      PI = 3.141592653589793, HZ = 1000.0;
+    AudioResampler        resampler(IN, OUT, 2, BLOCK);
+    std::vector<float>    input(BLOCK * 2);
+    std::vector<float>    output(resampler.maxOutputFrames(BLOCK) * 2);
+    std::size_t           produced = 0;
+    double                worst    = 0.0;
+    for (std::size_t block = 0; block < BLOCKS; block++) {
+      for (std::size_t i = 0; i < BLOCK; i++) {
+        auto phase       = 2 * PI * HZ * double(block * BLOCK + i) / IN;
+        input[i * 2]     = static_cast<float>(std::sin(phase));
+        input[i * 2 + 1] = static_cast<float>(0.5 * std::cos(phase));
+      }
+      auto frames = resampler.process(input.data(), BLOCK, output.data());
+      for (std::size_t i = 0; i < frames; i++, produced++) {
+        // the filter delays the signal by (TAPS - 1) / 2 input samples,
+        // and needs that long to fill up
+        auto t = double(produced) * IN / OUT -
+                 (AudioResampler::TAPS - 1) / 2.0;
+        if (t < AudioResampler::TAPS) {
+          continue;
+        }
+        auto phase = 2 * PI * HZ * t / IN;
+        worst      = std::max({ worst,
+                                std::abs(output[i * 2] - std::sin(phase)),
+                                std::abs(output[i * 2 + 1] -
+                                         0.5 * std::cos(phase)) });
+      }
+    }
+    check(produced + 1 >= OUT && produced <= OUT + 1, "resampler: rate");
+    check(worst < 0.01, "resampler: sine matches the ideal one");
+
+    AudioResampler same(OUT, OUT, 2, BLOCK);
+    check(same.process(input.data(), BLOCK, output.data()) == BLOCK &&
+            std::equal(input.begin(), input.end(), output.begin()),
+          "resampler: equal rates are copied");
+  }
+
+  void checkSpscRing()
+  {
+    SpscRing<int> ring(5);
+    check(ring.capacity() == 8, "ring: capacity is a power of two");
+    int  values[10] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9 };
+    int  out[12]    = {};
+    bool valid      = ring.write(values, 6) == 6 && ring.read(out, 4) == 4;
+    // wraps around the end of the buffer, and stops when full
+    valid &= ring.write(values + 6, 4) == 4 && ring.write(values, 3) == 2;
+    valid &= ring.readable() == 8 && ring.read(out + 4, 8) == 8;
+    valid &= std::equal(values, values + 10, out) && out[10] == 0 &&
+             out[11] == 1 && ring.read(out, 1) == 0;
+    check(valid, "ring: wrap around");
+
+    // one thread writes a counter, the other checks that nothing is lost or
+    // reordered
+    constexpr int      COUNT = 1'000'000;
+    SpscRing<int>      shared(1024);
+    std::thread        producer([&shared] {
+      std::vector<int> chunk(37);
+      for (int next = 0; next < COUNT;) {
+        auto size = std::min<std::size_t>(chunk.size(), COUNT - next);
+        for (std::size_t i = 0; i < size; i++) {
+          chunk[i] = next + static_cast<int>(i);
+        }
+        std::size_t written = 0;
+        while (written < size) {
+          written += shared.write(chunk.data() + written, size - written);
+        }
+        next += static_cast<int>(size);
+      }
+    });
+    std::vector<int> chunk(53);
+    int              expected = 0;
+    bool             ordered  = true;
+    while (expected < COUNT) {
+      auto size = shared.read(chunk.data(), chunk.size());
+      for (std::size_t i = 0; i < size; i++) {
+        ordered &= chunk[i] == expected++;
+      }
+    }
+    producer.join();
+    check(ordered && shared.readable() == 0, "ring: two threads");
+  }
+
+  auto bgrx(uint32_t width, uint32_t height, uint32_t seed) -> VideoFrame
+  {
+    VideoFrame frame;
+    frame.resize(PixelLayout::BGRX, width, height);
+    frame.bytes = noise(frame.bytes.size(), seed);
+    return frame;
+  }
+
+  auto covered(const std::vector<DirtyRect> &rects, int x, int y) -> bool
+  {
+    return std::any_of(rects.begin(), rects.end(), [x, y](const auto &rect) {
+      return x >= rect.x && x < rect.x + rect.width && y >= rect.y &&
+             y < rect.y + rect.height;
+    });
+  }
+
+  void checkTileDiff()
+  {
+    TileDiff diff;
+    auto     frame = bgrx(200, 130, 1);
+    auto     rects = diff.update(frame.view());
+    check(rects.size() == 1 && rects[0].x == 0 && rects[0].y == 0 &&
+            rects[0].width == 200 && rects[0].height == 130,
+          "tiles: the first frame is dirty");
+    check(diff.update(frame.view()).empty(), "tiles: nothing changed");
+
+    frame.bytes[(70 * 200 + 130) * 4]++;
+    frame.bytes[(129 * 200 + 10) * 4 + 2]++;
+    rects            = diff.update(frame.view());
+    std::size_t area = 0;
+    for (const auto &rect : rects) {
+      area += std::size_t { rect.width } * rect.height;
+    }
+    check(covered(rects, 130, 70) && covered(rects, 10, 129) &&
+            area <= 2 * TileDiff::TILE_SIZE * TileDiff::TILE_SIZE,
+          "tiles: changed pixels");
+
+    auto smaller = bgrx(100, 50, 2);
+    rects        = diff.update(smaller.view());
+    check(rects.size() == 1 && rects[0].width == 100 && rects[0].height == 50,
+          "tiles: a new size is dirty");
+  }
+
+  void checkRawRecording()
+  {
+    auto path =
+      (std::filesystem::temp_directory_path() / "codec-checks.smvraw")
+        .string();
+    // key, delta, repeat, key (interval), key (new size)
+    std::vector<VideoFrame> frames;
+    frames.push_back(bgrx(100, 70, 1));
+    frames.push_back(frames.back());
+    for (uint32_t y = 10; y < 20; y++) {
+      std::fill_n(frames.back().bytes.begin() + (y * 100 + 80) * 4, 40, 7);
+    }
+    frames.push_back(frames.back());
+    frames.push_back(bgrx(100, 70, 2));
+    frames.push_back(bgrx(60, 40, 3));
+
+    {
+      RawRecordingWriter writer(path, 30, 3);
+      auto               err = writer.open();
+      for (std::size_t i = 0; !err && i < frames.size(); i++) {
+        err = writer.write(frames[i].view(), static_cast<int64_t>(i) * 33'333);
+      }
+      if (!err) {
+        err = writer.finish();
+      }
+      check(!err, "raw: write");
+    }
+
+    RawRecordingReader reader;
+    check(!reader.open(path) && reader.fps() == 30, "raw: open");
+    const auto &index = reader.index();
+    check(index.size() == frames.size() &&
+            index[0].type == RawFrameType::Key &&
+            index[1].type == RawFrameType::Delta &&
+            index[2].type == RawFrameType::Repeat &&
+            index[3].type == RawFrameType::Key &&
+            index[4].type == RawFrameType::Key && index[4].ptsUs == 133'332,
+          "raw: index");
+    VideoFrame canvas;
+    bool       same = index.size() == frames.size();
+    for (std::size_t i = 0; same && i < frames.size(); i++) {
+      same = !reader.decode(i, canvas) && canvas.width == frames[i].width &&
+             canvas.height == frames[i].height &&
+             canvas.bytes == frames[i].bytes;
+    }
+    check(same, "raw: frames round trip");
+    std::filesystem::remove(path);
+  }
+
+  /**
+   * @brief compare convertToYuv with the 8-bit limited range BT.601 and
+   * BT.709 formulas, applied pixel by pixel, and to the average of each 2x2
+   * block for chroma
+   */
+  void checkYuv()
+  {
+    struct Matrix
+    {
+      YuvMatrix matrix;
+      int       y[3], u[3], v[3];
+    };
+    const Matrix matrices[] = {
+      { YuvMatrix::BT601,
+        { 66, 129, 25 },
+        { -38, -74, 112 },
+        { 112, -94, -18 } },
+      { YuvMatrix::BT709,
+        { 47, 157, 16 },
+        { -26, -86, 112 },
+        { 112, -102, -10 } },
+    };
+    auto weigh = [](const int *w, int r, int g, int b) {
+      return (w[0] * r + w[1] * g + w[2] * b + 128) >> 8;
+    };
+    // wide enough for the vector path, odd for the edges
+    auto       frame = bgrx(37, 11, 4);
+    VideoFrame yuv;
+    for (const auto &m : matrices) {
+      for (auto layout : { PixelLayout::I420, PixelLayout::NV12 }) {
+        for (bool msbFirst : { false, true }) {
+          auto src     = frame.view();
+          src.msbFirst = msbFirst;
+          convertToYuv(src, layout, m.matrix, yuv);
+          // red, green and blue of pixel (x, y), clamped to the frame
+          auto rgb = [&](uint32_t x, uint32_t y, int c) -> int {
+            const auto *px = src.row(std::min(y, src.height - 1)) +
+                             std::min(x, src.width - 1) * 4;
+            return msbFirst ? px[1 + c] : px[2 - c];
+          };
+          int worstLuma = 0, worstChroma = 0;
+          for (uint32_t y = 0; y < src.height; y++) {
+            for (uint32_t x = 0; x < src.width; x++) {
+              auto luma =
+                weigh(m.y, rgb(x, y, 0), rgb(x, y, 1), rgb(x, y, 2)) + 16;
+              const auto *lumaRow = yuv.plane(0) + y * yuv.strides[0];
+              worstLuma = std::max(worstLuma, std::abs(lumaRow[x] - luma));
+              if (x % 2 != 0 || y % 2 != 0) {
+                continue;
+              }
+              int avg[3];
+              for (int c = 0; c < 3; c++) {
+                avg[c] = (rgb(x, y, c) + rgb(x + 1, y, c) + rgb(x, y + 1, c) +
+                          rgb(x + 1, y + 1, c) + 2) /
+                         4;
+              }
+              auto  planar = layout == PixelLayout::I420;
+              auto  row    = (y / 2) * yuv.strides[1];
+              auto *u      = yuv.plane(1) + row;
+              auto *v      = planar ? yuv.plane(2) + row : u + 1;
+              auto  at     = planar ? x / 2 : x;
+              worstChroma =
+                std::max({ worstChroma,
+                           std::abs(u[at] - weigh(m.u, avg[0], avg[1], avg[2]) -
+                                    128),
+                           std::abs(v[at] - weigh(m.v, avg[0], avg[1], avg[2]) -
+                                    128) });
+            }
+          }
+          check(worstLuma == 0, "yuv: luma");
+          // the vector path rounds the 2x2 averages in two steps
+          check(worstChroma <= 1, "yuv: chroma");
+        }
+      }
+    }
+  }
+
+  void checkScale()
+  {
+    auto       frame = bgrx(67, 45, 5);
+    const auto src   = frame.view();
+    VideoFrame scaled;
+    auto worst = [&](const FrameView &out, auto reference) {
+      int result = 0;
+      for (uint32_t y = 0; y < out.height; y++) {
+        for (uint32_t x = 0; x < out.width; x++) {
+          for (uint32_t c = 0; c < 4; c++) {
+            result = std::max(
+              result, std::abs(out.row(y)[x * 4 + c] - reference(x, y, c)));
+          }
+        }
+      }
+      return result;
+    };
+
+    // every source pixel the output pixel covers, averaged
+    auto box = [](const FrameView &from, uint32_t w, uint32_t h) {
+      return [&from, w, h](uint32_t x, uint32_t y, uint32_t c) {
+        auto x0  = x * from.width / w;
+        auto x1  = std::max((x + 1) * from.width / w, x0 + 1);
+        auto y0  = y * from.height / h;
+        auto y1  = std::max((y + 1) * from.height / h, y0 + 1);
+        auto sum = 0.0;
+        for (auto sy = y0; sy < y1; sy++) {
+          for (auto sx = x0; sx < x1; sx++) {
+            sum += from.row(sy)[sx * 4 + c];
+          }
+        }
+        return static_cast<int>(std::lround(sum / ((x1 - x0) * (y1 - y0))));
+      };
+    };
+    // the vector path averages the 2x2 blocks in two steps
+    auto even = FrameView { src.data, 66, 44, src.stride };
+    auto out  = scaleFrame(even, { 33, 22 }, ScaleFilter::Box, scaled);
+    check(worst(out, box(even, 33, 22)) <= 1, "scale: halving");
+    out = scaleFrame(src, { 20, 13 }, ScaleFilter::Box, scaled);
+    check(worst(out, box(src, 20, 13)) <= 1, "scale: box");
+
+    // the centers of the pixels are aligned
+    auto bilinear = [&src](uint32_t w, uint32_t h) {
+      auto sample = [](uint32_t at, uint32_t from, uint32_t to) {
+        auto pos   = std::max((at + 0.5) * from / to - 0.5, 0.0);
+        auto index = std::min(static_cast<uint32_t>(pos), from - 1);
+        return std::tuple(index, std::min(index + 1, from - 1), pos - index);
+      };
+      return [&src, sample, w, h](uint32_t x, uint32_t y, uint32_t c) {
+        auto [x0, x1, fx] = sample(x, src.width, w);
+        auto [y0, y1, fy] = sample(y, src.height, h);
+        auto at = [&src, c](uint32_t px, uint32_t py) {
+          return double(src.row(py)[px * 4 + c]);
+        };
+        auto top    = at(x0, y0) * (1 - fx) + at(x1, y0) * fx;
+        auto bottom = at(x0, y1) * (1 - fx) + at(x1, y1) * fx;
+        return static_cast<int>(std::lround(top * (1 - fy) + bottom * fy));
+      };
+    };
+    out = scaleFrame(src, { 30, 20 }, ScaleFilter::Bilinear, scaled);
+    // the weights have 8 bits, and each step rounds down
+    check(worst(out, bilinear(30, 20)) <= 3, "scale: bilinear");
+  }
+} // namespace
+
+auto main() -> int
+{
+  checkQoi();
+  checkOggOpus();
+  checkMatroska();
+  checkRtpH264();
+  checkAudioResampler();
+  checkSpscRing();
+  checkTileDiff();
+  checkRawRecording();
+  checkYuv();
+  checkScale();
+  if (failures > 0) {
+    std::cerr << failures << " check(s) failed\n";
+    return EXIT_FAILURE;
+  }
+  std::cout << "all checks passed\n";
+  return EXIT_SUCCESS;
+}
@@ -54,3 +54,25 @@ target ("screenshot")
     add_files("./x11-screenshot.cpp")
     add_packages("xcb", "xcb-util", "xcb-util-image", "spdlog")
     add_includedirs("$(projectdir)/include")
+
+target ("capture_bench")
+    set_default (false)
+    set_group("example")
+    set_kind("binary")
+    set_languages("c17", "c++17")
+    add_files("./capture-bench.cpp")
+    add_packages("spdlog")
+    add_includedirs("$(projectdir)/include")
+    add_deps("smvnative")
+
+-- xmake test codec_checks
+target ("codec_checks")
+    set_default (false)
+    set_group("test")
+    set_kind("binary")
+    set_languages("c17", "c++17")
+    add_files("./codec-checks.cpp")
+    add_packages("spdlog")
+    add_includedirs("$(projectdir)/include", "$(projectdir)/src/platform/internal")
+    add_deps("smvnative")
+    add_tests("default")
@@ -53,6 +53,9 @@ namespace fmt {
         case smv::EventType::WindowRenamed:
           name = "WindowRenamed";
           break;
+        case smv::EventType::CaptureAdjusted:
+          name = "CaptureAdjusted";
+          break;
         default:
           name = "None";
       }
@@ -111,4 +114,48 @@ namespace fmt {
       return formatter<std::string_view>::format(name, ctx);
     }
   };
+
+  template<>
+  struct formatter<smv::VideoStreamFormat>: formatter<std::string_view>
+  {
+    template<typename FormatContext>
+    auto format(smv::VideoStreamFormat vsFmt, FormatContext &ctx) const
+    {
+      std::string_view name = "Unknown";
+      switch (vsFmt) {
+        case smv::VideoStreamFormat::H264:
+          name = "H264";
+          break;
+        case smv::VideoStreamFormat::H265:
+          name = "H265";
+          break;
+        case smv::VideoStreamFormat::MJPEG:
+          name = "MJPEG";
+          break;
+      }
+      return formatter<std::string_view>::format(name, ctx);
+    }
+  };
+
+  template<>
+  struct formatter<smv::AudioCaptureFormat>: formatter<std::string_view>
+  {
+    template<typename FormatContext>
+    auto format(smv::AudioCaptureFormat acFmt, FormatContext &ctx) const
+    {
+      std::string_view name = "Unknown";
+      switch (acFmt) {
+        case smv::AudioCaptureFormat::OPUS:
+          name = "Opus";
+          break;
+        case smv::AudioCaptureFormat::AAC:
+          name = "AAC";
+          break;
+        case smv::AudioCaptureFormat::MP3:
+          name = "MP3";
+          break;
+      }
+      return formatter<std::string_view>::format(name, ctx);
+    }
+  };
 } // namespace fmt
@@ -32,6 +32,8 @@ namespace smv {
     WindowCreated = 0x200,
     WindowClose   = 0x400,
     WindowRenamed = 0x800,
+    // a capture changed its frame rate, size or encoder settings under load
+    CaptureAdjusted = 0x1000,
   };
 
   enum class MouseButton
@@ -269,4 +271,39 @@ namespace smv {
     bool                       visible;
     constexpr static EventType type = EventType::WindowVisible;
   };
+
+  /**
+   * @brief A capture adapted to how fast the machine can process it
+   * @details Not tied to a window, so window is always empty
+   */
+  struct EventDataCaptureAdjusted final: EventData
+  {
+    EventDataCaptureAdjusted(uint8_t     fps,
+                             float       scale,
+                             uint8_t     effort,
+                             std::string reason)
+      : EventData({})
+      , fps(fps)
+      , scale(scale)
+      , effort(effort)
+      , reason(std::move(reason))
+    {
+    }
+
+    auto format() const -> std::string override
+    {
+      return fmt::format(
+        "fps={}, scale={}, effort={}: {}", fps, scale, effort, reason);
+    }
+
+    // the new frame rate
+    uint8_t fps;
+    // the new size, as a factor of the configured size
+    float scale;
+    // how hard the encoder now works for quality. 0 is the fastest
+    uint8_t effort;
+    // why the capture was adjusted
+    std::string                reason;
+    constexpr static EventType type = EventType::CaptureAdjusted;
+  };
 } // namespace smv
@@ -1,17 +1,25 @@
 #pragma once
 
+#include "events.hpp"
 #include "window.hpp"
 
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
 #include <cstdint>
 #include <functional>
+#include <memory>
 #include <optional>
 #include <string>
 #include <string_view>
 #include <type_traits>
 #include <variant>
+#include <vector>
 
-constexpr auto DEFAULT_FPS          = 40;
-constexpr auto DEFAULT_JPEG_QUALITY = 95U;
+constexpr auto DEFAULT_FPS           = 40;
+constexpr auto DEFAULT_JPEG_QUALITY  = 95U;
+constexpr auto DEFAULT_REPLAY_BYTES  = std::size_t { 256 } << 20;
+constexpr auto DEFAULT_AUDIO_BITRATE = 64'000U;
 
 /**
  * @brief Record screen and audio
@@ -73,20 +81,49 @@ namespace smv {
 
   enum class AudioStreamFormat
   {
-    AAC = 0x1,
+    AAC  = 0x1,
+    OPUS = 0x2,
   };
 
   enum class VideoCaptureFormat
   {
-    MP4 = 0x1,
-    AVI = 0x2,
-    GIF = 0x4,
+    MP4  = 0x1,
+    AVI  = 0x2,
+    GIF  = 0x4,
+    // a raw H.264 (Annex B) stream, without a container
+    H264 = 0x8,
   };
 
   enum class VideoStreamFormat
   {
-    H264 = 0x1,
-    H265 = 0x2,
+    H264  = 0x1,
+    H265  = 0x2,
+    MJPEG = 0x4,
+  };
+
+  /**
+   * @brief How pixels are combined when a capture is scaled down
+   */
+  enum class ScaleFilter
+  {
+    // average every source pixel covered by the output pixel
+    Box      = 0x1,
+    // interpolate between the 4 nearest source pixels
+    Bilinear = 0x2,
+  };
+
+  /**
+   * @brief What to do with video frames that are identical to the frame
+   * before them
+   */
+  enum class DuplicateFrames
+  {
+    // treat them as any other frame
+    Keep   = 0x1,
+    // drop them, the previous frame is shown for longer instead
+    Skip   = 0x2,
+    // mark them as a repeat of the previous frame, without converting them
+    Repeat = 0x4,
   };
 
   struct ScreenshotConfig
@@ -98,6 +135,46 @@ namespace smv {
 
     uint8_t jpegQuality = DEFAULT_JPEG_QUALITY;
 
+    /**
+     * @brief Scale the capture down to this size
+     * @details Takes precedence over scaleFactor. The aspect ratio is not
+     * preserved, and the size is clamped to the size of the area
+     */
+    std::optional<Size> outputSize = std::nullopt;
+
+    /**
+     * @brief Scale the capture down by this factor
+     * @details A value between 0.0 and 1.0, where 0.5 halves both dimensions
+     */
+    float scaleFactor = 1.0F;
+
+    ScaleFilter scaleFilter = ScaleFilter::Box;
+
+    /**
+     * @brief Keep the alpha channel of translucent windows
+     * @details Only 32-bit ARGB windows have one. The screenshot has 4
+     * channels when it is kept. JPEG drops it, and PPM cannot hold it.
+     * Captures that turn out fully opaque still have 3 channels
+     */
+    bool keepAlpha = false;
+
+    /**
+     * @brief The size of the output, given the size of the captured area
+     */
+    auto inline outputSizeFor(Size captured) const -> Size
+    {
+      if (outputSize) {
+        return { std::clamp(outputSize->w, 1U, std::max(captured.w, 1U)),
+                 std::clamp(outputSize->h, 1U, std::max(captured.h, 1U)) };
+      }
+      if (scaleFactor > 0.0F && scaleFactor < 1.0F) {
+        return { std::max(static_cast<uint32_t>(captured.w * scaleFactor), 1U),
+                 std::max(static_cast<uint32_t>(captured.h * scaleFactor),
+                          1U) };
+      }
+      return captured;
+    }
+
     auto inline isValid() const -> bool
     {
       if (std::holds_alternative<Window *>(area)) {
@@ -115,16 +192,52 @@ namespace smv {
   {
     using AudioSourceId = uint32_t;
 
+    // the default capture device of the system
+    static constexpr AudioSourceId DEFAULT_SOURCE = 1;
+    // a generated tone, for trying out the audio path without a sound card
+    static constexpr AudioSourceId TEST_TONE_SOURCE = UINT32_MAX;
+
     /**
      * @brief The source id of the audio
+     * @details 0 means no audio. Besides the constants above, source n is
+     * the sound card numbered n - 2 by the system
      */
     AudioSourceId sourceId = 0;
 
+    /**
+     * @brief Another source mixed into the capture
+     */
+    struct MixInput
+    {
+      AudioSourceId sourceId = 0;
+      float         gain     = 1.0F;
+    };
+
+    /**
+     * @brief The sources mixed with sourceId
+     * @details e.g. the microphone over the system audio, for a narrated
+     * recording. The sources may run at different sample rates; they are
+     * resampled to the rate of the capture. volume applies to the mix
+     */
+    std::vector<MixInput> mix;
+
     /**
      * @brief The volume of the audio
      * @details The volume is a float between 0.0 and 1.0
      */
     float volume = 1.0F;
+
+    /**
+     * @brief The target bitrate of the encoded audio, in bits per second
+     */
+    uint32_t bitrate = DEFAULT_AUDIO_BITRATE;
+
+    /**
+     * @brief The duration of each encoded packet
+     * @details Opus only takes 10 or 20 milliseconds here. Shorter packets
+     * lower the latency of a stream, at the cost of a few more bits
+     */
+    std::chrono::milliseconds frameDuration { 20 };
   };
 
   struct VideoCaptureConfig: public ScreenshotConfig
@@ -136,12 +249,54 @@ namespace smv {
      */
     uint8_t fpsHint = DEFAULT_FPS;
 
+    /**
+     * @brief How frames where nothing changed on screen are handled
+     */
+    DuplicateFrames duplicateFrames = DuplicateFrames::Skip;
+
     /**
      * @brief The audio configuration
      */
     AudioCaptureConfig audioConfig;
   };
 
+  /**
+   * @brief Configure the replay buffer
+   * @details The buffer keeps whichever is shorter of the last duration, or
+   * the last maxBytes of encoded video. When audioConfig names a source, its
+   * audio is encoded to Opus and kept along with the video, in sync with it
+   */
+  struct ReplayConfig: public VideoCaptureConfig
+  {
+    std::chrono::seconds duration { 30 };
+    std::size_t          maxBytes = DEFAULT_REPLAY_BYTES;
+  };
+
+  /**
+   * @brief Configure a raw recording
+   * @details Frames are stored losslessly, as changes against the frame
+   * before them with fast compression, so that recording never waits on an
+   * encoder. See transcodeRaw
+   */
+  struct RawRecordConfig: public VideoCaptureConfig
+  {
+    /**
+     * @brief The file to record to. Replaced if it exists
+     */
+    std::string path;
+  };
+
+  /**
+   * @brief A monitor of the desktop
+   */
+  struct Monitor
+  {
+    std::string name;
+    // where the monitor is on its screen
+    Region area;
+    bool   primary = false;
+  };
+
   struct AudioStreamConfig: public AudioCaptureConfig
   {
     std::string rtspUrl;
@@ -149,20 +304,43 @@ namespace smv {
 
   struct VideoStreamConfig: public VideoCaptureConfig
   {
+    /**
+     * @brief Where the H.264/H.265 stream is served
+     * @details rtsp://host[:port][/path]. Defaults to rtsp://127.0.0.1:8554/
+     */
     std::string rtspUrl;
+
+    /**
+     * @brief Where the MJPEG live view is served
+     * @details http://host[:port][/path]. Defaults to http://127.0.0.1:8080/
+     */
+    std::string httpUrl;
   };
 
   /**
    * @brief Asynchronously start capturing for a video stream
    *
    * @param config The configuration for the capture
-   * @param format The format of the capture
-   * @param callback The callback to call as capture continues
+   * @param format The format of the capture. Only VideoCaptureFormat::H264 is
+   * supported for now, and only in builds with x264 enabled; other formats
+   * are logged as errors and the callback is never called
+   * @param callback Called on a thread of its own with the source, whose
+   * next returns each encoded access unit. The capture runs for as long as
+   * next is being called
    */
   void capture(const VideoCaptureConfig &config,
                VideoCaptureFormat        format,
                CaptureCb                 callback);
 
+  /**
+   * @brief Asynchronously start capturing audio
+   *
+   * @param config The configuration for the capture
+   * @param format The format of the capture. Only AudioCaptureFormat::OPUS is
+   * supported for now; other formats are logged as errors and the callback
+   * is never called
+   * @param callback The callback to call as capture continues
+   */
   void capture(const AudioCaptureConfig &config,
                AudioCaptureFormat        format,
                CaptureCb                 callback);
@@ -178,9 +356,226 @@ namespace smv {
                ScreenshotFormat        format,
                CaptureCb               callback);
 
-  void captureStream(const VideoStreamConfig &config,
+  /**
+   * @brief An uncompressed capture
+   * @details The pixels are 32 bits each, laid out in memory as blue, green,
+   * red, alpha. On little endian machines this is
+   * QImage::Format_ARGB32_Premultiplied, or QImage::Format_RGB32 when the
+   * capture has no alpha, in which case the alpha byte is 0xFF. The pixels
+   * stay valid for as long as a copy of the image (or of its buffer) is alive
+   */
+  struct RawImage
+  {
+    const uint8_t *data   = nullptr;
+    uint32_t       width  = 0;
+    uint32_t       height = 0;
+    // the number of bytes between the start of two consecutive rows
+    uint32_t stride = 0;
+    // the pixels have alpha, premultiplied into their colors as the X server
+    // stores them. Otherwise every pixel is opaque
+    bool hasAlpha = false;
+    // owns the pixels
+    std::shared_ptr<const void> buffer;
+  };
+
+  /**
+   * @brief Asynchronously capture an image, without encoding it
+   * @details Meant for when the pixels are used straight away, such as
+   * putting them on the clipboard or showing them, where encoding and then
+   * decoding a screenshot would be wasted work
+   *
+   * @param config The configuration for the capture
+   * @param callback Called with the image, or an error message
+   */
+  void captureImage(
+    const ScreenshotConfig                                   &config,
+    std::function<void(std::variant<RawImage, std::string>)> callback);
+
+  /**
+   * @brief Watch an area, e.g. to show it before it is recorded
+   * @details Meant for a low fpsHint and a small outputSize. The frames come
+   * from the same capture as any recording or stream of the same config.
+   * Each image shares its pixels with the capture, which does not reuse them
+   * until the image is released.
+   * The callback runs on a thread of its own. Frames captured while it runs
+   * are skipped, except for the latest
+   *
+   * @param config The configuration for the capture
+   * @param callback Called with every new frame
+   * @return Cancel stops the preview, once a running callback returns. Must
+   * not be called from the callback
+   */
+  auto capturePreview(const VideoCaptureConfig     &config,
+                      std::function<void(RawImage)> callback) -> Cancel;
+
+  /**
+   * @brief Start keeping the last few seconds of the capture in memory
+   * @details Only one replay buffer runs at a time. Starting a new one stops
+   * the previous one
+   *
+   * @param config The configuration for the capture and the buffer
+   * @return Cancel stops the capture and frees the buffer
+   */
+  auto captureReplay(const ReplayConfig &config) -> Cancel;
+
+  /**
+   * @brief Write the end of the replay buffer to a file
+   * @details The capture keeps running while the file is written. The file is
+   * a Matroska (.mkv) file of motion JPEG frames, and of Opus audio if the
+   * replay records audio, each stamped with the time it was captured at, so
+   * it plays at the speed it happened even when frames were skipped. It
+   * starts at the nearest frame before the requested time
+   *
+   * @param path Where to write the replay
+   * @param last How much of the end of the buffer to write
+   * @param callback Called once the file is written, with an error message if
+   * it could not be
+   */
+  void saveReplay(const std::string                              &path,
+                  std::chrono::seconds                            last,
+                  std::function<void(std::optional<std::string>)> callback);
+
+  /**
+   * @brief Start recording to a raw file
+   *
+   * @param config The configuration for the capture and the file
+   * @param callback Called once the file is finished, with an error message
+   * if the recording failed
+   * @return Cancel stops the recording
+   */
+  auto captureRaw(const RawRecordConfig                          &config,
+                  std::function<void(std::optional<std::string>)> callback)
+    -> Cancel;
+
+  /**
+   * @brief List the monitors of the desktop
+   * @details Empty if capture has not been initialized
+   */
+  auto monitors() -> std::vector<Monitor>;
+
+  /**
+   * @brief Record every monitor to a raw file of its own
+   * @details Each monitor is grabbed and compressed on its own threads, so
+   * adding a monitor does not slow the others down. The area of the config
+   * is ignored, and the name of each monitor is added to the path before
+   * its extension: recording.smvraw becomes recording-DP-1.smvraw
+   *
+   * @param config The configuration for the captures and the files
+   * @param callback Called once every file is finished, with an error
+   * message if any of the recordings failed
+   * @return Cancel stops every recording
+   */
+  auto captureMonitors(
+    const RawRecordConfig                          &config,
+    std::function<void(std::optional<std::string>)> callback) -> Cancel;
+
+  /**
+   * @brief Encode a raw recording, in the background
+   * @details The recording is split at its keyframes, which are encoded in
+   * parallel
+   *
+   * @param input The raw recording
+   * @param output Where to write the encoded video
+   * @param format The format to encode to. Only VideoCaptureFormat::H264 is
+   * supported for now, and only in builds with x264 enabled
+   * @param callback Called once the file is written, with an error message if
+   * it could not be
+   */
+  void transcodeRaw(const std::string                              &input,
+                    const std::string                              &output,
+                    VideoCaptureFormat                              format,
+                    std::function<void(std::optional<std::string>)> callback);
+
+  /**
+   * @brief The ways pixels can be read from the display server
+   */
+  enum class CapturePath
+  {
+    // copied over the connection
+    GetImage  = 0x1,
+    // written by the server into shared memory
+    Shm       = 0x2,
+    // read from the offscreen pixmap a compositor keeps for a window
+    Composite = 0x4,
+  };
+
+  /**
+   * @brief How fast a capture path grabbed a given area
+   */
+  struct CapturePathProbe
+  {
+    CapturePath path = CapturePath::GetImage;
+    // a window was grabbed, rather than a region of the screen
+    bool     window = false;
+    uint64_t pixels = 0;
+    // the median time of a grab
+    std::chrono::microseconds time {};
+    // the path worked at all
+    bool available = false;
+  };
+
+  /**
+   * @brief What the capture paths were measured at, for diagnostics
+   * @details Each grab goes through the path that was fastest for the same
+   * kind of source and the nearest size
+   */
+  struct CapturePathReport
+  {
+    std::vector<CapturePathProbe> probes;
+    // the probes were loaded from a previous run, rather than measured
+    bool        cached = false;
+    std::string cachePath;
+  };
+
+  /**
+   * @brief How long the capture pipeline took to warm up
+   */
+  struct WarmUpReport
+  {
+    // setting up the capture buffer
+    std::chrono::microseconds prepare {};
+    // the first grab and conversion of the whole screen
+    std::chrono::microseconds firstFrame {};
+    // the median of the grabs after the first one
+    std::chrono::microseconds steadyFrame {};
+    // the whole warm-up, encoders included
+    std::chrono::microseconds  total {};
+    std::optional<std::string> error;
+  };
+
+  /**
+   * @brief Prepare the capture pipeline in the background, so that the first
+   * capture is as fast as the ones after it
+   * @details Sets up the capture buffer and faults its pages in, measures
+   * the capture paths (see capturePaths), starts the worker threads, grabs
+   * the screen a few times, and loads the encoders.
+   * Called by init, and safe to call again: once the warm-up is done, the
+   * callback is called right away with the same report
+   *
+   * @param callback Called once the pipeline is warm
+   */
+  void warmUp(std::function<void(const WarmUpReport &)> callback = nullptr);
+
+  /**
+   * @brief The measures of the capture paths, taken during the warm-up
+   * @details Empty until the warm-up is done
+   */
+  auto capturePaths() -> CapturePathReport;
+
+  /**
+   * @brief Publish the capture as a network stream
+   * @details The stream is served over RTSP (H264) or HTTP (MJPEG), on the
+   * url of the config. Without a callback, the stream runs until cancelled
+   *
+   * @param config The configuration for the capture and the server
+   * @param format The format of the stream
+   * @param callback Called with the stream, which it drives by calling next,
+   * on its own thread. Can be empty
+   * @return Cancel ends the stream, and stops the server
+   */
+  auto captureStream(const VideoStreamConfig &config,
                      VideoStreamFormat        format,
-                     CaptureCb                callback);
+                     CaptureCb                callback) -> Cancel;
 
   void captureStream(const AudioStreamConfig &config,
                      AudioStreamFormat        format,
@@ -10,12 +10,15 @@ Item {
     required property var streamCallback
     readonly property ApplicationWindow target: ApplicationWindow.window
     property point targetPos
+    // the next screenshot goes to the clipboard instead of a file
+    property bool copyToClipboard: false
 
     signal mediaCaptureRequested(int mode)
     signal mediaCaptureStarted(int mode)
     signal mediaCaptureFailed(int mode, string error)
     signal mediaCaptureSuccess(int mode, variant result)
     signal mediaCaptureRequestEnded(int mode)
+    signal screenshotCopied(var image)
 
     Component.onCompleted: {
         // https://doc.qt.io/qt-5/qtqml-syntax-signals.html#connecting-signals-to-methods-and-signals
@@ -23,6 +26,7 @@ Item {
         AppCore.mediaCaptureFailed.connect(root.mediaCaptureFailed);
         AppCore.mediaCaptureSuccess.connect(root.mediaCaptureSuccess);
         AppCore.mediaCaptureStopped.connect(root.mediaCaptureRequestEnded);
+        AppCore.screenshotCopied.connect(root.screenshotCopied);
         targetPos = Qt.point(target.x, target.y);
     }
 
@@ -148,6 +152,10 @@ Item {
             console.log("Media capture success...", result);
         }
 
+        function onScreenshotCopied(image: var) {
+            console.log("Screenshot copied to the clipboard");
+        }
+
         function onMediaCaptureRequestEnded(mode: int) {
             switch (mode) {
             case CaptureMode.Screenshot:
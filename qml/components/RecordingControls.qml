@@ -5,7 +5,9 @@ import QtQml 2.15
 import QtQuick 2.15
 import QtQuick.Controls 2.15
 import QtQuick.Layouts 1.15
+import smv.app.AppCore 1.0
 import smv.app.CaptureMode 1.0
+import smv.app.CapturePreview 1.0
 
 Item {
     id: root
@@ -20,6 +22,7 @@ Item {
     readonly property int controlsY: controls.y
 
     signal takeScreenshot
+    signal copyScreenshot
     signal openRecordMenu(bool open)
     signal recordRegion(bool streaming)
 
@@ -53,6 +56,9 @@ Item {
                 function onTakeScreenshot() {
                     Qt.callLater(root.takeScreenshot);
                 }
+                function onCopyScreenshot() {
+                    Qt.callLater(root.copyScreenshot);
+                }
             }
 
             Loader {
@@ -104,6 +110,8 @@ Item {
             property int hoverHeight: 44
 
             signal takeScreenshot
+            // right click: to the clipboard instead of a file
+            signal copyScreenshot
 
             containmentMask: button
             implicitWidth: hovered ? hoverWidth : 38
@@ -161,7 +169,14 @@ Item {
 
                 anchors.fill: parent
                 hoverEnabled: true
-                onClicked: Qt.callLater(takeScreenshot)
+                acceptedButtons: Qt.LeftButton | Qt.RightButton
+                onClicked: mouse => {
+                    if (mouse.button === Qt.RightButton) {
+                        Qt.callLater(copyScreenshot);
+                    } else {
+                        Qt.callLater(takeScreenshot);
+                    }
+                }
             }
 
             Behavior on implicitWidth {
@@ -190,7 +205,12 @@ Item {
     Component {
         id: recordControls
 
-        Item {}
+        // what is about to be recorded
+        CapturePreview {
+            implicitWidth: 64
+            implicitHeight: 36
+            region: AppCore.recordRegion
+        }
     }
 
     component ActionButton: Item {
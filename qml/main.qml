@@ -44,7 +44,11 @@ ApplicationWindow {
             const y = Math.max(0, root.y);
             const w = Math.min(root.width + (root.x > 0 ? 0 : root.x), Screen.width - root.x);
             const h = Math.min(root.height + (root.y > 0 ? 0 : root.y), Screen.height - root.y);
-            AppCore.takeScreenshot(Qt.rect(x, y, w, h), AppData.screenshot);
+            if (mediaCapture.copyToClipboard) {
+                AppCore.copyScreenshot(Qt.rect(x, y, w, h));
+            } else {
+                AppCore.takeScreenshot(Qt.rect(x, y, w, h), AppData.screenshot);
+            }
         }
 
         recordingCallback: () => {
@@ -147,6 +151,11 @@ ApplicationWindow {
             mode: parent.mode
             drawerOpen: parent.mediaListOpen
             onTakeScreenshot: {
+                mediaCapture.copyToClipboard = false;
+                mediaCapture.mediaCaptureRequested(CaptureMode.Screenshot);
+            }
+            onCopyScreenshot: {
+                mediaCapture.copyToClipboard = true;
                 mediaCapture.mediaCaptureRequested(CaptureMode.Screenshot);
             }
             onOpenRecordMenu: open => {
@@ -7,7 +7,9 @@
 #include "smv_capture.hpp"
 #include "smv_utils.hpp"
 
+#include <QClipboard>
 #include <QDateTime>
+#include <QGuiApplication>
 #include <QMetaEnum>
 #include <QObject>
 #include <QPropertyAnimation>
@@ -70,6 +72,9 @@ void AppCore::operator()(const smv::EventDataMouseEnter &data)
 void AppCore::setQmlWindow(QWindow *window)
 {
   mQmlWindow = window;
+  // the capture UI is up: make sure the first capture does not pay for
+  // setting up the pipeline. Does nothing if it is already warm
+  smv::warmUp();
 }
 
 void AppCore::takeScreenshot(const QRect &rect, QObject *screenshotConfig)
@@ -123,6 +128,45 @@ void AppCore::takeScreenshot(const QRect &rect, QObject *screenshotConfig)
   });
 }
 
+void AppCore::copyScreenshot(const QRect &rect)
+{
+  emit mediaCaptureStarted(CaptureMode::Screenshot);
+  auto config = smv::ScreenshotConfig { rectToRegion(rect) };
+  if (!config.isValid()) {
+    auto msg =
+      fmt::format("Invalid screenshot region: x: {}, y: {}, w: {}, h: {}",
+                  rect.x(),
+                  rect.y(),
+                  rect.width(),
+                  rect.height());
+    emit mediaCaptureFailed(CaptureMode::Screenshot,
+                            QString::fromStdString(msg));
+    spdlog::error(msg);
+    return;
+  }
+  // the clipboard keeps the image as it is, and only encodes it for a
+  // client that asks for a format other than an image
+  smv::captureImage(
+    config, [this](std::variant<smv::RawImage, std::string> result) {
+    if (std::holds_alternative<std::string>(result)) {
+      auto msg = fmt::format("Failed to copy screenshot: {}",
+                             std::get<std::string>(result));
+      emit mediaCaptureFailed(CaptureMode::Screenshot,
+                              QString::fromStdString(msg));
+      spdlog::error(msg);
+      return;
+    }
+    auto image = rawImageToQImage(std::get<smv::RawImage>(std::move(result)));
+    QMetaObject::invokeMethod(this, [this, image = std::move(image)]() {
+      QGuiApplication::clipboard()->setImage(image);
+      spdlog::info("Screenshot copied: {}x{}", image.width(), image.height());
+      emit screenshotCopied(image);
+      emit mediaCaptureSuccess(CaptureMode::Screenshot,
+                               QVariant::fromValue(image));
+    });
+  });
+}
+
 void AppCore::startRecording() {}
 
 void AppCore::streamRecording() {}
@@ -130,21 +174,30 @@ void AppCore::streamRecording() {}
 void AppCore::updateRecordRegion(const QRect &rect)
 {
   mRecordRegion = rect;
+  emit recordRegionChanged(mRecordRegion);
 }
 
 void AppCore::updateRecordRegion(const QPoint &point)
 {
   mRecordRegion.moveTo(point);
+  emit recordRegionChanged(mRecordRegion);
 }
 
 void AppCore::updateRecordRegion(const QSize &size)
 {
   mRecordRegion.setSize(size);
+  emit recordRegionChanged(mRecordRegion);
 }
 
 void AppCore::updateRecordRegion(const QSize &size, const QPoint &point)
 {
   mRecordRegion = QRect(point, size);
+  emit recordRegionChanged(mRecordRegion);
+}
+
+auto AppCore::recordRegion() const -> QRect
+{
+  return mRecordRegion;
 }
 
 auto AppCore::targetWindow() const -> std::shared_ptr<smv::Window>
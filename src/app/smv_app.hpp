@@ -5,6 +5,7 @@
 #include <memory>
 #include <shared_mutex>
 
+#include <QImage>
 #include <QJSEngine>
 #include <QObject>
 #include <QPropertyAnimation>
@@ -19,6 +20,7 @@ class AppCore: public QObject
   // https://doc.qt.io/qt-5/qtqml-cppintegration-exposecppattributes.html
   Q_OBJECT
   Q_PROPERTY(Mode mode MEMBER mMode NOTIFY modeChanged)
+  Q_PROPERTY(QRect recordRegion READ recordRegion NOTIFY recordRegionChanged)
   Q_PROPERTY(std::shared_ptr<smv::Window> targetWindow READ targetWindow WRITE
                setTargetWindow NOTIFY targetWindowChanged)
   explicit AppCore(QObject *parent = nullptr);
@@ -34,6 +36,7 @@ public:
   Q_ENUM(Mode)
 
   auto targetWindow() const -> std::shared_ptr<smv::Window>;
+  auto recordRegion() const -> QRect;
   void setQmlWindow(QWindow *window);
   void setTargetWindow(const std::shared_ptr<smv::Window> &);
   void operator()(const smv::EventDataMouseEnter &data);
@@ -41,6 +44,7 @@ public:
 
 signals:
   void modeChanged(Mode);
+  void recordRegionChanged(const QRect &);
   void targetWindowMoved(const QPoint &);
   void targetWindowResized(const QSize &);
   void targetWindowChanged(const QSize &, const QPoint &);
@@ -48,6 +52,7 @@ signals:
   void mediaCaptureSuccess(CaptureMode, const QVariant &);
   void mediaCaptureFailed(CaptureMode, const QString &);
   void mediaCaptureStopped(CaptureMode);
+  void screenshotCopied(const QImage &);
 
 private slots:
   void startRecording();
@@ -59,6 +64,7 @@ public slots:
   void updateRecordRegion(const QSize &);
   void updateRecordRegion(const QSize &, const QPoint &);
   void takeScreenshot(const QRect &rect, QObject *);
+  void copyScreenshot(const QRect &rect);
 
 private:
   QRect                        mRecordRegion;
@@ -30,6 +30,7 @@ auto AppData::screenshot() -> ScreenshotsConfig *
 
 ScreenshotsConfig::ScreenshotsConfig(QObject *parent)
   : QObject(parent)
+  , mSettings(category())
 {
   QSettings settings;
   settings.beginGroup(category());
@@ -56,7 +57,7 @@ ScreenshotsConfig::ScreenshotsConfig(QObject *parent)
       screenshotsPath /
       QCoreApplication::applicationName().toLower().toStdString();
     mSaveLocation = QString::fromStdString(appScreenshots.string());
-    settings.setValue("saveLocation", mSaveLocation);
+    mSettings.setValue("saveLocation", mSaveLocation);
   } else {
     mSaveLocation = saveLocation.toString();
   }
@@ -64,7 +65,7 @@ ScreenshotsConfig::ScreenshotsConfig(QObject *parent)
   if (auto format = settings.value("format"); format.isNull()) {
     if (!formatsList().isEmpty()) {
       mFormat = formatsList().first();
-      settings.setValue("format", mFormat);
+      mSettings.setValue("format", mFormat);
     }
   } else {
     mFormat = format.toString();
@@ -72,14 +73,14 @@ ScreenshotsConfig::ScreenshotsConfig(QObject *parent)
 
   if (auto prefix = settings.value("prefix"); prefix.isNull()) {
     mPrefix = "Screenshot_";
-    settings.setValue("prefix", mPrefix);
+    mSettings.setValue("prefix", mPrefix);
   } else {
     mPrefix = prefix.toString();
   }
 
   if (auto suffix = settings.value("suffix"); suffix.isNull()) {
     mSuffix = "yyyy-MMM-dd_hh-mm-ss-zzz";
-    settings.setValue("suffix", mSuffix);
+    mSettings.setValue("suffix", mSuffix);
   } else {
     mSuffix = suffix.toString();
   }
@@ -89,11 +90,7 @@ void ScreenshotsConfig::setFormat(const QString &format)
 {
   if (mFormat != format) {
     mFormat = format;
-    QSettings settings;
-    settings.beginGroup(category());
-    settings.setValue("format", mFormat);
-    settings.endGroup();
-    settings.sync();
+    mSettings.setValue("format", mFormat);
   }
 }
 
@@ -101,11 +98,7 @@ void ScreenshotsConfig::setPrefix(const QString &prefix)
 {
   if (mPrefix != prefix) {
     mPrefix = prefix;
-    QSettings settings;
-    settings.beginGroup(category());
-    settings.setValue("prefix", mPrefix);
-    settings.endGroup();
-    settings.sync();
+    mSettings.setValue("prefix", mPrefix);
   }
 }
 
@@ -113,11 +106,7 @@ void ScreenshotsConfig::setSuffix(const QString &suffix)
 {
   if (mSuffix != suffix) {
     mSuffix = suffix;
-    QSettings settings;
-    settings.beginGroup(category());
-    settings.setValue("suffix", mSuffix);
-    settings.endGroup();
-    settings.sync();
+    mSettings.setValue("suffix", mSuffix);
   }
 }
 
@@ -125,11 +114,7 @@ void ScreenshotsConfig::setSaveLocation(const QString &saveLocation)
 {
   if (mSaveLocation != saveLocation) {
     mSaveLocation = saveLocation;
-    QSettings settings;
-    settings.beginGroup(category());
-    settings.setValue("saveLocation", mSaveLocation);
-    settings.endGroup();
-    settings.sync();
+    mSettings.setValue("saveLocation", mSaveLocation);
   }
 }
 
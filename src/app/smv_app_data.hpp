@@ -1,5 +1,6 @@
 #pragma once
 
+#include "smv_settings.hpp"
 #include "smv_utils.hpp"
 
 #include <QCursor>
@@ -80,6 +81,8 @@ public:
 
 private:
   QString mSaveLocation, mFormat, mPrefix, mSuffix;
+  // setters only change the values in memory. This saves them
+  SettingsWriter mSettings;
 
   inline auto static category() -> const char * { return "Screenshots"; }
   inline auto static formatsList() -> QStringList
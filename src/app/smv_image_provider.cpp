@@ -1,44 +1,145 @@
 #include "smv_image_provider.hpp"
 
+#include <utility>
+
+#include <QDirIterator>
+#include <QGuiApplication>
 #include <QPainter>
+#include <QRunnable>
 #include <QSvgRenderer>
 
 static auto constexpr DEFAULT_IMAGE_WIDTH  = 48;
 static auto constexpr DEFAULT_IMAGE_HEIGHT = 48;
+// the cache is limited by the bytes of its images. Enough for every icon at
+// a few sizes, on a high density screen
+static auto constexpr CACHE_BYTES = 8 << 20;
+// the sizes the icons are shown at, see the qml components
+static constexpr int PRELOAD_SIZES[] = { 24, 32, 38, 40, 44, 48 }; // NOLINT
+
+namespace {
+  /**
+   * @brief rasterize an image of the qrc at the given size in device pixels
+   */
+  auto rasterize(const QString &imgId, const QSize &size, qreal dpr) -> QImage
+  {
+    auto   imageSource = QString(":/%1").arg(imgId);
+    QImage image(size * dpr, QImage::Format_ARGB32_Premultiplied);
+    image.fill(Qt::transparent);
+
+    if (imgId.endsWith(".svg", Qt::CaseInsensitive)) {
+      QSvgRenderer renderer(imageSource);
+      QPainter     painter(&image);
+      renderer.render(&painter);
+    } else {
+      image.load(imageSource);
+    }
+    image.setDevicePixelRatio(dpr);
+    return image;
+  }
+
+  auto cacheKey(const QString &imgId, const QSize &size, qreal dpr) -> QString
+  {
+    return QString("%1@%2x%3@%4")
+      .arg(imgId)
+      .arg(size.width())
+      .arg(size.height())
+      .arg(dpr);
+  }
+
+  /**
+   * @brief rasterizes one image on the provider's pool
+   */
+  class AppImageResponse
+    : public QQuickImageResponse
+    , public QRunnable
+  {
+  public:
+    AppImageResponse(AppImageProvider &provider,
+                     QString           imgId,
+                     const QSize      &requestedSize)
+      : mProvider(provider)
+      , mId(std::move(imgId))
+      , mRequestedSize(requestedSize)
+    {
+      setAutoDelete(false);
+    }
+
+    auto textureFactory() const -> QQuickTextureFactory * override
+    {
+      return QQuickTextureFactory::textureFactoryForImage(mImage);
+    }
+
+    void run() override
+    {
+      mImage = mProvider.image(mId, mRequestedSize);
+      emit finished();
+    }
+
+  private:
+    AppImageProvider &mProvider;
+    const QString     mId;
+    const QSize       mRequestedSize;
+    QImage            mImage;
+  };
+} // namespace
 
 AppImageProvider::AppImageProvider(QObject *parent)
   : QObject(parent)
-  , QQuickImageProvider(QQuickImageProvider::Image)
+  , mCache(CACHE_BYTES)
 {
+  preload();
 }
 
-// TODO: Apparently svg images can be slow to load.
-// Can we make use of some of the tips given here:
-// https://wiki.qt.io/Performance_tip_Images, to make it faster?
-auto AppImageProvider::requestImage(const QString &imgId,
-                                    QSize         *size,
-                                    const QSize   &requestedSize) -> QImage
+AppImageProvider::~AppImageProvider()
 {
-  auto imageSource = QString(":/%1").arg(imgId);
-  auto width       = requestedSize.width();
-  auto height      = requestedSize.height();
+  mPool.clear();
+  mPool.waitForDone();
+}
 
+auto AppImageProvider::requestImageResponse(const QString &imgId,
+                                            const QSize   &requestedSize)
+  -> QQuickImageResponse *
+{
+  auto *response = new AppImageResponse(*this, imgId, requestedSize);
+  mPool.start(response);
+  return response;
+}
+
+auto AppImageProvider::image(const QString &imgId, const QSize &requestedSize)
+  -> QImage
+{
+  auto size = requestedSize;
   if (!requestedSize.isValid()) {
-    width  = DEFAULT_IMAGE_WIDTH;
-    height = DEFAULT_IMAGE_HEIGHT;
+    size = QSize(DEFAULT_IMAGE_WIDTH, DEFAULT_IMAGE_HEIGHT);
   }
-  if (size != nullptr) {
-    *size = QSize(width, height);
-  }
-  QImage image(width, height, QImage::Format_ARGB32);
-  image.fill(Qt::transparent);
-
-  if (imgId.endsWith(".svg", Qt::CaseInsensitive)) {
-    QSvgRenderer renderer(imageSource);
-    QPainter     painter(&image);
-    renderer.render(&painter);
-  } else {
-    image.load(imageSource);
+  auto dpr = qGuiApp != nullptr ? qGuiApp->devicePixelRatio() : 1.0;
+  auto key = cacheKey(imgId, size, dpr);
+  {
+    std::lock_guard _(mMutex);
+    if (const auto *cached = mCache.object(key)) {
+      return *cached;
+    }
   }
+  // rasterized outside of the lock. Two threads asking for the same image
+  // at once both rasterize it, which is cheaper than making one wait
+  auto image = rasterize(imgId, size, dpr);
+  std::lock_guard _(mMutex);
+  mCache.insert(key, new QImage(image), static_cast<int>(image.sizeInBytes()));
   return image;
 }
+
+void AppImageProvider::preload()
+{
+  QStringList icons;
+  for (QDirIterator it(":/icons"); it.hasNext();) {
+    // ids are relative to the root of the qrc
+    icons << it.next().mid(2);
+  }
+  mPool.start([this, icons]() {
+    for (const auto &icon : icons) {
+      for (auto size : PRELOAD_SIZES) {
+        image(icon, QSize(size, size));
+      }
+    }
+  });
+}
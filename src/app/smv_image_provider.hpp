@@ -1,18 +1,43 @@
 #pragma once
 
+#include <mutex>
+
+#include <QCache>
 #include <QImage>
 #include <QObject>
-#include <QQuickImageProvider>
+#include <QQuickAsyncImageProvider>
+#include <QThreadPool>
 
-// TODO: Consider using QQuickAsyncImageProvider.
-// https://doc.qt.io/qt-5/qquickasyncimageprovider.html
+/**
+ * @brief Serves the app's icons and images to QML
+ *
+ * @details Images are rasterized on a thread pool, never on the thread that
+ * asked for them, and kept in an LRU cache keyed by the image, its size and
+ * the device pixel ratio. The icons are rasterized at the common sizes as
+ * soon as the provider is created, so the first hover or mode change does
+ * not have to parse an SVG
+ */
 class AppImageProvider
   : public QObject
-  , public QQuickImageProvider
+  , public QQuickAsyncImageProvider
 {
 public:
   explicit AppImageProvider(QObject * = nullptr);
-  auto requestImage(const QString & /*id*/,
-                    QSize * /*size*/,
-                    const QSize & /*requestedSize*/) -> QImage override;
+  ~AppImageProvider() override;
+  auto requestImageResponse(const QString & /*id*/,
+                            const QSize & /*requestedSize*/)
+    -> QQuickImageResponse * override;
+
+  /**
+   * @brief get the image from the cache, or rasterize and cache it
+   * @details Safe to call from any thread
+   */
+  auto image(const QString &imgId, const QSize &requestedSize) -> QImage;
+
+private:
+  void preload();
+
+  QThreadPool             mPool;
+  std::mutex              mMutex;
+  QCache<QString, QImage> mCache;
 };
@@ -0,0 +1,150 @@
+#include "smv_preview.hpp"
+#include "smv/record.hpp"
+#include "smv_utils.hpp"
+
+#include <algorithm>
+#include <utility>
+
+#include <QQuickWindow>
+#include <QSGSimpleTextureNode>
+
+// long enough to cover the moves of a window being dragged
+static auto constexpr RESTART_DELAY_MS = 150;
+
+CapturePreview::CapturePreview(QQuickItem *parent)
+  : QQuickItem(parent)
+{
+  setFlag(ItemHasContents);
+  mRestart.setSingleShot(true);
+  mRestart.setInterval(RESTART_DELAY_MS);
+  QObject::connect(&mRestart, &QTimer::timeout, this, &CapturePreview::restart);
+}
+
+CapturePreview::~CapturePreview()
+{
+  stop();
+}
+
+auto CapturePreview::region() const -> QRect
+{
+  return mRegion;
+}
+
+void CapturePreview::setRegion(const QRect &region)
+{
+  if (region == mRegion) {
+    return;
+  }
+  mRegion = region;
+  emit regionChanged();
+  mRestart.start();
+}
+
+auto CapturePreview::fps() const -> int
+{
+  return mFps;
+}
+
+void CapturePreview::setFps(int fps)
+{
+  if (fps == mFps) {
+    return;
+  }
+  mFps = fps;
+  emit fpsChanged();
+  mRestart.start();
+}
+
+auto CapturePreview::active() const -> bool
+{
+  return mActive;
+}
+
+void CapturePreview::setActive(bool active)
+{
+  if (active == mActive) {
+    return;
+  }
+  mActive = active;
+  emit activeChanged();
+  mRestart.start();
+}
+
+void CapturePreview::geometryChanged(const QRectF &newGeometry,
+                                     const QRectF &oldGeometry)
+{
+  QQuickItem::geometryChanged(newGeometry, oldGeometry);
+  if (newGeometry.size() != oldGeometry.size()) {
+    mRestart.start();
+  }
+}
+
+void CapturePreview::restart()
+{
+  stop();
+  if (!mActive || mRegion.isEmpty() || width() < 1 || height() < 1) {
+    update();
+    return;
+  }
+  auto dpr =
+    window() != nullptr ? window()->effectiveDevicePixelRatio() : 1.0;
+  auto config       = smv::VideoCaptureConfig {};
+  config.area       = rectToRegion(mRegion);
+  config.fpsHint    = static_cast<uint8_t>(std::clamp(mFps, 1, DEFAULT_FPS));
+  config.outputSize = smv::Size { static_cast<uint32_t>(width() * dpr),
+                                  static_cast<uint32_t>(height() * dpr) };
+  // runs on the capture thread
+  mCancel = smv::capturePreview(config, [this](smv::RawImage image) {
+    auto frame = rawImageToQImage(std::move(image));
+    {
+      std::lock_guard _(mMutex);
+      mPending = std::move(frame);
+    }
+    QMetaObject::invokeMethod(this, &QQuickItem::update, Qt::QueuedConnection);
+  });
+}
+
+void CapturePreview::stop()
+{
+  if (mCancel) {
+    std::exchange(mCancel, nullptr)();
+  }
+  std::lock_guard _(mMutex);
+  mPending = QImage();
+}
+
+auto CapturePreview::updatePaintNode(QSGNode *oldNode,
+                                     UpdatePaintNodeData * /*unused*/)
+  -> QSGNode *
+{
+  auto *node = static_cast<QSGSimpleTextureNode *>(oldNode);
+  if (!mCancel) {
+    delete node;
+    return nullptr;
+  }
+  QImage frame;
+  {
+    std::lock_guard _(mMutex);
+    frame = std::exchange(mPending, QImage());
+  }
+  if (!frame.isNull()) {
+    if (node == nullptr) {
+      node = new QSGSimpleTextureNode();
+      node->setOwnsTexture(true);
+      node->setFiltering(QSGTexture::Linear);
+    }
+    // the texture keeps the image, which keeps the capture buffer, until it
+    // is uploaded. Replacing it deletes the previous one
+    node->setTexture(window()->createTextureFromImage(frame));
+  }
+  if (node == nullptr) {
+    return nullptr;
+  }
+  // fit the frame in the item, keeping its aspect ratio
+  auto size = QSizeF(node->texture()->textureSize())
+                .scaled(boundingRect().size(), Qt::KeepAspectRatio);
+  node->setRect(QRectF(QPointF((width() - size.width()) / 2,
+                               (height() - size.height()) / 2),
+                       size));
+  return node;
+}
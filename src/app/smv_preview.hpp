@@ -0,0 +1,76 @@
+#pragma once
+
+#include "smv/events.hpp"
+
+#include <mutex>
+
+#include <QImage>
+#include <QQmlEngine>
+#include <QQuickItem>
+#include <QRect>
+#include <QTimer>
+#include <spdlog/spdlog.h>
+
+/**
+ * @brief Shows a live, downscaled view of an area of the screen
+ *
+ * @details The area is captured at a low rate, at the size of the item.
+ * Every frame is wrapped in a QImage and uploaded as a texture straight from
+ * the capture buffer, without being copied first.
+ * Changes to the region are coalesced, so following a window that is being
+ * dragged does not restart the capture for every move
+ */
+class CapturePreview: public QQuickItem
+{
+  Q_OBJECT
+  Q_PROPERTY(QRect region READ region WRITE setRegion NOTIFY regionChanged)
+  Q_PROPERTY(int fps READ fps WRITE setFps NOTIFY fpsChanged)
+  Q_PROPERTY(bool active READ active WRITE setActive NOTIFY activeChanged)
+
+public:
+  explicit CapturePreview(QQuickItem *parent = nullptr);
+  ~CapturePreview() override;
+
+  auto region() const -> QRect;
+  void setRegion(const QRect &region);
+  auto fps() const -> int;
+  void setFps(int fps);
+  auto active() const -> bool;
+  void setActive(bool active);
+
+signals:
+  void regionChanged();
+  void fpsChanged();
+  void activeChanged();
+
+protected:
+  auto updatePaintNode(QSGNode *node, UpdatePaintNodeData *data)
+    -> QSGNode * override;
+  void geometryChanged(const QRectF &newGeometry,
+                       const QRectF &oldGeometry) override;
+
+private:
+  void restart();
+  void stop();
+
+  QRect       mRegion;
+  int         mFps    = PREVIEW_FPS;
+  bool        mActive = true;
+  QTimer      mRestart;
+  smv::Cancel mCancel;
+  std::mutex  mMutex;
+  // the latest frame, until the render thread picks it up
+  QImage mPending;
+
+public:
+  static constexpr auto PREVIEW_FPS = 5;
+  static constexpr auto QML_NAME    = "CapturePreview";
+  static constexpr auto QML_URI     = "smv.app.CapturePreview";
+  [[maybe_unused]] inline static auto registerType() -> int
+  {
+    auto typeId = qmlRegisterType<CapturePreview>(QML_URI, 1, 0, QML_NAME);
+    spdlog::info(
+      "CapturePreview registered. Name={}, URL={}", QML_NAME, QML_URI);
+    return typeId;
+  }
+};
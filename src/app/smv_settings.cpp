@@ -0,0 +1,72 @@
+#include "smv_settings.hpp"
+
+#include <utility>
+
+#include <QCoreApplication>
+#include <QSettings>
+#include <spdlog/spdlog.h>
+
+// how long the values have to stay put before they are written, e.g. while
+// typing in a settings field
+static auto constexpr QUIET_PERIOD_MS = 500;
+
+SettingsWriter::SettingsWriter(QString group)
+  : mGroup(std::move(group))
+{
+  mQuiet.setSingleShot(true);
+  mQuiet.setInterval(QUIET_PERIOD_MS);
+  QObject::connect(&mQuiet, &QTimer::timeout, &mQuiet, [this]() { write(); });
+  // a single thread keeps the batches in order
+  mWriter.setMaxThreadCount(1);
+  if (auto *app = QCoreApplication::instance()) {
+    QObject::connect(app, &QCoreApplication::aboutToQuit, &mQuiet, [this]() {
+      flush();
+    });
+  }
+}
+
+SettingsWriter::~SettingsWriter()
+{
+  flush();
+}
+
+void SettingsWriter::setValue(const QString &key, const QVariant &value)
+{
+  {
+    std::lock_guard _(mMutex);
+    mPending.insert(key, value);
+  }
+  // restarted by every value, so a burst of them is written once
+  mQuiet.start();
+}
+
+void SettingsWriter::flush()
+{
+  mQuiet.stop();
+  write();
+  mWriter.waitForDone();
+}
+
+void SettingsWriter::write()
+{
+  QMap<QString, QVariant> batch;
+  {
+    std::lock_guard _(mMutex);
+    batch.swap(mPending);
+  }
+  if (batch.isEmpty()) {
+    return;
+  }
+  mWriter.start([group = mGroup, batch = std::move(batch)]() {
+    QSettings settings;
+    settings.beginGroup(group);
+    for (auto it = batch.cbegin(); it != batch.cend(); ++it) {
+      settings.setValue(it.key(), it.value());
+    }
+    settings.endGroup();
+    settings.sync();
+    if (settings.status() != QSettings::NoError) {
+      spdlog::error("Failed to save the {} settings", group.toStdString());
+    }
+  });
+}
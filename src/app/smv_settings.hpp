@@ -0,0 +1,49 @@
+#pragma once
+
+#include <mutex>
+
+#include <QMap>
+#include <QString>
+#include <QThreadPool>
+#include <QTimer>
+#include <QVariant>
+
+/**
+ * @brief Writes the settings of one group in the background, in batches
+ *
+ * @details setValue only records the value in memory. Once no value has been
+ * set for a short while, everything that was set is written in one go, and
+ * synced, on a thread of its own. Batches are written in the order they
+ * were made, so a later value is never overwritten by an earlier one.
+ * Anything still pending is written when the application is about to quit,
+ * and when the writer is destroyed
+ */
+class SettingsWriter
+{
+public:
+  explicit SettingsWriter(QString group);
+  SettingsWriter(const SettingsWriter &)                     = delete;
+  auto operator=(const SettingsWriter &) -> SettingsWriter & = delete;
+  ~SettingsWriter();
+
+  /**
+   * @brief set a value of the group, to be written later
+   * @details Must be called from the thread the writer was created on
+   */
+  void setValue(const QString &key, const QVariant &value);
+
+  /**
+   * @brief write everything that is pending, and wait for it to be written
+   */
+  void flush();
+
+private:
+  // schedules the pending values to be written
+  void write();
+
+  const QString           mGroup;
+  QTimer                  mQuiet;
+  QThreadPool             mWriter;
+  std::mutex              mMutex;
+  QMap<QString, QVariant> mPending;
+};
@@ -23,6 +23,24 @@ auto rectToRegion(const QRect &rect) -> smv::Region
            rect.y() };
 }
 
+auto rawImageToQImage(smv::RawImage image) -> QImage
+{
+  static_assert(Q_BYTE_ORDER == Q_LITTLE_ENDIAN,
+                "RawImage pixels only match QImage on little endian hosts");
+  auto *owner   = new smv::RawImage(std::move(image));
+  auto  cleanup = [](void *info) {
+    delete static_cast<smv::RawImage *>(info);
+  };
+  return { owner->data,
+           static_cast<int>(owner->width),
+           static_cast<int>(owner->height),
+           static_cast<int>(owner->stride),
+           owner->hasAlpha ? QImage::Format_ARGB32_Premultiplied
+                           : QImage::Format_RGB32,
+           cleanup,
+           owner };
+}
+
 auto ScreenshotFormatClass::formatToString(Value value) -> QString
 {
   return metaEnum.valueToKey(static_cast<int>(value));
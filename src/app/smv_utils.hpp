@@ -6,6 +6,7 @@
 
 #include <QDateTime>
 #include <QIODevice>
+#include <QImage>
 #include <QMetaEnum>
 #include <QObject>
 
@@ -17,6 +18,17 @@
  */
 auto rectToRegion(const QRect &rect) -> smv::Region;
 
+/**
+ * @brief Wrap a capture in a QImage, without copying it
+ * @details The image keeps the capture alive, and releases it once the
+ * image and all its implicit copies are gone
+ *
+ * @param image the capture
+ * @return QImage a Format_ARGB32_Premultiplied image if the capture has
+ * alpha, Format_RGB32 otherwise
+ */
+auto rawImageToQImage(smv::RawImage image) -> QImage;
+
 // https://qml.guide/enums-in-qt-qml/
 class CaptureModeClass
 {
@@ -1,5 +1,6 @@
 #include "app/smv_app.hpp"
 #include "app/smv_image_provider.hpp"
+#include "app/smv_preview.hpp"
 #include "app/smv_utils.hpp"
 #include "smv/client.hpp"
 
@@ -85,6 +86,7 @@ auto main(int argc, char *argv[]) -> int
   });
 
   auto typeId = AppCore::registerInstance();
+  CapturePreview::registerType();
   // NOLINTBEGIN(cppcoreguidelines-owning-memory)
   engine.addImageProvider("smv", new AppImageProvider);
   // NOLINTEND(cppcoreguidelines-owning-memory)
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace smv::details {
+  /**
+   * @brief The shape of the samples a backend delivers
+   * @details Samples are always 32-bit floats in [-1, 1], interleaved
+   */
+  struct AudioFormat
+  {
+    static constexpr uint32_t DEFAULT_SAMPLE_RATE = 48'000;
+
+    uint32_t sampleRate = DEFAULT_SAMPLE_RATE;
+    uint8_t  channels   = 2;
+    // the number of frames (samples of every channel) in each callback
+    uint32_t periodFrames = DEFAULT_SAMPLE_RATE / 100;
+  };
+
+  /**
+   * @brief Where audio samples come from
+   *
+   * @details Backends deliver samples on their own (often real-time) thread.
+   * The callback must not block, lock or allocate
+   */
+  class AudioBackend
+  {
+  public:
+    /**
+     * @param samples the interleaved samples
+     * @param frames the number of frames in samples
+     */
+    using Callback =
+      std::function<void(const float *samples, std::size_t frames)>;
+
+    virtual ~AudioBackend() = default;
+
+    virtual auto format() const noexcept -> AudioFormat     = 0;
+    virtual auto name() const noexcept -> std::string_view = 0;
+
+    /**
+     * @brief Start delivering samples to the callback
+     * @return std::optional<std::string> an error message if the device could
+     * not be opened
+     */
+    virtual auto start(Callback callback) -> std::optional<std::string> = 0;
+
+    /**
+     * @brief Stop delivering samples. The callback is not called once this
+     * returns
+     */
+    virtual void stop() = 0;
+  };
+} // namespace smv::details
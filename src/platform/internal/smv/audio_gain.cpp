@@ -0,0 +1,44 @@
+#include "audio_gain.hpp"
+
+#include <algorithm>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace smv::details {
+  void applyGain(float *samples, std::size_t count, float gain) noexcept
+  {
+    std::size_t i = 0;
+#if defined(__SSE2__)
+    const auto factor = _mm_set1_ps(gain);
+    const auto high   = _mm_set1_ps(1.0F);
+    const auto low    = _mm_set1_ps(-1.0F);
+    for (; i + 4 <= count; i += 4) {
+      auto value = _mm_mul_ps(_mm_loadu_ps(samples + i), factor);
+      _mm_storeu_ps(samples + i, _mm_max_ps(_mm_min_ps(value, high), low));
+    }
+#endif
+    for (; i < count; i++) {
+      samples[i] = std::clamp(samples[i] * gain, -1.0F, 1.0F);
+    }
+  }
+
+  void mixWithGain(float       *mix,
+                   const float *samples,
+                   std::size_t  count,
+                   float        gain) noexcept
+  {
+    std::size_t i = 0;
+#if defined(__SSE2__)
+    const auto factor = _mm_set1_ps(gain);
+    for (; i + 4 <= count; i += 4) {
+      auto value = _mm_mul_ps(_mm_loadu_ps(samples + i), factor);
+      _mm_storeu_ps(mix + i, _mm_add_ps(_mm_loadu_ps(mix + i), value));
+    }
+#endif
+    for (; i < count; i++) {
+      mix[i] += samples[i] * gain;
+    }
+  }
+} // namespace smv::details
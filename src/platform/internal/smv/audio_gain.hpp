@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+
+namespace smv::details {
+  /**
+   * @brief Multiply samples by a gain, in place
+   * @details The result is clamped to [-1, 1], so a gain above 1 clips
+   * instead of wrapping around once the samples are converted to integers
+   *
+   * @param samples 32-bit float samples, any number of channels
+   * @param count the number of samples
+   * @param gain the factor to apply
+   */
+  void applyGain(float *samples, std::size_t count, float gain) noexcept;
+
+  /**
+   * @brief Add samples multiplied by a gain to a mix
+   * @details Nothing is clamped, so that sources can be added in any order.
+   * Clamp the finished mix with applyGain(mix, count, 1)
+   *
+   * @param mix the samples to add to
+   * @param samples the samples to add, in the same layout as mix
+   * @param count the number of samples
+   * @param gain the factor to apply to samples
+   */
+  void mixWithGain(float       *mix,
+                   const float *samples,
+                   std::size_t  count,
+                   float        gain) noexcept;
+} // namespace smv::details
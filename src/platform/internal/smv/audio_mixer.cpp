@@ -0,0 +1,190 @@
+#include "audio_mixer.hpp"
+#include "audio_gain.hpp"
+#include "audio_resampler.hpp"
+#include "smv/log.hpp"
+#include "spsc_ring.hpp"
+
+#include <algorithm>
+
+namespace smv::details {
+  using smv::log::logger;
+
+  namespace {
+    constexpr auto MICROS_PER_SECOND = 1'000'000;
+    // the most input frames resampled at once. Larger callbacks are split
+    constexpr std::size_t CHUNK_FRAMES = 1024;
+  } // namespace
+
+  struct MixingAudioBackend::Source
+  {
+    Source(Input input, const AudioFormat &output, std::size_t maxQueued)
+      : backend(std::move(input.backend))
+      , gain(input.gain)
+      , format(backend->format())
+      , resampler(
+          format.sampleRate, output.sampleRate, format.channels, CHUNK_FRAMES)
+      , ring(maxQueued)
+      , resampled(resampler.maxOutputFrames(CHUNK_FRAMES) * format.channels)
+      , remapped(resampler.maxOutputFrames(CHUNK_FRAMES) * output.channels)
+    {
+    }
+
+    std::unique_ptr<AudioBackend> backend;
+    const float                   gain;
+    const AudioFormat             format;
+    AudioResampler                resampler;
+    SpscRing<float>               ring;
+    std::vector<float>            resampled;
+    std::vector<float>            remapped;
+    std::atomic_uint64_t          dropped = 0;
+  };
+
+  MixingAudioBackend::MixingAudioBackend(std::vector<Input>        inputs,
+                                         AudioFormat               format,
+                                         std::chrono::milliseconds maxLatency)
+    : mFormat(format)
+    , mMaxQueued(std::max<std::size_t>(
+        static_cast<std::size_t>(maxLatency.count()) * format.sampleRate /
+          1000,
+        format.periodFrames * 2) *
+                 format.channels)
+    , mMix(static_cast<std::size_t>(format.periodFrames) * format.channels)
+    , mRead(mMix.size())
+  {
+    for (auto &input : inputs) {
+      if (input.backend) {
+        mSources.push_back(
+          std::make_unique<Source>(std::move(input), mFormat, mMaxQueued));
+      }
+    }
+  }
+
+  MixingAudioBackend::~MixingAudioBackend()
+  {
+    stop();
+  }
+
+  auto MixingAudioBackend::format() const noexcept -> AudioFormat
+  {
+    return mFormat;
+  }
+
+  auto MixingAudioBackend::name() const noexcept -> std::string_view
+  {
+    return "mix";
+  }
+
+  auto MixingAudioBackend::start(Callback callback)
+    -> std::optional<std::string>
+  {
+    if (mSources.empty()) {
+      return "Nothing to mix";
+    }
+    if (mRunning.exchange(true)) {
+      return "Already started";
+    }
+    for (auto &source : mSources) {
+      auto &input = *source;
+      logger->info("Mixing {} audio. Rate={}, Channels={}, Gain={}",
+                   input.backend->name(),
+                   input.format.sampleRate,
+                   input.format.channels,
+                   input.gain);
+      auto err = input.backend->start(
+        [this, &input](const float *samples, std::size_t frames) {
+        onSamples(input, samples, frames);
+      });
+      if (err) {
+        stop();
+        return err;
+      }
+    }
+    mThread = std::thread(&MixingAudioBackend::run, this, std::move(callback));
+    return std::nullopt;
+  }
+
+  void MixingAudioBackend::stop()
+  {
+    mRunning = false;
+    for (auto &source : mSources) {
+      source->backend->stop();
+    }
+    if (mThread.joinable()) {
+      mThread.join();
+    }
+  }
+
+  auto MixingAudioBackend::dropped() const noexcept -> uint64_t
+  {
+    uint64_t total = 0;
+    for (const auto &source : mSources) {
+      total += source->dropped.load(std::memory_order_relaxed);
+    }
+    return total;
+  }
+
+  void MixingAudioBackend::onSamples(Source      &source,
+                                     const float *samples,
+                                     std::size_t  frames)
+  {
+    // runs on the input's thread: no locks, no allocations
+    const auto inChannels  = source.format.channels;
+    const auto outChannels = mFormat.channels;
+    while (frames > 0) {
+      auto chunk = std::min(frames, CHUNK_FRAMES);
+      auto count =
+        source.resampler.process(samples, chunk, source.resampled.data());
+      samples += chunk * inChannels;
+      frames -= chunk;
+
+      // extra output channels repeat the last input channel, extra input
+      // channels are left out
+      for (std::size_t i = 0; i < count; i++) {
+        for (uint8_t channel = 0; channel < outChannels; channel++) {
+          auto from = std::min<uint8_t>(channel, inChannels - 1);
+          source.remapped[i * outChannels + channel] =
+            source.resampled[i * inChannels + from];
+        }
+      }
+
+      auto queued = source.ring.readable();
+      auto room   = mMaxQueued > queued ? mMaxQueued - queued : 0;
+      auto total  = count * outChannels;
+      auto written =
+        source.ring.write(source.remapped.data(), std::min(total, room));
+      if (written < total) {
+        source.dropped.fetch_add((total - written) / outChannels,
+                                 std::memory_order_relaxed);
+      }
+    }
+  }
+
+  void MixingAudioBackend::run(const Callback &callback)
+  {
+    const auto period       = mMix.size();
+    const auto pollInterval = std::chrono::microseconds(
+      MICROS_PER_SECOND / 2 * mFormat.periodFrames / mFormat.sampleRate);
+
+    while (mRunning) {
+      bool ready = true;
+      bool full  = false;
+      for (const auto &source : mSources) {
+        auto queued = source->ring.readable();
+        ready       = ready && queued >= period;
+        full        = full || queued + period > mMaxQueued;
+      }
+      if (!ready && !full) {
+        std::this_thread::sleep_for(pollInterval);
+        continue;
+      }
+
+      std::fill(mMix.begin(), mMix.end(), 0.0F);
+      for (auto &source : mSources) {
+        auto count = source->ring.read(mRead.data(), period);
+        mixWithGain(mMix.data(), mRead.data(), count, source->gain);
+      }
+      applyGain(mMix.data(), mMix.size(), 1.0F);
+      callback(mMix.data(), mFormat.periodFrames);
+    }
+  }
+} // namespace smv::details
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "audio_backend.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace smv::details {
+  /**
+   * @brief Mixes several backends into one stream of samples
+   *
+   * @details Each input is resampled to the output rate (see
+   * AudioResampler) and remapped to the output channels on its own thread,
+   * then queued in a lock-free ring. A mixing thread adds one period of every
+   * input together, with each input's gain, and hands the mix to the
+   * callback. Nothing is allocated or locked after start.
+   *
+   * A period is mixed as soon as every input has one ready. Inputs are never
+   * queued for more than maxLatency: once one input has that much waiting,
+   * the period is mixed with whatever the others have (the rest is silence),
+   * and samples that would go past the limit are dropped. This keeps the
+   * latency bounded when an input stalls, and absorbs the drift between the
+   * clocks of two sound cards
+   */
+  class MixingAudioBackend: public AudioBackend
+  {
+  public:
+    struct Input
+    {
+      std::unique_ptr<AudioBackend> backend;
+      float                         gain = 1.0F;
+    };
+
+    static constexpr auto DEFAULT_LATENCY = std::chrono::milliseconds(60);
+
+    explicit MixingAudioBackend(
+      std::vector<Input>        inputs,
+      AudioFormat               format     = {},
+      std::chrono::milliseconds maxLatency = DEFAULT_LATENCY);
+    ~MixingAudioBackend() override;
+
+    auto format() const noexcept -> AudioFormat override;
+    auto name() const noexcept -> std::string_view override;
+    auto start(Callback callback) -> std::optional<std::string> override;
+    void stop() override;
+
+    /**
+     * @brief the number of input frames dropped to keep the latency bounded
+     */
+    auto dropped() const noexcept -> uint64_t;
+
+  private:
+    struct Source;
+
+    void onSamples(Source &source, const float *samples, std::size_t frames);
+    void run(const Callback &callback);
+
+    const AudioFormat                    mFormat;
+    // the most samples an input may have queued
+    const std::size_t                    mMaxQueued;
+    std::vector<std::unique_ptr<Source>> mSources;
+    std::vector<float>                   mMix;
+    std::vector<float>                   mRead;
+    std::atomic_bool                     mRunning = false;
+    std::thread                          mThread;
+  };
+} // namespace smv::details
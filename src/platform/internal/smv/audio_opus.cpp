@@ -0,0 +1,222 @@
+#include "audio_opus.hpp"
+#include "smv/log.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <random>
+
+#include <opus/opus.h>
+
+namespace smv::details {
+  using smv::log::logger;
+
+  namespace {
+    constexpr auto MICROS_PER_SECOND = 1'000'000;
+    constexpr auto OPUS_RATE         = 48'000U;
+    // the largest packet libopus produces is 1275 bytes per 20 ms of audio,
+    // and up to 3 of those make a packet
+    constexpr auto MAX_PACKET_BYTES = 4000;
+  } // namespace
+
+  OpusAudioEncoder::OpusAudioEncoder(AudioFormat               format,
+                                     uint32_t                  bitrate,
+                                     std::chrono::milliseconds frameDuration)
+    : mFormat(format)
+    , mBitrate(bitrate)
+    , mFrameSize(static_cast<uint32_t>(
+        format.sampleRate * (frameDuration.count() <= 10 ? 10 : 20) / 1000))
+    , mPending(static_cast<std::size_t>(mFrameSize) * format.channels)
+    , mBuffer(MAX_PACKET_BYTES)
+  {
+  }
+
+  OpusAudioEncoder::~OpusAudioEncoder()
+  {
+    if (mEncoder) {
+      opus_encoder_destroy(mEncoder);
+    }
+  }
+
+  auto OpusAudioEncoder::open() -> std::optional<std::string>
+  {
+    int err  = OPUS_OK;
+    mEncoder = opus_encoder_create(static_cast<opus_int32>(mFormat.sampleRate),
+                                   mFormat.channels,
+                                   OPUS_APPLICATION_RESTRICTED_LOWDELAY,
+                                   &err);
+    if (err != OPUS_OK) {
+      mEncoder = nullptr;
+      return std::string(opus_strerror(err));
+    }
+    opus_encoder_ctl(mEncoder,
+                     OPUS_SET_BITRATE(static_cast<opus_int32>(mBitrate)));
+    opus_int32 lookahead = 0;
+    opus_encoder_ctl(mEncoder, OPUS_GET_LOOKAHEAD(&lookahead));
+    // the lookahead is in input samples, the pre-skip always in 48 kHz ones
+    mPreSkip = static_cast<uint16_t>(static_cast<uint64_t>(lookahead) *
+                                     OPUS_RATE / mFormat.sampleRate);
+    logger->info("Opus encoder opened. Rate={}, Channels={}, Bitrate={}, "
+                 "FrameSize={}",
+                 mFormat.sampleRate,
+                 mFormat.channels,
+                 mBitrate,
+                 mFrameSize);
+    return std::nullopt;
+  }
+
+  auto OpusAudioEncoder::encode(const float *samples,
+                                std::size_t  frames,
+                                int64_t      ptsUs)
+    -> const std::vector<PacketPtr> &
+  {
+    mPackets.clear();
+    if (!mEncoder) {
+      return mPackets;
+    }
+    std::size_t consumed = 0;
+    while (frames > 0) {
+      if (mPendingFrames == 0) {
+        mPendingPtsUs = ptsUs + static_cast<int64_t>(
+                                  consumed * MICROS_PER_SECOND /
+                                  mFormat.sampleRate);
+      }
+      auto count = std::min<std::size_t>(frames, mFrameSize - mPendingFrames);
+      std::memcpy(mPending.data() + mPendingFrames * mFormat.channels,
+                  samples,
+                  count * mFormat.channels * sizeof(float));
+      samples += count * mFormat.channels;
+      frames -= count;
+      consumed += count;
+      mPendingFrames += count;
+      if (mPendingFrames < mFrameSize) {
+        break;
+      }
+
+      mPendingFrames = 0;
+      auto size      = opus_encode_float(mEncoder,
+                                    mPending.data(),
+                                    static_cast<int>(mFrameSize),
+                                    mBuffer.data(),
+                                    static_cast<opus_int32>(mBuffer.size()));
+      if (size < 0) {
+        logger->warn("Opus encoding failed: {}", opus_strerror(size));
+        continue;
+      }
+      auto packet = std::make_shared<EncodedPacket>();
+      packet->payload  = std::make_shared<const std::vector<uint8_t>>(
+        mBuffer.data(), mBuffer.data() + size);
+      packet->ptsUs    = mPendingPtsUs;
+      packet->keyframe = true;
+      mPackets.push_back(std::move(packet));
+    }
+    return mPackets;
+  }
+
+  auto OpusAudioEncoder::preSkip() const noexcept -> uint16_t
+  {
+    return mPreSkip;
+  }
+
+  auto OpusAudioEncoder::packetSamples() const noexcept -> uint32_t
+  {
+    return static_cast<uint32_t>(static_cast<uint64_t>(mFrameSize) *
+                                 OPUS_RATE / mFormat.sampleRate);
+  }
+
+  auto OpusAudioEncoder::format() const noexcept -> AudioFormat
+  {
+    return mFormat;
+  }
+
+  OpusCaptureSource::OpusCaptureSource(AudioCaptureSource       &source,
+                                       const AudioCaptureConfig &config,
+                                       OpusFraming               framing)
+    : mSource(source)
+    , mFraming(framing)
+    , mEncoder(source.format(), config.bitrate, config.frameDuration)
+  {
+  }
+
+  auto OpusCaptureSource::open() -> std::optional<std::string>
+  {
+    mErrMsg = mEncoder.open();
+    return mErrMsg;
+  }
+
+  auto OpusCaptureSource::next() noexcept
+    -> std::optional<std::basic_string_view<uint8_t>>
+  {
+    if (mErrMsg) {
+      return std::nullopt;
+    }
+    if (mFraming == OpusFraming::Raw) {
+      while (mQueued == mQueue.size()) {
+        if (!fill()) {
+          return std::nullopt;
+        }
+      }
+      mPacket = mQueue[mQueued++];
+      return std::basic_string_view(mPacket->bytes().data(),
+                                    mPacket->bytes().size());
+    }
+
+    if (!mWriter) {
+      auto format = mEncoder.format();
+      mWriter.emplace(format.channels,
+                      format.sampleRate,
+                      mEncoder.preSkip(),
+                      std::random_device {}());
+      mPage = mWriter->header();
+      return std::basic_string_view(mPage.data(), mPage.size());
+    }
+    if (mEnded) {
+      return std::nullopt;
+    }
+    mPage.clear();
+    while (mPage.empty()) {
+      if (!fill()) {
+        mPage = mWriter->flush(true);
+        break;
+      }
+      for (; mQueued < mQueue.size(); mQueued++) {
+        const auto &bytes = mQueue[mQueued]->bytes();
+        auto        page  = mWriter->add({ bytes.data(), bytes.size() },
+                                 mEncoder.packetSamples());
+        mPage.insert(mPage.end(), page.begin(), page.end());
+      }
+    }
+    return std::basic_string_view(mPage.data(), mPage.size());
+  }
+
+  auto OpusCaptureSource::error() noexcept -> std::optional<std::string>
+  {
+    return mErrMsg;
+  }
+
+  auto OpusCaptureSource::packet() const noexcept -> const PacketPtr &
+  {
+    return mPacket;
+  }
+
+  auto OpusCaptureSource::fill() -> bool
+  {
+    mQueue.clear();
+    mQueued             = 0;
+    const auto channels = mEncoder.format().channels;
+    for (;;) {
+      if (!mSource.next()) {
+        mEnded  = true;
+        mErrMsg = mSource.error();
+        return false;
+      }
+      const auto &samples = mSource.samples();
+      const auto &packets = mEncoder.encode(
+        samples.data(), samples.size() / channels, mSource.ptsUs());
+      if (!packets.empty()) {
+        mQueue = packets;
+        return true;
+      }
+    }
+  }
+} // namespace smv::details
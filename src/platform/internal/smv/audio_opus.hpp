@@ -0,0 +1,144 @@
+#pragma once
+
+#include "audio_backend.hpp"
+#include "capture_audio.hpp"
+#include "encoder.hpp"
+#include "ogg_opus.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+struct OpusEncoder;
+
+namespace smv::details {
+  /**
+   * @brief Encodes PCM samples to Opus with libopus
+   *
+   * @details The encoder runs in the restricted low-delay mode, which drops
+   * the speech-only (SILK) layer in favour of the lowest algorithmic delay.
+   * Samples can be given in any amount; they are collected until a whole
+   * packet (10 or 20 ms) can be encoded. Each packet is independent of the
+   * ones before it only as far as the Ogg container is concerned, so every
+   * packet is marked as a keyframe
+   */
+  class OpusAudioEncoder
+  {
+  public:
+    /**
+     * @param format the format of the samples. Opus takes 8, 12, 16, 24 or
+     * 48 kHz, in mono or stereo
+     * @param bitrate the target bitrate in bits per second
+     * @param frameDuration the duration of each packet: 10 or 20 ms
+     */
+    OpusAudioEncoder(AudioFormat               format,
+                     uint32_t                  bitrate,
+                     std::chrono::milliseconds frameDuration);
+    OpusAudioEncoder(const OpusAudioEncoder &)                     = delete;
+    auto operator=(const OpusAudioEncoder &) -> OpusAudioEncoder & = delete;
+    ~OpusAudioEncoder();
+
+    /**
+     * @brief Create the encoder
+     * @return std::optional<std::string> an error message if it failed
+     */
+    auto open() -> std::optional<std::string>;
+
+    /**
+     * @brief Encode interleaved samples
+     *
+     * @param samples the samples
+     * @param frames the number of frames (samples of every channel)
+     * @param ptsUs the time of the first sample, which the pts of the
+     * packets is derived from
+     * @return the packets completed by these samples. Valid until the next
+     * call to encode
+     */
+    auto encode(const float *samples, std::size_t frames, int64_t ptsUs)
+      -> const std::vector<PacketPtr> &;
+
+    /**
+     * @brief the number of 48 kHz samples the decoder should discard at the
+     * start of the stream
+     */
+    auto preSkip() const noexcept -> uint16_t;
+
+    /**
+     * @brief the duration of each packet, in 48 kHz samples
+     */
+    auto packetSamples() const noexcept -> uint32_t;
+
+    auto format() const noexcept -> AudioFormat;
+
+  private:
+    const AudioFormat      mFormat;
+    const uint32_t         mBitrate;
+    const uint32_t         mFrameSize;
+    ::OpusEncoder         *mEncoder = nullptr;
+    uint16_t               mPreSkip = 0;
+    std::vector<float>     mPending;
+    std::size_t            mPendingFrames = 0;
+    // the time of the first sample in mPending
+    int64_t                mPendingPtsUs = 0;
+    std::vector<uint8_t>   mBuffer;
+    std::vector<PacketPtr> mPackets;
+  };
+
+  /**
+   * @brief How an OpusCaptureSource hands out its packets
+   */
+  enum class OpusFraming
+  {
+    // one Opus packet per call to next, for streaming
+    Raw,
+    // an Ogg/Opus file: the header pages first, then about a second of audio
+    // per call to next, then a final page once the capture stops
+    Ogg,
+  };
+
+  /**
+   * @brief Encodes the samples of an AudioCaptureSource to Opus
+   */
+  class OpusCaptureSource: public CaptureSource
+  {
+  public:
+    OpusCaptureSource(AudioCaptureSource       &source,
+                      const AudioCaptureConfig &config,
+                      OpusFraming               framing);
+
+    /**
+     * @brief Open the encoder
+     * @return std::optional<std::string> an error message if it failed
+     */
+    auto open() -> std::optional<std::string>;
+
+    auto next() noexcept
+      -> std::optional<std::basic_string_view<uint8_t>> override;
+    auto error() noexcept -> std::optional<std::string> override;
+
+    /**
+     * @brief the last packet returned by next, with OpusFraming::Raw
+     */
+    auto packet() const noexcept -> const PacketPtr &;
+
+  private:
+    /**
+     * @brief encode periods of the source until a packet is ready
+     * @return false once the source has no more samples
+     */
+    auto fill() -> bool;
+
+    AudioCaptureSource          &mSource;
+    const OpusFraming            mFraming;
+    OpusAudioEncoder             mEncoder;
+    std::optional<OggOpusWriter> mWriter;
+    std::vector<PacketPtr>       mQueue;
+    std::size_t                  mQueued = 0;
+    PacketPtr                    mPacket;
+    std::vector<uint8_t>         mPage;
+    bool                         mEnded = false;
+    std::optional<std::string>   mErrMsg;
+  };
+} // namespace smv::details
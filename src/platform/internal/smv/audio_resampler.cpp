@@ -0,0 +1,137 @@
+#include "audio_resampler.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace smv::details {
+  namespace {
+    constexpr auto PI = 3.141592653589793;
+    // more phases than this are rounded to the nearest one
+    constexpr uint32_t MAX_PHASES = 1024;
+    // keep the cutoff a little below Nyquist, for the transition band
+    constexpr auto CUTOFF = 0.92;
+
+    auto dot(const float *a, const float *b) noexcept -> float
+    {
+      uint32_t i   = 0;
+      float    sum = 0.0F;
+#if defined(__SSE2__)
+      auto acc = _mm_setzero_ps();
+      for (; i + 4 <= AudioResampler::TAPS; i += 4) {
+        auto product = _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i));
+        acc          = _mm_add_ps(acc, product);
+      }
+      // add the four lanes together
+      acc = _mm_add_ps(acc, _mm_movehl_ps(acc, acc));
+      acc = _mm_add_ss(acc, _mm_shuffle_ps(acc, acc, 1));
+      sum = _mm_cvtss_f32(acc);
+#endif
+      for (; i < AudioResampler::TAPS; i++) {
+        sum += a[i] * b[i];
+      }
+      return sum;
+    }
+  } // namespace
+
+  AudioResampler::AudioResampler(uint32_t    inputRate,
+                                 uint32_t    outputRate,
+                                 uint8_t     channels,
+                                 std::size_t maxFrames)
+    : mChannels(channels)
+    , mMaxFrames(maxFrames)
+  {
+    auto divisor = std::gcd(inputRate, outputRate);
+    if (divisor == 0 || inputRate == outputRate) {
+      return;
+    }
+    mUp     = outputRate / divisor;
+    mDown   = inputRate / divisor;
+    mPhases = std::min(mUp, MAX_PHASES);
+    mHistory.assign((TAPS - 1 + maxFrames) * channels, 0.0F);
+    mPosition = static_cast<uint64_t>(TAPS - 1) * mUp;
+
+    // the cutoff of the prototype filter, in cycles per input sample
+    auto cutoff = 0.5 * CUTOFF * std::min(1.0, double(outputRate) / inputRate);
+    mFilter.resize(static_cast<std::size_t>(mPhases) * TAPS);
+    for (uint32_t phase = 0; phase < mPhases; phase++) {
+      auto *row    = mFilter.data() + static_cast<std::size_t>(phase) * TAPS;
+      auto  offset = double(phase) / mPhases;
+      auto  sum    = 0.0;
+      for (uint32_t tap = 0; tap < TAPS; tap++) {
+        // how far input sample (newest - tap) is from the middle of the
+        // filter, which sits (TAPS - 1) / 2 samples behind the output
+        auto x      = tap + offset - (TAPS - 1) / 2.0;
+        auto arg    = 2 * cutoff * x;
+        auto sinc   = arg == 0.0 ? 1.0 : std::sin(PI * arg) / (PI * arg);
+        auto t      = (x + TAPS / 2.0) / TAPS;
+        auto window = t <= 0.0 || t >= 1.0
+                        ? 0.0
+                        : 0.42 - 0.5 * std::cos(2 * PI * t) +
+                            0.08 * std::cos(4 * PI * t);
+        auto value  = sinc * window;
+        // reversed, so that it lines up with the oldest sample first
+        row[TAPS - 1 - tap] = static_cast<float>(value);
+        sum += value;
+      }
+      // unity gain at DC for every phase
+      for (uint32_t tap = 0; tap < TAPS; tap++) {
+        row[tap] = static_cast<float>(row[tap] / sum);
+      }
+    }
+  }
+
+  auto AudioResampler::maxOutputFrames(std::size_t frames) const noexcept
+    -> std::size_t
+  {
+    return frames * mUp / mDown + 1;
+  }
+
+  auto AudioResampler::process(const float *input,
+                               std::size_t  frames,
+                               float       *output) noexcept -> std::size_t
+  {
+    frames = std::min(frames, mMaxFrames);
+    if (mFilter.empty()) {
+      std::memcpy(output, input, frames * mChannels * sizeof(float));
+      return frames;
+    }
+
+    const auto stride    = TAPS - 1 + mMaxFrames;
+    const auto available = TAPS - 1 + frames;
+    for (uint8_t channel = 0; channel < mChannels; channel++) {
+      auto *history = mHistory.data() + channel * stride + TAPS - 1;
+      for (std::size_t i = 0; i < frames; i++) {
+        history[i] = input[i * mChannels + channel];
+      }
+    }
+
+    std::size_t produced = 0;
+    for (; mPosition / mUp < available; mPosition += mDown, produced++) {
+      auto newest = mPosition / mUp;
+      auto phase  = static_cast<std::size_t>(mPosition % mUp);
+      if (mPhases != mUp) {
+        phase = (phase * mPhases + mUp / 2) / mUp % mPhases;
+      }
+      const auto *coefficients = mFilter.data() + phase * TAPS;
+      for (uint8_t channel = 0; channel < mChannels; channel++) {
+        const auto *samples = mHistory.data() + channel * stride + newest -
+                              (TAPS - 1);
+        output[produced * mChannels + channel] = dot(coefficients, samples);
+      }
+    }
+
+    // keep the last TAPS - 1 samples for the next block
+    for (uint8_t channel = 0; channel < mChannels; channel++) {
+      auto *history = mHistory.data() + channel * stride;
+      std::memmove(history, history + frames, (TAPS - 1) * sizeof(float));
+    }
+    mPosition -= static_cast<uint64_t>(frames) * mUp;
+    return produced;
+  }
+} // namespace smv::details
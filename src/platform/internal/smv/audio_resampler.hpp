@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace smv::details {
+  /**
+   * @brief Converts interleaved float samples from one rate to another
+   *
+   * @details A polyphase FIR resampler: the ratio is reduced to L/M, and
+   * each output sample is the dot product of the last TAPS input samples of
+   * its channel with one of L windowed-sinc phases. Samples are kept
+   * planar, so the dot product runs over contiguous memory, four taps at a
+   * time with SSE2. The filter cuts off just below the lower of the two
+   * Nyquist frequencies, and delays the signal by (TAPS - 1) / 2 input
+   * samples.
+   * All the memory is allocated by the constructor; process can be called
+   * from a real-time thread. Equal rates are copied through
+   */
+  class AudioResampler
+  {
+  public:
+    static constexpr uint32_t TAPS = 32;
+
+    /**
+     * @param inputRate the sample rate of the input
+     * @param outputRate the sample rate of the output
+     * @param channels the number of interleaved channels
+     * @param maxFrames the most frames process is given at once
+     */
+    AudioResampler(uint32_t    inputRate,
+                   uint32_t    outputRate,
+                   uint8_t     channels,
+                   std::size_t maxFrames);
+
+    /**
+     * @brief the most frames process produces for the given number of
+     * input frames
+     */
+    auto maxOutputFrames(std::size_t frames) const noexcept -> std::size_t;
+
+    /**
+     * @brief Resample a block of samples
+     *
+     * @param input interleaved samples
+     * @param frames the number of frames in input, at most maxFrames
+     * @param output room for maxOutputFrames(frames) frames
+     * @return the number of frames written to output
+     */
+    auto process(const float *input, std::size_t frames, float *output) noexcept
+      -> std::size_t;
+
+  private:
+    const uint8_t      mChannels;
+    const std::size_t  mMaxFrames;
+    uint32_t           mUp   = 1;
+    uint32_t           mDown = 1;
+    // the number of filter phases, which is mUp unless that is too many
+    uint32_t           mPhases = 1;
+    // mPhases rows of TAPS coefficients, in reverse order
+    std::vector<float> mFilter;
+    // per channel: TAPS - 1 samples of history, then room for mMaxFrames
+    std::vector<float> mHistory;
+    // the position of the next output, in 1/mUp of an input sample
+    uint64_t           mPosition = 0;
+  };
+} // namespace smv::details
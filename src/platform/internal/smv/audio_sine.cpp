@@ -0,0 +1,78 @@
+#include "audio_sine.hpp"
+
+#include <chrono>
+#include <cmath>
+
+namespace smv::details {
+  namespace {
+    constexpr auto TWO_PI = 6.283185307179586;
+  } // namespace
+
+  SineAudioBackend::SineAudioBackend(AudioFormat format,
+                                     float       frequency,
+                                     float       amplitude)
+    : mFormat(format)
+    , mFrequency(frequency)
+    , mAmplitude(amplitude)
+    , mPeriod(static_cast<std::size_t>(format.periodFrames) * format.channels)
+  {
+  }
+
+  SineAudioBackend::~SineAudioBackend()
+  {
+    stop();
+  }
+
+  auto SineAudioBackend::format() const noexcept -> AudioFormat
+  {
+    return mFormat;
+  }
+
+  auto SineAudioBackend::name() const noexcept -> std::string_view
+  {
+    return "sine";
+  }
+
+  auto SineAudioBackend::start(Callback callback)
+    -> std::optional<std::string>
+  {
+    if (mRunning.exchange(true)) {
+      return "Already started";
+    }
+    mThread = std::thread(&SineAudioBackend::run, this, std::move(callback));
+    return std::nullopt;
+  }
+
+  void SineAudioBackend::stop()
+  {
+    mRunning = false;
+    if (mThread.joinable()) {
+      mThread.join();
+    }
+  }
+
+  void SineAudioBackend::run(const Callback &callback)
+  {
+    using Clock = std::chrono::steady_clock;
+
+    const auto period = std::chrono::duration_cast<Clock::duration>(
+      std::chrono::duration<double>(static_cast<double>(mFormat.periodFrames) /
+                                    mFormat.sampleRate));
+    const auto step    = TWO_PI * mFrequency / mFormat.sampleRate;
+    auto       phase   = 0.0;
+    auto       nextDue = Clock::now();
+
+    while (mRunning) {
+      for (uint32_t frame = 0; frame < mFormat.periodFrames; frame++) {
+        auto value = static_cast<float>(std::sin(phase)) * mAmplitude;
+        for (uint8_t channel = 0; channel < mFormat.channels; channel++) {
+          mPeriod[frame * mFormat.channels + channel] = value;
+        }
+        phase = std::fmod(phase + step, TWO_PI);
+      }
+      nextDue += period;
+      std::this_thread::sleep_until(nextDue);
+      callback(mPeriod.data(), mFormat.periodFrames);
+    }
+  }
+} // namespace smv::details
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "audio_backend.hpp"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace smv::details {
+  /**
+   * @brief Generates a sine tone in real time
+   * @details Used in place of a sound card, so that the audio path can be
+   * exercised anywhere. Samples are delivered one period at a time, on the
+   * same schedule a sound card would
+   */
+  class SineAudioBackend: public AudioBackend
+  {
+  public:
+    static constexpr float DEFAULT_FREQUENCY = 440.0F;
+    static constexpr float DEFAULT_AMPLITUDE = 0.5F;
+
+    explicit SineAudioBackend(AudioFormat format    = {},
+                              float       frequency = DEFAULT_FREQUENCY,
+                              float       amplitude = DEFAULT_AMPLITUDE);
+    ~SineAudioBackend() override;
+
+    auto format() const noexcept -> AudioFormat override;
+    auto name() const noexcept -> std::string_view override;
+    auto start(Callback callback) -> std::optional<std::string> override;
+    void stop() override;
+
+  private:
+    void run(const Callback &callback);
+
+    const AudioFormat  mFormat;
+    const float        mFrequency;
+    const float        mAmplitude;
+    std::vector<float> mPeriod;
+    std::atomic_bool   mRunning = false;
+    std::thread        mThread;
+  };
+} // namespace smv::details
@@ -1,13 +1,29 @@
 #include "capture_audio.hpp"
+#include "audio_gain.hpp"
+#include "audio_mixer.hpp"
+#include "audio_opus.hpp"
+#include "audio_sine.hpp"
 #include "capture_impl.hpp"
+#include "smv/common/fmt.hpp" // IWYU pragma: keep
 #include "smv/log.hpp"
 
+#include <algorithm>
+#include <chrono>
 #include <thread>
 #include <utility>
 
 namespace smv::details {
   using smv::log::logger;
 
+  namespace {
+    // how much audio the ring holds before samples are dropped
+    constexpr auto RING_SECONDS      = 1;
+    constexpr auto MICROS_PER_SECOND = 1'000'000;
+    // callbacks are late by a few ms at random, so the drift is averaged
+    // over this many of them (about 5s with 10ms periods)
+    constexpr auto DRIFT_SMOOTHING = 512;
+  } // namespace
+
   void capture(const AudioCaptureConfig      &config,
                TCaptureCb<AudioCaptureSource> callback)
   {
@@ -17,37 +33,223 @@ namespace smv::details {
     }
     std::thread([config, callback = std::move(callback)]() {
       auto source = details::createAudioCaptureSource(config);
-      if (source) {
-        callback(*source);
+      if (!source) {
+        return;
+      }
+      if (auto err = source->start()) {
+        logger->error("Failed to start audio capture: {}", *err);
+        return;
       }
+      callback(*source);
+      source->stop();
     }).detach();
   }
+
+  AudioCaptureSource::AudioCaptureSource(const AudioCaptureConfig     &config,
+                                         std::unique_ptr<AudioBackend> backend)
+    : mConfig(config)
+    , mBackend(std::move(backend))
+    , mFormat(mBackend->format())
+    , mRing(static_cast<std::size_t>(mFormat.sampleRate) * mFormat.channels *
+            RING_SECONDS)
+    , mSamples(static_cast<std::size_t>(mFormat.periodFrames) *
+               mFormat.channels)
+  {
+  }
+
+  AudioCaptureSource::~AudioCaptureSource()
+  {
+    stop();
+  }
+
+  auto AudioCaptureSource::start() -> std::optional<std::string>
+  {
+    logger->info("Starting audio capture. Backend={}, Rate={}, Channels={}",
+                 mBackend->name(),
+                 mFormat.sampleRate,
+                 mFormat.channels);
+    mErrMsg = mBackend->start([this](const float *samples, std::size_t frames) {
+      onSamples(samples, frames);
+    });
+    return mErrMsg;
+  }
+
+  auto AudioCaptureSource::next() noexcept
+    -> std::optional<std::basic_string_view<uint8_t>>
+  {
+    // half a period, so a period is never waited for more than 1.5 times
+    const auto pollInterval = std::chrono::microseconds(
+      MICROS_PER_SECOND / 2 * mFormat.periodFrames / mFormat.sampleRate);
+    while (!mErrMsg && mRing.readable() < mSamples.size()) {
+      if (mStopped) {
+        return std::nullopt;
+      }
+      std::this_thread::sleep_for(pollInterval);
+    }
+    if (mErrMsg) {
+      return std::nullopt;
+    }
+
+    mRing.read(mSamples.data(), mSamples.size());
+    if (mConfig.volume != 1.0F) {
+      applyGain(mSamples.data(), mSamples.size(), mConfig.volume);
+    }
+    mPtsUs = static_cast<int64_t>(mFramesRead * MICROS_PER_SECOND /
+                                  mFormat.sampleRate);
+    if (mClock) {
+      mPtsUs += mAnchorUs.load(std::memory_order_acquire);
+    }
+    mFramesRead += mFormat.periodFrames;
+    return std::basic_string_view(
+      reinterpret_cast<const uint8_t *>(mSamples.data()),
+      mSamples.size() * sizeof(float));
+  }
+
+  auto AudioCaptureSource::error() noexcept -> std::optional<std::string>
+  {
+    return mErrMsg;
+  }
+
+  auto AudioCaptureSource::samples() const noexcept
+    -> const std::vector<float> &
+  {
+    return mSamples;
+  }
+
+  auto AudioCaptureSource::ptsUs() const noexcept -> int64_t
+  {
+    return mPtsUs;
+  }
+
+  void AudioCaptureSource::useClock(const MediaClock &clock)
+  {
+    mClock = &clock;
+  }
+
+  auto AudioCaptureSource::driftUs() const noexcept -> int64_t
+  {
+    return mDriftUs.load(std::memory_order_relaxed);
+  }
+
+  auto AudioCaptureSource::format() const noexcept -> AudioFormat
+  {
+    return mFormat;
+  }
+
+  auto AudioCaptureSource::stats() const noexcept -> AudioCaptureStats
+  {
+    return { mCaptured, mOverruns };
+  }
+
+  void AudioCaptureSource::stop() noexcept
+  {
+    if (!mStopped.exchange(true)) {
+      mBackend->stop();
+      logger->info("Audio capture stopped. Captured={}, Overruns={}",
+                   mCaptured.load(),
+                   mOverruns.load());
+    }
+  }
+
+  void AudioCaptureSource::onSamples(const float *samples,
+                                     std::size_t  frames) noexcept
+  {
+    // runs on the backend's thread: no locks, no allocations
+    if (mClock) {
+      mDeviceFrames += frames;
+      // the samples end now, according to the media clock
+      auto now      = mClock->nowUs();
+      auto deviceUs = static_cast<int64_t>(mDeviceFrames * MICROS_PER_SECOND /
+                                           mFormat.sampleRate);
+      auto anchor   = mAnchorUs.load(std::memory_order_relaxed);
+      if (anchor < 0) {
+        anchor = now - deviceUs;
+        mAnchorUs.store(anchor, std::memory_order_release);
+      }
+      auto drift    = now - (anchor + deviceUs);
+      auto smoothed = mDriftUs.load(std::memory_order_relaxed);
+      mDriftUs.store(smoothed + (drift - smoothed) / DRIFT_SMOOTHING,
+                     std::memory_order_relaxed);
+    }
+    auto count   = frames * mFormat.channels;
+    auto written = mRing.write(samples, count);
+    mCaptured.fetch_add(frames, std::memory_order_relaxed);
+    if (written < count) {
+      mOverruns.fetch_add((count - written) / mFormat.channels,
+                          std::memory_order_relaxed);
+    }
+  }
+
+  auto createAudioBackend(const AudioCaptureConfig &config)
+    -> std::unique_ptr<AudioBackend>
+  {
+    if (!config.mix.empty()) {
+      std::vector<MixingAudioBackend::Input> inputs;
+      auto single = config;
+      single.mix.clear();
+      inputs.push_back({ createAudioBackend(single), 1.0F });
+      for (const auto &input : config.mix) {
+        single.sourceId = input.sourceId;
+        inputs.push_back({ createAudioBackend(single), input.gain });
+      }
+      if (std::any_of(inputs.begin(), inputs.end(), [](const auto &input) {
+            return !input.backend;
+          })) {
+        return nullptr;
+      }
+      return std::make_unique<MixingAudioBackend>(std::move(inputs));
+    }
+    if (config.sourceId == AudioCaptureConfig::TEST_TONE_SOURCE) {
+      return std::make_unique<SineAudioBackend>();
+    }
+    return createPlatformAudioBackend(config);
+  }
 } // namespace smv::details
 
 namespace smv {
   using smv::details::AudioCaptureSource;
   using smv::details::capture;
+  using smv::details::OpusCaptureSource;
+  using smv::details::OpusFraming;
   using smv::log::logger;
 
+  namespace {
+    void captureOpus(const AudioCaptureConfig &config,
+                     OpusFraming               framing,
+                     CaptureCb                 callback)
+    {
+      capture(config,
+              [config, framing, callback = std::move(callback)](
+                AudioCaptureSource &source) {
+        OpusCaptureSource opus(source, config, framing);
+        if (auto err = opus.open()) {
+          logger->error("Failed to open the Opus encoder: {}", *err);
+          return;
+        }
+        callback(opus);
+      });
+    }
+  } // namespace
+
   void capture(const AudioCaptureConfig &config,
-               AudioCaptureFormat /*unused*/,
-               CaptureCb callback)
+               AudioCaptureFormat        format,
+               CaptureCb                 callback)
   {
-    capture(config,
-            [callback = std::move(callback)](const AudioCaptureSource &) {
-      // TODO: capture the audio and call the callback
-      logger->warn("Audio capture not yet implemented");
-    });
+    if (format == AudioCaptureFormat::OPUS) {
+      captureOpus(config, OpusFraming::Ogg, std::move(callback));
+      return;
+    }
+    logger->error("Unsupported audio capture format: {}", format);
   }
 
   void captureStream(const AudioStreamConfig &config,
-                     AudioStreamFormat /*unused*/,
-                     CaptureCb callback)
+                     AudioStreamFormat        format,
+                     CaptureCb                callback)
   {
-    capture(dynamic_cast<const AudioCaptureConfig &>(config),
-            [callback = std::move(callback)](const AudioCaptureSource &) {
-      // TODO: capture the audio and call the callback
-      logger->warn("Audio streaming not yet implemented");
-    });
+    if (format == AudioStreamFormat::OPUS) {
+      captureOpus(config, OpusFraming::Raw, std::move(callback));
+      return;
+    }
+    logger->error("Audio streaming is only implemented for Opus");
   }
 } // namespace smv
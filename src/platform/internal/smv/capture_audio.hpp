@@ -1,8 +1,124 @@
 #pragma once
 
+#include "audio_backend.hpp"
+#include "media_clock.hpp"
 #include "smv/record.hpp"
+#include "spsc_ring.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
 
 namespace smv::details {
-  struct AudioCaptureSource: CaptureSource
-  {};
+  /**
+   * @brief Counters kept by an AudioCaptureSource
+   */
+  struct AudioCaptureStats
+  {
+    // frames delivered by the backend
+    uint64_t captured = 0;
+    // frames lost because the reader did not keep up
+    uint64_t overruns = 0;
+  };
+
+  /**
+   * @brief Produces PCM audio from an AudioBackend
+   *
+   * @details The backend thread only copies samples into a lock-free ring
+   * buffer (see SpscRing), so it never blocks, locks or allocates. Every call
+   * to next waits for one period of samples, applies
+   * AudioCaptureConfig::volume to it, and returns it as interleaved 32-bit
+   * floats (see format()).
+   * If the reader falls more than a second behind, the samples that do not
+   * fit in the ring are dropped and counted as overruns
+   */
+  class AudioCaptureSource: public CaptureSource
+  {
+  public:
+    AudioCaptureSource(const AudioCaptureConfig   &config,
+                       std::unique_ptr<AudioBackend> backend);
+    ~AudioCaptureSource() override;
+
+    /**
+     * @brief Start the backend
+     * @return std::optional<std::string> an error message if it failed
+     */
+    auto start() -> std::optional<std::string>;
+
+    /**
+     * @brief Wait for the next period of samples
+     *
+     * @return the samples, as bytes. std::nullopt once the source is stopped
+     * and every sample was read
+     */
+    auto next() noexcept
+      -> std::optional<std::basic_string_view<uint8_t>> override;
+    auto error() noexcept -> std::optional<std::string> override;
+
+    /**
+     * @brief the samples returned by the last call to next
+     */
+    auto samples() const noexcept -> const std::vector<float> &;
+
+    /**
+     * @brief the time of the first sample returned by the last call to next,
+     * in microseconds since the capture started
+     */
+    auto ptsUs() const noexcept -> int64_t;
+
+    /**
+     * @brief stamp samples with the time on the given clock
+     *
+     * @details The first period delivered by the backend anchors the samples
+     * to the clock; from there the pts advances with the number of samples,
+     * i.e. with the device's own clock. How far that drifts from the media
+     * clock is tracked by driftUs. The clock must outlive the source, and
+     * this should be called before start
+     */
+    void useClock(const MediaClock &clock);
+
+    /**
+     * @brief how far the device clock is behind the media clock, smoothed
+     * over the last few seconds
+     * @details Positive when the device delivers fewer samples than its
+     * nominal rate. Always 0 without a clock. Safe to call from any thread
+     */
+    auto driftUs() const noexcept -> int64_t;
+
+    auto format() const noexcept -> AudioFormat;
+    auto stats() const noexcept -> AudioCaptureStats;
+    void stop() noexcept;
+
+  private:
+    void onSamples(const float *samples, std::size_t frames) noexcept;
+
+    const AudioCaptureConfig      mConfig;
+    std::unique_ptr<AudioBackend> mBackend;
+    const AudioFormat             mFormat;
+    SpscRing<float>               mRing;
+    std::vector<float>            mSamples;
+    uint64_t                      mFramesRead = 0;
+    int64_t                       mPtsUs      = 0;
+    std::optional<std::string>    mErrMsg;
+    std::atomic_bool              mStopped  = false;
+    std::atomic_uint64_t          mCaptured = 0;
+    std::atomic_uint64_t          mOverruns = 0;
+    const MediaClock             *mClock    = nullptr;
+    // the clock time of the first sample, or -1 until the backend delivers
+    std::atomic_int64_t mAnchorUs { -1 };
+    std::atomic_int64_t mDriftUs { 0 };
+    // only touched by the backend's thread
+    uint64_t mDeviceFrames = 0;
+  };
+
+  /**
+   * @brief Create the backend for the requested source
+   * @details AudioCaptureConfig::TEST_TONE_SOURCE gives a SineAudioBackend.
+   * Anything else is up to the platform
+   */
+  auto createAudioBackend(const AudioCaptureConfig &config)
+    -> std::unique_ptr<AudioBackend>;
 } // namespace smv::details
@@ -0,0 +1,154 @@
+#include "capture_governor.hpp"
+#include "capture_impl.hpp"
+#include "smv/log.hpp"
+
+#include <algorithm>
+
+namespace smv::details {
+  using smv::log::logger;
+
+  namespace {
+    constexpr auto MICROS_PER_SECOND = 1'000'000.0;
+    // share of the frame time a stage may take before stepping down
+    constexpr auto OVERLOADED = 0.9;
+    // share of the frame time the next step up may be predicted to take
+    constexpr auto HEADROOM = 0.7;
+    // quiet intervals before stepping up
+    constexpr auto QUIET_INTERVALS = 5U;
+    // how much slower the encoder gets for each effort step, roughly
+    constexpr auto EFFORT_COST = 1.5;
+
+    auto perFrame(uint64_t totalUs, uint64_t frames) -> double
+    {
+      return frames == 0 ? 0.0 : static_cast<double>(totalUs) / frames;
+    }
+  } // namespace
+
+  CaptureGovernor::CaptureGovernor(FrameBus          &bus,
+                                   FrameSubscription &subscription,
+                                   uint8_t            effort)
+    : mBus(bus)
+    , mSubscription(subscription)
+    , mLastSample(Clock::now())
+    , mLastStats(bus.stats())
+    , mLastDropped(subscription.dropped())
+  {
+    auto fps  = std::max<uint8_t>(bus.config().fpsHint, 1);
+    auto half = std::max<uint8_t>(fps / 2, MIN_FPS);
+    auto low  = std::max<uint8_t>(fps / 4, MIN_FPS);
+    for (int step = effort; step >= 0; step--) {
+      mLadder.push_back({ fps, 1.0F, static_cast<uint8_t>(step) });
+    }
+    if (auto threeQuarters = static_cast<uint8_t>(fps * 3 / 4);
+        threeQuarters > half) {
+      mLadder.push_back({ threeQuarters, 1.0F, 0 });
+    }
+    if (half < fps) {
+      mLadder.push_back({ half, 1.0F, 0 });
+    }
+    mLadder.push_back({ std::min(half, fps), 0.75F, 0 });
+    mLadder.push_back({ std::min(half, fps), 0.5F, 0 });
+    if (low < std::min(half, fps)) {
+      mLadder.push_back({ low, 0.5F, 0 });
+    }
+  }
+
+  auto CaptureGovernor::onEncoded(std::chrono::microseconds took) -> bool
+  {
+    mEncoded++;
+    mEncodeUs += static_cast<uint64_t>(took.count());
+    auto now = Clock::now();
+    if (now - mLastSample < INTERVAL) {
+      return false;
+    }
+
+    auto stats   = mBus.stats();
+    auto dropped = mSubscription.dropped();
+    auto sample  = PipelineSample {
+      stats.captured - mLastStats.captured,
+      stats.grabUs - mLastStats.grabUs,
+      stats.convertUs - mLastStats.convertUs,
+      mEncoded,
+      mEncodeUs,
+      mSubscription.depth(),
+      mSubscription.capacity(),
+      dropped - mLastDropped,
+    };
+    mLastSample  = now;
+    mLastStats   = stats;
+    mLastDropped = dropped;
+    mEncoded     = 0;
+    mEncodeUs    = 0;
+
+    auto reason = update(sample);
+    if (!reason) {
+      return false;
+    }
+    const auto &current = settings();
+    logger->info("Capture adjusted. Fps={}, Scale={}, Effort={}: {}",
+                 current.fps,
+                 current.scale,
+                 current.effort,
+                 *reason);
+    mSubscription.limit(current.fps, current.scale);
+    publishEvent(EventDataCaptureAdjusted(
+      current.fps, current.scale, current.effort, std::move(*reason)));
+    return true;
+  }
+
+  auto CaptureGovernor::update(const PipelineSample &sample)
+    -> std::optional<std::string>
+  {
+    if (sample.frames == 0 && sample.encoded == 0) {
+      return std::nullopt;
+    }
+    const auto &current = settings();
+    auto        budget  = MICROS_PER_SECOND / current.fps;
+    auto capture = perFrame(sample.grabUs + sample.convertUs, sample.frames);
+    auto encode  = perFrame(sample.encodeUs, sample.encoded);
+    auto load    = std::max(capture, encode) / budget;
+    auto stage   = capture >= encode ? "capture" : "encode";
+    bool backlog = sample.dropped > 0 || (sample.queueCapacity > 1 &&
+                                          sample.queueDepth * 2 >
+                                            sample.queueCapacity);
+
+    if (load > OVERLOADED || backlog) {
+      mQuiet = 0;
+      if (mStep + 1 >= mLadder.size()) {
+        return std::nullopt;
+      }
+      mStep++;
+      if (backlog && load <= OVERLOADED) {
+        return fmt::format("the encoder dropped {} frames", sample.dropped);
+      }
+      return fmt::format(
+        "the {} stage takes {:.0f}% of the frame time", stage, load * 100);
+    }
+
+    if (mStep == 0 || ++mQuiet < QUIET_INTERVALS) {
+      return std::nullopt;
+    }
+    // the cost of a frame grows with its pixels, the budget shrinks with
+    // the frame rate
+    const auto &up         = mLadder[mStep - 1];
+    auto        pixels     = (up.scale * up.scale) /
+                             (current.scale * current.scale);
+    auto        effortCost = up.effort > current.effort ? EFFORT_COST : 1.0;
+    auto        predicted  = std::max(capture * pixels, encode * pixels *
+                                                          effortCost) /
+                             (MICROS_PER_SECOND / up.fps);
+    if (predicted > HEADROOM) {
+      return std::nullopt;
+    }
+    mQuiet = 0;
+    mStep--;
+    return fmt::format("the pipeline has room to spare ({:.0f}% of the frame "
+                       "time used)",
+                       load * 100);
+  }
+
+  auto CaptureGovernor::settings() const noexcept -> const GovernorSettings &
+  {
+    return mLadder[mStep];
+  }
+} // namespace smv::details
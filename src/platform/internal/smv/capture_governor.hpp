@@ -0,0 +1,108 @@
+#pragma once
+
+#include "frame_bus.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace smv::details {
+  /**
+   * @brief What a capture pipeline did over one adaptation interval
+   */
+  struct PipelineSample
+  {
+    // frames grabbed, and the time spent grabbing and converting them
+    uint64_t frames    = 0;
+    uint64_t grabUs    = 0;
+    uint64_t convertUs = 0;
+    // frames encoded, and the time spent encoding them
+    uint64_t encoded  = 0;
+    uint64_t encodeUs = 0;
+    // frames waiting for the encoder at the end of the interval, out of how
+    // many can wait
+    std::size_t queueDepth    = 0;
+    std::size_t queueCapacity = 1;
+    // frames the encoder did not get to
+    uint64_t dropped = 0;
+  };
+
+  /**
+   * @brief The knobs a CaptureGovernor turns
+   */
+  struct GovernorSettings
+  {
+    uint8_t fps = 0;
+    // a factor of the configured output size
+    float scale = 1.0F;
+    // how hard the encoder works for quality, 0 being the fastest
+    uint8_t effort = 0;
+  };
+
+  /**
+   * @brief Adapts a capture to what the machine can keep up with
+   *
+   * @details Once a second, the time spent grabbing, converting and encoding
+   * a frame is compared to the time between two frames, and the encoder's
+   * queue is checked for dropped frames. When a stage takes more than 90% of
+   * the frame time, or frames pile up, the capture goes one step down a
+   * ladder of settings: a faster encoder preset first, then a lower frame
+   * rate, then a smaller size, then the lowest frame rate. It steps back up
+   * after five quiet seconds, and only when the next step up is predicted to
+   * fit in the frame time, so that it does not bounce between two steps.
+   * Every step is logged and published as an EventDataCaptureAdjusted.
+   *
+   * The frame rate and the size are limited on the governed subscription
+   * only (see FrameSubscription::limit), so the other consumers of the
+   * FrameBus keep their own rate and size; the caller applies the effort to
+   * its own encoder
+   */
+  class CaptureGovernor
+  {
+  public:
+    static constexpr auto    INTERVAL = std::chrono::seconds(1);
+    static constexpr uint8_t MIN_FPS  = 5;
+
+    /**
+     * @param bus the capture the encoder reads from
+     * @param subscription the frames the encoder reads, which are adapted
+     * @param effort the encoder effort to start with, and never go above
+     */
+    CaptureGovernor(FrameBus          &bus,
+                    FrameSubscription &subscription,
+                    uint8_t            effort);
+
+    /**
+     * @brief Account for one encoded frame, and adapt once per interval
+     * @return true if the settings changed
+     */
+    auto onEncoded(std::chrono::microseconds took) -> bool;
+
+    /**
+     * @brief Decide on a new step from the last interval
+     * @return why the settings changed, if they did
+     */
+    auto update(const PipelineSample &sample) -> std::optional<std::string>;
+
+    auto settings() const noexcept -> const GovernorSettings &;
+
+  private:
+    using Clock = std::chrono::steady_clock;
+
+    FrameBus                     &mBus;
+    FrameSubscription            &mSubscription;
+    // from the best settings to the lightest
+    std::vector<GovernorSettings> mLadder;
+    std::size_t                   mStep = 0;
+    // intervals in a row with room to spare
+    uint32_t                      mQuiet = 0;
+    Clock::time_point             mLastSample;
+    VideoCaptureStats             mLastStats;
+    uint64_t                      mLastDropped = 0;
+    uint64_t                      mEncoded     = 0;
+    uint64_t                      mEncodeUs    = 0;
+  };
+} // namespace smv::details
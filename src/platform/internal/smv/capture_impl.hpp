@@ -3,15 +3,74 @@
 #include "capture_audio.hpp"
 #include "capture_screenshot.hpp"
 #include "capture_video.hpp"
+#include "frame.hpp"
+#include "smv/events.hpp"
 #include "smv/record.hpp"
 
+#include <functional>
 #include <memory>
+#include <optional>
+#include <string>
+#include <vector>
 
 namespace smv::details {
   auto createScreenshotCaptureSource(const ScreenshotConfig &)
     -> std::shared_ptr<ScreenshotSource>;
   auto createAudioCaptureSource(const AudioCaptureConfig &)
     -> std::shared_ptr<AudioCaptureSource>;
-  auto createVideoCaptureSource(const VideoCaptureConfig &)
+  auto createPlatformAudioBackend(const AudioCaptureConfig &)
+    -> std::unique_ptr<AudioBackend>;
+  auto createVideoCaptureSource(const VideoCaptureConfig &,
+                                PixelLayout layout = PixelLayout::I420)
     -> std::shared_ptr<VideoCaptureSource>;
+
+  /**
+   * @brief Grab the raw pixels of the given area
+   *
+   * @details Nothing is copied or converted. The view passed to func is only
+   * valid until func returns
+   *
+   * @param area the window/region to capture
+   * @param func receives the raw pixels
+   * @param path the capture path of a capture that grabs the same area over
+   * and over. Chosen on its first grab and kept, or replaced when it stops
+   * working. nullptr to choose it again on every grab
+   * @return std::optional<std::string> an error message if the grab failed
+   */
+  auto grabFrame(const decltype(ScreenshotConfig::area)       &area,
+                 const std::function<void(const FrameView &)> &func,
+                 std::optional<CapturePath> *path = nullptr)
+    -> std::optional<std::string>;
+
+  /**
+   * @brief Set up what the first capture would otherwise have to, such as
+   * the capture buffer
+   * @return the size of the screen, or std::nullopt if capture has not been
+   * initialized
+   */
+  auto prepareCapture() -> std::optional<Size>;
+
+  /**
+   * @brief Measure how fast each capture path is on this display server, or
+   * load the measures of a previous run with the same server
+   * @details Until then, grabs go through shared memory whenever they can
+   */
+  void probeCapturePaths();
+
+  /**
+   * @brief the measures taken by probeCapturePaths
+   */
+  auto capturePathReport() -> CapturePathReport;
+
+  /**
+   * @brief the monitors of every screen
+   * @details A screen whose monitors cannot be listed is reported as a
+   * single monitor
+   */
+  auto listMonitors() -> std::vector<Monitor>;
+
+  /**
+   * @brief Deliver a capture event to its listeners (see smv::listen)
+   */
+  void publishEvent(const EventDataCaptureAdjusted &data);
 } // namespace smv::details
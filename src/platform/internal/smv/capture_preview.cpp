@@ -0,0 +1,61 @@
+#include "frame_bus.hpp"
+#include "smv/log.hpp"
+#include "smv/record.hpp"
+
+#include <memory>
+#include <thread>
+#include <utility>
+
+namespace smv {
+  using smv::details::DropPolicy;
+  using smv::details::FrameBus;
+  using smv::details::PixelLayout;
+  using smv::log::logger;
+
+  auto capturePreview(const VideoCaptureConfig     &config,
+                      std::function<void(RawImage)> callback) -> Cancel
+  {
+    if (!config.isValid()) {
+      logger->error("Invalid capture config");
+      return [] {};
+    }
+    auto bus = FrameBus::acquire(config);
+    if (auto err = bus->error()) {
+      logger->error("Failed to start the preview: {}", *err);
+      return [] {};
+    }
+    // a preview only ever wants the latest frame
+    auto subscription = bus->subscribe(PixelLayout::BGRX, DropPolicy::Oldest);
+    auto preview      = [bus, subscription, callback = std::move(callback)]() {
+      while (auto frame = subscription->next()) {
+        if (frame->repeat) {
+          continue;
+        }
+        const auto &pixels = *frame->pixels;
+        RawImage    image;
+        image.data     = pixels.bytes.data();
+        image.width    = pixels.width;
+        image.height   = pixels.height;
+        image.stride   = pixels.strides[0];
+        image.hasAlpha = pixels.hasAlpha;
+        // the bus recycles a frame once nobody else holds it
+        image.buffer = std::move(frame->pixels);
+        callback(std::move(image));
+      }
+    };
+    // a preview that is never cancelled keeps running, detached
+    auto thread = std::shared_ptr<std::thread>(
+      new std::thread(std::move(preview)), [](std::thread *running) {
+      if (running->joinable()) {
+        running->detach();
+      }
+      delete running;
+    });
+    return [subscription, thread] {
+      subscription->close();
+      if (thread->joinable()) {
+        thread->join();
+      }
+    };
+  }
+} // namespace smv
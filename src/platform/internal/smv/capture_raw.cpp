@@ -0,0 +1,223 @@
+#include "capture_impl.hpp"
+#include "frame_bus.hpp"
+#include "raw_recording.hpp"
+#include "raw_transcode.hpp"
+#include "smv/log.hpp"
+#include "smv/record.hpp"
+
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <variant>
+#include <vector>
+
+namespace smv::details {
+  using smv::log::logger;
+
+  namespace {
+    // frames waiting to be written, before the oldest are dropped. Writing is
+    // mostly compression, so this only absorbs short stalls of the disk
+    constexpr auto RAW_QUEUE = 8;
+    // seconds between keyframes. Also the size of the transcoder's segments
+    constexpr auto RAW_KEYFRAME_SECONDS = 2;
+
+    void runRawRecording(const std::shared_ptr<FrameBus>          &bus,
+                         const std::shared_ptr<FrameSubscription> &subscription,
+                         std::unique_ptr<RawRecordingWriter>       writer,
+                         const std::function<void(std::optional<std::string>)>
+                           &callback)
+    {
+      std::optional<std::string> errMsg;
+      while (auto frame = subscription->next()) {
+        if ((errMsg = writer->write(frame->pixels->view(), frame->ptsUs))) {
+          break;
+        }
+      }
+      subscription->close();
+      if (auto err = writer->finish(); !errMsg) {
+        errMsg = std::move(err);
+      }
+      if (!errMsg) {
+        errMsg = bus->error();
+      }
+      if (subscription->dropped() > 0) {
+        logger->warn("Raw recording dropped {} frames",
+                     subscription->dropped());
+      }
+      if (callback) {
+        callback(std::move(errMsg));
+      }
+    }
+
+    /**
+     * @brief start a raw recording on its own thread
+     * @return Cancel stops the recording, or an error message if it could not
+     * start. The callback is only called if the recording started
+     */
+    auto startRawRecording(
+      const RawRecordConfig                          &config,
+      std::function<void(std::optional<std::string>)> callback)
+      -> std::variant<Cancel, std::string>
+    {
+      auto writer = std::make_unique<RawRecordingWriter>(
+        config.path, config.fpsHint, config.fpsHint * RAW_KEYFRAME_SECONDS);
+      if (auto err = writer->open()) {
+        return std::move(*err);
+      }
+      auto bus = FrameBus::acquire(config);
+      if (auto err = bus->error()) {
+        return std::move(*err);
+      }
+      auto subscription =
+        bus->subscribe(PixelLayout::BGRX, DropPolicy::Oldest, RAW_QUEUE);
+      std::thread(runRawRecording,
+                  bus,
+                  subscription,
+                  std::move(writer),
+                  std::move(callback))
+        .detach();
+      logger->info("Raw recording started. Path={}", config.path);
+
+      return [weakSubscription = std::weak_ptr(subscription)] {
+        if (auto subscription = weakSubscription.lock()) {
+          subscription->close();
+        }
+      };
+    }
+
+    /**
+     * @brief the path with the name of the monitor added before its extension
+     */
+    auto monitorPath(const std::string &path, const std::string &monitor)
+      -> std::string
+    {
+      auto name = path.find_last_of('/');
+      auto dot  = path.find_last_of('.');
+      if (dot == std::string::npos ||
+          (name != std::string::npos && dot < name)) {
+        return path + "-" + monitor;
+      }
+      return path.substr(0, dot) + "-" + monitor + path.substr(dot);
+    }
+  } // namespace
+} // namespace smv::details
+
+namespace smv {
+  using smv::details::listMonitors;
+  using smv::details::monitorPath;
+  using smv::details::startRawRecording;
+  using smv::details::ThreadPool;
+  using smv::details::transcodeToH264;
+  using smv::log::logger;
+
+  auto captureRaw(const RawRecordConfig                          &config,
+                  std::function<void(std::optional<std::string>)> callback)
+    -> Cancel
+  {
+    if (!config.isValid() || config.path.empty()) {
+      logger->error("Invalid capture config");
+      return [] {};
+    }
+    auto started = startRawRecording(config, std::move(callback));
+    if (std::holds_alternative<std::string>(started)) {
+      logger->error("Failed to start the raw recording: {}",
+                    std::get<std::string>(started));
+      return [] {};
+    }
+    return std::get<Cancel>(std::move(started));
+  }
+
+  auto captureMonitors(
+    const RawRecordConfig                          &config,
+    std::function<void(std::optional<std::string>)> callback) -> Cancel
+  {
+    if (config.path.empty()) {
+      logger->error("Invalid capture config");
+      return [] {};
+    }
+    auto outputs = listMonitors();
+    if (outputs.empty()) {
+      logger->error("No monitors to record");
+      return [] {};
+    }
+
+    // reports the first error, once every recording is finished
+    struct Recordings
+    {
+      std::mutex                                      mutex;
+      std::size_t                                     running = 0;
+      std::optional<std::string>                      errMsg;
+      std::function<void(std::optional<std::string>)> callback;
+    };
+    auto recordings      = std::make_shared<Recordings>();
+    recordings->running  = outputs.size();
+    recordings->callback = std::move(callback);
+    auto finished = [recordings](std::optional<std::string> err) {
+      std::unique_lock lock(recordings->mutex);
+      if (err && !recordings->errMsg) {
+        recordings->errMsg = std::move(err);
+      }
+      if (--recordings->running == 0 && recordings->callback) {
+        lock.unlock();
+        recordings->callback(std::move(recordings->errMsg));
+      }
+    };
+
+    std::vector<Cancel> cancels;
+    for (const auto &monitor : outputs) {
+      auto output = config;
+      output.area = monitor.area;
+      output.path = monitorPath(config.path, monitor.name);
+      auto started = startRawRecording(output, finished);
+      if (std::holds_alternative<std::string>(started)) {
+        logger->error("Failed to record monitor {}: {}",
+                      monitor.name,
+                      std::get<std::string>(started));
+        for (const auto &cancel : cancels) {
+          cancel();
+        }
+        // the monitors that were not started never finish on their own
+        auto missing = outputs.size() - cancels.size();
+        finished(std::get<std::string>(std::move(started)));
+        for (std::size_t i = 1; i < missing; i++) {
+          finished(std::nullopt);
+        }
+        return [] {};
+      }
+      cancels.push_back(std::get<Cancel>(std::move(started)));
+    }
+    return [cancels = std::move(cancels)] {
+      for (const auto &cancel : cancels) {
+        cancel();
+      }
+    };
+  }
+
+  void transcodeRaw(const std::string                              &input,
+                    const std::string                              &output,
+                    VideoCaptureFormat                              format,
+                    std::function<void(std::optional<std::string>)> callback)
+  {
+    if (format != VideoCaptureFormat::H264) {
+      if (callback) {
+        callback("Raw recordings can only be transcoded to H.264 for now");
+      }
+      return;
+    }
+    std::thread([input, output, callback = std::move(callback)] {
+      // a pool of its own, so that a live capture keeps the shared one
+      ThreadPool pool(std::max(std::thread::hardware_concurrency(), 2U) - 1);
+      auto       errMsg = transcodeToH264(input, output, pool);
+      if (errMsg) {
+        logger->error("Failed to transcode {}: {}", input, *errMsg);
+      } else {
+        logger->info("Transcoded {} to {}", input, output);
+      }
+      if (callback) {
+        callback(std::move(errMsg));
+      }
+    }).detach();
+  }
+} // namespace smv
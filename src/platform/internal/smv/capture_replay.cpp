@@ -0,0 +1,277 @@
+#include "audio_opus.hpp"
+#include "capture_impl.hpp"
+#include "encoder_mjpeg.hpp"
+#include "frame_bus.hpp"
+#include "interleaver.hpp"
+#include "ogg_opus.hpp"
+#include "replay_buffer.hpp"
+#include "smv/log.hpp"
+#include "smv/record.hpp"
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace smv::details {
+  using smv::log::logger;
+
+  namespace {
+    // frames waiting for the encoder, before the oldest are dropped
+    constexpr auto REPLAY_QUEUE = 4;
+    // Opus always decodes at 48 kHz, whatever the input rate
+    constexpr auto OPUS_RATE = 48'000U;
+
+    struct Replay
+    {
+      std::shared_ptr<FrameBus>          bus;
+      std::shared_ptr<FrameSubscription> subscription;
+      std::shared_ptr<ReplayBuffer>      buffer;
+      // orders the video and audio packets by pts on their way to the buffer
+      std::shared_ptr<InterleavingMuxer> muxer;
+      // the audio track, if audio is recorded along with the video
+      std::optional<MatroskaTrack> audio;
+    };
+
+    struct ReplayAudio
+    {
+      std::shared_ptr<AudioCaptureSource> source;
+      std::unique_ptr<OpusAudioEncoder>   encoder;
+    };
+
+    std::mutex              replayMutex;
+    std::shared_ptr<Replay> activeReplay;
+
+    /**
+     * @brief the size of a JPEG picture, read from its start of frame
+     */
+    auto jpegSize(const std::vector<uint8_t> &bytes) -> Size
+    {
+      // each segment after the SOI marker is FF, the marker, and a length
+      // that counts itself
+      std::size_t at = 2;
+      while (at + 9 <= bytes.size() && bytes[at] == 0xFF) {
+        auto marker = bytes[at + 1];
+        if (marker >= 0xC0 && marker <= 0xC2) {
+          return { static_cast<uint32_t>(bytes[at + 7] << 8 | bytes[at + 8]),
+                   static_cast<uint32_t>(bytes[at + 5] << 8 | bytes[at + 6]) };
+        }
+        at += 2 + static_cast<std::size_t>(bytes[at + 2] << 8 | bytes[at + 3]);
+      }
+      return {};
+    }
+
+    /**
+     * @brief Start capturing audio stamped on the clock of the video
+     * @return the source and its encoder, or std::nullopt if no audio source
+     * is configured or it could not be started
+     */
+    auto startAudio(const AudioCaptureConfig &config, const MediaClock &clock)
+      -> std::optional<ReplayAudio>
+    {
+      if (config.sourceId == 0) {
+        return std::nullopt;
+      }
+      auto source = createAudioCaptureSource(config);
+      if (!source) {
+        return std::nullopt;
+      }
+      auto encoder = std::make_unique<OpusAudioEncoder>(
+        source->format(), config.bitrate, config.frameDuration);
+      if (auto err = encoder->open()) {
+        logger->error("Failed to open the replay audio encoder: {}", *err);
+        return std::nullopt;
+      }
+      source->useClock(clock);
+      if (auto err = source->start()) {
+        logger->error("Failed to start the replay audio: {}", *err);
+        return std::nullopt;
+      }
+      return ReplayAudio { std::move(source), std::move(encoder) };
+    }
+
+    /**
+     * @brief encode frames into the buffer until the subscription is closed
+     */
+    void runReplay(const std::shared_ptr<Replay> &replay,
+                   std::unique_ptr<VideoEncoder>  encoder)
+    {
+      while (auto frame = replay->subscription->next()) {
+        auto packet =
+          encoder->encode(*frame->pixels, frame->ptsUs, frame->repeat);
+        if (!packet) {
+          logger->error("Failed to encode replay frame");
+          break;
+        }
+        replay->muxer->push(StreamKind::Video, std::move(packet));
+      }
+      replay->subscription->close();
+      replay->muxer->flush();
+      if (auto err = replay->bus->error()) {
+        logger->error("Replay capture stopped: {}", *err);
+      }
+    }
+
+    /**
+     * @brief encode audio into the buffer until the subscription is closed
+     */
+    void runReplayAudio(const std::shared_ptr<Replay> &replay,
+                        ReplayAudio                    audio)
+    {
+      const auto channels = audio.source->format().channels;
+      while (!replay->subscription->isClosed() && audio.source->next()) {
+        const auto &samples = audio.source->samples();
+        const auto &packets = audio.encoder->encode(
+          samples.data(), samples.size() / channels, audio.source->ptsUs());
+        for (const auto &packet : packets) {
+          replay->muxer->setAudioDrift(audio.source->driftUs());
+          replay->muxer->push(StreamKind::Audio, packet);
+        }
+      }
+      audio.source->stop();
+      if (auto err = audio.source->error()) {
+        logger->error("Replay audio stopped: {}", *err);
+      }
+    }
+  } // namespace
+
+  /**
+   * @brief Start the replay buffer, replacing the one running, if any
+   * @return Cancel stops it
+   */
+  auto startReplay(const ReplayConfig &config) -> Cancel
+  {
+    if (!config.isValid()) {
+      logger->error("Invalid capture config");
+      return [] {};
+    }
+    auto encoder = std::make_unique<MjpegEncoder>(config.jpegQuality);
+    auto bus     = FrameBus::acquire(config);
+    if (auto err = bus->error()) {
+      logger->error("Failed to start the replay buffer: {}", *err);
+      return [] {};
+    }
+    auto buffer =
+      std::make_shared<ReplayBuffer>(config.duration, config.maxBytes);
+    auto muxer = std::make_shared<InterleavingMuxer>(
+      [buffer](StreamKind stream, const PacketPtr &packet, int64_t ptsUs) {
+      if (ptsUs == packet->ptsUs) {
+        buffer->push(stream, packet);
+        return;
+      }
+      // the payload is shared, only the pts is corrected
+      auto corrected   = std::make_shared<EncodedPacket>(*packet);
+      corrected->ptsUs = ptsUs;
+      buffer->push(stream, std::move(corrected));
+    });
+    muxer->addStream(StreamKind::Video);
+
+    // audio is stamped on the clock of the bus, so both line up
+    std::optional<MatroskaTrack> audioTrack;
+    auto audio = startAudio(config.audioConfig, bus->clock());
+    if (audio) {
+      auto format = audio->encoder->format();
+      audioTrack  = MatroskaTrack { "A_OPUS",
+                                    opusHead(format.channels,
+                                             format.sampleRate,
+                                             audio->encoder->preSkip()),
+                                    0,
+                                    0,
+                                    OPUS_RATE,
+                                    format.channels };
+      muxer->addStream(StreamKind::Audio);
+    }
+
+    auto subscription =
+      bus->subscribe(encoder->layout(), DropPolicy::Oldest, REPLAY_QUEUE);
+    auto replay = std::make_shared<Replay>(Replay { std::move(bus),
+                                                    std::move(subscription),
+                                                    std::move(buffer),
+                                                    std::move(muxer),
+                                                    std::move(audioTrack) });
+
+    {
+      std::lock_guard _(replayMutex);
+      if (activeReplay) {
+        activeReplay->subscription->close();
+      }
+      activeReplay = replay;
+    }
+    std::thread(runReplay, replay, std::move(encoder)).detach();
+    if (audio) {
+      std::thread(runReplayAudio, replay, std::move(*audio)).detach();
+    }
+    logger->info("Replay buffer started. Duration={}s, MaxBytes={}, Audio={}",
+                 config.duration.count(),
+                 config.maxBytes,
+                 replay->audio.has_value());
+
+    return [weakReplay = std::weak_ptr(replay)] {
+      auto replay = weakReplay.lock();
+      if (!replay) {
+        return;
+      }
+      replay->subscription->close();
+      std::lock_guard _(replayMutex);
+      if (activeReplay == replay) {
+        activeReplay.reset();
+      }
+    };
+  }
+
+  /**
+   * @brief Save the end of the running replay buffer
+   */
+  void saveReplay(const std::string                              &path,
+                  std::chrono::seconds                            last,
+                  std::function<void(std::optional<std::string>)> callback)
+  {
+    std::shared_ptr<Replay> replay;
+    {
+      std::lock_guard _(replayMutex);
+      replay = activeReplay;
+    }
+    if (!replay) {
+      if (callback) {
+        callback("No replay buffer is running");
+      }
+      return;
+    }
+    auto packets = replay->buffer->snapshot(last);
+    if (packets.empty()) {
+      if (callback) {
+        callback("The replay buffer is empty");
+      }
+      return;
+    }
+    // the frames keep the time they were captured at, so the replay plays
+    // at the speed it happened even when frames were skipped. A snapshot
+    // starts with a video keyframe
+    auto size   = jpegSize(packets.front().packet->bytes());
+    auto tracks = std::vector { MatroskaTrack {
+      "V_MJPEG", {}, size.w, size.h } };
+    if (replay->audio) {
+      tracks.push_back(*replay->audio);
+    }
+    logger->info("Saving {} replay packets to {}", packets.size(), path);
+    writePackets(
+      std::move(packets), std::move(tracks), path, std::move(callback));
+  }
+} // namespace smv::details
+
+namespace smv {
+  auto captureReplay(const ReplayConfig &config) -> Cancel
+  {
+    return details::startReplay(config);
+  }
+
+  void saveReplay(const std::string                              &path,
+                  std::chrono::seconds                            last,
+                  std::function<void(std::optional<std::string>)> callback)
+  {
+    details::saveReplay(path, last, std::move(callback));
+  }
+} // namespace smv
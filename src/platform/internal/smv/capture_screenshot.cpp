@@ -1,5 +1,9 @@
 #include "capture_screenshot.hpp"
 #include "capture_impl.hpp"
+#include "convert.hpp"
+#include "convert_rgb.hpp"
+#include "qoi.hpp"
+#include "scale.hpp"
 #include "smv/common/fmt.hpp" // IWYU pragma: keep
 #include "smv/common/raw_iter.hpp"
 #include "smv/log.hpp"
@@ -7,6 +11,7 @@
 
 #include <cstdint>
 #include <iterator>
+#include <memory>
 #include <sstream>
 #include <thread>
 
@@ -151,7 +156,8 @@ namespace smv::details {
   auto ScreenshotSource::toPPM(ScreenshotSource &source)
     -> std::optional<ScreenshotSource>
   {
-    if (source.channelCount < 3) {
+    // P6 has no alpha
+    if (source.channelCount != 3) {
       return std::nullopt;
     }
     /* TODO: Replace with Boost.Interprocess, specifically vectorstream */
@@ -181,12 +187,22 @@ namespace smv::details {
     return ppmSource;
   }
 
-  auto ScreenshotSource::toQoi(ScreenshotSource & /*unused*/)
+  auto ScreenshotSource::toQoi(ScreenshotSource &source)
     -> std::optional<ScreenshotSource>
   {
-    // TODO QOI conversion. See https://qoiformat.org/
-    logger->warn("QOI conversion not yet implemented");
-    return std::nullopt;
+    auto encoded = encodeQoi(source.captureBytes.data(),
+                             source.width(),
+                             source.height(),
+                             source.channels(),
+                             source.scanLine());
+    if (encoded.empty()) {
+      return std::nullopt;
+    }
+    ScreenshotSource qoiSource(
+      std::move(encoded), { source.width(), source.height() });
+    qoiSource.format       = ScreenshotFormat::QOI;
+    qoiSource.channelCount = source.channels();
+    return qoiSource;
   }
 
   void writeFunc(void *context, void *data, int size)
@@ -213,7 +229,51 @@ namespace smv::details {
 namespace smv {
   using log::logger;
   using smv::details::capture;
+  using smv::details::convertToBgra;
+  using smv::details::FrameView;
+  using smv::details::grabFrame;
+  using smv::details::isOpaque;
+  using smv::details::scaleFrame;
   using smv::details::ScreenshotSource;
+  using smv::details::VideoFrame;
+
+  void captureImage(
+    const ScreenshotConfig                                   &config,
+    std::function<void(std::variant<RawImage, std::string>)> callback)
+  {
+    if (!config.isValid()) {
+      callback(std::string("Invalid capture config"));
+      return;
+    }
+    std::thread([config, callback = std::move(callback)]() {
+      // the pixels are copied once out of the capture buffer, which is
+      // reused by the next grab, and then handed over as they are
+      auto frame    = std::make_shared<VideoFrame>();
+      bool hasAlpha = false;
+      auto err      = grabFrame(config.area, [&](FrameView view) {
+        VideoFrame scaled;
+        if (auto outputSize = config.outputSizeFor({ view.width, view.height });
+            outputSize.w != view.width || outputSize.h != view.height) {
+          view = scaleFrame(view, outputSize, config.scaleFilter, scaled);
+        }
+        view.hasAlpha = view.hasAlpha && config.keepAlpha && !isOpaque(view);
+        hasAlpha      = view.hasAlpha;
+        convertToBgra(view, *frame);
+      });
+      if (err) {
+        callback(std::move(*err));
+        return;
+      }
+      RawImage image;
+      image.data     = frame->bytes.data();
+      image.width    = frame->width;
+      image.height   = frame->height;
+      image.stride   = frame->strides[0];
+      image.hasAlpha = hasAlpha;
+      image.buffer   = std::move(frame);
+      callback(std::move(image));
+    }).detach();
+  }
 
   void capture(const ScreenshotConfig &config,
                ScreenshotFormat        format,
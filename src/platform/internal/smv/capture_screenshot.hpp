@@ -63,7 +63,7 @@ namespace smv::details {
     static auto toPPM(ScreenshotSource &source)
       -> std::optional<ScreenshotSource>;
 
-    static auto toQoi(ScreenshotSource & /*unused*/)
+    static auto toQoi(ScreenshotSource &source)
       -> std::optional<ScreenshotSource>;
 
     // allow writeFunc to access private members.
@@ -0,0 +1,376 @@
+#include "capture_stream.hpp"
+#include "smv/common/fmt.hpp" // IWYU pragma: keep
+#include "smv/log.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+namespace smv::details {
+  using smv::log::logger;
+
+  namespace {
+    constexpr auto ADAPT_INTERVAL  = std::chrono::seconds(1);
+    // above this share of dropped frames, the stream is made lighter
+    constexpr auto MAX_DROP_RATIO  = 0.1;
+    // the stream is not made lighter than this by lowering its quality. A
+    // lower configured quality is kept as it is
+    constexpr auto MIN_QUALITY     = 40;
+    constexpr auto QUALITY_DOWN    = 10;
+    constexpr auto QUALITY_UP      = 5;
+    constexpr auto MAX_FRAME_SKIP  = 3U;
+  } // namespace
+
+  EncodedVideoSource::EncodedVideoSource(std::shared_ptr<FrameBus>     bus,
+                                         std::unique_ptr<VideoEncoder> encoder)
+    : mBus(std::move(bus))
+    , mSubscription(mBus->subscribe(encoder->layout()))
+    , mEncoder(std::move(encoder))
+  {
+  }
+
+  EncodedVideoSource::~EncodedVideoSource()
+  {
+    mSubscription->close();
+  }
+
+  auto EncodedVideoSource::next() noexcept
+    -> std::optional<std::basic_string_view<uint8_t>>
+  {
+    auto frame = mErrMsg ? std::nullopt : mSubscription->next();
+    if (!frame) {
+      return std::nullopt;
+    }
+    mPacket = mEncoder->encode(*frame->pixels, frame->ptsUs, frame->repeat);
+    if (!mPacket) {
+      mErrMsg = "Failed to encode frame";
+      return std::nullopt;
+    }
+    return std::basic_string_view(mPacket->bytes().data(),
+                                  mPacket->bytes().size());
+  }
+
+  auto EncodedVideoSource::error() noexcept -> std::optional<std::string>
+  {
+    if (mErrMsg) {
+      return mErrMsg;
+    }
+    return mBus->error();
+  }
+
+  VideoStreamSource::VideoStreamSource(std::shared_ptr<FrameBus>    bus,
+                                       std::unique_ptr<X264Encoder> encoder,
+                                       std::unique_ptr<RtspServer>  server)
+    : mBus(std::move(bus))
+    , mSubscription(mBus->subscribe(PixelLayout::I420))
+    , mEncoder(std::move(encoder))
+    , mGovernor(*mBus, *mSubscription, mEncoder->effort())
+    , mServer(std::move(server))
+  {
+    mServer->onViewerJoined([encoder = mEncoder.get()] {
+      encoder->forceKeyframe();
+    });
+  }
+
+  VideoStreamSource::~VideoStreamSource()
+  {
+    mSubscription->close();
+  }
+
+  auto VideoStreamSource::next() noexcept
+    -> std::optional<std::basic_string_view<uint8_t>>
+  {
+    auto frame = mErrMsg ? std::nullopt : mSubscription->next();
+    if (!frame) {
+      return std::nullopt;
+    }
+    auto start = std::chrono::steady_clock::now();
+    mPacket = mEncoder->encode(*frame->pixels, frame->ptsUs, frame->repeat);
+    if (!mPacket) {
+      mErrMsg = "Failed to encode frame";
+      return std::nullopt;
+    }
+    if (mGovernor.onEncoded(
+          std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start))) {
+      mEncoder->setEffort(mGovernor.settings().effort);
+    }
+    mServer->send(*mPacket);
+    return std::basic_string_view(mPacket->bytes().data(),
+                                  mPacket->bytes().size());
+  }
+
+  auto VideoStreamSource::error() noexcept -> std::optional<std::string>
+  {
+    if (mErrMsg) {
+      return mErrMsg;
+    }
+    return mBus->error();
+  }
+
+  auto VideoStreamSource::server() noexcept -> RtspServer &
+  {
+    return *mServer;
+  }
+
+  void VideoStreamSource::stop() noexcept
+  {
+    mSubscription->close();
+  }
+
+  MjpegStreamSource::MjpegStreamSource(std::shared_ptr<FrameBus>    bus,
+                                       int                          quality,
+                                       std::unique_ptr<MjpegServer> server)
+    : mBus(std::move(bus))
+    , mSubscription(mBus->subscribe(PixelLayout::RGB))
+    , mEncoder(quality)
+    , mServer(std::move(server))
+    , mMaxQuality(quality)
+    , mQuality(quality)
+    , mLastAdapt(Clock::now())
+  {
+  }
+
+  MjpegStreamSource::~MjpegStreamSource()
+  {
+    mSubscription->close();
+  }
+
+  auto MjpegStreamSource::next() noexcept
+    -> std::optional<std::basic_string_view<uint8_t>>
+  {
+    while (!mErrMsg) {
+      auto frame = mSubscription->next();
+      if (!frame) {
+        break;
+      }
+      adapt();
+      if (mFrameCount++ % (mFrameSkip + 1) != 0) {
+        continue;
+      }
+      mPacket = mEncoder.encode(*frame->pixels, frame->ptsUs, frame->repeat);
+      if (!mPacket) {
+        mErrMsg = "Failed to encode frame";
+        break;
+      }
+      mServer->send(mPacket);
+      return std::basic_string_view(mPacket->bytes().data(),
+                                    mPacket->bytes().size());
+    }
+    return std::nullopt;
+  }
+
+  auto MjpegStreamSource::error() noexcept -> std::optional<std::string>
+  {
+    if (mErrMsg) {
+      return mErrMsg;
+    }
+    return mBus->error();
+  }
+
+  auto MjpegStreamSource::server() noexcept -> MjpegServer &
+  {
+    return *mServer;
+  }
+
+  void MjpegStreamSource::stop() noexcept
+  {
+    mSubscription->close();
+  }
+
+  void MjpegStreamSource::adapt()
+  {
+    auto now = Clock::now();
+    if (now - mLastAdapt < ADAPT_INTERVAL) {
+      return;
+    }
+    mLastAdapt = now;
+    auto stats = mServer->takeStats();
+    auto total = stats.sent + stats.dropped;
+    if (total == 0) {
+      return;
+    }
+
+    auto quality   = mQuality;
+    auto frameSkip = mFrameSkip;
+    if (static_cast<double>(stats.dropped) / static_cast<double>(total) >
+        MAX_DROP_RATIO) {
+      if (quality > MIN_QUALITY) {
+        quality = std::max(quality - QUALITY_DOWN, MIN_QUALITY);
+      } else {
+        frameSkip = std::min(frameSkip + 1, MAX_FRAME_SKIP);
+      }
+    } else if (stats.dropped == 0) {
+      if (frameSkip > 0) {
+        frameSkip--;
+      } else {
+        quality = std::min(quality + QUALITY_UP, mMaxQuality);
+      }
+    }
+    if (quality != mQuality || frameSkip != mFrameSkip) {
+      logger->debug("MJPEG stream adapted. Quality={}, FrameSkip={}, "
+                    "Sent={}, Dropped={}",
+                    quality,
+                    frameSkip,
+                    stats.sent,
+                    stats.dropped);
+      mQuality   = quality;
+      mFrameSkip = frameSkip;
+      mEncoder.setQuality(mQuality);
+    }
+  }
+} // namespace smv::details
+
+namespace smv {
+  using smv::details::DEFAULT_HTTP_PORT;
+  using smv::details::DEFAULT_RTSP_PORT;
+  using smv::details::FrameBus;
+  using smv::details::MjpegServer;
+  using smv::details::MjpegStreamSource;
+  using smv::details::RtspServer;
+  using smv::details::ServerUrl;
+  using smv::details::VideoStreamSource;
+  using smv::details::X264Encoder;
+  using smv::log::logger;
+
+  namespace {
+    /**
+     * @brief How the Cancel of a stream reaches its thread
+     */
+    struct StreamControl
+    {
+      std::mutex            mutex;
+      bool                  cancelled = false;
+      // ends the stream while it runs
+      std::function<void()> stop;
+    };
+
+    /**
+     * @brief let the callback drive the stream, or drive it until it fails
+     * or is cancelled. The server is stopped once the stream ends
+     */
+    template<typename S>
+    void runStream(S &stream, const CaptureCb &callback, StreamControl &control)
+    {
+      {
+        std::lock_guard _(control.mutex);
+        if (control.cancelled) {
+          stream.server().stop();
+          return;
+        }
+        control.stop = [&stream] { stream.stop(); };
+      }
+      if (callback) {
+        callback(stream);
+      } else {
+        while (stream.next()) {
+        }
+      }
+      {
+        std::lock_guard _(control.mutex);
+        control.stop = nullptr;
+      }
+      if (auto err = stream.error()) {
+        logger->error("Video stream stopped: {}", *err);
+      }
+      stream.server().stop();
+    }
+
+    void streamH264(const VideoStreamConfig             &config,
+                    CaptureCb                            callback,
+                    const std::shared_ptr<StreamControl> &control)
+    {
+      if (!X264Encoder::available()) {
+        logger->error("H.264 streaming needs a build with x264 enabled");
+        return;
+      }
+      auto url = ServerUrl::parse(config.rtspUrl, "rtsp", DEFAULT_RTSP_PORT);
+      if (!url) {
+        logger->error("Invalid RTSP url: {}", config.rtspUrl);
+        return;
+      }
+      std::thread([config,
+                   control,
+                   url      = std::move(*url),
+                   callback = std::move(callback)]() mutable {
+        auto bus = FrameBus::acquire(config);
+        if (auto err = bus->error()) {
+          logger->error("Failed to capture the video stream: {}", *err);
+          return;
+        }
+        auto server = std::make_unique<RtspServer>(std::move(url));
+        if (auto err = server->start()) {
+          logger->error("Failed to start the RTSP server: {}", *err);
+          return;
+        }
+        // one preset above the fastest, for the governor to fall back from
+        VideoStreamSource stream(
+          std::move(bus),
+          std::make_unique<X264Encoder>(config.fpsHint, 2, 1),
+          std::move(server));
+        runStream(stream, callback, *control);
+      }).detach();
+    }
+
+    void streamMjpeg(const VideoStreamConfig             &config,
+                     CaptureCb                            callback,
+                     const std::shared_ptr<StreamControl> &control)
+    {
+      auto url = ServerUrl::parse(config.httpUrl, "http", DEFAULT_HTTP_PORT);
+      if (!url) {
+        logger->error("Invalid HTTP url: {}", config.httpUrl);
+        return;
+      }
+      std::thread([config,
+                   control,
+                   url      = std::move(*url),
+                   callback = std::move(callback)]() mutable {
+        auto bus = FrameBus::acquire(config);
+        if (auto err = bus->error()) {
+          logger->error("Failed to capture the video stream: {}", *err);
+          return;
+        }
+        auto server = std::make_unique<MjpegServer>(std::move(url));
+        if (auto err = server->start()) {
+          logger->error("Failed to start the MJPEG server: {}", *err);
+          return;
+        }
+        MjpegStreamSource stream(
+          std::move(bus), config.jpegQuality, std::move(server));
+        runStream(stream, callback, *control);
+      }).detach();
+    }
+  } // namespace
+
+  auto captureStream(const VideoStreamConfig &config,
+                     VideoStreamFormat        format,
+                     CaptureCb                callback) -> Cancel
+  {
+    if (!config.isValid()) {
+      logger->error("Invalid capture config");
+      return [] {};
+    }
+    auto control = std::make_shared<StreamControl>();
+    switch (format) {
+      case VideoStreamFormat::H264:
+        streamH264(config, std::move(callback), control);
+        break;
+      case VideoStreamFormat::MJPEG:
+        streamMjpeg(config, std::move(callback), control);
+        break;
+      default:
+        logger->error("Unsupported video stream format: {}", format);
+        return [] {};
+    }
+    return [control] {
+      std::lock_guard _(control->mutex);
+      control->cancelled = true;
+      if (control->stop) {
+        control->stop();
+      }
+    };
+  }
+} // namespace smv
@@ -0,0 +1,138 @@
+#pragma once
+
+#include "capture_governor.hpp"
+#include "encoder_mjpeg.hpp"
+#include "encoder_x264.hpp"
+#include "frame_bus.hpp"
+#include "mjpeg_server.hpp"
+#include "rtsp_server.hpp"
+#include "smv/record.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+
+namespace smv::details {
+  /**
+   * @brief Encodes a video capture, for the caller to keep
+   *
+   * @details Every call to next waits for the next frame of the bus, encodes
+   * it, and returns the packet, e.g. an H.264 access unit (Annex B). The
+   * capture runs for as long as next is being called
+   */
+  class EncodedVideoSource: public CaptureSource
+  {
+  public:
+    EncodedVideoSource(std::shared_ptr<FrameBus>     bus,
+                       std::unique_ptr<VideoEncoder> encoder);
+    ~EncodedVideoSource() override;
+
+    auto next() noexcept
+      -> std::optional<std::basic_string_view<uint8_t>> override;
+    auto error() noexcept -> std::optional<std::string> override;
+
+  private:
+    std::shared_ptr<FrameBus>          mBus;
+    std::shared_ptr<FrameSubscription> mSubscription;
+    std::unique_ptr<VideoEncoder>      mEncoder;
+    PacketPtr                          mPacket;
+    std::optional<std::string>         mErrMsg;
+  };
+
+  /**
+   * @brief Encodes a video capture and publishes it with an RtspServer
+   *
+   * @details Every call to next waits for the next frame of the bus, encodes
+   * it, sends it to the viewers of the server, and returns the encoded access
+   * unit (Annex B), so the caller can also record what is being streamed.
+   * The stream runs for as long as next is being called.
+   * A CaptureGovernor watches how long capturing and encoding take, and
+   * lowers the encoder preset, the frame rate or the size of this stream
+   * when they fall behind. Other consumers of the bus are not affected
+   */
+  class VideoStreamSource: public CaptureSource
+  {
+  public:
+    VideoStreamSource(std::shared_ptr<FrameBus>    bus,
+                      std::unique_ptr<X264Encoder> encoder,
+                      std::unique_ptr<RtspServer>  server);
+    ~VideoStreamSource() override;
+
+    auto next() noexcept
+      -> std::optional<std::basic_string_view<uint8_t>> override;
+    auto error() noexcept -> std::optional<std::string> override;
+
+    /**
+     * @brief the server the stream is published on
+     */
+    auto server() noexcept -> RtspServer &;
+
+    /**
+     * @brief End the stream from any thread: next returns std::nullopt from
+     * then on
+     */
+    void stop() noexcept;
+
+  private:
+    std::shared_ptr<FrameBus>          mBus;
+    std::shared_ptr<FrameSubscription> mSubscription;
+    std::unique_ptr<X264Encoder>       mEncoder;
+    CaptureGovernor                    mGovernor;
+    std::unique_ptr<RtspServer>        mServer;
+    PacketPtr                          mPacket;
+    std::optional<std::string>         mErrMsg;
+  };
+
+  /**
+   * @brief Encodes a video capture to JPEG and publishes it with an
+   * MjpegServer
+   *
+   * @details Works like VideoStreamSource. Once a second, the source looks at
+   * how many frames the viewers had to drop: when they cannot keep up, the
+   * JPEG quality is lowered first, then frames are skipped. Both are restored
+   * step by step once the viewers keep up again
+   */
+  class MjpegStreamSource: public CaptureSource
+  {
+  public:
+    MjpegStreamSource(std::shared_ptr<FrameBus>    bus,
+                      int                          quality,
+                      std::unique_ptr<MjpegServer> server);
+    ~MjpegStreamSource() override;
+
+    auto next() noexcept
+      -> std::optional<std::basic_string_view<uint8_t>> override;
+    auto error() noexcept -> std::optional<std::string> override;
+
+    auto server() noexcept -> MjpegServer &;
+
+    /**
+     * @brief End the stream from any thread, like VideoStreamSource::stop
+     */
+    void stop() noexcept;
+
+  private:
+    using Clock = std::chrono::steady_clock;
+
+    /**
+     * @brief adjust the quality and frame rate to how the viewers are doing
+     */
+    void adapt();
+
+    std::shared_ptr<FrameBus>          mBus;
+    std::shared_ptr<FrameSubscription> mSubscription;
+    MjpegEncoder                       mEncoder;
+    std::unique_ptr<MjpegServer>       mServer;
+    // the configured quality, which adapting never goes above
+    const int                          mMaxQuality;
+    int                                mQuality;
+    // every (mFrameSkip + 1)th frame is sent
+    uint32_t                           mFrameSkip  = 0;
+    uint64_t                           mFrameCount = 0;
+    Clock::time_point                  mLastAdapt;
+    PacketPtr                          mPacket;
+    std::optional<std::string>         mErrMsg;
+  };
+} // namespace smv::details
@@ -1,7 +1,12 @@
 #include "capture_video.hpp"
 #include "capture_impl.hpp"
+#include "capture_stream.hpp"
+#include "convert.hpp"
+#include "frame_hash.hpp"
+#include "scale.hpp"
 #include "smv/log.hpp"
 
+#include <algorithm>
 #include <memory>
 #include <thread>
 #include <utility>
@@ -24,32 +29,199 @@ namespace smv::details {
       }
     }).detach();
   }
+
+  VideoCaptureSource::VideoCaptureSource(const VideoCaptureConfig &config,
+                                         PixelLayout               layout,
+                                         YuvMatrix                 matrix)
+    : mConfig(config)
+    , mLayout(layout)
+    , mMatrix(matrix)
+    , mInterval((std::chrono::duration_cast<Clock::duration>(
+                   std::chrono::seconds(1)) /
+                 std::max<int>(config.fpsHint, 1))
+                  .count())
+    , mStart(Clock::now())
+    , mNextTick(mStart)
+  {
+  }
+
+  auto VideoCaptureSource::next() noexcept
+    -> std::optional<std::basic_string_view<uint8_t>>
+  {
+    auto captured = nextView([this](const FrameView &view) {
+      convertFrame(view, mLayout, mMatrix, mFrame);
+    });
+    if (!captured) {
+      return std::nullopt;
+    }
+    return std::basic_string_view(mFrame.bytes.data(), mFrame.bytes.size());
+  }
+
+  auto VideoCaptureSource::nextView(
+    const std::function<void(const FrameView &)> &visit) noexcept -> bool
+  {
+    for (;;) {
+      if (mErrMsg || !waitNextTick()) {
+        return false;
+      }
+
+      auto grabStart = Clock::now();
+      auto ptsUs     = std::chrono::duration_cast<std::chrono::microseconds>(
+                     grabStart - mStart)
+                     .count();
+      auto grabbed   = grabStart;
+      bool duplicate = false;
+      auto err       = grabFrame(mConfig.area, [&](FrameView view) {
+        grabbed = Clock::now();
+        if (mConfig.duplicateFrames != DuplicateFrames::Keep) {
+          auto hash = hashFrame(view);
+          duplicate = hash == mLastHash;
+          mLastHash = hash;
+          if (duplicate) {
+            return;
+          }
+        }
+        auto outputSize = mConfig.outputSizeFor({ view.width, view.height });
+        if (auto scale = mScale.load(std::memory_order_relaxed); scale < 1.0F) {
+          outputSize = { std::max<uint32_t>(outputSize.w * scale, 1),
+                         std::max<uint32_t>(outputSize.h * scale, 1) };
+        }
+        if (outputSize.w != view.width || outputSize.h != view.height) {
+          view = scaleFrame(view, outputSize, mConfig.scaleFilter, mScaled);
+        }
+        mFrame.ptsUs = ptsUs;
+        visit(view);
+      }, &mPath);
+      auto done = Clock::now();
+      mGrabUs += std::chrono::duration_cast<std::chrono::microseconds>(
+                   grabbed - grabStart)
+                   .count();
+      mConvertUs += std::chrono::duration_cast<std::chrono::microseconds>(
+                      done - grabbed)
+                      .count();
+      if (err) {
+        mErrMsg = std::move(err);
+      }
+      if (mErrMsg) {
+        logger->error("Video capture failed: {}", *mErrMsg);
+        return false;
+      }
+
+      mCaptured++;
+      if (duplicate) {
+        mDuplicates++;
+        if (mConfig.duplicateFrames == DuplicateFrames::Skip) {
+          continue;
+        }
+      }
+      mEmitted++;
+      mFrame.repeat = duplicate;
+      mFrame.ptsUs  = ptsUs;
+      return true;
+    }
+  }
+
+  auto VideoCaptureSource::error() noexcept -> std::optional<std::string>
+  {
+    return mErrMsg;
+  }
+
+  auto VideoCaptureSource::frame() const noexcept -> const VideoFrame &
+  {
+    return mFrame;
+  }
+
+  void VideoCaptureSource::stop() noexcept
+  {
+    if (!mStopped.exchange(true)) {
+      auto counters = stats();
+      logger->info("Video capture stopped. Captured={}, Duplicates={}, "
+                   "Emitted={}",
+                   counters.captured,
+                   counters.duplicates,
+                   counters.emitted);
+    }
+  }
+
+  void VideoCaptureSource::useClock(const MediaClock &clock)
+  {
+    mStart = clock.origin();
+  }
+
+  auto VideoCaptureSource::stats() const noexcept -> VideoCaptureStats
+  {
+    return { mCaptured, mDuplicates, mEmitted, mGrabUs, mConvertUs };
+  }
+
+  void VideoCaptureSource::setFps(uint8_t fps) noexcept
+  {
+    mInterval = (std::chrono::duration_cast<Clock::duration>(
+                   std::chrono::seconds(1)) /
+                 std::max<int>(fps, 1))
+                  .count();
+  }
+
+  void VideoCaptureSource::setScale(float scale) noexcept
+  {
+    mScale = std::clamp(scale, 0.01F, 1.0F);
+  }
+
+  auto VideoCaptureSource::waitNextTick() -> bool
+  {
+    if (mStopped) {
+      return false;
+    }
+    auto now      = Clock::now();
+    auto interval = Clock::duration(mInterval.load());
+    if (now < mNextTick) {
+      std::this_thread::sleep_until(mNextTick);
+    } else if (now - mNextTick > interval) {
+      // we fell behind. Drop the frames we missed instead of bursting
+      mNextTick = now;
+    }
+    mNextTick += interval;
+    return !mStopped;
+  }
 } // namespace smv::details
 
 namespace smv {
-  using smv::details::capture;
-  using smv::details::VideoCaptureSource;
+  using smv::details::EncodedVideoSource;
+  using smv::details::FrameBus;
+  using smv::details::listMonitors;
+  using smv::details::X264Encoder;
   using smv::log::logger;
 
-  void capture(const VideoCaptureConfig &config,
-               VideoCaptureFormat /*unused*/,
-               CaptureCb callback)
+  auto monitors() -> std::vector<Monitor>
   {
-    capture(config,
-            [callback = std::move(callback)](const VideoCaptureSource &) {
-      // TODO: capture the video and call the callback
-      logger->warn("Video capture not yet implemented");
-    });
+    return listMonitors();
   }
 
-  void captureStream(const VideoStreamConfig &config,
-                     VideoStreamFormat /*unused*/,
-                     CaptureCb callback)
+  void capture(const VideoCaptureConfig &config,
+               VideoCaptureFormat        format,
+               CaptureCb                 callback)
   {
-    capture(dynamic_cast<const VideoCaptureConfig &>(config),
-            [callback = std::move(callback)](const VideoCaptureSource &) {
-      // TODO: capture the video and call the callback
-      logger->warn("Video streaming not yet implemented");
-    });
+    if (!config.isValid() || !callback) {
+      logger->error("Invalid capture config");
+      return;
+    }
+    if (format != VideoCaptureFormat::H264) {
+      logger->error("Unsupported video capture format: {}",
+                    static_cast<int>(format));
+      return;
+    }
+    if (!X264Encoder::available()) {
+      logger->error("H.264 capture needs a build with x264 enabled");
+      return;
+    }
+    std::thread([config, callback = std::move(callback)]() {
+      auto bus = FrameBus::acquire(config);
+      if (auto err = bus->error()) {
+        logger->error("Failed to start the video capture: {}", *err);
+        return;
+      }
+      EncodedVideoSource source(
+        std::move(bus), std::make_unique<X264Encoder>(config.fpsHint));
+      callback(source);
+    }).detach();
   }
 } // namespace smv
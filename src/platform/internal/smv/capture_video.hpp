@@ -1,13 +1,152 @@
 #pragma once
 
+#include "convert_yuv.hpp"
+#include "frame.hpp"
+#include "media_clock.hpp"
 #include "smv/record.hpp"
 
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+
 namespace smv::details {
-  struct VideoCaptureSource: public CaptureSource
-  {};
+  /**
+   * @brief Counters kept by a VideoCaptureSource
+   */
+  struct VideoCaptureStats
+  {
+    // frames grabbed from the screen
+    uint64_t captured = 0;
+    // grabbed frames that were identical to the frame before them
+    uint64_t duplicates = 0;
+    // frames returned by next, including repeats
+    uint64_t emitted = 0;
+    // total time spent waiting for the pixels of a frame, in microseconds
+    uint64_t grabUs = 0;
+    // total time spent hashing, scaling and converting the pixels
+    uint64_t convertUs = 0;
+  };
+
+  /**
+   * @brief Produces paced, uncompressed frames of the captured area
+   *
+   * @details Every call to next blocks until the next frame is due (based on
+   * VideoCaptureConfig::fpsHint), grabs the area and converts it to the
+   * requested layout straight out of the capture buffer. When the config asks
+   * for a smaller output, the capture buffer is scaled first.
+   * If the caller falls behind, the missed frames are skipped rather than
+   * queued.
+   *
+   * Each grab is hashed before it is converted. A grab that matches the
+   * previous one is handled according to VideoCaptureConfig::duplicateFrames:
+   * skipped (the frame after it simply has a later pts), or returned as is
+   * with VideoFrame::repeat set
+   */
+  class VideoCaptureSource: public CaptureSource
+  {
+  public:
+    explicit VideoCaptureSource(const VideoCaptureConfig &config,
+                                PixelLayout layout = PixelLayout::I420,
+                                YuvMatrix   matrix = YuvMatrix::BT709);
+
+    /**
+     * @brief Capture the next frame
+     *
+     * @return the bytes of the frame. See frame() for how to interpret them.
+     * std::nullopt once the source is stopped or has failed
+     */
+    auto next() noexcept
+      -> std::optional<std::basic_string_view<uint8_t>> override;
+    auto error() noexcept -> std::optional<std::string> override;
+
+    /**
+     * @brief Capture the next frame, without converting it
+     *
+     * @details Paced, hashed and scaled like next, but the pixels are handed
+     * to visit while they are still in the capture buffer, so a caller that
+     * needs several layouts converts each one straight from the source.
+     * visit is not called for a repeated frame. While visit runs, frame()
+     * holds the pts of the frame being visited; afterwards, it only holds
+     * the pts and the repeat flag of the frame
+     *
+     * @return false once the source is stopped or has failed
+     */
+    auto nextView(const std::function<void(const FrameView &)> &visit) noexcept
+      -> bool;
+
+    /**
+     * @brief the last frame returned by next
+     */
+    auto frame() const noexcept -> const VideoFrame &;
+
+    /**
+     * @brief stop the capture. The next call to next returns std::nullopt
+     */
+    void stop() noexcept;
+
+    /**
+     * @brief stamp frames with the time on the given clock, instead of the
+     * time since the capture started. Should be called before the first call
+     * to next
+     */
+    void useClock(const MediaClock &clock);
+
+    /**
+     * @brief a snapshot of the counters. Safe to call from any thread
+     */
+    auto stats() const noexcept -> VideoCaptureStats;
+
+    /**
+     * @brief change the frame rate, e.g. when the machine cannot keep up.
+     * Safe to call from any thread
+     */
+    void setFps(uint8_t fps) noexcept;
+
+    /**
+     * @brief scale the output further down, on top of what the config asks
+     * for. Safe to call from any thread
+     *
+     * @param scale a factor in (0, 1]
+     */
+    void setScale(float scale) noexcept;
+
+  protected:
+    using Clock = std::chrono::steady_clock;
+
+    /**
+     * @brief wait until the next frame is due
+     * @return false if the source was stopped while waiting
+     */
+    auto waitNextTick() -> bool;
+
+    const VideoCaptureConfig   mConfig;
+    const PixelLayout          mLayout;
+    const YuvMatrix            mMatrix;
+    std::atomic<Clock::rep>    mInterval;
+    std::atomic<float>         mScale = 1.0F;
+    Clock::time_point          mStart;
+    Clock::time_point          mNextTick;
+    VideoFrame                 mFrame;
+    // holds the scaled capture, when scaling is requested
+    VideoFrame                 mScaled;
+    std::optional<std::string> mErrMsg;
+    std::optional<CapturePath> mPath;
+    std::atomic_bool           mStopped = false;
+    std::optional<uint64_t>    mLastHash;
+    std::atomic_uint64_t       mCaptured { 0 };
+    std::atomic_uint64_t       mDuplicates { 0 };
+    std::atomic_uint64_t       mEmitted { 0 };
+    std::atomic_uint64_t       mGrabUs { 0 };
+    std::atomic_uint64_t       mConvertUs { 0 };
+  };
 
   struct Gif89aCaptureSource: public VideoCaptureSource
   {
+    using VideoCaptureSource::VideoCaptureSource;
+
     /* GIF89a specification: https://www.w3.org/Graphics/GIF/spec-gif89a.txt
     https://www.fileformat.info/format/gif/egff.htm
     */
@@ -0,0 +1,94 @@
+#include "convert.hpp"
+#include "convert_rgb.hpp"
+
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace smv::details {
+  namespace {
+    constexpr auto ROWS_PER_TASK = 32;
+
+    /**
+     * @brief set the alpha byte of every BGRX pixel of a row to 0xFF
+     */
+    void fillAlpha(uint8_t *row, uint32_t width)
+    {
+      uint32_t x = 0;
+#if defined(__SSE2__)
+      const auto alpha = _mm_set1_epi32(static_cast<int>(0xFF000000U));
+      for (; x + 4 <= width; x += 4) {
+        auto *pixels = reinterpret_cast<__m128i *>(row + x * 4);
+        _mm_storeu_si128(pixels,
+                         _mm_or_si128(_mm_loadu_si128(pixels), alpha));
+      }
+#endif
+      for (; x < width; x++) {
+        row[x * 4 + 3] = 0xFF;
+      }
+    }
+
+    void copyBgrx(const FrameView &src, VideoFrame &dst, ThreadPool &pool)
+    {
+      dst.resize(PixelLayout::BGRX, src.width, src.height);
+      pool.parallelFor(
+        0,
+        src.height,
+        [&](std::size_t first, std::size_t last) {
+        for (auto y = first; y < last; y++) {
+          const auto *in  = src.row(static_cast<uint32_t>(y));
+          auto       *out = dst.plane(0) + y * dst.strides[0];
+          if (!src.msbFirst) {
+            std::memcpy(out, in, dst.strides[0]);
+          } else {
+            // XRGB -> BGRX is a byte swap of each pixel
+            for (uint32_t x = 0; x < src.width; x++) {
+              out[x * 4]     = in[x * 4 + 3];
+              out[x * 4 + 1] = in[x * 4 + 2];
+              out[x * 4 + 2] = in[x * 4 + 1];
+              out[x * 4 + 3] = in[x * 4];
+            }
+          }
+          if (!src.hasAlpha) {
+            // still in cache from the copy
+            fillAlpha(out, src.width);
+          }
+        }
+      },
+        ROWS_PER_TASK);
+    }
+  } // namespace
+
+  void convertFrame(const FrameView &src,
+                    PixelLayout      layout,
+                    YuvMatrix        matrix,
+                    VideoFrame      &dst,
+                    ThreadPool      &pool)
+  {
+    switch (layout) {
+      case PixelLayout::I420:
+      case PixelLayout::NV12:
+        convertToYuv(src, layout, matrix, dst, pool);
+        break;
+      case PixelLayout::RGB:
+        convertToRgb(src, dst, pool);
+        break;
+      case PixelLayout::RGBA:
+        convertToRgba(src, dst, pool);
+        break;
+      case PixelLayout::BGRX:
+        copyBgrx(src, dst, pool);
+        break;
+    }
+    dst.hasAlpha = src.hasAlpha && (layout == PixelLayout::BGRX ||
+                                    layout == PixelLayout::RGBA);
+  }
+
+  void convertToBgra(const FrameView &src, VideoFrame &dst, ThreadPool &pool)
+  {
+    copyBgrx(src, dst, pool);
+    dst.hasAlpha = src.hasAlpha;
+  }
+} // namespace smv::details
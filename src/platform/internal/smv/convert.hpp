@@ -0,0 +1,40 @@
+#pragma once
+
+#include "convert_yuv.hpp"
+#include "frame.hpp"
+#include "thread_pool.hpp"
+
+namespace smv::details {
+  /**
+   * @brief Convert a raw capture to any of the frame layouts
+   *
+   * @details PixelLayout::BGRX output is always blue first, whatever the
+   * byte order of the source, so VideoFrame::view can be used on it. Its
+   * fourth byte is 0xFF, unless the source has alpha
+   *
+   * @param src the raw capture
+   * @param layout the layout of the output
+   * @param matrix the color matrix, for the YUV layouts
+   * @param dst the frame to write to. It is resized to match src
+   * @param pool the thread pool to run the conversion on
+   */
+  void convertFrame(const FrameView &src,
+                    PixelLayout      layout,
+                    YuvMatrix        matrix,
+                    VideoFrame      &dst,
+                    ThreadPool      &pool = ThreadPool::shared());
+
+  /**
+   * @brief Convert a raw capture to PixelLayout::BGRX, with a defined fourth
+   * byte
+   * @details Same as convertFrame to PixelLayout::BGRX: the fourth byte is
+   * the alpha of src when FrameView::hasAlpha is set, and 0xFF otherwise
+   *
+   * @param src the raw capture
+   * @param dst the frame to write to. It is resized to match src
+   * @param pool the thread pool to run the conversion on
+   */
+  void convertToBgra(const FrameView &src,
+                     VideoFrame      &dst,
+                     ThreadPool      &pool = ThreadPool::shared());
+} // namespace smv::details
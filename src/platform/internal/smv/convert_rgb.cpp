@@ -0,0 +1,122 @@
+#include "convert_rgb.hpp"
+
+#include <algorithm>
+#include <cstdint>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace smv::details {
+  namespace {
+    /**
+     * @brief undo the premultiplication of a color channel by its alpha
+     */
+    inline auto unpremultiply(uint8_t color, uint8_t alpha) -> uint8_t
+    {
+      if (alpha == 0) {
+        return 0;
+      }
+      auto straight = (color * 255U + alpha / 2U) / alpha;
+      return static_cast<uint8_t>(std::min(straight, 255U));
+    }
+  } // namespace
+
+  void convertToRgb(const FrameView &src, VideoFrame &dst, ThreadPool &pool)
+  {
+    static constexpr auto ROWS_PER_TASK = 16;
+
+    dst.resize(PixelLayout::RGB, src.width, src.height);
+    // byte offsets of red, green and blue within a source pixel
+    const auto red   = src.msbFirst ? 1 : 2;
+    const auto green = src.msbFirst ? 2 : 1;
+    const auto blue  = src.msbFirst ? 3 : 0;
+
+    pool.parallelFor(
+      0,
+      src.height,
+      [&](std::size_t first, std::size_t last) {
+      for (auto y = first; y < last; y++) {
+        const auto *in  = src.row(static_cast<uint32_t>(y));
+        auto       *out = dst.plane(0) + y * dst.strides[0];
+        for (uint32_t x = 0; x < src.width; x++, in += 4, out += 3) {
+          out[0] = in[red];
+          out[1] = in[green];
+          out[2] = in[blue];
+        }
+      }
+    },
+      ROWS_PER_TASK);
+  }
+
+  void convertToRgba(const FrameView &src, VideoFrame &dst, ThreadPool &pool)
+  {
+    static constexpr auto ROWS_PER_TASK = 16;
+
+    dst.resize(PixelLayout::RGBA, src.width, src.height);
+    const auto red   = src.msbFirst ? 1 : 2;
+    const auto green = src.msbFirst ? 2 : 1;
+    const auto blue  = src.msbFirst ? 3 : 0;
+    const auto alpha = src.msbFirst ? 0 : 3;
+    // or'ed into the alpha of every pixel, to ignore undefined padding
+    const uint8_t opaque = src.hasAlpha ? 0 : 0xFF;
+
+    pool.parallelFor(
+      0,
+      src.height,
+      [&](std::size_t first, std::size_t last) {
+      for (auto y = first; y < last; y++) {
+        const auto *in  = src.row(static_cast<uint32_t>(y));
+        auto       *out = dst.plane(0) + y * dst.strides[0];
+        for (uint32_t x = 0; x < src.width; x++, in += 4, out += 4) {
+          auto a = static_cast<uint8_t>(in[alpha] | opaque);
+          if (a == 0xFF) {
+            out[0] = in[red];
+            out[1] = in[green];
+            out[2] = in[blue];
+          } else {
+            out[0] = unpremultiply(in[red], a);
+            out[1] = unpremultiply(in[green], a);
+            out[2] = unpremultiply(in[blue], a);
+          }
+          out[3] = a;
+        }
+      }
+    },
+      ROWS_PER_TASK);
+  }
+
+  auto isOpaque(const FrameView &src) -> bool
+  {
+    if (!src.hasAlpha) {
+      return true;
+    }
+    // the alpha byte of a pixel, read as a little endian 32-bit word
+    const uint32_t alphaMask = src.msbFirst ? 0xFFU : 0xFF000000U;
+    const auto     alpha     = src.msbFirst ? 0 : 3;
+    for (uint32_t y = 0; y < src.height; y++) {
+      const auto *row = src.row(y);
+      uint32_t    x   = 0;
+#if defined(__SSE2__)
+      const auto mask = _mm_set1_epi32(static_cast<int>(alphaMask));
+      // 16 pixels at a time, checked once for all four vectors
+      for (; x + 16 <= src.width; x += 16) {
+        const auto *in  = reinterpret_cast<const __m128i *>(row + x * 4);
+        auto        all = _mm_and_si128(
+          _mm_and_si128(_mm_loadu_si128(in), _mm_loadu_si128(in + 1)),
+          _mm_and_si128(_mm_loadu_si128(in + 2), _mm_loadu_si128(in + 3)));
+        auto eq = _mm_cmpeq_epi32(_mm_and_si128(all, mask), mask);
+        if (_mm_movemask_epi8(eq) != 0xFFFF) {
+          return false;
+        }
+      }
+#endif
+      for (; x < src.width; x++) {
+        if (row[x * 4 + alpha] != 0xFF) {
+          return false;
+        }
+      }
+    }
+    return true;
+  }
+} // namespace smv::details
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "frame.hpp"
+#include "thread_pool.hpp"
+
+namespace smv::details {
+  /**
+   * @brief Convert a raw capture to packed 24-bit RGB
+   *
+   * @details This is the layout the stb encoders expect. Rows are spread over
+   * the thread pool
+   *
+   * @param src the raw capture
+   * @param dst the frame to write to. It is resized to match src
+   * @param pool the thread pool to run the conversion on
+   */
+  void convertToRgb(const FrameView &src,
+                    VideoFrame      &dst,
+                    ThreadPool      &pool = ThreadPool::shared());
+
+  /**
+   * @brief Convert a raw capture to packed 32-bit RGBA
+   *
+   * @details The alpha comes from the padding byte when FrameView::hasAlpha
+   * is set. Otherwise the output is opaque.
+   * X stores ARGB visuals premultiplied, while PNG and QOI expect straight
+   * alpha, so the colors of translucent pixels are divided by their alpha
+   *
+   * @param src the raw capture
+   * @param dst the frame to write to. It is resized to match src
+   * @param pool the thread pool to run the conversion on
+   */
+  void convertToRgba(const FrameView &src,
+                     VideoFrame      &dst,
+                     ThreadPool      &pool = ThreadPool::shared());
+
+  /**
+   * @brief Whether every pixel of a capture is fully opaque
+   * @details Always true when the capture has no alpha. Stops at the first
+   * pixel that is not, so translucent captures are usually found out early
+   */
+  auto isOpaque(const FrameView &src) -> bool;
+} // namespace smv::details
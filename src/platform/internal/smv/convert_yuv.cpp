@@ -0,0 +1,291 @@
+#include "convert_yuv.hpp"
+
+#include <array>
+#include <cstdint>
+
+#include <assert.hpp>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace smv::details {
+  namespace {
+    // 8-bit fixed point (x256) coefficients for limited range output
+    struct Coefficients
+    {
+      int16_t yr, yg, yb;
+      int16_t ur, ug, ub;
+      int16_t vr, vg, vb;
+    };
+
+    constexpr Coefficients BT601_COEFFICIENTS {
+      66, 129, 25, -38, -74, 112, 112, -94, -18,
+    };
+    constexpr Coefficients BT709_COEFFICIENTS {
+      47, 157, 16, -26, -86, 112, 112, -102, -10,
+    };
+
+    // where each color lives within the 4 bytes of a pixel
+    struct ChannelOffsets
+    {
+      uint8_t r, g, b, x;
+    };
+
+    constexpr ChannelOffsets LSB_OFFSETS { 2, 1, 0, 3 };
+    constexpr ChannelOffsets MSB_OFFSETS { 1, 2, 3, 0 };
+
+    inline auto weighScalar(int16_t cr,
+                            int16_t cg,
+                            int16_t cb,
+                            int     r,
+                            int     g,
+                            int     b) -> int
+    {
+      return (cr * r + cg * g + cb * b + 128) >> 8; // NOLINT
+    }
+
+    struct RowContext
+    {
+      const FrameView     &src;
+      VideoFrame          &dst;
+      const Coefficients  &coef;
+      const ChannelOffsets offsets;
+#if defined(__SSE2__)
+      __m128i              yWeights, uWeights, vWeights;
+#endif
+    };
+
+    /**
+     * @brief convert the pixels [xBegin, width) of rows y and y + 1
+     * @details this is the generic path, used for whatever the vector path
+     * could not handle
+     */
+    void convertPairScalar(const RowContext &ctx, uint32_t y, uint32_t xBegin)
+    {
+      const auto &src     = ctx.src;
+      const auto &coef    = ctx.coef;
+      const auto &off     = ctx.offsets;
+      auto       &dst     = ctx.dst;
+      auto        nextRow = y + 1 < src.height ? y + 1 : y;
+      auto       *lumaA   = dst.plane(0) + y * dst.strides[0];
+      auto       *lumaB   = dst.plane(0) + nextRow * dst.strides[0];
+      auto       *uPlane =
+        dst.plane(1) + static_cast<std::size_t>(y / 2) * dst.strides[1];
+      auto *vPlane =
+        dst.layout == PixelLayout::I420
+          ? dst.plane(2) + static_cast<std::size_t>(y / 2) * dst.strides[2]
+          : uPlane + 1;
+      auto chromaStep = dst.layout == PixelLayout::I420 ? 1 : 2;
+
+      const auto *rowA = src.row(y);
+      const auto *rowB = src.row(nextRow);
+      for (auto x = xBegin; x < src.width; x += 2) {
+        auto nextX = x + 1 < src.width ? x + 1 : x;
+        int  r = 0, g = 0, b = 0;
+        for (const auto *pixel : { rowA + x * 4,
+                                   rowA + nextX * 4,
+                                   rowB + x * 4,
+                                   rowB + nextX * 4 }) {
+          r += pixel[off.r];
+          g += pixel[off.g];
+          b += pixel[off.b];
+        }
+        for (auto px : { x, nextX }) {
+          const auto *a = rowA + px * 4;
+          const auto *c = rowB + px * 4;
+          lumaA[px]     = static_cast<uint8_t>(
+            weighScalar(
+              coef.yr, coef.yg, coef.yb, a[off.r], a[off.g], a[off.b]) +
+            16);
+          lumaB[px] = static_cast<uint8_t>(
+            weighScalar(
+              coef.yr, coef.yg, coef.yb, c[off.r], c[off.g], c[off.b]) +
+            16);
+        }
+        r = (r + 2) / 4;
+        g = (g + 2) / 4;
+        b = (b + 2) / 4;
+        auto cx    = static_cast<std::size_t>(x / 2) * chromaStep;
+        uPlane[cx] = static_cast<uint8_t>(
+          weighScalar(coef.ur, coef.ug, coef.ub, r, g, b) + 128);
+        vPlane[cx] = static_cast<uint8_t>(
+          weighScalar(coef.vr, coef.vg, coef.vb, r, g, b) + 128);
+      }
+    }
+
+#if defined(__SSE2__)
+    auto makeWeights(const ChannelOffsets &off, int16_t r, int16_t g, int16_t b)
+      -> __m128i
+    {
+      alignas(16) std::array<int16_t, 8> lanes {};
+      for (auto pixel : { 0, 4 }) {
+        lanes[pixel + off.r] = r;
+        lanes[pixel + off.g] = g;
+        lanes[pixel + off.b] = b;
+        lanes[pixel + off.x] = 0;
+      }
+      return _mm_load_si128(reinterpret_cast<const __m128i *>(lanes.data()));
+    }
+
+    /**
+     * @brief apply the weights to 4 pixels
+     * @return the rounded weighted sums, as 4 x int32
+     */
+    inline auto weigh(__m128i pixels, __m128i weights) -> __m128i
+    {
+      const auto zero = _mm_setzero_si128();
+      // each madd yields two partial sums per pixel
+      auto lo   = _mm_madd_epi16(_mm_unpacklo_epi8(pixels, zero), weights);
+      auto hi   = _mm_madd_epi16(_mm_unpackhi_epi8(pixels, zero), weights);
+      auto even = _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(lo),
+                                                  _mm_castsi128_ps(hi),
+                                                  _MM_SHUFFLE(2, 0, 2, 0)));
+      auto odd  = _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(lo),
+                                                 _mm_castsi128_ps(hi),
+                                                 _MM_SHUFFLE(3, 1, 3, 1)));
+      auto sum  = _mm_add_epi32(even, odd);
+      return _mm_srai_epi32(_mm_add_epi32(sum, _mm_set1_epi32(128)), 8);
+    }
+
+    /**
+     * @brief compute the luma of 16 pixels
+     */
+    inline auto luma16(const uint8_t *pixels, __m128i weights) -> __m128i
+    {
+      const auto *in     = reinterpret_cast<const __m128i *>(pixels);
+      const auto  offset = _mm_set1_epi16(16);
+      auto        lo     = _mm_packs_epi32(weigh(_mm_loadu_si128(in), weights),
+                                weigh(_mm_loadu_si128(in + 1), weights));
+      auto        hi = _mm_packs_epi32(weigh(_mm_loadu_si128(in + 2), weights),
+                                weigh(_mm_loadu_si128(in + 3), weights));
+      return _mm_packus_epi16(_mm_add_epi16(lo, offset),
+                              _mm_add_epi16(hi, offset));
+    }
+
+    /**
+     * @brief average 2x2 blocks of 8 pixels from two rows
+     * @return 4 averaged pixels
+     */
+    inline auto subsample8(const uint8_t *rowA, const uint8_t *rowB) -> __m128i
+    {
+      const auto *inA = reinterpret_cast<const __m128i *>(rowA);
+      const auto *inB = reinterpret_cast<const __m128i *>(rowB);
+      auto v0 = _mm_avg_epu8(_mm_loadu_si128(inA), _mm_loadu_si128(inB));
+      auto v1 =
+        _mm_avg_epu8(_mm_loadu_si128(inA + 1), _mm_loadu_si128(inB + 1));
+      // horizontal neighbours land in pixels 0 and 2
+      v0 = _mm_avg_epu8(v0, _mm_srli_si128(v0, 4));
+      v1 = _mm_avg_epu8(v1, _mm_srli_si128(v1, 4));
+      v0 = _mm_shuffle_epi32(v0, _MM_SHUFFLE(3, 1, 2, 0));
+      v1 = _mm_shuffle_epi32(v1, _MM_SHUFFLE(3, 1, 2, 0));
+      return _mm_unpacklo_epi64(v0, v1);
+    }
+
+    /**
+     * @brief compute one chroma component for 8 subsampled pixels
+     * @return 8 bytes, in the lower half of the result
+     */
+    inline auto chroma8(__m128i first, __m128i second, __m128i weights)
+      -> __m128i
+    {
+      auto words =
+        _mm_packs_epi32(weigh(first, weights), weigh(second, weights));
+      words = _mm_add_epi16(words, _mm_set1_epi16(128));
+      return _mm_packus_epi16(words, words);
+    }
+
+    /**
+     * @brief convert as many pixels of rows y and y + 1 as possible
+     * @return the first column that has not been converted
+     */
+    auto convertPairVector(const RowContext &ctx, uint32_t y) -> uint32_t
+    {
+      const auto &src     = ctx.src;
+      auto       &dst     = ctx.dst;
+      auto        nextRow = y + 1 < src.height ? y + 1 : y;
+      const auto *rowA    = src.row(y);
+      const auto *rowB    = src.row(nextRow);
+      auto       *lumaA   = dst.plane(0) + y * dst.strides[0];
+      auto       *lumaB   = dst.plane(0) + nextRow * dst.strides[0];
+      auto       *uPlane =
+        dst.plane(1) + static_cast<std::size_t>(y / 2) * dst.strides[1];
+      auto *vPlane =
+        dst.layout == PixelLayout::I420
+          ? dst.plane(2) + static_cast<std::size_t>(y / 2) * dst.strides[2]
+          : nullptr;
+
+      uint32_t x = 0;
+      for (; x + 16 <= src.width; x += 16) {
+        const auto *pxA = rowA + static_cast<std::size_t>(x) * 4;
+        const auto *pxB = rowB + static_cast<std::size_t>(x) * 4;
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(lumaA + x),
+                         luma16(pxA, ctx.yWeights));
+        if (nextRow != y) {
+          _mm_storeu_si128(reinterpret_cast<__m128i *>(lumaB + x),
+                           luma16(pxB, ctx.yWeights));
+        }
+
+        auto first  = subsample8(pxA, pxB);
+        auto second = subsample8(pxA + 32, pxB + 32);
+        auto u      = chroma8(first, second, ctx.uWeights);
+        auto v      = chroma8(first, second, ctx.vWeights);
+        if (vPlane != nullptr) {
+          _mm_storel_epi64(reinterpret_cast<__m128i *>(uPlane + x / 2), u);
+          _mm_storel_epi64(reinterpret_cast<__m128i *>(vPlane + x / 2), v);
+        } else {
+          _mm_storeu_si128(reinterpret_cast<__m128i *>(uPlane + x),
+                           _mm_unpacklo_epi8(u, v));
+        }
+      }
+      return x;
+    }
+#endif
+  } // namespace
+
+  void convertToYuv(const FrameView &src,
+                    PixelLayout      layout,
+                    YuvMatrix        matrix,
+                    VideoFrame      &dst,
+                    ThreadPool      &pool)
+  {
+    ASSERT(/* NOLINT */
+           layout == PixelLayout::I420 || layout == PixelLayout::NV12,
+           "layout must be planar YUV",
+           static_cast<int>(layout));
+
+    dst.resize(layout, src.width, src.height);
+    const auto &coef =
+      matrix == YuvMatrix::BT601 ? BT601_COEFFICIENTS : BT709_COEFFICIENTS;
+    const auto &offsets = src.msbFirst ? MSB_OFFSETS : LSB_OFFSETS;
+
+#if defined(__SSE2__)
+    const RowContext ctx { src,
+                           dst,
+                           coef,
+                           offsets,
+                           makeWeights(offsets, coef.yr, coef.yg, coef.yb),
+                           makeWeights(offsets, coef.ur, coef.ug, coef.ub),
+                           makeWeights(offsets, coef.vr, coef.vg, coef.vb) };
+#else
+    const RowContext ctx { src, dst, coef, offsets };
+#endif
+
+    static constexpr auto ROW_PAIRS_PER_TASK = 8;
+    auto                  rowPairs           = (src.height + 1) / 2;
+    pool.parallelFor(
+      0,
+      rowPairs,
+      [&ctx](std::size_t first, std::size_t last) {
+      for (auto pair = first; pair < last; pair++) {
+        auto     y = static_cast<uint32_t>(pair * 2);
+        uint32_t x = 0;
+#if defined(__SSE2__)
+        x = convertPairVector(ctx, y);
+#endif
+        convertPairScalar(ctx, y, x);
+      }
+    },
+      ROW_PAIRS_PER_TASK);
+  }
+} // namespace smv::details
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "frame.hpp"
+#include "thread_pool.hpp"
+
+namespace smv::details {
+  /**
+   * @brief The RGB to YUV matrix to use
+   * @details BT.601 is what most decoders assume for SD content, BT.709 for
+   * anything HD and above
+   */
+  enum class YuvMatrix
+  {
+    BT601,
+    BT709,
+  };
+
+  /**
+   * @brief Convert a raw capture to YUV 4:2:0
+   *
+   * @details Produces limited (studio swing) range output. The chroma of each
+   * 2x2 block of pixels is averaged. The work is split by pairs of rows over
+   * the given thread pool, and reads the source pixels only once, so it can be
+   * fed straight from the capture buffer.
+   *
+   * @param src the raw capture
+   * @param layout either PixelLayout::I420 or PixelLayout::NV12
+   * @param matrix the color matrix
+   * @param dst the frame to write to. It is resized to match src
+   * @param pool the thread pool to run the conversion on
+   */
+  void convertToYuv(const FrameView &src,
+                    PixelLayout      layout,
+                    YuvMatrix        matrix,
+                    VideoFrame      &dst,
+                    ThreadPool      &pool = ThreadPool::shared());
+} // namespace smv::details
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "frame.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+namespace smv::details {
+  /**
+   * @brief A compressed video frame
+   * @details Packets are immutable once produced, so they can be shared
+   * between the consumers of an encoder without copying. A packet that
+   * repeats an earlier one shares its payload, and only has its own pts
+   */
+  struct EncodedPacket
+  {
+    std::shared_ptr<const std::vector<uint8_t>> payload;
+    // presentation timestamp in microseconds, copied from the VideoFrame
+    int64_t ptsUs = 0;
+    // the packet can be decoded without the packets before it
+    bool keyframe = false;
+
+    /**
+     * @brief the compressed bytes, which are empty if there is no payload
+     */
+    auto bytes() const noexcept -> const std::vector<uint8_t> &
+    {
+      static const std::vector<uint8_t> none;
+      return payload ? *payload : none;
+    }
+  };
+
+  using PacketPtr = std::shared_ptr<const EncodedPacket>;
+
+  /**
+   * @brief Turns the frames of a VideoCaptureSource into packets
+   */
+  class VideoEncoder
+  {
+  public:
+    virtual ~VideoEncoder() = default;
+
+    /**
+     * @brief the layout of the frames this encoder accepts
+     */
+    virtual auto layout() const noexcept -> PixelLayout = 0;
+
+    /**
+     * @brief Encode a frame
+     * @details The pts and repeat flag are passed apart from the pixels, so
+     * that a repeat can be encoded from the pixels of the frame it repeats
+     *
+     * @param frame the pixels
+     * @param ptsUs the presentation timestamp of the frame
+     * @param repeat the pixels are the same as the previous frame's
+     * @return PacketPtr the encoded frame, or nullptr if encoding failed
+     */
+    virtual auto encode(const VideoFrame &frame, int64_t ptsUs, bool repeat)
+      -> PacketPtr = 0;
+
+    /**
+     * @brief Encode a frame at its own pts
+     */
+    auto encode(const VideoFrame &frame) -> PacketPtr
+    {
+      return encode(frame, frame.ptsUs, frame.repeat);
+    }
+
+    /**
+     * @brief the file extension used when the packets are written to disk as
+     * they are
+     */
+    virtual auto extension() const noexcept -> std::string_view = 0;
+  };
+} // namespace smv::details
@@ -0,0 +1,81 @@
+#include "encoder_mjpeg.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+extern "C"
+{
+#include <stb_image_write.h>
+}
+
+namespace smv::details {
+  namespace {
+    constexpr auto MIN_QUALITY = 1;
+    constexpr auto MAX_QUALITY = 100;
+
+    void appendBytes(void *context, void *data, int size)
+    {
+      auto       *dest  = static_cast<std::vector<uint8_t> *>(context);
+      const auto *bytes = static_cast<const uint8_t *>(data);
+      dest->insert(dest->end(), bytes, bytes + size);
+    }
+  } // namespace
+
+  MjpegEncoder::MjpegEncoder(int quality)
+    : mQuality(std::clamp(quality, MIN_QUALITY, MAX_QUALITY))
+  {
+  }
+
+  auto MjpegEncoder::layout() const noexcept -> PixelLayout
+  {
+    return PixelLayout::RGB;
+  }
+
+  auto MjpegEncoder::encode(const VideoFrame &frame,
+                            int64_t           ptsUs,
+                            bool              repeat) -> PacketPtr
+  {
+    if (frame.layout != PixelLayout::RGB) {
+      return nullptr;
+    }
+    auto packet = std::make_shared<EncodedPacket>();
+    if (repeat && mLast) {
+      // the jpeg is shared, only the pts is the repeat's own
+      packet->payload  = mLast->payload;
+      packet->ptsUs    = ptsUs;
+      packet->keyframe = true;
+      mLast            = std::move(packet);
+      return mLast;
+    }
+
+    std::vector<uint8_t> bytes;
+    // leave enough room for most frames, so stb does not have to grow it
+    bytes.reserve(frame.bytes.size() / 8);
+    if (!stbi_write_jpg_to_func(&appendBytes,
+                                &bytes,
+                                static_cast<int>(frame.width),
+                                static_cast<int>(frame.height),
+                                3,
+                                frame.bytes.data(),
+                                mQuality)) {
+      return nullptr;
+    }
+    packet->payload  = std::make_shared<const std::vector<uint8_t>>(
+      std::move(bytes));
+    packet->ptsUs    = ptsUs;
+    packet->keyframe = true;
+    mLast            = std::move(packet);
+    return mLast;
+  }
+
+  auto MjpegEncoder::extension() const noexcept -> std::string_view
+  {
+    return "mjpeg";
+  }
+
+  void MjpegEncoder::setQuality(int quality) noexcept
+  {
+    mQuality = std::clamp(quality, MIN_QUALITY, MAX_QUALITY);
+  }
+} // namespace smv::details
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "encoder.hpp"
+#include "smv/record.hpp"
+
+namespace smv::details {
+  /**
+   * @brief Encodes every frame as a standalone JPEG
+   *
+   * @details Uses the same stb encoder as the screenshots. Every packet is a
+   * keyframe, and concatenating the packets gives a motion JPEG stream that
+   * most players (ffplay -f mjpeg, mpv, browsers) understand.
+   * A repeated frame shares the payload of the previous packet instead of
+   * being encoded again, and only has its own pts
+   */
+  class MjpegEncoder: public VideoEncoder
+  {
+  public:
+    explicit MjpegEncoder(int quality = DEFAULT_JPEG_QUALITY);
+
+    auto layout() const noexcept -> PixelLayout override;
+    using VideoEncoder::encode;
+    auto encode(const VideoFrame &frame, int64_t ptsUs, bool repeat)
+      -> PacketPtr override;
+    auto extension() const noexcept -> std::string_view override;
+
+    /**
+     * @brief change the quality of the frames that follow
+     * @param quality between 1 and 100
+     */
+    void setQuality(int quality) noexcept;
+
+  private:
+    int       mQuality;
+    PacketPtr mLast;
+  };
+} // namespace smv::details
@@ -0,0 +1,195 @@
+#include "encoder_x264.hpp"
+#include "smv/log.hpp"
+
+#include <algorithm>
+#include <array>
+#include <memory>
+
+#if defined(SMV_WITH_X264)
+extern "C"
+{
+#include <x264.h>
+}
+#endif
+
+namespace smv::details {
+  using smv::log::logger;
+
+  namespace {
+    constexpr auto MICROS_PER_SECOND = 1'000'000;
+    constexpr auto CONSTANT_RATE     = 23.0F;
+    // by effort
+    constexpr std::array<const char *, X264Encoder::MAX_EFFORT + 1> PRESETS = {
+      "ultrafast",
+      "superfast",
+      "veryfast",
+    };
+  } // namespace
+
+  X264Encoder::X264Encoder(uint8_t fps,
+                           uint8_t keyframeInterval,
+                           uint8_t effort)
+    : mFps(std::max<uint8_t>(fps, 1))
+    , mKeyframeInterval(std::max<uint8_t>(keyframeInterval, 1))
+    , mEffort(std::min(effort, MAX_EFFORT))
+  {
+  }
+
+  X264Encoder::~X264Encoder()
+  {
+    close();
+  }
+
+  auto X264Encoder::available() noexcept -> bool
+  {
+#if defined(SMV_WITH_X264)
+    return true;
+#else
+    return false;
+#endif
+  }
+
+  auto X264Encoder::layout() const noexcept -> PixelLayout
+  {
+    return PixelLayout::I420;
+  }
+
+  // a repeat is encoded like any other frame: x264 turns it into skipped
+  // macroblocks
+  auto X264Encoder::encode(const VideoFrame      &frame,
+                           [[maybe_unused]] int64_t ptsUs,
+                           bool /*repeat*/) -> PacketPtr
+  {
+    if (frame.layout != PixelLayout::I420 || frame.width < 2 ||
+        frame.height < 2) {
+      return nullptr;
+    }
+#if defined(SMV_WITH_X264)
+    auto width  = frame.width & ~1U;
+    auto height = frame.height & ~1U;
+    if (!mEncoder || width != mWidth || height != mHeight ||
+        mEffort != mOpenEffort) {
+      close();
+      if (auto err = open(width, height)) {
+        logger->error("Failed to open the H.264 encoder: {}", *err);
+        return nullptr;
+      }
+    }
+
+    x264_picture_t input;
+    x264_picture_t output;
+    x264_picture_init(&input);
+    input.img.i_csp   = X264_CSP_I420;
+    input.img.i_plane = 3;
+    for (int i = 0; i < 3; i++) {
+      // x264 does not write to the input planes
+      input.img.plane[i]    = const_cast<uint8_t *>(frame.plane(i));
+      input.img.i_stride[i] = static_cast<int>(frame.strides[i]);
+    }
+    input.i_pts = ptsUs;
+    if (mForceKeyframe.exchange(false)) {
+      input.i_type = X264_TYPE_IDR;
+    }
+
+    x264_nal_t *nals     = nullptr;
+    int         nalCount = 0;
+    auto        size =
+      x264_encoder_encode(mEncoder, &nals, &nalCount, &input, &output);
+    if (size <= 0) {
+      // with no lookahead, every frame produces output unless it failed
+      return nullptr;
+    }
+    // the payloads of the nal units are contiguous
+    auto packet = std::make_shared<EncodedPacket>();
+    packet->payload  = std::make_shared<const std::vector<uint8_t>>(
+      nals[0].p_payload, nals[0].p_payload + size);
+    packet->ptsUs    = output.i_pts;
+    packet->keyframe = output.b_keyframe != 0;
+    return packet;
+#else
+    return nullptr;
+#endif
+  }
+
+  auto X264Encoder::extension() const noexcept -> std::string_view
+  {
+    return "h264";
+  }
+
+  void X264Encoder::forceKeyframe() noexcept
+  {
+    mForceKeyframe = true;
+  }
+
+  void X264Encoder::setEffort(uint8_t effort) noexcept
+  {
+    mEffort = std::min(effort, MAX_EFFORT);
+  }
+
+  auto X264Encoder::effort() const noexcept -> uint8_t
+  {
+    return mEffort;
+  }
+
+#if defined(SMV_WITH_X264)
+  auto X264Encoder::open(uint32_t width, uint32_t height)
+    -> std::optional<std::string>
+  {
+    x264_param_t param;
+    auto         effort = mEffort.load();
+    if (x264_param_default_preset(&param, PRESETS[effort], "zerolatency") <
+        0) {
+      return "Unknown preset";
+    }
+    param.i_width          = static_cast<int>(width);
+    param.i_height         = static_cast<int>(height);
+    param.i_csp            = X264_CSP_I420;
+    param.i_fps_num        = mFps;
+    param.i_fps_den        = 1;
+    param.i_timebase_num   = 1;
+    param.i_timebase_den   = MICROS_PER_SECOND;
+    param.b_vfr_input      = 1;
+    param.i_keyint_max     = mFps * mKeyframeInterval;
+    param.b_repeat_headers = 1;
+    param.b_annexb         = 1;
+    param.i_log_level      = X264_LOG_WARNING;
+    param.rc.i_rc_method   = X264_RC_CRF;
+    param.rc.f_rf_constant = CONSTANT_RATE;
+    if (x264_param_apply_profile(&param, "baseline") < 0) {
+      return "Unknown profile";
+    }
+
+    mEncoder = x264_encoder_open(&param);
+    if (!mEncoder) {
+      return "x264_encoder_open failed";
+    }
+    mWidth      = width;
+    mHeight     = height;
+    mOpenEffort = effort;
+    logger->info("Opened H.264 encoder. Size={}x{}, Fps={}, Preset={}",
+                 width,
+                 height,
+                 mFps,
+                 PRESETS[effort]);
+    return std::nullopt;
+  }
+
+  void X264Encoder::close()
+  {
+    if (mEncoder) {
+      x264_encoder_close(mEncoder);
+      mEncoder = nullptr;
+    }
+  }
+#else
+  auto X264Encoder::open(uint32_t /*width*/, uint32_t /*height*/)
+    -> std::optional<std::string>
+  {
+    return "smvnative was built without x264";
+  }
+
+  void X264Encoder::close()
+  {
+  }
+#endif
+} // namespace smv::details
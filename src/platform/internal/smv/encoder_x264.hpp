@@ -0,0 +1,87 @@
+#pragma once
+
+#include "encoder.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <optional>
+#include <string>
+
+struct x264_t;
+
+namespace smv::details {
+  /**
+   * @brief Encodes I420 frames to H.264 with x264
+   *
+   * @details Tuned for live streaming: no B-frames, no lookahead, and the
+   * parameter sets are repeated before every keyframe so that viewers can join
+   * at any keyframe. Packets are in Annex B format (start code prefixed NAL
+   * units), one access unit per packet.
+   * The encoder is opened on the first frame, and reopened whenever the size
+   * of the frames changes. Odd dimensions are cropped to the nearest even
+   * size, as 4:2:0 requires.
+   * x264 is only linked when the build enables it (SMV_WITH_X264), see
+   * available()
+   */
+  class X264Encoder: public VideoEncoder
+  {
+  public:
+    static constexpr uint8_t MAX_EFFORT = 2;
+
+    /**
+     * @param fps the expected frame rate, used for rate control and to space
+     * out the keyframes
+     * @param keyframeInterval the number of seconds between keyframes
+     * @param effort how hard the encoder works for quality, from 0
+     * (ultrafast) to MAX_EFFORT
+     */
+    explicit X264Encoder(uint8_t fps,
+                         uint8_t keyframeInterval = 2,
+                         uint8_t effort           = 0);
+    X264Encoder(const X264Encoder &)                     = delete;
+    auto operator=(const X264Encoder &) -> X264Encoder & = delete;
+    ~X264Encoder() override;
+
+    /**
+     * @brief whether this build can encode H.264
+     * @details x264 is GPL licensed, so it is an opt-in build option. Without
+     * it, encode() always fails
+     */
+    static auto available() noexcept -> bool;
+
+    auto layout() const noexcept -> PixelLayout override;
+    using VideoEncoder::encode;
+    auto encode(const VideoFrame &frame, int64_t ptsUs, bool repeat)
+      -> PacketPtr override;
+    auto extension() const noexcept -> std::string_view override;
+
+    /**
+     * @brief make the next frame a keyframe
+     * @details Used when a new viewer joins, so it does not have to wait for
+     * the next scheduled keyframe. Safe to call from any thread
+     */
+    void forceKeyframe() noexcept;
+
+    /**
+     * @brief change the x264 preset
+     * @details The encoder is reopened on the next frame, which makes it a
+     * keyframe. Safe to call from any thread
+     */
+    void setEffort(uint8_t effort) noexcept;
+    auto effort() const noexcept -> uint8_t;
+
+  private:
+    auto open(uint32_t width, uint32_t height) -> std::optional<std::string>;
+    void close();
+
+    const uint8_t       mFps;
+    const uint8_t       mKeyframeInterval;
+    x264_t             *mEncoder       = nullptr;
+    uint32_t            mWidth         = 0;
+    uint32_t            mHeight        = 0;
+    std::atomic_bool    mForceKeyframe = false;
+    std::atomic_uint8_t mEffort;
+    // the effort the encoder was opened with
+    uint8_t             mOpenEffort = 0;
+  };
+} // namespace smv::details
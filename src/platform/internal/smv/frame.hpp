@@ -0,0 +1,148 @@
+#pragma once
+
+#include "smv/window.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace smv::details {
+  /**
+   * @brief A read-only view of the raw pixels of a capture
+   *
+   * @details The pixels are 32 bits each, as delivered by the X server. When
+   * the server's image byte order is LSB first, the bytes of a pixel are laid
+   * out in memory as blue, green, red, padding (BGRX). Otherwise they are
+   * padding, red, green, blue (XRGB). In captures of 32-bit ARGB windows the
+   * padding byte holds alpha, which hasAlpha tells apart.
+   * The view does not own the pixels, and is usually only valid until the next
+   * capture
+   */
+  struct FrameView
+  {
+    const uint8_t *data   = nullptr;
+    uint32_t       width  = 0;
+    uint32_t       height = 0;
+    // the number of bytes between the start of two consecutive rows
+    uint32_t stride   = 0;
+    bool     msbFirst = false;
+    // the padding byte of each pixel is alpha, rather than undefined
+    bool hasAlpha = false;
+
+    inline auto row(uint32_t y) const -> const uint8_t *
+    {
+      return data + static_cast<std::size_t>(y) * stride;
+    }
+  };
+
+  /**
+   * @brief A part of a frame that changed since the previous frame
+   * @details Same shape as the rectangles reported by the X Damage extension
+   */
+  struct DirtyRect
+  {
+    int16_t  x, y;
+    uint16_t width, height;
+  };
+
+  enum class PixelLayout
+  {
+    // packed 32-bit, same as FrameView. The fourth byte is 0xFF, or alpha
+    BGRX,
+    // packed 24-bit, red first
+    RGB,
+    // packed 32-bit, red first, with straight (not premultiplied) alpha,
+    // opaque when the source has none
+    RGBA,
+    // planar Y, U, V with 2x2 subsampled chroma
+    I420,
+    // planar Y, followed by interleaved UV with 2x2 subsampled chroma
+    NV12,
+  };
+
+  /**
+   * @brief A frame produced by the video capture pipeline
+   */
+  struct VideoFrame
+  {
+    PixelLayout layout = PixelLayout::I420;
+    uint32_t    width  = 0;
+    uint32_t    height = 0;
+    // presentation timestamp in microseconds since the capture started
+    int64_t ptsUs = 0;
+    // the pixels are the same as the previous frame's
+    bool                       repeat = false;
+    // the fourth byte of BGRX and RGBA pixels is the source's alpha, rather
+    // than 0xFF
+    bool                       hasAlpha = false;
+    std::array<uint32_t, 3>    strides {};
+    std::array<std::size_t, 3> offsets {};
+    std::vector<uint8_t>       bytes;
+
+    /**
+     * @brief change the layout/dimension of the frame
+     * @details The underlying buffer is only reallocated when it grows, so
+     * calling this for every frame of the same size is cheap
+     */
+    void resize(PixelLayout pixelLayout, uint32_t w, uint32_t h)
+    {
+      layout        = pixelLayout;
+      width         = w;
+      height        = h;
+      auto chromaW  = (w + 1) / 2;
+      auto chromaH  = (h + 1) / 2;
+      auto lumaSize = static_cast<std::size_t>(w) * h;
+      auto size     = std::size_t { 0 };
+
+      strides = {};
+      offsets = {};
+      switch (layout) {
+        case PixelLayout::BGRX:
+          strides[0] = w * 4;
+          size       = lumaSize * 4;
+          break;
+        case PixelLayout::RGB:
+          strides[0] = w * 3;
+          size       = lumaSize * 3;
+          break;
+        case PixelLayout::RGBA:
+          strides[0] = w * 4;
+          size       = lumaSize * 4;
+          break;
+        case PixelLayout::I420:
+          strides    = { w, chromaW, chromaW };
+          offsets[1] = lumaSize;
+          offsets[2] = lumaSize + static_cast<std::size_t>(chromaW) * chromaH;
+          size       = offsets[2] + static_cast<std::size_t>(chromaW) * chromaH;
+          break;
+        case PixelLayout::NV12:
+          strides    = { w, chromaW * 2, 0 };
+          offsets[1] = lumaSize;
+          size = lumaSize + static_cast<std::size_t>(chromaW) * 2 * chromaH;
+          break;
+      }
+      bytes.resize(size);
+    }
+
+    inline auto plane(std::size_t index) -> uint8_t *
+    {
+      return bytes.data() + offsets[index];
+    }
+
+    inline auto plane(std::size_t index) const -> const uint8_t *
+    {
+      return bytes.data() + offsets[index];
+    }
+
+    inline auto size() const -> Size { return { width, height }; }
+
+    /**
+     * @brief view a PixelLayout::BGRX frame as if it was a raw capture
+     */
+    inline auto view() const -> FrameView
+    {
+      return { bytes.data(), width, height, strides[0], false, hasAlpha };
+    }
+  };
+} // namespace smv::details
@@ -0,0 +1,403 @@
+#include "frame_bus.hpp"
+#include "capture_impl.hpp"
+#include "convert.hpp"
+#include "scale.hpp"
+#include "smv/log.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+namespace smv::details {
+  using smv::log::logger;
+
+  namespace {
+    std::mutex                           registryMutex;
+    std::vector<std::weak_ptr<FrameBus>> registry;
+
+    auto sameArea(const decltype(ScreenshotConfig::area) &a,
+                  const decltype(ScreenshotConfig::area) &b) -> bool
+    {
+      if (a.index() != b.index()) {
+        return false;
+      }
+      if (std::holds_alternative<Window *>(a)) {
+        const auto *windowA = std::get<Window *>(a);
+        const auto *windowB = std::get<Window *>(b);
+        return windowA == windowB ||
+               (windowA && windowB && windowA->id() == windowB->id());
+      }
+      const auto &regionA = std::get<Region>(a);
+      const auto &regionB = std::get<Region>(b);
+      return regionA.x() == regionB.x() && regionA.y() == regionB.y() &&
+             regionA.width() == regionB.width() &&
+             regionA.height() == regionB.height();
+    }
+
+    /**
+     * @brief whether both configs produce the same frames
+     */
+    auto sameCapture(const VideoCaptureConfig &a, const VideoCaptureConfig &b)
+      -> bool
+    {
+      auto sameSize = a.outputSize.has_value() == b.outputSize.has_value() &&
+                      (!a.outputSize || (a.outputSize->w == b.outputSize->w &&
+                                         a.outputSize->h == b.outputSize->h));
+      return sameArea(a.area, b.area) && sameSize &&
+             a.scaleFactor == b.scaleFactor &&
+             a.scaleFilter == b.scaleFilter && a.fpsHint == b.fpsHint &&
+             a.duplicateFrames == b.duplicateFrames;
+    }
+  } // namespace
+
+  FrameSubscription::FrameSubscription(PixelLayout layout,
+                                       DropPolicy  policy,
+                                       std::size_t capacity)
+    : mLayout(layout)
+    , mPolicy(policy)
+    , mCapacity(std::max<std::size_t>(capacity, 1))
+  {
+  }
+
+  auto FrameSubscription::next() -> std::optional<BusFrame>
+  {
+    std::unique_lock lock(mMutex);
+    mCond.wait(lock, [this] { return mClosed || !mFrames.empty(); });
+    if (mClosed) {
+      return std::nullopt;
+    }
+    auto frame = std::move(mFrames.front());
+    mFrames.pop_front();
+    return frame;
+  }
+
+  void FrameSubscription::close()
+  {
+    {
+      std::lock_guard _(mMutex);
+      mClosed = true;
+      mFrames.clear();
+    }
+    mCond.notify_all();
+  }
+
+  auto FrameSubscription::layout() const noexcept -> PixelLayout
+  {
+    return mLayout;
+  }
+
+  auto FrameSubscription::isClosed() const -> bool
+  {
+    std::lock_guard _(mMutex);
+    return mClosed;
+  }
+
+  auto FrameSubscription::dropped() const -> uint64_t
+  {
+    std::lock_guard _(mMutex);
+    return mDropped;
+  }
+
+  auto FrameSubscription::depth() const -> std::size_t
+  {
+    std::lock_guard _(mMutex);
+    return mFrames.size();
+  }
+
+  auto FrameSubscription::capacity() const noexcept -> std::size_t
+  {
+    return mCapacity;
+  }
+
+  void FrameSubscription::limit(uint8_t fps, float scale)
+  {
+    mFps.store(fps, std::memory_order_relaxed);
+    mScale.store(std::clamp(scale, 0.01F, 1.0F), std::memory_order_relaxed);
+  }
+
+  auto FrameSubscription::fps() const noexcept -> uint8_t
+  {
+    return mFps.load(std::memory_order_relaxed);
+  }
+
+  auto FrameSubscription::scale() const noexcept -> float
+  {
+    return mScale.load(std::memory_order_relaxed);
+  }
+
+  auto FrameSubscription::wants(int64_t ptsUs, uint8_t fps) const -> bool
+  {
+    if (fps == 0 || !mLastPtsUs) {
+      return true;
+    }
+    // the capture ticks are not exact, so a frame a little early still counts
+    auto intervalUs = 1'000'000 / fps;
+    return ptsUs - *mLastPtsUs >= intervalUs - intervalUs / 10;
+  }
+
+  void FrameSubscription::push(const BusFrame &frame)
+  {
+    mLastPtsUs = frame.ptsUs;
+    {
+      std::lock_guard _(mMutex);
+      if (mClosed) {
+        return;
+      }
+      if (mFrames.size() >= mCapacity) {
+        mDropped++;
+        if (mPolicy == DropPolicy::Newest) {
+          return;
+        }
+        mFrames.pop_front();
+      }
+      mFrames.push_back(frame);
+    }
+    mCond.notify_one();
+  }
+
+  FrameBus::FrameBus(const VideoCaptureConfig &config, YuvMatrix matrix)
+    : mConfig(config)
+    , mMatrix(matrix)
+    , mSource(createVideoCaptureSource(config, PixelLayout::BGRX))
+  {
+    if (!mSource) {
+      mErrMsg = "Unable to capture the requested area";
+      return;
+    }
+    mSource->useClock(mClock);
+  }
+
+  FrameBus::~FrameBus()
+  {
+    if (mSource) {
+      mSource->stop();
+    }
+    if (mThread.joinable()) {
+      mThread.join();
+    }
+    for (auto &subscription : mSubscriptions) {
+      subscription->close();
+    }
+  }
+
+  auto FrameBus::acquire(const VideoCaptureConfig &config)
+    -> std::shared_ptr<FrameBus>
+  {
+    std::lock_guard _(registryMutex);
+    registry.erase(std::remove_if(registry.begin(),
+                                  registry.end(),
+                                  [](const auto &bus) {
+      return bus.expired();
+    }),
+                   registry.end());
+    for (const auto &weakBus : registry) {
+      auto bus = weakBus.lock();
+      if (bus && !bus->error() && sameCapture(bus->config(), config)) {
+        return bus;
+      }
+    }
+    auto bus = std::make_shared<FrameBus>(config);
+    registry.push_back(bus);
+    return bus;
+  }
+
+  auto FrameBus::subscribe(PixelLayout layout,
+                           DropPolicy  policy,
+                           std::size_t capacity)
+    -> std::shared_ptr<FrameSubscription>
+  {
+    auto subscription =
+      std::make_shared<FrameSubscription>(layout, policy, capacity);
+    std::lock_guard _(mMutex);
+    if (mErrMsg) {
+      subscription->close();
+      return subscription;
+    }
+    mSubscriptions.push_back(subscription);
+    if (!mThread.joinable()) {
+      mThread = std::thread(&FrameBus::run, this);
+    }
+    return subscription;
+  }
+
+  auto FrameBus::config() const noexcept -> const VideoCaptureConfig &
+  {
+    return mConfig;
+  }
+
+  auto FrameBus::error() const -> std::optional<std::string>
+  {
+    std::lock_guard _(mMutex);
+    return mErrMsg;
+  }
+
+  auto FrameBus::stats() const -> VideoCaptureStats
+  {
+    return mSource ? mSource->stats() : VideoCaptureStats {};
+  }
+
+  auto FrameBus::clock() const noexcept -> const MediaClock &
+  {
+    return mClock;
+  }
+
+  void FrameBus::follow(
+    const std::vector<std::shared_ptr<FrameSubscription>> &subs)
+  {
+    auto    configured = std::max<uint8_t>(mConfig.fpsHint, 1);
+    uint8_t fps        = subs.empty() ? configured : 0;
+    float   scale      = subs.empty() ? 1.0F : 0.0F;
+    for (const auto &subscription : subs) {
+      auto wanted = subscription->fps();
+      fps   = std::max(fps, wanted == 0 ? configured : wanted);
+      scale = std::max(scale, subscription->scale());
+    }
+    fps = std::min(fps, configured);
+    if (fps != mFps) {
+      mSource->setFps(fps);
+      mFps = fps;
+    }
+    if (scale != mScale) {
+      mSource->setScale(scale);
+      mScale = scale;
+    }
+  }
+
+  void FrameBus::run()
+  {
+    std::vector<std::shared_ptr<FrameSubscription>> subscriptions;
+    // for each subscription, the output it gets this frame, if any
+    std::vector<std::optional<std::size_t>> routes;
+    std::vector<Output>                     outputs;
+    // the last frame of each output, which repeats share
+    std::vector<Output> last;
+    // scaled pixels for the outputs smaller than the capture, by scale
+    std::vector<std::pair<float, VideoFrame>> scaled;
+    mFps   = std::max<uint8_t>(mConfig.fpsHint, 1);
+    mScale = 1.0F;
+    for (;;) {
+      {
+        std::lock_guard _(mMutex);
+        mSubscriptions.erase(
+          std::remove_if(mSubscriptions.begin(),
+                         mSubscriptions.end(),
+                         [](const auto &sub) { return sub->isClosed(); }),
+          mSubscriptions.end());
+        subscriptions = mSubscriptions;
+      }
+      follow(subscriptions);
+
+      // decides which output each subscription gets, once the pts is known
+      auto route = [&](int64_t ptsUs) {
+        routes.assign(subscriptions.size(), std::nullopt);
+        outputs.clear();
+        for (std::size_t i = 0; i < subscriptions.size(); i++) {
+          const auto &subscription = *subscriptions[i];
+          if (!subscription.wants(ptsUs, subscription.fps())) {
+            continue;
+          }
+          auto layout = subscription.layout();
+          auto scale  = std::min(subscription.scale() / mScale, 1.0F);
+          auto found  = std::find_if(
+            outputs.begin(), outputs.end(), [&](const auto &output) {
+            return output.layout == layout && output.scale == scale;
+          });
+          routes[i] = static_cast<std::size_t>(found - outputs.begin());
+          if (found == outputs.end()) {
+            outputs.push_back({ layout, scale, nullptr });
+          }
+        }
+      };
+
+      // each output is converted straight out of the capture buffer
+      auto captured = mSource->nextView([&](const FrameView &view) {
+        route(mSource->frame().ptsUs);
+        for (auto &output : outputs) {
+          auto src = view;
+          if (output.scale < 1.0F) {
+            auto found = std::find_if(
+              scaled.begin(), scaled.end(), [&](const auto &entry) {
+              return entry.first == output.scale;
+            });
+            if (found == scaled.end()) {
+              found = scaled.insert(scaled.end(), { output.scale, {} });
+            }
+            auto size = Size {
+              std::max<uint32_t>(std::lround(view.width * output.scale), 1),
+              std::max<uint32_t>(std::lround(view.height * output.scale), 1),
+            };
+            src = scaleFrame(view, size, mConfig.scaleFilter, found->second);
+          }
+          output.frame = recycle(output.layout);
+          convertFrame(src, output.layout, mMatrix, *output.frame);
+        }
+      });
+      if (!captured) {
+        break;
+      }
+
+      const auto &raw = mSource->frame();
+      if (raw.repeat) {
+        route(raw.ptsUs);
+      }
+      for (auto &output : outputs) {
+        auto previous =
+          std::find_if(last.begin(), last.end(), [&](const auto &entry) {
+          return entry.layout == output.layout && entry.scale == output.scale;
+        });
+        if (!output.frame) {
+          // a repeat of an output that has not been captured yet is skipped
+          if (previous == last.end()) {
+            continue;
+          }
+          output.frame = previous->frame;
+        } else {
+          output.frame->ptsUs  = raw.ptsUs;
+          output.frame->repeat = false;
+        }
+        if (previous == last.end()) {
+          last.push_back(output);
+        } else {
+          previous->frame = output.frame;
+        }
+      }
+      for (std::size_t i = 0; i < subscriptions.size(); i++) {
+        if (routes[i] && outputs[*routes[i]].frame) {
+          subscriptions[i]->push(
+            { outputs[*routes[i]].frame, raw.ptsUs, raw.repeat });
+        }
+      }
+      // forget the outputs no subscriber asks for anymore
+      last.erase(
+        std::remove_if(last.begin(),
+                       last.end(),
+                       [&](const auto &entry) {
+        return std::none_of(
+          subscriptions.begin(), subscriptions.end(), [&](const auto &sub) {
+          return sub->layout() == entry.layout &&
+                 std::min(sub->scale() / mScale, 1.0F) == entry.scale;
+        });
+      }),
+        last.end());
+      outputs.clear();
+    }
+
+    std::lock_guard _(mMutex);
+    mErrMsg = mSource->error();
+    for (auto &subscription : mSubscriptions) {
+      subscription->close();
+    }
+  }
+
+  auto FrameBus::recycle(PixelLayout layout) -> std::shared_ptr<VideoFrame>
+  {
+    auto &pool  = mPools[static_cast<std::size_t>(layout)];
+    auto  found = std::find_if(pool.begin(), pool.end(), [](const auto &f) {
+      return f.use_count() == 1;
+    });
+    if (found != pool.end()) {
+      return *found;
+    }
+    return pool.emplace_back(std::make_shared<VideoFrame>());
+  }
+} // namespace smv::details
@@ -0,0 +1,221 @@
+#pragma once
+
+#include "capture_video.hpp"
+#include "convert_yuv.hpp"
+#include "frame.hpp"
+#include "media_clock.hpp"
+#include "smv/record.hpp"
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace smv::details {
+  using FramePtr = std::shared_ptr<const VideoFrame>;
+
+  /**
+   * @brief A frame as a FrameBus delivers it
+   * @details The pixels are immutable and shared: a repeat hands out the
+   * pixels of the frame it repeats again. ptsUs and repeat are those of this
+   * delivery, not the ones the pixels were captured with
+   */
+  struct BusFrame
+  {
+    FramePtr pixels;
+    int64_t  ptsUs  = 0;
+    bool     repeat = false;
+  };
+
+  /**
+   * @brief What a subscriber that is not keeping up loses
+   */
+  enum class DropPolicy
+  {
+    // the oldest waiting frame makes room for the new one. With a capacity
+    // of 1, the subscriber always gets the latest frame
+    Oldest,
+    // the new frame is dropped, the waiting frames are kept
+    Newest,
+  };
+
+  /**
+   * @brief The frames a FrameBus delivers to one subscriber
+   */
+  class FrameSubscription
+  {
+  public:
+    FrameSubscription(PixelLayout layout,
+                      DropPolicy  policy,
+                      std::size_t capacity);
+
+    /**
+     * @brief Wait for the next frame
+     * @return the frame, or std::nullopt once the subscription is closed
+     */
+    auto next() -> std::optional<BusFrame>;
+
+    /**
+     * @brief Stop receiving frames. A pending call to next returns nullptr
+     */
+    void close();
+
+    auto layout() const noexcept -> PixelLayout;
+    auto isClosed() const -> bool;
+
+    /**
+     * @brief the number of frames this subscriber did not get to
+     */
+    auto dropped() const -> uint64_t;
+
+    /**
+     * @brief the number of frames waiting, and how many can wait
+     */
+    auto depth() const -> std::size_t;
+    auto capacity() const noexcept -> std::size_t;
+
+    /**
+     * @brief Receive fewer, smaller frames than the bus captures
+     * @details Only affects this subscriber: a frame that comes sooner than
+     * 1/fps after the last one it got is skipped, without counting as
+     * dropped, and its frames are scaled down by scale. The bus captures at
+     * the highest rate and size any of its subscribers still asks for. Safe
+     * to call from any thread
+     *
+     * @param fps the most frames per second to receive, 0 for every frame
+     * @param scale a factor of the size the bus is configured for, in (0, 1]
+     */
+    void limit(uint8_t fps, float scale);
+    auto fps() const noexcept -> uint8_t;
+    auto scale() const noexcept -> float;
+
+  private:
+    friend class FrameBus;
+    /**
+     * @brief whether the frame captured at ptsUs is due, given the limit
+     */
+    auto wants(int64_t ptsUs, uint8_t fps) const -> bool;
+    void push(const BusFrame &frame);
+
+    const PixelLayout       mLayout;
+    const DropPolicy        mPolicy;
+    const std::size_t       mCapacity;
+    mutable std::mutex      mMutex;
+    std::condition_variable mCond;
+    std::deque<BusFrame>    mFrames;
+    bool                    mClosed  = false;
+    uint64_t                mDropped = 0;
+    std::atomic_uint8_t     mFps     = 0;
+    std::atomic<float>      mScale   = 1.0F;
+    // the pts of the last frame pushed. Only used by the bus thread
+    std::optional<int64_t>  mLastPtsUs;
+  };
+
+  /**
+   * @brief Captures an area once, and hands the frames out to any number of
+   * subscribers
+   *
+   * @details Each frame is grabbed, hashed and scaled once, then converted
+   * straight out of the capture buffer once for every layout that has
+   * subscribers. The converted frames are immutable and shared between the
+   * subscribers of that layout, so adding an output only costs the
+   * conversion of its layout, and only if no other subscriber already asked
+   * for it. A repeated frame shares the pixels of the last frame of its
+   * layout and size.
+   * Every subscriber has its own bounded queue and DropPolicy, so a slow
+   * encoder does not hold back a preview, nor the capture itself. A
+   * subscriber can also limit its own rate and size (see
+   * FrameSubscription::limit), so that slowing one consumer down does not
+   * degrade the others: the bus captures for the most demanding one, and
+   * frames for the smaller sizes are scaled once per size.
+   *
+   * Frames are recycled once every subscriber is done with them, so a steady
+   * capture does not allocate.
+   * The capture runs on a thread owned by the bus, from the first
+   * subscription until the bus is destroyed.
+   */
+  class FrameBus
+  {
+  public:
+    explicit FrameBus(const VideoCaptureConfig &config,
+                      YuvMatrix                 matrix = YuvMatrix::BT709);
+    FrameBus(const FrameBus &)                     = delete;
+    auto operator=(const FrameBus &) -> FrameBus & = delete;
+    ~FrameBus();
+
+    /**
+     * @brief Get the bus capturing the given config
+     * @details If another consumer is already capturing the same area, at
+     * the same size and rate, its bus is shared instead of grabbing the same
+     * pixels twice
+     */
+    static auto acquire(const VideoCaptureConfig &config)
+      -> std::shared_ptr<FrameBus>;
+
+    /**
+     * @brief Start receiving frames
+     *
+     * @param layout the layout of the frames to receive
+     * @param policy what to drop when the subscriber falls behind
+     * @param capacity how many frames can wait for the subscriber
+     */
+    auto subscribe(PixelLayout layout,
+                   DropPolicy  policy   = DropPolicy::Oldest,
+                   std::size_t capacity = 1)
+      -> std::shared_ptr<FrameSubscription>;
+
+    auto config() const noexcept -> const VideoCaptureConfig &;
+    auto error() const -> std::optional<std::string>;
+    auto stats() const -> VideoCaptureStats;
+
+    /**
+     * @brief the clock the frames are stamped on, for the streams that are
+     * recorded along with them
+     */
+    auto clock() const noexcept -> const MediaClock &;
+
+  private:
+    static constexpr std::size_t LAYOUT_COUNT = 5;
+    using FramePool = std::vector<std::shared_ptr<VideoFrame>>;
+
+    /**
+     * @brief A layout at a size, shared by the subscribers that want it
+     */
+    struct Output
+    {
+      PixelLayout                 layout;
+      // a factor of the size the bus captures at
+      float                       scale;
+      std::shared_ptr<VideoFrame> frame;
+    };
+
+    void run();
+    /**
+     * @brief capture at the highest rate and size a subscriber asks for
+     */
+    void follow(const std::vector<std::shared_ptr<FrameSubscription>> &subs);
+    auto recycle(PixelLayout layout) -> std::shared_ptr<VideoFrame>;
+
+    const VideoCaptureConfig                        mConfig;
+    const YuvMatrix                                 mMatrix;
+    const MediaClock                                mClock;
+    std::shared_ptr<VideoCaptureSource>             mSource;
+    mutable std::mutex                              mMutex;
+    std::vector<std::shared_ptr<FrameSubscription>> mSubscriptions;
+    // converted frames, by layout, to be reused once nobody holds them
+    std::array<FramePool, LAYOUT_COUNT> mPools;
+    std::optional<std::string>          mErrMsg;
+    std::thread                         mThread;
+    // what the source was last set to. Only used by the bus thread
+    uint8_t mFps   = 0;
+    float   mScale = 1.0F;
+  };
+} // namespace smv::details
@@ -0,0 +1,23 @@
+#include "frame_hash.hpp"
+
+#include <cstddef>
+
+#define XXH_INLINE_ALL
+#include <xxhash.h>
+
+namespace smv::details {
+  auto hashFrame(const FrameView &frame) -> uint64_t
+  {
+    const auto rowBytes = static_cast<std::size_t>(frame.width) * 4;
+    if (frame.stride == rowBytes) {
+      return XXH3_64bits(frame.data, rowBytes * frame.height);
+    }
+
+    XXH3_state_t state;
+    XXH3_64bits_reset(&state);
+    for (uint32_t y = 0; y < frame.height; y++) {
+      XXH3_64bits_update(&state, frame.row(y), rowBytes);
+    }
+    return XXH3_64bits_digest(&state);
+  }
+} // namespace smv::details
@@ -0,0 +1,19 @@
+#pragma once
+
+#include "frame.hpp"
+
+#include <cstdint>
+
+namespace smv::details {
+  /**
+   * @brief Hash the visible pixels of a raw capture
+   *
+   * @details Uses XXH3, which is vectorized and runs close to memory
+   * bandwidth, so hashing a frame costs a fraction of converting it. Row
+   * padding is not part of the hash
+   *
+   * @param frame the raw capture
+   * @return uint64_t the hash
+   */
+  auto hashFrame(const FrameView &frame) -> uint64_t;
+} // namespace smv::details
@@ -0,0 +1,125 @@
+#include "interleaver.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <tuple>
+#include <utility>
+
+namespace smv::details {
+  namespace {
+    // the most the audio timestamps move per packet, about 2.5% of a 20ms
+    // packet, which is far below what a player would notice
+    constexpr int64_t MAX_SLEW_US = 500;
+    // smaller differences are left alone, they are within the noise of the
+    // drift estimate
+    constexpr int64_t DRIFT_DEADBAND_US = 2000;
+
+    constexpr auto index(StreamKind stream) -> std::size_t
+    {
+      return static_cast<std::size_t>(stream);
+    }
+  } // namespace
+
+  InterleavingMuxer::InterleavingMuxer(Output                    output,
+                                       std::chrono::microseconds window,
+                                       std::size_t               maxPackets)
+    : mOutput(std::move(output))
+    , mWindowUs(window.count())
+    , mMaxPackets(std::max<std::size_t>(maxPackets, 1))
+  {
+  }
+
+  void InterleavingMuxer::addStream(StreamKind stream)
+  {
+    std::lock_guard _(mMutex);
+    mExpected[index(stream)] = true;
+  }
+
+  void InterleavingMuxer::push(StreamKind stream, PacketPtr packet)
+  {
+    if (!packet) {
+      return;
+    }
+    std::lock_guard _(mMutex);
+    auto ptsUs = packet->ptsUs;
+    if (stream == StreamKind::Audio) {
+      auto &correction = mStats.audioCorrectionUs;
+      auto  error      = mAudioDriftUs - correction;
+      if (std::abs(error) > DRIFT_DEADBAND_US) {
+        correction += std::clamp(error, -MAX_SLEW_US, MAX_SLEW_US);
+      }
+      ptsUs += correction;
+    }
+
+    auto i = index(stream);
+    mNewestUs[i] = mSeen[i] ? std::max(mNewestUs[i], ptsUs) : ptsUs;
+    mSeen[i]     = true;
+    mQueue.push_back({ ptsUs, mOrder++, stream, std::move(packet) });
+    std::push_heap(mQueue.begin(), mQueue.end(), later);
+    drain(false);
+  }
+
+  void InterleavingMuxer::setAudioDrift(int64_t driftUs)
+  {
+    std::lock_guard _(mMutex);
+    mAudioDriftUs = driftUs;
+  }
+
+  void InterleavingMuxer::flush()
+  {
+    std::lock_guard _(mMutex);
+    drain(true);
+  }
+
+  auto InterleavingMuxer::stats() const -> InterleaverStats
+  {
+    std::lock_guard _(mMutex);
+    return mStats;
+  }
+
+  auto InterleavingMuxer::later(const Entry &a, const Entry &b) -> bool
+  {
+    return std::tie(a.ptsUs, a.order) > std::tie(b.ptsUs, b.order);
+  }
+
+  void InterleavingMuxer::drain(bool all)
+  {
+    auto newestUs = int64_t { 0 };
+    for (std::size_t i = 0; i < mSeen.size(); i++) {
+      if (mSeen[i]) {
+        newestUs = std::max(newestUs, mNewestUs[i]);
+      }
+    }
+
+    while (!mQueue.empty()) {
+      const auto &head     = mQueue.front();
+      bool        caughtUp = true;
+      for (std::size_t i = 0; i < mExpected.size(); i++) {
+        if (mExpected[i] && (!mSeen[i] || mNewestUs[i] < head.ptsUs)) {
+          caughtUp = false;
+        }
+      }
+      if (!all && !caughtUp) {
+        if (newestUs - head.ptsUs <= mWindowUs &&
+            mQueue.size() <= mMaxPackets) {
+          break;
+        }
+        mStats.forced++;
+      }
+      std::pop_heap(mQueue.begin(), mQueue.end(), later);
+      write(mQueue.back());
+      mQueue.pop_back();
+    }
+  }
+
+  void InterleavingMuxer::write(Entry &entry)
+  {
+    if (mStats.written > 0 && entry.ptsUs < mLastWrittenUs) {
+      entry.ptsUs = mLastWrittenUs;
+      mStats.late++;
+    }
+    mLastWrittenUs = entry.ptsUs;
+    mStats.written++;
+    mOutput(entry.stream, entry.packet, entry.ptsUs);
+  }
+} // namespace smv::details
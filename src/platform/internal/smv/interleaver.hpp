@@ -0,0 +1,124 @@
+#pragma once
+
+#include "encoder.hpp"
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+namespace smv::details {
+  enum class StreamKind : uint8_t
+  {
+    Video,
+    Audio,
+  };
+
+  /**
+   * @brief Counters kept by an InterleavingMuxer
+   */
+  struct InterleaverStats
+  {
+    // packets handed to the output
+    uint64_t written = 0;
+    // packets that arrived after a later packet was written, and had their
+    // pts moved up
+    uint64_t late = 0;
+    // packets written before every stream caught up with them, because the
+    // reorder window was exceeded
+    uint64_t forced = 0;
+    // how much the audio timestamps are currently shifted by
+    int64_t audioCorrectionUs = 0;
+  };
+
+  /**
+   * @brief Merges the packets of a recording's streams into one sequence
+   * ordered by pts
+   *
+   * @details Packets are held until every stream added with addStream has
+   * produced a packet at least as late, then written in pts order. The wait
+   * is bounded: a packet is written anyway once it is more than the reorder
+   * window older than the newest packet, or when more than maxPackets are
+   * queued. A packet that arrives after later ones were written has its pts
+   * moved up to the last written one, so the output never goes back in time.
+   *
+   * The audio device runs on its own clock, which drifts from the media
+   * clock video is paced with. setAudioDrift gives the drift measured by
+   * the audio source (see AudioCaptureSource::driftUs); audio timestamps are
+   * slewed towards it by a fraction of a millisecond per packet, so long
+   * recordings stay in sync without jumps.
+   * Packets can be pushed from any thread; the output is called with the
+   * lock held, one packet at a time
+   */
+  class InterleavingMuxer
+  {
+  public:
+    /**
+     * @param stream the stream the packet belongs to
+     * @param packet the packet
+     * @param ptsUs the corrected pts of the packet. Use this instead of the
+     * pts of the packet
+     */
+    using Output = std::function<
+      void(StreamKind stream, const PacketPtr &packet, int64_t ptsUs)>;
+
+    static constexpr auto DEFAULT_WINDOW      = std::chrono::milliseconds(500);
+    static constexpr auto DEFAULT_MAX_PACKETS = std::size_t { 512 };
+
+    explicit InterleavingMuxer(
+      Output                    output,
+      std::chrono::microseconds window     = DEFAULT_WINDOW,
+      std::size_t               maxPackets = DEFAULT_MAX_PACKETS);
+
+    /**
+     * @brief wait for packets of this stream before writing others
+     */
+    void addStream(StreamKind stream);
+
+    void push(StreamKind stream, PacketPtr packet);
+
+    /**
+     * @brief the current drift of the audio clock behind the media clock
+     */
+    void setAudioDrift(int64_t driftUs);
+
+    /**
+     * @brief write every queued packet, at the end of the recording
+     */
+    void flush();
+
+    auto stats() const -> InterleaverStats;
+
+  private:
+    struct Entry
+    {
+      int64_t    ptsUs;
+      // the order of arrival, to keep packets with the same pts in order
+      uint64_t   order;
+      StreamKind stream;
+      PacketPtr  packet;
+    };
+
+    static auto later(const Entry &a, const Entry &b) -> bool;
+
+    void drain(bool all);
+    void write(Entry &entry);
+
+    const Output           mOutput;
+    const int64_t          mWindowUs;
+    const std::size_t      mMaxPackets;
+    mutable std::mutex     mMutex;
+    // a min-heap on (pts, order)
+    std::vector<Entry>     mQueue;
+    std::array<bool, 2>    mExpected {};
+    std::array<bool, 2>    mSeen {};
+    std::array<int64_t, 2> mNewestUs {};
+    int64_t                mLastWrittenUs = 0;
+    uint64_t               mOrder         = 0;
+    int64_t                mAudioDriftUs  = 0;
+    InterleaverStats       mStats;
+  };
+} // namespace smv::details
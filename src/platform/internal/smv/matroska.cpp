@@ -0,0 +1,232 @@
+#include "matroska.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <string_view>
+#include <utility>
+
+namespace smv::details {
+  namespace {
+    // element ids, with their length marker
+    constexpr uint32_t EBML                 = 0x1A45DFA3;
+    constexpr uint32_t EBML_VERSION         = 0x4286;
+    constexpr uint32_t EBML_READ_VERSION    = 0x42F7;
+    constexpr uint32_t EBML_MAX_ID_LENGTH   = 0x42F2;
+    constexpr uint32_t EBML_MAX_SIZE_LENGTH = 0x42F3;
+    constexpr uint32_t DOC_TYPE             = 0x4282;
+    constexpr uint32_t DOC_TYPE_VERSION     = 0x4287;
+    constexpr uint32_t DOC_TYPE_READ        = 0x4285;
+    constexpr uint32_t SEGMENT              = 0x18538067;
+    constexpr uint32_t INFO                 = 0x1549A966;
+    constexpr uint32_t TIMESTAMP_SCALE      = 0x2AD7B1;
+    constexpr uint32_t MUXING_APP           = 0x4D80;
+    constexpr uint32_t WRITING_APP          = 0x5741;
+    constexpr uint32_t TRACKS               = 0x1654AE6B;
+    constexpr uint32_t TRACK_ENTRY          = 0xAE;
+    constexpr uint32_t TRACK_NUMBER         = 0xD7;
+    constexpr uint32_t TRACK_UID            = 0x73C5;
+    constexpr uint32_t TRACK_TYPE           = 0x83;
+    constexpr uint32_t FLAG_LACING          = 0x9C;
+    constexpr uint32_t CODEC_ID             = 0x86;
+    constexpr uint32_t CODEC_PRIVATE        = 0x63A2;
+    constexpr uint32_t VIDEO                = 0xE0;
+    constexpr uint32_t PIXEL_WIDTH          = 0xB0;
+    constexpr uint32_t PIXEL_HEIGHT         = 0xBA;
+    constexpr uint32_t AUDIO                = 0xE1;
+    constexpr uint32_t SAMPLING_FREQUENCY   = 0xB5;
+    constexpr uint32_t CHANNELS             = 0x9F;
+    constexpr uint32_t CLUSTER              = 0x1F43B675;
+    constexpr uint32_t TIMESTAMP            = 0xE7;
+    constexpr uint32_t SIMPLE_BLOCK         = 0xA3;
+
+    constexpr uint8_t  TRACK_VIDEO    = 1;
+    constexpr uint8_t  TRACK_AUDIO    = 2;
+    constexpr uint8_t  BLOCK_KEYFRAME = 0x80;
+    constexpr uint64_t NS_PER_MS      = 1'000'000;
+    constexpr auto     VENDOR         = std::string_view("ShareMyView");
+    // a segment size of all ones means the size is unknown
+    constexpr uint8_t UNKNOWN_SIZE[] = { 0x01, 0xFF, 0xFF, 0xFF,
+                                         0xFF, 0xFF, 0xFF, 0xFF };
+
+    /**
+     * @brief the number of bytes of a variable size integer holding value
+     */
+    auto sizeLength(uint64_t value) -> int
+    {
+      auto length = 1;
+      // all ones is reserved, so the largest value of a length is one less
+      while (length < 8 && value >= (uint64_t { 1 } << (7 * length)) - 1) {
+        length++;
+      }
+      return length;
+    }
+
+    void appendSize(std::vector<uint8_t> &out, uint64_t size)
+    {
+      auto length = sizeLength(size);
+      auto value  = size | (uint64_t { 1 } << (7 * length));
+      for (auto i = length - 1; i >= 0; i--) {
+        out.push_back(static_cast<uint8_t>(value >> (8 * i)));
+      }
+    }
+
+    void appendId(std::vector<uint8_t> &out, uint32_t id)
+    {
+      auto length = id > 0xFFFFFF ? 4 : id > 0xFFFF ? 3 : id > 0xFF ? 2 : 1;
+      for (auto i = length - 1; i >= 0; i--) {
+        out.push_back(static_cast<uint8_t>(id >> (8 * i)));
+      }
+    }
+
+    void appendElement(std::vector<uint8_t>       &out,
+                       uint32_t                    id,
+                       const std::vector<uint8_t> &payload)
+    {
+      appendId(out, id);
+      appendSize(out, payload.size());
+      out.insert(out.end(), payload.begin(), payload.end());
+    }
+
+    void appendUint(std::vector<uint8_t> &out, uint32_t id, uint64_t value)
+    {
+      auto length = 1;
+      while (length < 8 && (value >> (8 * length)) != 0) {
+        length++;
+      }
+      appendId(out, id);
+      appendSize(out, length);
+      for (auto i = length - 1; i >= 0; i--) {
+        out.push_back(static_cast<uint8_t>(value >> (8 * i)));
+      }
+    }
+
+    void appendFloat(std::vector<uint8_t> &out, uint32_t id, double value)
+    {
+      uint64_t bits = 0;
+      std::memcpy(&bits, &value, sizeof(bits));
+      appendId(out, id);
+      appendSize(out, sizeof(bits));
+      for (auto i = static_cast<int>(sizeof(bits)) - 1; i >= 0; i--) {
+        out.push_back(static_cast<uint8_t>(bits >> (8 * i)));
+      }
+    }
+
+    void appendString(std::vector<uint8_t> &out,
+                      uint32_t              id,
+                      std::string_view      value)
+    {
+      appendId(out, id);
+      appendSize(out, value.size());
+      out.insert(out.end(), value.begin(), value.end());
+    }
+
+    auto trackEntry(const MatroskaTrack &track, uint64_t number)
+      -> std::vector<uint8_t>
+    {
+      std::vector<uint8_t> entry;
+      appendUint(entry, TRACK_NUMBER, number);
+      appendUint(entry, TRACK_UID, number);
+      appendUint(entry, TRACK_TYPE, track.channels ? TRACK_AUDIO : TRACK_VIDEO);
+      appendUint(entry, FLAG_LACING, 0);
+      appendString(entry, CODEC_ID, track.codecId);
+      if (!track.codecPrivate.empty()) {
+        appendElement(entry, CODEC_PRIVATE, track.codecPrivate);
+      }
+      std::vector<uint8_t> settings;
+      if (track.channels) {
+        appendFloat(settings, SAMPLING_FREQUENCY, track.sampleRate);
+        appendUint(settings, CHANNELS, track.channels);
+        appendElement(entry, AUDIO, settings);
+      } else {
+        appendUint(settings, PIXEL_WIDTH, track.width);
+        appendUint(settings, PIXEL_HEIGHT, track.height);
+        appendElement(entry, VIDEO, settings);
+      }
+      return entry;
+    }
+  } // namespace
+
+  MatroskaWriter::MatroskaWriter(std::vector<MatroskaTrack> tracks)
+    : mTracks(std::move(tracks))
+  {
+  }
+
+  auto MatroskaWriter::header() const -> std::vector<uint8_t>
+  {
+    std::vector<uint8_t> ebml;
+    appendUint(ebml, EBML_VERSION, 1);
+    appendUint(ebml, EBML_READ_VERSION, 1);
+    appendUint(ebml, EBML_MAX_ID_LENGTH, 4);
+    appendUint(ebml, EBML_MAX_SIZE_LENGTH, 8);
+    appendString(ebml, DOC_TYPE, "matroska");
+    appendUint(ebml, DOC_TYPE_VERSION, 4);
+    appendUint(ebml, DOC_TYPE_READ, 2);
+
+    std::vector<uint8_t> info;
+    appendUint(info, TIMESTAMP_SCALE, NS_PER_MS);
+    appendString(info, MUXING_APP, VENDOR);
+    appendString(info, WRITING_APP, VENDOR);
+
+    std::vector<uint8_t> tracks;
+    for (std::size_t i = 0; i < mTracks.size(); i++) {
+      appendElement(tracks, TRACK_ENTRY, trackEntry(mTracks[i], i + 1));
+    }
+
+    std::vector<uint8_t> out;
+    appendElement(out, EBML, ebml);
+    appendId(out, SEGMENT);
+    out.insert(out.end(), std::begin(UNKNOWN_SIZE), std::end(UNKNOWN_SIZE));
+    appendElement(out, INFO, info);
+    appendElement(out, TRACKS, tracks);
+    return out;
+  }
+
+  auto MatroskaWriter::add(std::size_t track, const EncodedPacket &packet)
+    -> std::vector<uint8_t>
+  {
+    if (!mOriginUs) {
+      mOriginUs = packet.ptsUs;
+    }
+    // a block cannot go back in time within its cluster
+    auto ms = std::max((packet.ptsUs - *mOriginUs) / 1000, mLastMs);
+    mLastMs = ms;
+
+    std::vector<uint8_t> out;
+    if (!mBlocks.empty() && ms - mClusterMs > CLUSTER_MS) {
+      out = flush();
+    }
+    if (mBlocks.empty()) {
+      mClusterMs = ms;
+    }
+
+    // the track number, the timestamp relative to the cluster, the flags
+    const auto &bytes    = packet.bytes();
+    auto        number   = static_cast<uint64_t>(track + 1);
+    auto        relative = static_cast<int16_t>(ms - mClusterMs);
+    appendId(mBlocks, SIMPLE_BLOCK);
+    appendSize(mBlocks, sizeLength(number) + 3 + bytes.size());
+    appendSize(mBlocks, number);
+    mBlocks.push_back(static_cast<uint8_t>(relative >> 8));
+    mBlocks.push_back(static_cast<uint8_t>(relative));
+    mBlocks.push_back(packet.keyframe ? BLOCK_KEYFRAME : 0);
+    mBlocks.insert(mBlocks.end(), bytes.begin(), bytes.end());
+    return out;
+  }
+
+  auto MatroskaWriter::flush() -> std::vector<uint8_t>
+  {
+    if (mBlocks.empty()) {
+      return {};
+    }
+    std::vector<uint8_t> timestamp;
+    appendUint(timestamp, TIMESTAMP, static_cast<uint64_t>(mClusterMs));
+
+    std::vector<uint8_t> out;
+    appendId(out, CLUSTER);
+    appendSize(out, timestamp.size() + mBlocks.size());
+    out.insert(out.end(), timestamp.begin(), timestamp.end());
+    out.insert(out.end(), mBlocks.begin(), mBlocks.end());
+    mBlocks.clear();
+    return out;
+  }
+} // namespace smv::details
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "encoder.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace smv::details {
+  /**
+   * @brief A track of a Matroska file
+   */
+  struct MatroskaTrack
+  {
+    // the Matroska codec id, such as V_MJPEG
+    std::string codecId;
+    // what the decoder needs before the first packet, if anything
+    std::vector<uint8_t> codecPrivate;
+    // the size of the pictures of a video track
+    uint32_t width  = 0;
+    uint32_t height = 0;
+    // the sample rate and channels of an audio track. A track without
+    // channels is a video track
+    uint32_t sampleRate = 0;
+    uint8_t  channels   = 0;
+  };
+
+  /**
+   * @brief Writes timestamped packets as a Matroska file
+   *
+   * @details header gives the EBML header, the segment info and the tracks.
+   * Packets are then collected with add, in pts order across the tracks, and
+   * written out as clusters of up to CLUSTER_MS each, or sooner with flush.
+   * Every packet is a SimpleBlock with its own timestamp (in milliseconds,
+   * from the first packet), so a player shows each frame for as long as it
+   * was on screen, whatever the rate of the capture. The segment is written
+   * with an unknown size, so the file is written in a single pass
+   */
+  class MatroskaWriter
+  {
+  public:
+    static constexpr int64_t CLUSTER_MS = 5'000;
+
+    explicit MatroskaWriter(std::vector<MatroskaTrack> tracks);
+
+    /**
+     * @brief the EBML header, and the start of the segment up to its tracks
+     */
+    auto header() const -> std::vector<uint8_t>;
+
+    /**
+     * @brief Add a packet to the current cluster
+     *
+     * @param track the index of the packet's track
+     * @param packet the packet. Its pts must not be before the last one
+     * @return the cluster completed by this packet, if any
+     */
+    auto add(std::size_t track, const EncodedPacket &packet)
+      -> std::vector<uint8_t>;
+
+    /**
+     * @brief Write the packets of the current cluster, if any
+     */
+    auto flush() -> std::vector<uint8_t>;
+
+  private:
+    const std::vector<MatroskaTrack> mTracks;
+    std::optional<int64_t>           mOriginUs;
+    int64_t                          mClusterMs = 0;
+    int64_t                          mLastMs    = 0;
+    std::vector<uint8_t>             mBlocks;
+  };
+} // namespace smv::details
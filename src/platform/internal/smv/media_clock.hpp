@@ -0,0 +1,42 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+namespace smv::details {
+  /**
+   * @brief The timeline shared by the streams of one recording
+   *
+   * @details Sources that are given the same clock stamp their output in
+   * microseconds since the same origin, so a video frame and an audio packet
+   * with the same pts were captured at the same moment. The clock is
+   * monotonic, and cheap enough to read from a real-time audio thread
+   */
+  class MediaClock
+  {
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    MediaClock()
+      : mOrigin(Clock::now())
+    {
+    }
+
+    inline auto origin() const noexcept -> Clock::time_point { return mOrigin; }
+
+    inline auto toUs(Clock::time_point time) const noexcept -> int64_t
+    {
+      return std::chrono::duration_cast<std::chrono::microseconds>(time -
+                                                                   mOrigin)
+        .count();
+    }
+
+    inline auto nowUs() const noexcept -> int64_t
+    {
+      return toUs(Clock::now());
+    }
+
+  private:
+    Clock::time_point mOrigin;
+  };
+} // namespace smv::details
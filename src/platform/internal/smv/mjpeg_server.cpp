@@ -0,0 +1,194 @@
+#include "mjpeg_server.hpp"
+#include "smv/log.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <utility>
+
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+namespace smv::details {
+  using smv::log::logger;
+
+  namespace {
+    constexpr std::size_t MAX_REQUEST_BYTES = 16 << 10;
+    constexpr auto        BOUNDARY          = "smvframe";
+  } // namespace
+
+  struct MjpegServer::Client: TcpClient
+  {
+    bool        streaming = false;
+    // the frame being written, its part header, and how much of both is out
+    PacketPtr   current;
+    std::string partHeader;
+    std::size_t written = 0;
+    // the frame to write next. Replaced when a newer frame arrives
+    PacketPtr pending;
+
+    void startFrame(PacketPtr frame)
+    {
+      current = std::move(frame);
+      written = 0;
+      if (current) {
+        // the CRLF before the boundary also ends the previous part
+        partHeader = std::string("\r\n--") + BOUNDARY +
+                     "\r\nContent-Type: image/jpeg\r\nContent-Length: " +
+                     std::to_string(current->bytes().size()) + "\r\n\r\n";
+      }
+    }
+  };
+
+  MjpegServer::MjpegServer(ServerUrl url)
+    : TcpServer(std::move(url), "http", "MJPEG")
+  {
+  }
+
+  MjpegServer::~MjpegServer()
+  {
+    stop();
+  }
+
+  void MjpegServer::send(const PacketPtr &frame)
+  {
+    std::lock_guard _(mMutex);
+    for (auto &entry : mClients) {
+      auto &client = static_cast<Client &>(*entry);
+      if (!client.streaming || client.closing) {
+        continue;
+      }
+      if (client.current) {
+        if (client.pending) {
+          mStats.dropped++;
+        }
+        client.pending = frame;
+        continue;
+      }
+      client.startFrame(frame);
+      if (!flush(client)) {
+        client.closing = true;
+      }
+    }
+  }
+
+  auto MjpegServer::viewers() const -> std::size_t
+  {
+    std::lock_guard _(mMutex);
+    return static_cast<std::size_t>(
+      std::count_if(mClients.begin(), mClients.end(), [](const auto &entry) {
+      const auto &client = static_cast<const Client &>(*entry);
+      return client.streaming && !client.closing;
+    }));
+  }
+
+  auto MjpegServer::takeStats() -> MjpegServerStats
+  {
+    std::lock_guard _(mMutex);
+    return std::exchange(mStats, {});
+  }
+
+  auto MjpegServer::newClient() -> std::unique_ptr<TcpClient>
+  {
+    return std::make_unique<Client>();
+  }
+
+  auto MjpegServer::handle(TcpClient &entry) -> bool
+  {
+    auto &client = static_cast<Client &>(entry);
+    // a viewer has nothing more to say once it streams
+    if (client.streaming) {
+      client.input.clear();
+      return true;
+    }
+    auto end = client.input.find("\r\n\r\n");
+    if (end == std::string::npos) {
+      return client.input.size() < MAX_REQUEST_BYTES;
+    }
+    // GET path HTTP/1.x
+    std::string_view request(client.input.data(), end);
+    auto             line   = request.substr(0, request.find("\r\n"));
+    auto             gap    = line.find(' ');
+    auto             method = line.substr(0, gap);
+    auto             path   = line.substr(std::min(gap + 1, line.size()));
+    path = path.substr(0, std::min(path.find(' '), path.find('?')));
+
+    if (gap == std::string_view::npos) {
+      client.output  = "HTTP/1.0 400 Bad Request\r\nConnection: close\r\n\r\n";
+      client.closing = true;
+    } else if (method != "GET") {
+      client.output  = "HTTP/1.0 405 Method Not Allowed\r\n"
+                       "Allow: GET\r\nConnection: close\r\n\r\n";
+      client.closing = true;
+    } else if (path.substr(0, mUrl.path.size()) != mUrl.path) {
+      client.output  = "HTTP/1.0 404 Not Found\r\nConnection: close\r\n\r\n";
+      client.closing = true;
+    } else {
+      client.output = std::string("HTTP/1.0 200 OK\r\n"
+                                  "Content-Type: multipart/x-mixed-replace; "
+                                  "boundary=") +
+                      BOUNDARY +
+                      "\r\nCache-Control: no-cache, no-store\r\n"
+                      "Pragma: no-cache\r\nConnection: close\r\n\r\n";
+      client.streaming = true;
+      logger->info("MJPEG client {} started streaming",
+                   inet_ntoa(client.address.sin_addr));
+    }
+    client.input.clear();
+    return flush(client);
+  }
+
+  auto MjpegServer::wantsWrite(const TcpClient &entry) const -> bool
+  {
+    return TcpServer::wantsWrite(entry) ||
+           static_cast<const Client &>(entry).current;
+  }
+
+  auto MjpegServer::flush(TcpClient &entry) -> bool
+  {
+    auto &client = static_cast<Client &>(entry);
+    // the response goes out before any frame
+    if (!TcpServer::flush(client)) {
+      client.current.reset();
+      client.pending.reset();
+      return false;
+    }
+    while (client.output.empty() && client.current) {
+      const auto &header    = client.partHeader;
+      const auto &bytes     = client.current->bytes();
+      iovec       parts[2] {};
+      std::size_t partCount = 0;
+      if (client.written < header.size()) {
+        parts[partCount++] = { const_cast<char *>(header.data()) +
+                                 client.written,
+                               header.size() - client.written };
+        parts[partCount++] = { const_cast<uint8_t *>(bytes.data()),
+                               bytes.size() };
+      } else {
+        auto offset        = client.written - header.size();
+        parts[partCount++] = { const_cast<uint8_t *>(bytes.data()) + offset,
+                               bytes.size() - offset };
+      }
+      msghdr message {};
+      message.msg_iov    = parts;
+      message.msg_iovlen = partCount;
+      auto count = sendmsg(client.fd, &message, MSG_DONTWAIT | MSG_NOSIGNAL);
+      if (count < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+          return true;
+        }
+        // nothing more can be sent to this client
+        client.current.reset();
+        client.pending.reset();
+        return false;
+      }
+      client.written += static_cast<std::size_t>(count);
+      if (client.written == header.size() + bytes.size()) {
+        mStats.sent++;
+        client.startFrame(std::move(client.pending));
+        client.pending.reset();
+      }
+    }
+    return true;
+  }
+} // namespace smv::details
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "encoder.hpp"
+#include "net.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace smv::details {
+  constexpr uint16_t DEFAULT_HTTP_PORT = 8080;
+
+  /**
+   * @brief How well the viewers of an MjpegServer keep up
+   */
+  struct MjpegServerStats
+  {
+    // frames fully written to a viewer
+    uint64_t sent = 0;
+    // frames replaced by a newer one before a viewer got to them
+    uint64_t dropped = 0;
+  };
+
+  /**
+   * @brief Serves JPEG frames as a multipart/x-mixed-replace HTTP stream
+   *
+   * @details Any browser pointed at the server shows the frames as they
+   * arrive. Each viewer has at most one frame being written and one waiting:
+   * a new frame replaces the waiting one, so a slow viewer sees fewer frames
+   * but never older ones. The frames are shared between viewers, not copied.
+   *
+   * The connections are handled by TcpServer
+   */
+  class MjpegServer: public TcpServer
+  {
+  public:
+    explicit MjpegServer(ServerUrl url);
+    ~MjpegServer() override;
+
+    /**
+     * @brief Send a JPEG frame to every viewer
+     */
+    void send(const PacketPtr &frame);
+
+    auto viewers() const -> std::size_t;
+
+    /**
+     * @brief the counters since the previous call
+     */
+    auto takeStats() -> MjpegServerStats;
+
+  protected:
+    auto newClient() -> std::unique_ptr<TcpClient> override;
+    auto handle(TcpClient &client) -> bool override;
+    auto wantsWrite(const TcpClient &client) const -> bool override;
+    auto flush(TcpClient &client) -> bool override;
+
+  private:
+    struct Client;
+
+    MjpegServerStats mStats;
+  };
+} // namespace smv::details
@@ -0,0 +1,309 @@
+#include "net.hpp"
+#include "smv/log.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <utility>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace smv::details {
+  using smv::log::logger;
+
+  namespace {
+    constexpr auto POLL_TIMEOUT_MS = 50;
+    constexpr auto RECV_CHUNK      = 4096;
+  } // namespace
+
+  auto ServerUrl::parse(std::string_view url,
+                        std::string_view scheme,
+                        uint16_t defaultPort) -> std::optional<ServerUrl>
+  {
+    ServerUrl result;
+    result.port = defaultPort;
+    if (url.empty()) {
+      return result;
+    }
+    if (url.substr(0, scheme.size()) != scheme ||
+        url.substr(scheme.size(), 3) != "://") {
+      return std::nullopt;
+    }
+    url.remove_prefix(scheme.size() + 3);
+    auto slash = url.find('/');
+    if (slash != std::string_view::npos) {
+      result.path = std::string(url.substr(slash));
+      url         = url.substr(0, slash);
+    }
+    auto colon = url.rfind(':');
+    if (colon != std::string_view::npos) {
+      auto port = url.substr(colon + 1);
+      auto res =
+        std::from_chars(port.data(), port.data() + port.size(), result.port);
+      if (res.ec != std::errc {} || res.ptr != port.data() + port.size()) {
+        return std::nullopt;
+      }
+      url = url.substr(0, colon);
+    }
+    if (!url.empty()) {
+      result.host = url == "localhost" ? "127.0.0.1" : std::string(url);
+    }
+    return result;
+  }
+
+  auto listenTcp(const ServerUrl &url) -> std::variant<int, std::string>
+  {
+    sockaddr_in address {};
+    address.sin_family = AF_INET;
+    address.sin_port   = htons(url.port);
+    if (inet_pton(AF_INET, url.host.c_str(), &address.sin_addr) != 1) {
+      address.sin_addr.s_addr = htonl(INADDR_ANY);
+    }
+
+    auto fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+      return errnoStr();
+    }
+    int reuse = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    if (bind(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) <
+          0 ||
+        listen(fd, SOMAXCONN) < 0 || !setNonBlocking(fd)) {
+      auto err = "Failed to listen on " + url.host + ":" +
+                 std::to_string(url.port) + ": " + errnoStr();
+      close(fd);
+      return err;
+    }
+    return fd;
+  }
+
+  auto setNonBlocking(int fd) -> bool
+  {
+    auto flags = fcntl(fd, F_GETFL, 0);
+    return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+  }
+
+  auto errnoStr() -> std::string
+  {
+    return std::strerror(errno);
+  }
+
+  TcpServer::TcpServer(ServerUrl        url,
+                       std::string_view scheme,
+                       std::string_view name)
+    : mUrl(std::move(url))
+    , mScheme(scheme)
+    , mName(name)
+  {
+  }
+
+  TcpServer::~TcpServer()
+  {
+    TcpServer::stop();
+  }
+
+  auto TcpServer::start() -> std::optional<std::string>
+  {
+    auto listener = listenTcp(mUrl);
+    if (std::holds_alternative<std::string>(listener)) {
+      return std::get<std::string>(std::move(listener));
+    }
+    mListenFd = std::get<int>(listener);
+    if (auto err = prepare()) {
+      stop();
+      return err;
+    }
+    mRunning = true;
+    mThread  = std::thread(&TcpServer::run, this);
+    logger->info("{} server listening on {}://{}:{}{}",
+                 mName,
+                 mScheme,
+                 mUrl.host,
+                 mUrl.port,
+                 mUrl.path);
+    return std::nullopt;
+  }
+
+  void TcpServer::stop()
+  {
+    mRunning = false;
+    if (mThread.joinable()) {
+      mThread.join();
+    }
+    std::lock_guard _(mMutex);
+    for (auto &client : mClients) {
+      close(client->fd);
+    }
+    mClients.clear();
+    if (mListenFd >= 0) {
+      close(mListenFd);
+      mListenFd = -1;
+    }
+  }
+
+  auto TcpServer::prepare() -> std::optional<std::string>
+  {
+    return std::nullopt;
+  }
+
+  auto TcpServer::newClient() -> std::unique_ptr<TcpClient>
+  {
+    return std::make_unique<TcpClient>();
+  }
+
+  auto TcpServer::wantsWrite(const TcpClient &client) const -> bool
+  {
+    return !client.output.empty();
+  }
+
+  auto TcpServer::flush(TcpClient &client) -> bool
+  {
+    while (!client.output.empty()) {
+      auto count = ::send(client.fd,
+                          client.output.data(),
+                          client.output.size(),
+                          MSG_DONTWAIT | MSG_NOSIGNAL);
+      if (count < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+          return true;
+        }
+        // nothing more can be sent to this client
+        client.output.clear();
+        return false;
+      }
+      client.output.erase(0, static_cast<std::size_t>(count));
+    }
+    return true;
+  }
+
+  void TcpServer::polled()
+  {
+  }
+
+  auto TcpServer::localAddress() const -> sockaddr_in
+  {
+    sockaddr_in address {};
+    socklen_t   length = sizeof(address);
+    getsockname(
+      mListenFd, reinterpret_cast<sockaddr *>(&address), &length);
+    return address;
+  }
+
+  void TcpServer::run()
+  {
+    std::vector<pollfd> fds;
+    while (mRunning) {
+      fds.clear();
+      fds.push_back({ mListenFd, POLLIN, 0 });
+      {
+        std::lock_guard _(mMutex);
+        for (const auto &client : mClients) {
+          short events = POLLIN;
+          if (wantsWrite(*client)) {
+            events |= POLLOUT;
+          }
+          fds.push_back({ client->fd, events, 0 });
+        }
+      }
+      if (poll(fds.data(), fds.size(), POLL_TIMEOUT_MS) < 0 && errno != EINTR) {
+        logger->error("{} server poll failed: {}", mName, errnoStr());
+        break;
+      }
+      if (fds[0].revents & POLLIN) {
+        acceptClient();
+      }
+
+      {
+        std::lock_guard _(mMutex);
+        for (std::size_t i = 1; i < fds.size(); i++) {
+          auto found = std::find_if(
+            mClients.begin(), mClients.end(), [fd = fds[i].fd](auto &c) {
+            return c->fd == fd;
+          });
+          if (found == mClients.end()) {
+            continue;
+          }
+          auto &client  = **found;
+          auto  revents = fds[i].revents;
+          if (revents & (POLLERR | POLLHUP)) {
+            client.closing = true;
+            client.output.clear();
+          }
+          if (!client.closing && (revents & POLLIN) &&
+              !(receive(client) && handle(client))) {
+            client.closing = true;
+          }
+          // a client that is closing still gets the rest of its output
+          if ((revents & POLLOUT) && !flush(client)) {
+            client.closing = true;
+          }
+        }
+
+        // drop the clients that went away, or asked to
+        auto removed = std::remove_if(
+          mClients.begin(), mClients.end(), [](const auto &client) {
+          if (client->closing && client->output.empty()) {
+            close(client->fd);
+            return true;
+          }
+          return false;
+        });
+        for (auto it = removed; it != mClients.end(); ++it) {
+          logger->info("{} client {} disconnected",
+                       mName,
+                       inet_ntoa((*it)->address.sin_addr));
+        }
+        mClients.erase(removed, mClients.end());
+      }
+      polled();
+    }
+  }
+
+  void TcpServer::acceptClient()
+  {
+    sockaddr_in address {};
+    socklen_t   length = sizeof(address);
+    auto        fd     = accept4(mListenFd,
+                      reinterpret_cast<sockaddr *>(&address),
+                      &length,
+                      SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0) {
+      return;
+    }
+    // what the servers send is written whole, there is nothing to gain from
+    // batching
+    int noDelay = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+    std::lock_guard _(mMutex);
+    auto            client = newClient();
+    client->fd             = fd;
+    client->address        = address;
+    logger->info("{} client {} connected", mName, inet_ntoa(address.sin_addr));
+    mClients.push_back(std::move(client));
+  }
+
+  auto TcpServer::receive(TcpClient &client) -> bool
+  {
+    char buffer[RECV_CHUNK]; // NOLINT
+    for (;;) {
+      auto count = recv(client.fd, buffer, sizeof(buffer), 0);
+      if (count == 0) {
+        return false;
+      }
+      if (count < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+          return true;
+        }
+        return errno == EINTR;
+      }
+      client.input.append(buffer, static_cast<std::size_t>(count));
+    }
+  }
+} // namespace smv::details
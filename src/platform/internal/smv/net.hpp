@@ -0,0 +1,165 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <variant>
+#include <vector>
+
+#include <netinet/in.h>
+
+namespace smv::details {
+  /**
+   * @brief The address a local server listens on, taken from a url
+   */
+  struct ServerUrl
+  {
+    std::string host = "127.0.0.1";
+    uint16_t    port = 0;
+    std::string path = "/";
+
+    /**
+     * @brief Parse a url of the form scheme://host[:port][/path]
+     * @details An empty url gives the defaults. "localhost" is resolved to
+     * the loopback address, anything else that is not an IPv4 address makes
+     * the server listen on every interface
+     *
+     * @param url the url to parse
+     * @param scheme the expected scheme, without "://"
+     * @param defaultPort the port used when the url has none
+     */
+    static auto parse(std::string_view url,
+                      std::string_view scheme,
+                      uint16_t         defaultPort) -> std::optional<ServerUrl>;
+  };
+
+  /**
+   * @brief Open a non-blocking TCP socket listening on the given address
+   * @return the socket, or an error message
+   */
+  auto listenTcp(const ServerUrl &url) -> std::variant<int, std::string>;
+
+  auto setNonBlocking(int fd) -> bool;
+
+  /**
+   * @brief the message for the current errno
+   */
+  auto errnoStr() -> std::string;
+
+  /**
+   * @brief A connection to a TcpServer
+   */
+  struct TcpClient
+  {
+    virtual ~TcpClient() = default;
+
+    int         fd = -1;
+    sockaddr_in address {};
+    // received, and not handled yet
+    std::string input;
+    // waiting to be sent
+    std::string output;
+    // the client is dropped once its output is sent
+    bool closing = false;
+  };
+
+  /**
+   * @brief The connection handling shared by the servers of a stream
+   *
+   * @details Listens on the url, accepts clients, reads what they send and
+   * writes their output without blocking, all on a thread owned by the
+   * server. A subclass only speaks the protocol: it creates its clients,
+   * handles their input, and may write more than their output. The hooks are
+   * called on the server thread, with mMutex held. A subclass must call stop
+   * in its destructor, so that the thread is gone before its members are
+   */
+  class TcpServer
+  {
+  public:
+    TcpServer(const TcpServer &)                     = delete;
+    auto operator=(const TcpServer &) -> TcpServer & = delete;
+    virtual ~TcpServer();
+
+    /**
+     * @brief Start listening for clients
+     * @return std::optional<std::string> an error message if the server could
+     * not listen on the configured address
+     */
+    auto start() -> std::optional<std::string>;
+
+    /**
+     * @brief Disconnect every client and stop listening
+     */
+    virtual void stop();
+
+  protected:
+    /**
+     * @param url the address to listen on
+     * @param scheme the scheme of the urls the server is reached at
+     * @param name what the logs call the server and its clients
+     */
+    TcpServer(ServerUrl url, std::string_view scheme, std::string_view name);
+
+    /**
+     * @brief Called by start once the server listens, before the first
+     * client is accepted. Not called with mMutex held
+     * @return std::optional<std::string> an error message to fail start with
+     */
+    virtual auto prepare() -> std::optional<std::string>;
+
+    /**
+     * @brief create the state of a client that just connected
+     */
+    virtual auto newClient() -> std::unique_ptr<TcpClient>;
+
+    /**
+     * @brief Handle the input of a client, once more of it was received
+     * @return false to drop the client
+     */
+    virtual auto handle(TcpClient &client) -> bool = 0;
+
+    /**
+     * @brief whether there is anything to write to the client
+     */
+    virtual auto wantsWrite(const TcpClient &client) const -> bool;
+
+    /**
+     * @brief Write as much as the client takes without blocking
+     * @details Writes the output. A subclass that has more to write than the
+     * output, such as frames shared between clients, writes it once the
+     * output is out
+     * @return false if the client cannot be written to anymore
+     */
+    virtual auto flush(TcpClient &client) -> bool;
+
+    /**
+     * @brief Called after each round of polling. Not called with mMutex held
+     */
+    virtual void polled();
+
+    /**
+     * @brief the local address the server listens on
+     */
+    auto localAddress() const -> sockaddr_in;
+
+    const ServerUrl                         mUrl;
+    mutable std::mutex                      mMutex;
+    std::vector<std::unique_ptr<TcpClient>> mClients;
+
+  private:
+    void run();
+    void acceptClient();
+    auto receive(TcpClient &client) -> bool;
+
+    const std::string mScheme;
+    const std::string mName;
+    int               mListenFd = -1;
+    std::atomic_bool  mRunning  = false;
+    std::thread       mThread;
+  };
+} // namespace smv::details
@@ -0,0 +1,184 @@
+#include "ogg_opus.hpp"
+
+#include <array>
+#include <cstring>
+
+namespace smv::details {
+  namespace {
+    constexpr uint8_t  FLAG_FIRST      = 0x02;
+    constexpr uint8_t  FLAG_LAST       = 0x04;
+    constexpr uint32_t OPUS_RATE       = 48'000;
+    constexpr auto     MAX_SEGMENTS    = 255U;
+    constexpr auto     VENDOR          = std::string_view("ShareMyView");
+    constexpr uint32_t CRC_POLYNOMIAL  = 0x04C11DB7;
+    constexpr auto     PAGE_HEADER     = 27U;
+
+    /**
+     * @brief the CRC used by Ogg: not reflected, no final xor
+     */
+    auto crcTable() -> const std::array<uint32_t, 256> &
+    {
+      static const auto table = [] {
+        std::array<uint32_t, 256> result {};
+        for (uint32_t i = 0; i < result.size(); i++) {
+          auto value = i << 24;
+          for (int bit = 0; bit < 8; bit++) {
+            value = (value & 0x80000000U) ? (value << 1) ^ CRC_POLYNOMIAL
+                                          : value << 1;
+          }
+          result[i] = value;
+        }
+        return result;
+      }();
+      return table;
+    }
+
+    template<typename T>
+    void putLE(uint8_t *out, T value)
+    {
+      for (std::size_t i = 0; i < sizeof(T); i++) {
+        out[i] = static_cast<uint8_t>(static_cast<uint64_t>(value) >> (i * 8));
+      }
+    }
+
+    template<typename T>
+    void appendLE(std::vector<uint8_t> &out, T value)
+    {
+      out.resize(out.size() + sizeof(T));
+      putLE(out.data() + out.size() - sizeof(T), value);
+    }
+
+    /**
+     * @brief the lacing values of a packet: 255 for each full segment, then
+     * the remainder, which may be 0
+     */
+    void lace(std::vector<uint8_t> &lacing, std::size_t size)
+    {
+      lacing.insert(lacing.end(), size / MAX_SEGMENTS, MAX_SEGMENTS);
+      lacing.push_back(static_cast<uint8_t>(size % MAX_SEGMENTS));
+    }
+  } // namespace
+
+  auto opusHead(uint8_t channels, uint32_t inputRate, uint16_t preSkip)
+    -> std::vector<uint8_t>
+  {
+    std::vector<uint8_t> head;
+    head.insert(head.end(), { 'O', 'p', 'u', 's', 'H', 'e', 'a', 'd' });
+    head.push_back(1); // version
+    head.push_back(channels);
+    appendLE(head, preSkip);
+    appendLE(head, inputRate);
+    appendLE(head, int16_t { 0 }); // output gain
+    head.push_back(0);             // mapping family: mono or stereo
+    return head;
+  }
+
+  OggOpusWriter::OggOpusWriter(uint8_t  channels,
+                               uint32_t inputRate,
+                               uint16_t preSkip,
+                               uint32_t serial)
+    : mChannels(channels)
+    , mInputRate(inputRate)
+    , mPreSkip(preSkip)
+    , mSerial(serial)
+  {
+  }
+
+  auto OggOpusWriter::header() -> std::vector<uint8_t>
+  {
+    auto head = opusHead(mChannels, mInputRate, mPreSkip);
+
+    std::vector<uint8_t> tags;
+    tags.insert(tags.end(), { 'O', 'p', 'u', 's', 'T', 'a', 'g', 's' });
+    appendLE(tags, static_cast<uint32_t>(VENDOR.size()));
+    tags.insert(tags.end(), VENDOR.begin(), VENDOR.end());
+    appendLE(tags, uint32_t { 0 }); // no user comments
+
+    // each header packet is alone on its page
+    std::vector<uint8_t> out;
+    for (const auto *packet : { &head, &tags }) {
+      std::vector<uint8_t> lacing;
+      lace(lacing, packet->size());
+      writePage(out,
+                packet == &head ? FLAG_FIRST : 0,
+                0,
+                packet->data(),
+                packet->size(),
+                lacing.data(),
+                lacing.size());
+    }
+    return out;
+  }
+
+  auto OggOpusWriter::add(std::basic_string_view<uint8_t> packet,
+                          uint32_t                        samples)
+    -> std::vector<uint8_t>
+  {
+    std::vector<uint8_t> out;
+    // a page holds at most 255 lacing values
+    if (mLacing.size() + packet.size() / MAX_SEGMENTS + 1 > MAX_SEGMENTS) {
+      out = flush(false);
+    }
+    lace(mLacing, packet.size());
+    mData.insert(mData.end(), packet.begin(), packet.end());
+    mGranule += samples;
+    mPending += samples;
+    // about a second per page keeps the overhead low without delaying much
+    if (mPending >= OPUS_RATE) {
+      auto page = flush(false);
+      out.insert(out.end(), page.begin(), page.end());
+    }
+    return out;
+  }
+
+  auto OggOpusWriter::flush(bool last) -> std::vector<uint8_t>
+  {
+    std::vector<uint8_t> out;
+    if (mLacing.empty() && !last) {
+      return out;
+    }
+    writePage(out,
+              last ? FLAG_LAST : 0,
+              mGranule,
+              mData.data(),
+              mData.size(),
+              mLacing.data(),
+              mLacing.size());
+    mData.clear();
+    mLacing.clear();
+    mPending = 0;
+    return out;
+  }
+
+  void OggOpusWriter::writePage(std::vector<uint8_t> &out,
+                                uint8_t               flags,
+                                uint64_t              granule,
+                                const uint8_t        *data,
+                                std::size_t           size,
+                                const uint8_t        *lacing,
+                                std::size_t           segments)
+  {
+    auto  start = out.size();
+    out.resize(start + PAGE_HEADER + segments + size);
+    auto *page = out.data() + start;
+    std::memcpy(page, "OggS", 4);
+    page[4] = 0; // version
+    page[5] = flags;
+    putLE(page + 6, granule);
+    putLE(page + 14, mSerial);
+    putLE(page + 18, mSequence++);
+    putLE(page + 22, uint32_t { 0 }); // crc, computed below
+    page[26] = static_cast<uint8_t>(segments);
+    std::memcpy(page + PAGE_HEADER, lacing, segments);
+    if (size > 0) {
+      std::memcpy(page + PAGE_HEADER + segments, data, size);
+    }
+
+    const auto &table = crcTable();
+    uint32_t    crc   = 0;
+    for (std::size_t i = 0; i < PAGE_HEADER + segments + size; i++) {
+      crc = (crc << 8) ^ table[((crc >> 24) ^ page[i]) & 0xFF];
+    }
+    putLE(page + 22, crc);
+  }
+} // namespace smv::details
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace smv::details {
+  /**
+   * @brief The OpusHead packet that identifies an Opus stream (RFC 7845)
+   * @details Also the codec private data of Opus in Matroska
+   */
+  auto opusHead(uint8_t channels, uint32_t inputRate, uint16_t preSkip)
+    -> std::vector<uint8_t>;
+
+  /**
+   * @brief Wraps Opus packets in Ogg pages, as per RFC 7845
+   *
+   * @details The first call to header gives the two mandatory header pages
+   * (OpusHead and OpusTags). Audio packets are then collected with add, and
+   * written out as pages of up to a second of audio each, or sooner with
+   * flush. The granule position of each page is the number of 48 kHz samples
+   * decoded by the end of the page, pre-skip included
+   */
+  class OggOpusWriter
+  {
+  public:
+    /**
+     * @param channels the number of channels of the stream
+     * @param inputRate the sample rate the audio was captured at
+     * @param preSkip the number of 48 kHz samples to drop at the start
+     * @param serial the serial number of the logical stream
+     */
+    OggOpusWriter(uint8_t  channels,
+                  uint32_t inputRate,
+                  uint16_t preSkip,
+                  uint32_t serial);
+
+    /**
+     * @brief the OpusHead and OpusTags pages
+     */
+    auto header() -> std::vector<uint8_t>;
+
+    /**
+     * @brief Add a packet to the current page
+     *
+     * @param packet the Opus packet
+     * @param samples the duration of the packet, in 48 kHz samples
+     * @return the pages completed by this packet, if any
+     */
+    auto add(std::basic_string_view<uint8_t> packet, uint32_t samples)
+      -> std::vector<uint8_t>;
+
+    /**
+     * @brief Write the packets of the current page, if any
+     * @param last whether this is the end of the stream
+     */
+    auto flush(bool last) -> std::vector<uint8_t>;
+
+  private:
+    void writePage(std::vector<uint8_t> &out,
+                   uint8_t               flags,
+                   uint64_t              granule,
+                   const uint8_t        *data,
+                   std::size_t           size,
+                   const uint8_t        *lacing,
+                   std::size_t           segments);
+
+    const uint8_t        mChannels;
+    const uint32_t       mInputRate;
+    const uint16_t       mPreSkip;
+    const uint32_t       mSerial;
+    uint32_t             mSequence = 0;
+    uint64_t             mGranule  = 0;
+    uint32_t             mPending  = 0;
+    std::vector<uint8_t> mData;
+    std::vector<uint8_t> mLacing;
+  };
+} // namespace smv::details
@@ -0,0 +1,244 @@
+#include "pixel_format.hpp"
+
+#include <cstring>
+
+namespace smv::details {
+  namespace {
+    // the visuals that get a loop of their own
+    enum class SourceKind
+    {
+      // 32-bit, blue in the lowest byte, with or without alpha
+      Bgra32,
+      // 32-bit, stored most significant byte first
+      Argb32Msb,
+      // 30-bit color in 32-bit pixels, 2 bits of padding
+      X2Rgb10,
+      // 24-bit pixels, blue first
+      Bgr24,
+      // 24-bit pixels, red first
+      Rgb24,
+      Rgb565,
+      Rgb555,
+      Generic,
+    };
+
+    inline auto expand5(uint32_t value) -> uint8_t
+    {
+      return static_cast<uint8_t>((value << 3) | (value >> 2));
+    }
+
+    inline auto expand6(uint32_t value) -> uint8_t
+    {
+      return static_cast<uint8_t>((value << 2) | (value >> 4));
+    }
+
+    inline auto read16(const uint8_t *src) -> uint32_t
+    {
+      return static_cast<uint32_t>(src[0]) |
+             (static_cast<uint32_t>(src[1]) << 8);
+    }
+
+    inline auto read32(const uint8_t *src) -> uint32_t
+    {
+      uint32_t value = 0;
+      std::memcpy(&value, src, sizeof(value));
+      return value;
+    }
+
+    /**
+     * @brief the position of the lowest bit of a mask, and how many bits it
+     * has
+     */
+    struct Channel
+    {
+      uint32_t shift = 0;
+      uint32_t bits  = 0;
+
+      explicit Channel(uint32_t mask)
+      {
+        for (; mask != 0 && (mask & 1U) == 0; mask >>= 1) {
+          shift++;
+        }
+        for (; (mask & 1U) != 0; mask >>= 1) {
+          bits++;
+        }
+      }
+
+      inline auto extract(uint32_t pixel) const -> uint8_t
+      {
+        if (bits == 0) {
+          return 0xFF;
+        }
+        auto value = (pixel >> shift) & ((1U << bits) - 1U);
+        if (bits >= 8) {
+          return static_cast<uint8_t>(value >> (bits - 8));
+        }
+        return static_cast<uint8_t>(value * 0xFF / ((1U << bits) - 1));
+      }
+    };
+
+    template<SourceKind K>
+    void convertRow(const uint8_t     *src,
+                    uint8_t           *dst,
+                    uint32_t           width,
+                    const PixelFormat &format)
+    {
+      if constexpr (K == SourceKind::Bgra32) {
+        auto alpha = format.alphaMask() == 0 ? 0xFF000000U : 0U;
+        for (uint32_t x = 0; x < width; x++, src += 4, dst += 4) {
+          auto pixel = read32(src) | alpha;
+          std::memcpy(dst, &pixel, sizeof(pixel));
+        }
+      } else if constexpr (K == SourceKind::Argb32Msb) {
+        const uint8_t alpha = format.alphaMask() == 0 ? 0xFF : 0;
+        for (uint32_t x = 0; x < width; x++, src += 4, dst += 4) {
+          dst[0] = src[3];
+          dst[1] = src[2];
+          dst[2] = src[1];
+          dst[3] = static_cast<uint8_t>(src[0] | alpha);
+        }
+      } else if constexpr (K == SourceKind::X2Rgb10) {
+        for (uint32_t x = 0; x < width; x++, src += 4, dst += 4) {
+          auto pixel = read32(src);
+          dst[0]     = static_cast<uint8_t>(pixel >> 2);
+          dst[1]     = static_cast<uint8_t>(pixel >> 12);
+          dst[2]     = static_cast<uint8_t>(pixel >> 22);
+          dst[3]     = 0xFF;
+        }
+      } else if constexpr (K == SourceKind::Bgr24) {
+        for (uint32_t x = 0; x < width; x++, src += 3, dst += 4) {
+          dst[0] = src[0];
+          dst[1] = src[1];
+          dst[2] = src[2];
+          dst[3] = 0xFF;
+        }
+      } else if constexpr (K == SourceKind::Rgb24) {
+        for (uint32_t x = 0; x < width; x++, src += 3, dst += 4) {
+          dst[0] = src[2];
+          dst[1] = src[1];
+          dst[2] = src[0];
+          dst[3] = 0xFF;
+        }
+      } else if constexpr (K == SourceKind::Rgb565) {
+        for (uint32_t x = 0; x < width; x++, src += 2, dst += 4) {
+          auto pixel = read16(src);
+          dst[0]     = expand5(pixel & 0x1FU);
+          dst[1]     = expand6((pixel >> 5) & 0x3FU);
+          dst[2]     = expand5(pixel >> 11);
+          dst[3]     = 0xFF;
+        }
+      } else if constexpr (K == SourceKind::Rgb555) {
+        for (uint32_t x = 0; x < width; x++, src += 2, dst += 4) {
+          auto pixel = read16(src);
+          dst[0]     = expand5(pixel & 0x1FU);
+          dst[1]     = expand5((pixel >> 5) & 0x1FU);
+          dst[2]     = expand5((pixel >> 10) & 0x1FU);
+          dst[3]     = 0xFF;
+        }
+      } else {
+        const Channel red(format.redMask);
+        const Channel green(format.greenMask);
+        const Channel blue(format.blueMask);
+        const Channel alpha(format.alphaMask());
+        const auto    bytes = format.bytesPerPixel();
+        for (uint32_t x = 0; x < width; x++, src += bytes, dst += 4) {
+          uint32_t pixel = 0;
+          for (uint32_t i = 0; i < bytes; i++) {
+            auto shift = format.msbFirst ? (bytes - 1 - i) * 8 : i * 8;
+            pixel |= static_cast<uint32_t>(src[i]) << shift;
+          }
+          dst[0] = blue.extract(pixel);
+          dst[1] = green.extract(pixel);
+          dst[2] = red.extract(pixel);
+          dst[3] = alpha.extract(pixel);
+        }
+      }
+    }
+
+    auto kindOf(const PixelFormat &format) -> SourceKind
+    {
+      auto masks = [&](uint32_t red, uint32_t green, uint32_t blue) {
+        return format.redMask == red && format.greenMask == green &&
+               format.blueMask == blue;
+      };
+      switch (format.bitsPerPixel) {
+        case 32:
+          if (masks(0xFF0000, 0xFF00, 0xFF)) {
+            return format.msbFirst ? SourceKind::Argb32Msb
+                                   : SourceKind::Bgra32;
+          }
+          if (!format.msbFirst && masks(0x3FF00000, 0xFFC00, 0x3FF)) {
+            return SourceKind::X2Rgb10;
+          }
+          break;
+        case 24:
+          if (masks(0xFF0000, 0xFF00, 0xFF)) {
+            return format.msbFirst ? SourceKind::Rgb24 : SourceKind::Bgr24;
+          }
+          break;
+        case 16:
+          if (!format.msbFirst && masks(0xF800, 0x7E0, 0x1F)) {
+            return SourceKind::Rgb565;
+          }
+          if (!format.msbFirst && masks(0x7C00, 0x3E0, 0x1F)) {
+            return SourceKind::Rgb555;
+          }
+          break;
+        default:
+          break;
+      }
+      return SourceKind::Generic;
+    }
+  } // namespace
+
+  auto bgrxConverter(const PixelFormat &format) -> RowConverter
+  {
+    switch (kindOf(format)) {
+      case SourceKind::Bgra32:
+        return &convertRow<SourceKind::Bgra32>;
+      case SourceKind::Argb32Msb:
+        return &convertRow<SourceKind::Argb32Msb>;
+      case SourceKind::X2Rgb10:
+        return &convertRow<SourceKind::X2Rgb10>;
+      case SourceKind::Bgr24:
+        return &convertRow<SourceKind::Bgr24>;
+      case SourceKind::Rgb24:
+        return &convertRow<SourceKind::Rgb24>;
+      case SourceKind::Rgb565:
+        return &convertRow<SourceKind::Rgb565>;
+      case SourceKind::Rgb555:
+        return &convertRow<SourceKind::Rgb555>;
+      case SourceKind::Generic:
+        break;
+    }
+    return &convertRow<SourceKind::Generic>;
+  }
+
+  auto convertToBgrx(const uint8_t     *data,
+                     uint32_t           width,
+                     uint32_t           height,
+                     uint32_t           stride,
+                     const PixelFormat &format,
+                     VideoFrame        &dst,
+                     ThreadPool        &pool) -> FrameView
+  {
+    static constexpr auto ROWS_PER_TASK = 16;
+
+    dst.resize(PixelLayout::BGRX, width, height);
+    auto convert = bgrxConverter(format);
+    pool.parallelFor(
+      0,
+      height,
+      [&](std::size_t first, std::size_t last) {
+      for (auto y = first; y < last; y++) {
+        convert(data + y * stride,
+                dst.plane(0) + y * dst.strides[0],
+                width,
+                format);
+      }
+    },
+      ROWS_PER_TASK);
+    dst.hasAlpha = format.alphaMask() != 0;
+    return dst.view();
+  }
+} // namespace smv::details
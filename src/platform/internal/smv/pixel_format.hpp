@@ -0,0 +1,106 @@
+#pragma once
+
+#include "frame.hpp"
+#include "thread_pool.hpp"
+
+#include <cstdint>
+
+namespace smv::details {
+  /**
+   * @brief How the pixels of a capture are laid out in memory
+   *
+   * @details Describes any TrueColor visual: a pixel is bitsPerPixel bits,
+   * stored in the given byte order, and each color is found under its mask.
+   * Bits of the depth that are under no color mask hold the alpha channel,
+   * as in 32-bit ARGB visuals.
+   * The default describes what FrameView expects: 24-bit color in 32-bit
+   * pixels, blue in the lowest byte
+   */
+  struct PixelFormat
+  {
+    // the number of significant bits of a pixel
+    uint8_t  depth        = 24;
+    uint8_t  bitsPerPixel = 32;
+    uint32_t redMask      = 0xFF0000;
+    uint32_t greenMask    = 0xFF00;
+    uint32_t blueMask     = 0xFF;
+    // pixels are stored most significant byte first
+    bool msbFirst = false;
+    // rows are padded to a multiple of this many bits
+    uint8_t scanlinePad = 32;
+
+    inline auto bytesPerPixel() const -> uint32_t
+    {
+      return (bitsPerPixel + 7U) / 8U;
+    }
+
+    /**
+     * @brief the number of bytes between two rows of the given width
+     */
+    inline auto stride(uint32_t width) const -> uint32_t
+    {
+      auto pad  = static_cast<uint32_t>(scanlinePad);
+      auto bits = width * bitsPerPixel;
+      return (bits + pad - 1) / pad * pad / 8;
+    }
+
+    /**
+     * @brief the bits of the depth that are not color
+     */
+    inline auto alphaMask() const -> uint32_t
+    {
+      auto depthMask = depth >= 32 ? ~0U : (1U << depth) - 1U;
+      return depthMask & ~(redMask | greenMask | blueMask);
+    }
+
+    /**
+     * @brief whether a FrameView can describe the pixels as they are
+     */
+    inline auto isNative() const -> bool
+    {
+      return bitsPerPixel == 32 && redMask == 0xFF0000 &&
+             greenMask == 0xFF00 && blueMask == 0xFF;
+    }
+  };
+
+  /**
+   * @brief Converts one row of pixels to BGRX
+   * @details The fourth byte of a BGRX pixel is the alpha of the source, or
+   * 0xFF when it has none
+   */
+  using RowConverter = void (*)(const uint8_t     *src,
+                                uint8_t           *dst,
+                                uint32_t           width,
+                                const PixelFormat &format);
+
+  /**
+   * @brief Pick the row converter for a format
+   *
+   * @details Common visuals (16-bit 565 and 555, packed 24-bit, 30-bit and
+   * 32-bit ARGB) get a loop specialized for them at compile time. Anything
+   * else goes through a generic loop that shifts each channel out from
+   * under its mask. Meant to be called once per capture, not per row
+   */
+  auto bgrxConverter(const PixelFormat &format) -> RowConverter;
+
+  /**
+   * @brief Convert a capture of any format to BGRX
+   *
+   * @param data the first row of the capture
+   * @param width the width of the capture, in pixels
+   * @param height the number of rows
+   * @param stride the number of bytes between two rows of data
+   * @param format the format of data
+   * @param dst the frame to write to. It is resized to match the capture
+   * @param pool the thread pool to run the conversion on
+   * @return FrameView a view of the converted pixels in dst
+   */
+  auto convertToBgrx(const uint8_t     *data,
+                     uint32_t           width,
+                     uint32_t           height,
+                     uint32_t           stride,
+                     const PixelFormat &format,
+                     VideoFrame        &dst,
+                     ThreadPool        &pool = ThreadPool::shared())
+    -> FrameView;
+} // namespace smv::details
@@ -0,0 +1,135 @@
+#include "qoi.hpp"
+
+#include <array>
+#include <cstring>
+
+namespace smv::details {
+  namespace {
+    constexpr uint8_t OP_INDEX    = 0x00;
+    constexpr uint8_t OP_DIFF     = 0x40;
+    constexpr uint8_t OP_LUMA     = 0x80;
+    constexpr uint8_t OP_RUN      = 0xC0;
+    constexpr uint8_t OP_RGB      = 0xFE;
+    constexpr uint8_t OP_RGBA     = 0xFF;
+    constexpr auto    MAX_RUN     = 62;
+    constexpr auto    HEADER_SIZE = 14U;
+    constexpr std::array<uint8_t, 8> END_MARKER { 0, 0, 0, 0, 0, 0, 0, 1 };
+
+    struct Pixel
+    {
+      uint8_t r = 0, g = 0, b = 0, a = 0xFF;
+
+      inline auto operator==(const Pixel &other) const -> bool
+      {
+        return r == other.r && g == other.g && b == other.b && a == other.a;
+      }
+
+      inline auto hash() const -> uint8_t
+      {
+        return static_cast<uint8_t>((r * 3 + g * 5 + b * 7 + a * 11) % 64);
+      }
+    };
+
+    inline void write32(uint8_t *out, uint32_t value)
+    {
+      out[0] = static_cast<uint8_t>(value >> 24);
+      out[1] = static_cast<uint8_t>(value >> 16);
+      out[2] = static_cast<uint8_t>(value >> 8);
+      out[3] = static_cast<uint8_t>(value);
+    }
+  } // namespace
+
+  auto encodeQoi(const uint8_t *pixels,
+                 uint32_t       width,
+                 uint32_t       height,
+                 uint8_t        channels,
+                 uint32_t       stride) -> std::vector<uint8_t>
+  {
+    if (channels != 3 && channels != 4) {
+      return {};
+    }
+    // every pixel costs at most a tag byte and its channels
+    std::vector<uint8_t> encoded(
+      HEADER_SIZE +
+      static_cast<std::size_t>(width) * height * (channels + 1) +
+      END_MARKER.size());
+    auto *out = encoded.data();
+
+    std::memcpy(out, "qoif", 4);
+    write32(out + 4, width);
+    write32(out + 8, height);
+    out[12] = channels;
+    // sRGB with linear alpha
+    out[13] = 0;
+    out += HEADER_SIZE;
+
+    // the spec starts the index all zeros, alpha included, and the previous
+    // pixel as opaque black
+    std::array<Pixel, 64> index;
+    index.fill({ 0, 0, 0, 0 });
+    Pixel previous;
+    int                   run = 0;
+    for (uint32_t y = 0; y < height; y++) {
+      const auto *in = pixels + static_cast<std::size_t>(y) * stride;
+      for (uint32_t x = 0; x < width; x++, in += channels) {
+        Pixel pixel { in[0], in[1], in[2], channels == 4 ? in[3] : previous.a };
+        if (pixel == previous) {
+          if (++run == MAX_RUN) {
+            *out++ = static_cast<uint8_t>(OP_RUN | (run - 1));
+            run    = 0;
+          }
+          continue;
+        }
+        if (run > 0) {
+          *out++ = static_cast<uint8_t>(OP_RUN | (run - 1));
+          run    = 0;
+        }
+
+        auto slot = pixel.hash();
+        if (index[slot] == pixel) {
+          *out++   = static_cast<uint8_t>(OP_INDEX | slot);
+          previous = pixel;
+          continue;
+        }
+        index[slot] = pixel;
+
+        if (pixel.a != previous.a) {
+          *out++ = OP_RGBA;
+          *out++ = pixel.r;
+          *out++ = pixel.g;
+          *out++ = pixel.b;
+          *out++ = pixel.a;
+          previous = pixel;
+          continue;
+        }
+        auto dr  = static_cast<int8_t>(pixel.r - previous.r);
+        auto dg  = static_cast<int8_t>(pixel.g - previous.g);
+        auto db  = static_cast<int8_t>(pixel.b - previous.b);
+        auto drg = static_cast<int8_t>(dr - dg);
+        auto dbg = static_cast<int8_t>(db - dg);
+        if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 &&
+            db <= 1) {
+          *out++ = static_cast<uint8_t>(OP_DIFF | (dr + 2) << 4 |
+                                        (dg + 2) << 2 | (db + 2));
+        } else if (dg >= -32 && dg <= 31 && drg >= -8 && drg <= 7 &&
+                   dbg >= -8 && dbg <= 7) {
+          *out++ = static_cast<uint8_t>(OP_LUMA | (dg + 32));
+          *out++ = static_cast<uint8_t>((drg + 8) << 4 | (dbg + 8));
+        } else {
+          *out++ = OP_RGB;
+          *out++ = pixel.r;
+          *out++ = pixel.g;
+          *out++ = pixel.b;
+        }
+        previous = pixel;
+      }
+    }
+    if (run > 0) {
+      *out++ = static_cast<uint8_t>(OP_RUN | (run - 1));
+    }
+    std::memcpy(out, END_MARKER.data(), END_MARKER.size());
+    out += END_MARKER.size();
+    encoded.resize(static_cast<std::size_t>(out - encoded.data()));
+    return encoded;
+  }
+} // namespace smv::details
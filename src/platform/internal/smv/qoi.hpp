@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace smv::details {
+  /**
+   * @brief Encode packed pixels as a QOI image
+   *
+   * @details See https://qoiformat.org/qoi-specification.pdf. Single pass,
+   * no allocations besides the output, which is reserved for the worst case
+   *
+   * @param pixels the first row of the image, red first
+   * @param width the width of the image
+   * @param height the height of the image
+   * @param channels 3 for RGB, 4 for RGBA
+   * @param stride the number of bytes between two rows of pixels
+   * @return the encoded image. Empty if channels is not 3 or 4
+   */
+  auto encodeQoi(const uint8_t *pixels,
+                 uint32_t       width,
+                 uint32_t       height,
+                 uint8_t        channels,
+                 uint32_t       stride) -> std::vector<uint8_t>;
+} // namespace smv::details
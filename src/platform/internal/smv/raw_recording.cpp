@@ -0,0 +1,460 @@
+#include "raw_recording.hpp"
+#include "net.hpp"
+#include "smv/log.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <string_view>
+#include <utility>
+
+#include <fcntl.h>
+#include <lz4.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace smv::details {
+  using smv::log::logger;
+
+  namespace {
+    constexpr auto     MAGIC        = std::string_view("SMVRAW\r\n");
+    constexpr uint32_t VERSION      = 1;
+    constexpr uint32_t RECORD_MAGIC = 0x46564D53; // "SMVF"
+    // the file is grown this much at a time, so remapping is rare
+    constexpr std::size_t GROW_STEP = std::size_t { 64 } << 20;
+
+    struct FileHeader
+    {
+      char     magic[8];
+      uint32_t version;
+      uint8_t  fps;
+      uint8_t  reserved[3];
+      uint32_t keyframeInterval;
+      uint32_t reserved2;
+      // 0 until the recording is finished
+      uint64_t indexOffset;
+      uint64_t frameCount;
+      uint8_t  reserved3[24];
+    };
+
+    struct RecordHeader
+    {
+      uint32_t magic;
+      uint8_t  type;
+      uint8_t  reserved;
+      uint16_t rectCount;
+      uint32_t width;
+      uint32_t height;
+      // the size of the compressed pixels, after the rectangles
+      uint32_t payloadSize;
+      uint32_t rawSize;
+      int64_t  ptsUs;
+    };
+
+    struct IndexRecord
+    {
+      int64_t  ptsUs;
+      uint64_t offset;
+      uint8_t  type;
+      uint8_t  reserved[7];
+    };
+
+    static_assert(sizeof(FileHeader) == 64);
+    static_assert(sizeof(RecordHeader) == 32);
+    static_assert(sizeof(IndexRecord) == 24);
+    static_assert(sizeof(DirtyRect) == 8);
+
+    constexpr auto PIXEL_SIZE = 4U;
+
+    /**
+     * @brief copy the rows of a rectangle one after the other
+     */
+    auto packRect(const FrameView &frame, const DirtyRect &rect, uint8_t *out)
+      -> uint8_t *
+    {
+      auto rowBytes = static_cast<std::size_t>(rect.width) * PIXEL_SIZE;
+      for (uint32_t y = 0; y < rect.height; y++) {
+        std::memcpy(out,
+                    frame.row(rect.y + y) +
+                      static_cast<std::size_t>(rect.x) * PIXEL_SIZE,
+                    rowBytes);
+        out += rowBytes;
+      }
+      return out;
+    }
+  } // namespace
+
+  RawRecordingWriter::RawRecordingWriter(std::string path,
+                                         uint8_t     fps,
+                                         uint32_t    keyframeInterval)
+    : mPath(std::move(path))
+    , mFps(fps)
+    , mKeyframeInterval(std::max<uint32_t>(keyframeInterval, 1))
+  {
+  }
+
+  RawRecordingWriter::~RawRecordingWriter()
+  {
+    if (mMap) {
+      if (auto err = finish()) {
+        logger->error("Failed to finish raw recording {}: {}", mPath, *err);
+      }
+    }
+  }
+
+  auto RawRecordingWriter::open() -> std::optional<std::string>
+  {
+    mFd = ::open(mPath.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (mFd < 0) {
+      return "Failed to create " + mPath + ": " + errnoStr();
+    }
+    if (auto err = reserve(sizeof(FileHeader))) {
+      close();
+      return err;
+    }
+    FileHeader header {};
+    std::memcpy(header.magic, MAGIC.data(), MAGIC.size());
+    header.version          = VERSION;
+    header.fps              = mFps;
+    header.keyframeInterval = mKeyframeInterval;
+    std::memcpy(mMap, &header, sizeof(header));
+    mOffset = sizeof(header);
+    return std::nullopt;
+  }
+
+  auto RawRecordingWriter::write(const FrameView &frame, int64_t ptsUs)
+    -> std::optional<std::string>
+  {
+    if (!mMap) {
+      return "The recording is not open";
+    }
+    const auto &rects = mDiff.update(frame);
+    auto        type  = RawFrameType::Delta;
+    if (mSinceKey == 0 || frame.width != mWidth || frame.height != mHeight) {
+      type = RawFrameType::Key;
+    } else if (rects.empty()) {
+      type = RawFrameType::Repeat;
+    }
+
+    const uint8_t *raw     = nullptr;
+    std::size_t    rawSize = 0;
+    if (type == RawFrameType::Key) {
+      auto rowBytes = static_cast<std::size_t>(frame.width) * PIXEL_SIZE;
+      rawSize       = rowBytes * frame.height;
+      raw           = frame.data;
+      if (frame.stride != rowBytes) {
+        mPacked.resize(rawSize);
+        packRect(frame,
+                 { 0,
+                   0,
+                   static_cast<uint16_t>(frame.width),
+                   static_cast<uint16_t>(frame.height) },
+                 mPacked.data());
+        raw = mPacked.data();
+      }
+    } else if (type == RawFrameType::Delta) {
+      for (const auto &rect : rects) {
+        rawSize += static_cast<std::size_t>(rect.width) * rect.height;
+      }
+      rawSize *= PIXEL_SIZE;
+      mPacked.resize(rawSize);
+      auto *out = mPacked.data();
+      for (const auto &rect : rects) {
+        out = packRect(frame, rect, out);
+      }
+      raw = mPacked.data();
+    }
+
+    auto rectCount = type == RawFrameType::Delta ? rects.size() : 0;
+    auto bound     = static_cast<std::size_t>(
+      LZ4_compressBound(static_cast<int>(rawSize)));
+    auto rectBytes = rectCount * sizeof(DirtyRect);
+    if (auto err = reserve(sizeof(RecordHeader) + rectBytes + bound)) {
+      return err;
+    }
+
+    auto *record  = mMap + mOffset;
+    auto *payload = record + sizeof(RecordHeader) + rectBytes;
+    int   size    = 0;
+    if (rawSize > 0) {
+      size = LZ4_compress_default(reinterpret_cast<const char *>(raw),
+                                  reinterpret_cast<char *>(payload),
+                                  static_cast<int>(rawSize),
+                                  static_cast<int>(bound));
+      if (size <= 0) {
+        return std::string("Failed to compress a frame");
+      }
+    }
+    if (rectCount > 0) {
+      std::memcpy(record + sizeof(RecordHeader), rects.data(), rectBytes);
+    }
+    RecordHeader header {};
+    header.magic       = RECORD_MAGIC;
+    header.type        = static_cast<uint8_t>(type);
+    header.rectCount   = static_cast<uint16_t>(rectCount);
+    header.width       = frame.width;
+    header.height      = frame.height;
+    header.payloadSize = static_cast<uint32_t>(size);
+    header.rawSize     = static_cast<uint32_t>(rawSize);
+    header.ptsUs       = ptsUs;
+    std::memcpy(record, &header, sizeof(header));
+
+    mIndex.push_back({ ptsUs, mOffset, type });
+    mOffset +=
+      sizeof(RecordHeader) + rectBytes + static_cast<std::size_t>(size);
+    mSinceKey = (mSinceKey + 1) % mKeyframeInterval;
+    mWidth    = frame.width;
+    mHeight   = frame.height;
+    return std::nullopt;
+  }
+
+  auto RawRecordingWriter::finish() -> std::optional<std::string>
+  {
+    if (!mMap) {
+      return "The recording is not open";
+    }
+    auto indexBytes = mIndex.size() * sizeof(IndexRecord);
+    if (auto err = reserve(indexBytes)) {
+      close();
+      return err;
+    }
+    auto indexOffset = mOffset;
+    for (const auto &entry : mIndex) {
+      IndexRecord record {};
+      record.ptsUs  = entry.ptsUs;
+      record.offset = entry.offset;
+      record.type   = static_cast<uint8_t>(entry.type);
+      std::memcpy(mMap + mOffset, &record, sizeof(record));
+      mOffset += sizeof(record);
+    }
+    FileHeader header {};
+    std::memcpy(&header, mMap, sizeof(header));
+    header.indexOffset = indexOffset;
+    header.frameCount  = mIndex.size();
+    std::memcpy(mMap, &header, sizeof(header));
+
+    std::optional<std::string> errMsg;
+    munmap(mMap, mMapSize);
+    mMap = nullptr;
+    // drop the room that was reserved but not used
+    if (ftruncate(mFd, static_cast<off_t>(mOffset)) != 0) {
+      errMsg = "Failed to truncate " + mPath + ": " + errnoStr();
+    }
+    close();
+    logger->info("Raw recording {} finished. Frames={}, Bytes={}",
+                 mPath,
+                 mIndex.size(),
+                 mOffset);
+    return errMsg;
+  }
+
+  auto RawRecordingWriter::bytes() const noexcept -> uint64_t
+  {
+    return mOffset;
+  }
+
+  auto RawRecordingWriter::reserve(std::size_t size)
+    -> std::optional<std::string>
+  {
+    if (mOffset + size <= mMapSize) {
+      return std::nullopt;
+    }
+    auto newSize = std::max<std::size_t>(mMapSize * 2, mOffset + size);
+    newSize      = (newSize + GROW_STEP - 1) / GROW_STEP * GROW_STEP;
+    if (ftruncate(mFd, static_cast<off_t>(newSize)) != 0) {
+      return "Failed to grow " + mPath + ": " + errnoStr();
+    }
+    if (mMap) {
+      munmap(mMap, mMapSize);
+      mMap = nullptr;
+    }
+    auto *map =
+      mmap(nullptr, newSize, PROT_READ | PROT_WRITE, MAP_SHARED, mFd, 0);
+    if (map == MAP_FAILED) {
+      return "Failed to map " + mPath + ": " + errnoStr();
+    }
+    mMap     = static_cast<uint8_t *>(map);
+    mMapSize = newSize;
+    return std::nullopt;
+  }
+
+  void RawRecordingWriter::close()
+  {
+    if (mMap) {
+      munmap(mMap, mMapSize);
+      mMap = nullptr;
+    }
+    if (mFd >= 0) {
+      ::close(mFd);
+      mFd = -1;
+    }
+    mMapSize = 0;
+  }
+
+  RawRecordingReader::~RawRecordingReader()
+  {
+    if (mMap) {
+      munmap(const_cast<uint8_t *>(mMap), mSize);
+    }
+  }
+
+  auto RawRecordingReader::open(const std::string &path)
+    -> std::optional<std::string>
+  {
+    auto fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+      return "Failed to open " + path + ": " + errnoStr();
+    }
+    struct stat info {};
+    if (fstat(fd, &info) != 0 ||
+        static_cast<std::size_t>(info.st_size) < sizeof(FileHeader)) {
+      ::close(fd);
+      return path + " is not a raw recording";
+    }
+    mSize    = static_cast<std::size_t>(info.st_size);
+    auto map = mmap(nullptr, mSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED) {
+      mSize = 0;
+      return "Failed to map " + path + ": " + errnoStr();
+    }
+    mMap = static_cast<const uint8_t *>(map);
+
+    FileHeader header {};
+    std::memcpy(&header, mMap, sizeof(header));
+    if (MAGIC != std::string_view(header.magic, sizeof(header.magic)) ||
+        header.version != VERSION) {
+      return path + " is not a raw recording";
+    }
+    mFps = header.fps;
+
+    auto indexBytes = header.frameCount * sizeof(IndexRecord);
+    if (header.indexOffset == 0 || header.indexOffset > mSize ||
+        indexBytes > mSize - header.indexOffset) {
+      logger->warn("{} was not finished, rebuilding its index", path);
+      return rebuildIndex();
+    }
+    mIndex.resize(header.frameCount);
+    for (std::size_t i = 0; i < mIndex.size(); i++) {
+      IndexRecord record {};
+      std::memcpy(&record,
+                  mMap + header.indexOffset + i * sizeof(IndexRecord),
+                  sizeof(record));
+      mIndex[i] = { record.ptsUs,
+                    record.offset,
+                    static_cast<RawFrameType>(record.type) };
+    }
+    return std::nullopt;
+  }
+
+  auto RawRecordingReader::index() const noexcept
+    -> const std::vector<RawIndexEntry> &
+  {
+    return mIndex;
+  }
+
+  auto RawRecordingReader::fps() const noexcept -> uint8_t
+  {
+    return mFps;
+  }
+
+  auto RawRecordingReader::decode(std::size_t frame, VideoFrame &canvas) const
+    -> std::optional<std::string>
+  {
+    if (frame >= mIndex.size()) {
+      return "No such frame";
+    }
+    auto         offset = mIndex[frame].offset;
+    RecordHeader header {};
+    if (offset + sizeof(header) > mSize) {
+      return "Frame record out of bounds";
+    }
+    std::memcpy(&header, mMap + offset, sizeof(header));
+    auto rectBytes = std::size_t { header.rectCount } * sizeof(DirtyRect);
+    if (header.magic != RECORD_MAGIC ||
+        offset + sizeof(header) + rectBytes + header.payloadSize > mSize) {
+      return "Corrupt frame record";
+    }
+    const auto *rects   = mMap + offset + sizeof(header);
+    const auto *payload = reinterpret_cast<const char *>(rects + rectBytes);
+    auto        type    = static_cast<RawFrameType>(header.type);
+
+    canvas.ptsUs  = header.ptsUs;
+    canvas.repeat = type == RawFrameType::Repeat;
+    if (type == RawFrameType::Key) {
+      canvas.resize(PixelLayout::BGRX, header.width, header.height);
+      if (header.rawSize != canvas.bytes.size() ||
+          LZ4_decompress_safe(payload,
+                              reinterpret_cast<char *>(canvas.bytes.data()),
+                              static_cast<int>(header.payloadSize),
+                              static_cast<int>(header.rawSize)) !=
+            static_cast<int>(header.rawSize)) {
+        return "Corrupt keyframe";
+      }
+      return std::nullopt;
+    }
+    if (canvas.width != header.width || canvas.height != header.height) {
+      return "Delta frame without its keyframe";
+    }
+    if (type == RawFrameType::Repeat) {
+      return std::nullopt;
+    }
+
+    thread_local std::vector<uint8_t> packed;
+    packed.resize(header.rawSize);
+    if (LZ4_decompress_safe(payload,
+                            reinterpret_cast<char *>(packed.data()),
+                            static_cast<int>(header.payloadSize),
+                            static_cast<int>(header.rawSize)) !=
+        static_cast<int>(header.rawSize)) {
+      return "Corrupt delta frame";
+    }
+    thread_local std::vector<DirtyRect> changed;
+    changed.resize(header.rectCount);
+    std::memcpy(changed.data(), rects, rectBytes);
+    const auto *in  = packed.data();
+    const auto *end = in + packed.size();
+    for (const auto &rect : changed) {
+      auto rowBytes = static_cast<std::size_t>(rect.width) * PIXEL_SIZE;
+      if (rect.x < 0 || rect.y < 0 ||
+          static_cast<uint32_t>(rect.x) + rect.width > canvas.width ||
+          static_cast<uint32_t>(rect.y) + rect.height > canvas.height ||
+          static_cast<std::size_t>(end - in) < rowBytes * rect.height) {
+        return "Corrupt delta frame";
+      }
+      for (uint32_t y = 0; y < rect.height; y++) {
+        std::memcpy(canvas.bytes.data() +
+                      static_cast<std::size_t>(rect.y + y) * canvas.strides[0] +
+                      static_cast<std::size_t>(rect.x) * PIXEL_SIZE,
+                    in,
+                    rowBytes);
+        in += rowBytes;
+      }
+    }
+    return std::nullopt;
+  }
+
+  auto RawRecordingReader::rebuildIndex() -> std::optional<std::string>
+  {
+    mIndex.clear();
+    uint64_t offset = sizeof(FileHeader);
+    while (offset + sizeof(RecordHeader) <= mSize) {
+      RecordHeader header {};
+      std::memcpy(&header, mMap + offset, sizeof(header));
+      auto length = sizeof(header) +
+                    std::size_t { header.rectCount } * sizeof(DirtyRect) +
+                    header.payloadSize;
+      // the space reserved past the last record is zeroes
+      if (header.magic != RECORD_MAGIC || offset + length > mSize) {
+        break;
+      }
+      mIndex.push_back(
+        { header.ptsUs, offset, static_cast<RawFrameType>(header.type) });
+      offset += length;
+    }
+    if (mIndex.empty()) {
+      return std::string("The recording has no frames");
+    }
+    return std::nullopt;
+  }
+} // namespace smv::details
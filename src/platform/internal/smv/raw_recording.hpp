@@ -0,0 +1,150 @@
+#pragma once
+
+#include "frame.hpp"
+#include "tile_diff.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace smv::details {
+  /**
+   * @brief How a frame is stored in a raw recording
+   */
+  enum class RawFrameType : uint8_t
+  {
+    // the whole frame
+    Key = 1,
+    // only the rectangles that changed since the previous frame
+    Delta = 2,
+    // same pixels as the previous frame
+    Repeat = 3,
+  };
+
+  /**
+   * @brief Where to find a frame in a raw recording
+   */
+  struct RawIndexEntry
+  {
+    int64_t      ptsUs  = 0;
+    uint64_t     offset = 0;
+    RawFrameType type   = RawFrameType::Key;
+  };
+
+  /**
+   * @brief Appends BGRX frames to a raw recording, for encoding later
+   *
+   * @details The file is memory mapped and grown in large steps, so a frame
+   * is compressed straight into the page cache and never goes through a
+   * write call. Every keyframeInterval frames (or when the size changes) a
+   * whole frame is stored; the frames in between only store the tiles that
+   * changed since the frame before them (see TileDiff), and frames where
+   * nothing changed take a few bytes. Pixels are compressed with LZ4, which
+   * keeps up with memory bandwidth.
+   *
+   * Layout: a 64 byte file header, the frame records, and an index of every
+   * frame, written by finish. A recording that was not finished (e.g. the
+   * recorder crashed) can still be read: the reader rebuilds the index by
+   * walking the records. All numbers are little-endian
+   */
+  class RawRecordingWriter
+  {
+  public:
+    /**
+     * @param path the file to write. Replaced if it exists
+     * @param fps the frame rate of the capture, for the transcoder
+     * @param keyframeInterval the number of frames between whole frames
+     */
+    RawRecordingWriter(std::string path,
+                       uint8_t     fps,
+                       uint32_t    keyframeInterval);
+    RawRecordingWriter(const RawRecordingWriter &) = delete;
+    auto operator=(const RawRecordingWriter &) -> RawRecordingWriter & = delete;
+    ~RawRecordingWriter();
+
+    auto open() -> std::optional<std::string>;
+
+    /**
+     * @brief Append a frame
+     * @param frame the pixels, in blue-first order (see VideoFrame::view)
+     * @param ptsUs the presentation timestamp of the frame
+     */
+    auto write(const FrameView &frame, int64_t ptsUs)
+      -> std::optional<std::string>;
+
+    /**
+     * @brief Write the index and close the file
+     */
+    auto finish() -> std::optional<std::string>;
+
+    /**
+     * @brief the number of bytes written so far
+     */
+    auto bytes() const noexcept -> uint64_t;
+
+  private:
+    /**
+     * @brief make sure that size more bytes fit in the mapping
+     */
+    auto reserve(std::size_t size) -> std::optional<std::string>;
+    void close();
+
+    const std::string          mPath;
+    const uint8_t              mFps;
+    const uint32_t             mKeyframeInterval;
+    int                        mFd        = -1;
+    uint8_t                   *mMap       = nullptr;
+    std::size_t                mMapSize   = 0;
+    uint64_t                   mOffset    = 0;
+    uint32_t                   mSinceKey  = 0;
+    uint32_t                   mWidth     = 0;
+    uint32_t                   mHeight    = 0;
+    TileDiff                   mDiff;
+    // the pixels of the dirty rectangles, packed, before compression
+    std::vector<uint8_t>       mPacked;
+    std::vector<RawIndexEntry> mIndex;
+  };
+
+  /**
+   * @brief Reads back the frames of a raw recording
+   *
+   * @details The file is mapped read-only, so any number of frames can be
+   * decoded at the same time from different threads, each into its own
+   * canvas
+   */
+  class RawRecordingReader
+  {
+  public:
+    RawRecordingReader() = default;
+    RawRecordingReader(const RawRecordingReader &)                     = delete;
+    auto operator=(const RawRecordingReader &) -> RawRecordingReader & = delete;
+    ~RawRecordingReader();
+
+    auto open(const std::string &path) -> std::optional<std::string>;
+
+    auto index() const noexcept -> const std::vector<RawIndexEntry> &;
+    auto fps() const noexcept -> uint8_t;
+
+    /**
+     * @brief Apply a frame to a canvas
+     *
+     * @details The canvas must hold the frame before it, unless the frame is
+     * a keyframe. Frames have to be decoded in order from a keyframe
+     *
+     * @param frame the position of the frame in the index
+     * @param canvas a PixelLayout::BGRX frame, resized by keyframes
+     */
+    auto decode(std::size_t frame, VideoFrame &canvas) const
+      -> std::optional<std::string>;
+
+  private:
+    auto rebuildIndex() -> std::optional<std::string>;
+
+    const uint8_t             *mMap  = nullptr;
+    std::size_t                mSize = 0;
+    uint8_t                    mFps  = 0;
+    std::vector<RawIndexEntry> mIndex;
+  };
+} // namespace smv::details
@@ -0,0 +1,119 @@
+#include "raw_transcode.hpp"
+#include "convert.hpp"
+#include "encoder_x264.hpp"
+#include "raw_recording.hpp"
+#include "smv/log.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+namespace smv::details {
+  using smv::log::logger;
+
+  namespace {
+    struct Segment
+    {
+      // [first, last) in the index of the recording
+      std::size_t                first = 0;
+      std::size_t                last  = 0;
+      std::vector<PacketPtr>     packets;
+      std::optional<std::string> errMsg;
+    };
+
+    void encodeSegment(const RawRecordingReader &reader,
+                       Segment                  &segment,
+                       ThreadPool               &pool)
+    {
+      X264Encoder encoder(reader.fps());
+      VideoFrame  canvas;
+      VideoFrame  yuv;
+      for (auto frame = segment.first; frame < segment.last; frame++) {
+        if (auto err = reader.decode(frame, canvas)) {
+          segment.errMsg = std::move(err);
+          return;
+        }
+        // the H.264 stream has no timestamps, so a repeat is encoded like any
+        // other frame for the stream to keep its length. x264 turns it into
+        // skipped macroblocks, which cost next to nothing
+        if (!canvas.repeat || yuv.bytes.empty()) {
+          convertFrame(
+            canvas.view(), PixelLayout::I420, YuvMatrix::BT709, yuv, pool);
+        }
+        yuv.ptsUs = canvas.ptsUs;
+        auto packet = encoder.encode(yuv);
+        if (!packet) {
+          segment.errMsg = "Failed to encode frame " + std::to_string(frame);
+          return;
+        }
+        segment.packets.push_back(std::move(packet));
+      }
+    }
+  } // namespace
+
+  auto transcodeToH264(const std::string &input,
+                       const std::string &output,
+                       ThreadPool        &pool) -> std::optional<std::string>
+  {
+    if (!X264Encoder::available()) {
+      return "H.264 transcoding needs a build with x264 enabled";
+    }
+    RawRecordingReader reader;
+    if (auto err = reader.open(input)) {
+      return err;
+    }
+    const auto &index = reader.index();
+    if (index.empty() || index.front().type != RawFrameType::Key) {
+      return input + " does not start with a keyframe";
+    }
+
+    std::vector<Segment> segments;
+    for (std::size_t i = 0; i < index.size(); i++) {
+      if (index[i].type == RawFrameType::Key) {
+        if (!segments.empty()) {
+          segments.back().last = i;
+        }
+        segments.emplace_back().first = i;
+      }
+    }
+    segments.back().last = index.size();
+
+    std::ofstream file(output, std::ios::binary | std::ios::trunc);
+    if (!file) {
+      return "Failed to create " + output + ": " + std::strerror(errno);
+    }
+    logger->info("Transcoding {} ({} frames, {} segments) to {}",
+                 input,
+                 index.size(),
+                 segments.size(),
+                 output);
+
+    // the calling thread also takes a segment
+    const auto wave = pool.size() + 1;
+    for (std::size_t start = 0; start < segments.size(); start += wave) {
+      auto end = std::min(start + wave, segments.size());
+      pool.parallelFor(start, end, [&](std::size_t first, std::size_t last) {
+        for (auto i = first; i < last; i++) {
+          encodeSegment(reader, segments[i], pool);
+        }
+      });
+      for (auto i = start; i < end; i++) {
+        auto &segment = segments[i];
+        if (segment.errMsg) {
+          return segment.errMsg;
+        }
+        for (const auto &packet : segment.packets) {
+          file.write(reinterpret_cast<const char *>(packet->bytes().data()),
+                     static_cast<std::streamsize>(packet->bytes().size()));
+        }
+        segment.packets.clear();
+      }
+      if (!file) {
+        return "Failed to write " + output + ": " + std::strerror(errno);
+      }
+    }
+    return std::nullopt;
+  }
+} // namespace smv::details
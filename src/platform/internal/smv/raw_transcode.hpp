@@ -0,0 +1,26 @@
+#pragma once
+
+#include "thread_pool.hpp"
+
+#include <optional>
+#include <string>
+
+namespace smv::details {
+  /**
+   * @brief Encode a raw recording (see RawRecordingWriter) to H.264
+   *
+   * @details The recording is cut at its keyframes, and the segments are
+   * decoded and encoded in parallel, each by its own encoder. Every segment
+   * starts with an IDR frame and repeats the parameter sets, so the Annex B
+   * outputs of the segments are simply written one after the other. Only as
+   * many segments as there are workers are held in memory at once
+   *
+   * @param input the raw recording
+   * @param output where to write the H.264 stream
+   * @param pool the workers to encode on
+   * @return std::optional<std::string> an error message if it failed
+   */
+  auto transcodeToH264(const std::string &input,
+                       const std::string &output,
+                       ThreadPool        &pool) -> std::optional<std::string>;
+} // namespace smv::details
@@ -0,0 +1,168 @@
+#include "replay_buffer.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <thread>
+#include <utility>
+
+namespace smv::details {
+  namespace {
+    constexpr auto index(StreamKind stream) -> std::size_t
+    {
+      return static_cast<std::size_t>(stream);
+    }
+
+    /**
+     * @brief whether a group of pictures starts at the packet
+     */
+    auto startsGroup(const ReplayPacket &entry) -> bool
+    {
+      return entry.stream == StreamKind::Video && entry.packet->keyframe;
+    }
+  } // namespace
+
+  ReplayBuffer::ReplayBuffer(std::chrono::microseconds duration,
+                             std::size_t               maxBytes)
+    : mMaxDuration(duration)
+    , mMaxBytes(maxBytes)
+  {
+  }
+
+  void ReplayBuffer::push(StreamKind stream, PacketPtr packet)
+  {
+    if (!packet) {
+      return;
+    }
+    std::lock_guard lock(mMutex);
+    // a repeat shares the payload of the packet before it in its stream
+    auto previous = std::find_if(
+      mPackets.rbegin(), mPackets.rend(), [stream](const ReplayPacket &entry) {
+      return entry.stream == stream;
+    });
+    if (previous == mPackets.rend() ||
+        previous->packet->payload != packet->payload) {
+      mBytes += packet->bytes().size();
+    }
+    mPackets.push_back({ stream, std::move(packet) });
+    evict();
+  }
+
+  auto ReplayBuffer::snapshot(std::chrono::microseconds last) const
+    -> std::vector<ReplayPacket>
+  {
+    std::lock_guard lock(mMutex);
+    if (mPackets.empty()) {
+      return {};
+    }
+    auto since = mPackets.back().packet->ptsUs - last.count();
+    // walk back to the latest keyframe at or before the requested start
+    auto first = mPackets.end();
+    for (auto it = mPackets.begin(); it != mPackets.end(); ++it) {
+      if (startsGroup(*it)) {
+        if (it->packet->ptsUs > since && first != mPackets.end()) {
+          break;
+        }
+        first = it;
+      }
+    }
+    return { first, mPackets.end() };
+  }
+
+  auto ReplayBuffer::bytes() const -> std::size_t
+  {
+    std::lock_guard lock(mMutex);
+    return mBytes;
+  }
+
+  auto ReplayBuffer::duration() const -> std::chrono::microseconds
+  {
+    std::lock_guard lock(mMutex);
+    return std::chrono::microseconds(spanUs());
+  }
+
+  void ReplayBuffer::clear()
+  {
+    std::lock_guard lock(mMutex);
+    mPackets.clear();
+    mBytes = 0;
+  }
+
+  void ReplayBuffer::evict()
+  {
+    while (spanUs() > mMaxDuration.count() || mBytes > mMaxBytes) {
+      // the end of the first group of pictures is the next keyframe
+      auto next = std::find_if(
+        std::next(mPackets.begin()), mPackets.end(), startsGroup);
+      if (next == mPackets.end()) {
+        // a single group. Only the byte limit is allowed to cut into it
+        if (mBytes <= mMaxBytes || mPackets.size() < 2) {
+          break;
+        }
+        next = std::next(mPackets.begin());
+      }
+      // a payload is freed with the last packet that shares it
+      for (auto it = mPackets.begin(); it != next; ++it) {
+        if (!sharesNext(it)) {
+          mBytes -= it->packet->bytes().size();
+        }
+      }
+      mPackets.erase(mPackets.begin(), next);
+    }
+  }
+
+  auto ReplayBuffer::spanUs() const -> int64_t
+  {
+    if (mPackets.size() < 2) {
+      return 0;
+    }
+    return mPackets.back().packet->ptsUs - mPackets.front().packet->ptsUs;
+  }
+
+  auto ReplayBuffer::sharesNext(Packets::const_iterator it) const -> bool
+  {
+    auto next = std::find_if(
+      std::next(it), mPackets.end(), [it](const ReplayPacket &entry) {
+      return entry.stream == it->stream;
+    });
+    return next != mPackets.end() &&
+           next->packet->payload == it->packet->payload;
+  }
+
+  void writePackets(std::vector<ReplayPacket>                       packets,
+                    std::vector<MatroskaTrack>                      tracks,
+                    std::string                                     path,
+                    std::function<void(std::optional<std::string>)> callback)
+  {
+    std::thread([packets  = std::move(packets),
+                 tracks   = std::move(tracks),
+                 path     = std::move(path),
+                 callback = std::move(callback)]() mutable {
+      std::optional<std::string> errMsg;
+      std::ofstream              file(path, std::ios::binary | std::ios::trunc);
+      auto                       count = tracks.size();
+      MatroskaWriter             writer(std::move(tracks));
+      auto write = [&file](const std::vector<uint8_t> &bytes) {
+        file.write(reinterpret_cast<const char *>(bytes.data()),
+                   static_cast<std::streamsize>(bytes.size()));
+      };
+      write(writer.header());
+      for (const auto &entry : packets) {
+        if (!file) {
+          break;
+        }
+        if (index(entry.stream) < count) {
+          write(writer.add(index(entry.stream), *entry.packet));
+        }
+      }
+      write(writer.flush());
+      file.close();
+      if (!file) {
+        // streams do not say why they failed
+        errMsg = "Failed to write " + path;
+      }
+      if (callback) {
+        callback(std::move(errMsg));
+      }
+    }).detach();
+  }
+} // namespace smv::details
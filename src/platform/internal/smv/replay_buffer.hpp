@@ -0,0 +1,96 @@
+#pragma once
+
+#include "encoder.hpp"
+#include "interleaver.hpp"
+#include "matroska.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace smv::details {
+  /**
+   * @brief A packet of a replay, and the stream it belongs to
+   */
+  struct ReplayPacket
+  {
+    StreamKind stream;
+    PacketPtr  packet;
+  };
+
+  /**
+   * @brief Keeps the most recent encoded packets of a capture in memory
+   *
+   * @details The buffer is bounded both by the time span between its first
+   * and last packets, and by the number of bytes it holds. When either bound
+   * is exceeded, whole groups of pictures (a keyframe and the packets that
+   * depend on it) are dropped from the front, so the buffer always starts at a
+   * keyframe. Only a single group that is larger than the byte limit on its
+   * own is cut in the middle; snapshots then skip to the next keyframe.
+   * Packets that share a payload (repeated frames) only count its bytes once.
+   * Audio packets are pushed in pts order along with the video ones, and are
+   * dropped with the group of pictures they fall in.
+   *
+   * push only holds the lock long enough to append and evict pointers, so
+   * taking a snapshot from another thread never stalls the capture.
+   */
+  class ReplayBuffer
+  {
+  public:
+    ReplayBuffer(std::chrono::microseconds duration, std::size_t maxBytes);
+
+    void push(StreamKind stream, PacketPtr packet);
+
+    /**
+     * @brief The packets covering (at least) the last given amount of time
+     *
+     * @details The result starts at a video keyframe, which may be a bit
+     * earlier than requested. The packets are shared, not copied
+     *
+     * @param last how much of the end of the buffer to return
+     * @return std::vector<ReplayPacket> the packets, oldest first
+     */
+    auto snapshot(std::chrono::microseconds last) const
+      -> std::vector<ReplayPacket>;
+
+    auto bytes() const -> std::size_t;
+    auto duration() const -> std::chrono::microseconds;
+    void clear();
+
+  private:
+    using Packets = std::deque<ReplayPacket>;
+
+    void evict();
+    auto spanUs() const -> int64_t;
+    /**
+     * @brief whether the next packet of the same stream shares the payload
+     */
+    auto sharesNext(Packets::const_iterator it) const -> bool;
+
+    const std::chrono::microseconds mMaxDuration;
+    const std::size_t               mMaxBytes;
+    mutable std::mutex              mMutex;
+    Packets                         mPackets;
+    std::size_t                     mBytes = 0;
+  };
+
+  /**
+   * @brief Write the packets to a Matroska file on a separate thread
+   *
+   * @param packets the packets to write, oldest first
+   * @param tracks what the packets of each stream are, by StreamKind. The
+   * packets of a stream without a track are left out
+   * @param path where to write them
+   * @param callback called from the writing thread once done, with an error
+   * message if the file could not be written
+   */
+  void writePackets(std::vector<ReplayPacket>                       packets,
+                    std::vector<MatroskaTrack>                      tracks,
+                    std::string                                     path,
+                    std::function<void(std::optional<std::string>)> callback);
+} // namespace smv::details
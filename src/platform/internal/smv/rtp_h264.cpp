@@ -0,0 +1,100 @@
+#include "rtp_h264.hpp"
+
+#include <algorithm>
+
+namespace smv::details {
+  namespace {
+    constexpr uint8_t NAL_TYPE_MASK = 0x1F;
+    constexpr uint8_t NAL_NRI_MASK  = 0x60;
+    constexpr uint8_t NAL_TYPE_FU_A = 28;
+    constexpr uint8_t FU_START      = 0x80;
+    constexpr uint8_t FU_END        = 0x40;
+    constexpr uint8_t RTP_VERSION   = 0x80;
+    constexpr uint8_t RTP_MARKER    = 0x80;
+  } // namespace
+
+  H264Packetizer::H264Packetizer(uint32_t ssrc, std::size_t mtu)
+    : mSsrc(ssrc)
+    , mMtu(std::max<std::size_t>(mtu, HEADER_SIZE + 3))
+  {
+  }
+
+  auto H264Packetizer::packetize(const EncodedPacket &packet)
+    -> const std::vector<std::basic_string_view<uint8_t>> &
+  {
+    mBuffer.clear();
+    mOffsets.clear();
+    mPackets.clear();
+
+    // pts can be negative if the capture clock was reset, RTP only needs the
+    // timestamps to increase modulo 2^32
+    auto timestamp = static_cast<uint32_t>(
+      packet.ptsUs * static_cast<int64_t>(CLOCK_RATE) / 1'000'000);
+    const auto maxPayload = mMtu - HEADER_SIZE;
+
+    // count the nal units first, so that the marker bit can be placed
+    std::size_t nalCount = 0;
+    forEachNal(packet.bytes().data(),
+               packet.bytes().size(),
+               [&nalCount](const uint8_t *, std::size_t) { nalCount++; });
+
+    std::size_t nalIndex = 0;
+    forEachNal(packet.bytes().data(),
+               packet.bytes().size(),
+               [&](const uint8_t *nal, std::size_t size) {
+      bool last = ++nalIndex == nalCount;
+      if (size <= maxPayload) {
+        writeHeader(timestamp, last);
+        mBuffer.insert(mBuffer.end(), nal, nal + size);
+        return;
+      }
+      // FU-A: the nal header is replaced by an indicator and a fu header
+      uint8_t indicator = (nal[0] & NAL_NRI_MASK) | NAL_TYPE_FU_A;
+      uint8_t type      = nal[0] & NAL_TYPE_MASK;
+      auto    chunk     = maxPayload - 2;
+      for (std::size_t pos = 1; pos < size; pos += chunk) {
+        auto    length = std::min(chunk, size - pos);
+        bool    end    = pos + length == size;
+        uint8_t header = type;
+        if (pos == 1) {
+          header |= FU_START;
+        }
+        if (end) {
+          header |= FU_END;
+        }
+        writeHeader(timestamp, last && end);
+        mBuffer.push_back(indicator);
+        mBuffer.push_back(header);
+        mBuffer.insert(mBuffer.end(), nal + pos, nal + pos + length);
+      }
+    });
+
+    mOffsets.push_back(mBuffer.size());
+    for (std::size_t i = 0; i + 1 < mOffsets.size(); i++) {
+      mPackets.emplace_back(mBuffer.data() + mOffsets[i],
+                            mOffsets[i + 1] - mOffsets[i]);
+    }
+    return mPackets;
+  }
+
+  void H264Packetizer::writeHeader(uint32_t timestamp, bool marker)
+  {
+    mOffsets.push_back(mBuffer.size());
+    uint8_t header[HEADER_SIZE] = { // NOLINT
+      RTP_VERSION,
+      static_cast<uint8_t>(PAYLOAD_TYPE | (marker ? RTP_MARKER : 0)),
+      static_cast<uint8_t>(mSequence >> 8),
+      static_cast<uint8_t>(mSequence),
+      static_cast<uint8_t>(timestamp >> 24),
+      static_cast<uint8_t>(timestamp >> 16),
+      static_cast<uint8_t>(timestamp >> 8),
+      static_cast<uint8_t>(timestamp),
+      static_cast<uint8_t>(mSsrc >> 24),
+      static_cast<uint8_t>(mSsrc >> 16),
+      static_cast<uint8_t>(mSsrc >> 8),
+      static_cast<uint8_t>(mSsrc),
+    };
+    mSequence++;
+    mBuffer.insert(mBuffer.end(), header, header + HEADER_SIZE);
+  }
+} // namespace smv::details
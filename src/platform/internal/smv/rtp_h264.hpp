@@ -0,0 +1,86 @@
+#pragma once
+
+#include "encoder.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace smv::details {
+  /**
+   * @brief Splits H.264 access units into RTP packets, as per RFC 6184
+   *
+   * @details NAL units that fit in a packet are sent as is (single NAL unit
+   * mode), larger ones are fragmented into FU-A packets. The marker bit is set
+   * on the last packet of each access unit.
+   * The packets are stored back to back in a buffer that is reused between
+   * calls, so a steady stream does not allocate
+   */
+  class H264Packetizer
+  {
+  public:
+    static constexpr uint8_t     PAYLOAD_TYPE = 96;
+    static constexpr uint32_t    CLOCK_RATE   = 90'000;
+    static constexpr std::size_t DEFAULT_MTU  = 1400;
+    static constexpr std::size_t HEADER_SIZE  = 12;
+
+    explicit H264Packetizer(uint32_t ssrc, std::size_t mtu = DEFAULT_MTU);
+
+    /**
+     * @brief Packetize an access unit in Annex B format
+     *
+     * @return the RTP packets, views into a buffer that is only valid until
+     * the next call
+     */
+    auto packetize(const EncodedPacket &packet)
+      -> const std::vector<std::basic_string_view<uint8_t>> &;
+
+    /**
+     * @brief Call func with every NAL unit (without its start code) of an
+     * Annex B byte stream
+     */
+    template<typename F>
+    static void forEachNal(const uint8_t *data, std::size_t size, F &&func);
+
+  private:
+    void writeHeader(uint32_t timestamp, bool marker);
+
+    const uint32_t                               mSsrc;
+    const std::size_t                            mMtu;
+    uint16_t                                     mSequence = 0;
+    std::vector<uint8_t>                         mBuffer;
+    std::vector<std::size_t>                     mOffsets;
+    std::vector<std::basic_string_view<uint8_t>> mPackets;
+  };
+
+  template<typename F>
+  void H264Packetizer::forEachNal(const uint8_t *data,
+                                  std::size_t    size,
+                                  F            &&func)
+  {
+    // find the first byte after each 00 00 01 start code. A 4 byte start code
+    // is the same with an extra leading zero, which is trimmed from the NAL
+    // before it
+    auto nextStart = [data, size](std::size_t from) {
+      for (auto i = from; i + 3 <= size; i++) {
+        if (data[i] == 0 && data[i + 1] == 0 && data[i + 2] == 1) {
+          return i + 3;
+        }
+      }
+      return size;
+    };
+    auto start = nextStart(0);
+    while (start < size) {
+      auto next = nextStart(start);
+      auto end  = next == size ? size : next - 3;
+      while (end > start && data[end - 1] == 0) {
+        end--;
+      }
+      if (end > start) {
+        func(data + start, end - start);
+      }
+      start = next;
+    }
+  }
+} // namespace smv::details
@@ -0,0 +1,375 @@
+#include "rtsp_server.hpp"
+#include "smv/log.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <random>
+#include <sstream>
+#include <utility>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace smv::details {
+  using smv::log::logger;
+
+  namespace {
+    // beyond this, a tcp client is considered too slow and skips frames
+    constexpr std::size_t MAX_PENDING_BYTES = std::size_t { 2 } << 20;
+    constexpr std::size_t MAX_REQUEST_BYTES = 16 << 10;
+    constexpr auto        SESSION_TIMEOUT   = 60;
+
+    /**
+     * @brief the value of a header in a request, case insensitive
+     */
+    auto header(std::string_view request, std::string_view name)
+      -> std::string_view
+    {
+      std::size_t pos = 0;
+      while ((pos = request.find("\r\n", pos)) != std::string_view::npos) {
+        pos += 2;
+        auto line = request.substr(pos, request.find("\r\n", pos) - pos);
+        if (line.size() > name.size() && line[name.size()] == ':' &&
+            std::equal(name.begin(),
+                       name.end(),
+                       line.begin(),
+                       [](char a, char b) {
+          return std::tolower(a) == std::tolower(b);
+        })) {
+          auto value = line.substr(name.size() + 1);
+          value.remove_prefix(std::min(value.find_first_not_of(' '),
+                                       value.size()));
+          return value;
+        }
+      }
+      return {};
+    }
+
+    /**
+     * @brief the session id of a request, without its parameters
+     */
+    auto session(std::string_view request) -> std::string_view
+    {
+      auto value = header(request, "Session");
+      return value.substr(0, value.find(';'));
+    }
+
+    /**
+     * @brief parse "key=a-b" out of a Transport header
+     */
+    auto portRange(std::string_view transport, std::string_view key)
+      -> std::optional<std::pair<uint16_t, uint16_t>>
+    {
+      auto pos = transport.find(key);
+      if (pos == std::string_view::npos) {
+        return std::nullopt;
+      }
+      const auto *first = transport.data() + pos + key.size();
+      const auto *end   = transport.data() + transport.size();
+      uint16_t    low   = 0;
+      uint16_t    high  = 0;
+      auto        res   = std::from_chars(first, end, low);
+      if (res.ec != std::errc {}) {
+        return std::nullopt;
+      }
+      high = low + 1;
+      if (res.ptr < end && *res.ptr == '-') {
+        std::from_chars(res.ptr + 1, end, high);
+      }
+      return std::make_pair(low, high);
+    }
+  } // namespace
+
+  struct RtspServer::Client: TcpClient
+  {
+    std::string session;
+    // whether a transport was set up, which PLAY needs
+    bool        setUp        = false;
+    bool        playing      = false;
+    bool        waitKeyframe = true;
+    bool        interleaved  = false;
+    uint8_t     channel      = 0;
+    sockaddr_in rtpAddress {};
+  };
+
+  RtspServer::RtspServer(ServerUrl url)
+    : TcpServer(std::move(url), "rtsp", "RTSP")
+    , mPacketizer(std::random_device {}())
+  {
+  }
+
+  RtspServer::~RtspServer()
+  {
+    stop();
+  }
+
+  auto RtspServer::prepare() -> std::optional<std::string>
+  {
+    // a single socket sends rtp to every udp client, from the same interface
+    auto      address = localAddress();
+    socklen_t length  = sizeof(address);
+    auto     *addr    = reinterpret_cast<sockaddr *>(&address);
+    address.sin_port  = 0;
+    mUdpFd            = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (mUdpFd < 0 || bind(mUdpFd, addr, sizeof(address)) < 0 ||
+        getsockname(mUdpFd, addr, &length) < 0) {
+      return "Failed to open the RTP socket: " + errnoStr();
+    }
+    mUdpPort = ntohs(address.sin_port);
+    return std::nullopt;
+  }
+
+  void RtspServer::stop()
+  {
+    TcpServer::stop();
+    std::lock_guard _(mMutex);
+    mViewers = 0;
+    if (mUdpFd >= 0) {
+      close(mUdpFd);
+      mUdpFd = -1;
+    }
+  }
+
+  void RtspServer::send(const EncodedPacket &packet)
+  {
+    std::lock_guard _(mMutex);
+    if (mViewers == 0) {
+      return;
+    }
+    const auto &rtpPackets = mPacketizer.packetize(packet);
+    for (auto &entry : mClients) {
+      auto *client = static_cast<Client *>(entry.get());
+      if (!client->playing || client->closing ||
+          (client->waitKeyframe && !packet.keyframe)) {
+        continue;
+      }
+      client->waitKeyframe = false;
+      if (!client->interleaved) {
+        for (const auto &rtp : rtpPackets) {
+          // a full socket buffer simply drops the packet, as udp would
+          sendto(mUdpFd,
+                 rtp.data(),
+                 rtp.size(),
+                 MSG_DONTWAIT | MSG_NOSIGNAL,
+                 reinterpret_cast<const sockaddr *>(&client->rtpAddress),
+                 sizeof(client->rtpAddress));
+        }
+        continue;
+      }
+      if (client->output.size() > MAX_PENDING_BYTES) {
+        client->waitKeyframe = true;
+        continue;
+      }
+      for (const auto &rtp : rtpPackets) {
+        // RFC 2326 section 10.12: '$', channel, 16-bit length, packet
+        client->output.push_back('$');
+        client->output.push_back(static_cast<char>(client->channel));
+        client->output.push_back(static_cast<char>(rtp.size() >> 8));
+        client->output.push_back(static_cast<char>(rtp.size()));
+        client->output.append(reinterpret_cast<const char *>(rtp.data()),
+                              rtp.size());
+      }
+      if (!flush(*client)) {
+        client->closing = true;
+      }
+    }
+  }
+
+  auto RtspServer::viewers() const -> std::size_t
+  {
+    std::lock_guard _(mMutex);
+    return mViewers;
+  }
+
+  void RtspServer::onViewerJoined(std::function<void()> callback)
+  {
+    std::lock_guard _(mMutex);
+    mViewerJoined = std::move(callback);
+  }
+
+  void RtspServer::polled()
+  {
+    std::function<void()> joined;
+    {
+      std::lock_guard _(mMutex);
+      mViewers = static_cast<std::size_t>(std::count_if(
+        mClients.begin(), mClients.end(), [](const auto &entry) {
+        const auto &client = static_cast<const Client &>(*entry);
+        return client.playing && !client.closing;
+      }));
+      if (std::exchange(mJoined, false)) {
+        joined = mViewerJoined;
+      }
+    }
+    if (joined) {
+      joined();
+    }
+  }
+
+  auto RtspServer::newClient() -> std::unique_ptr<TcpClient>
+  {
+    return std::make_unique<Client>();
+  }
+
+  auto RtspServer::handle(TcpClient &entry) -> bool
+  {
+    auto &client = static_cast<Client &>(entry);
+    for (;;) {
+      // interleaved RTCP from the client. We have no use for it
+      if (!client.input.empty() && client.input[0] == '$') {
+        if (client.input.size() < 4) {
+          break;
+        }
+        auto length = (static_cast<uint8_t>(client.input[2]) << 8 |
+                       static_cast<uint8_t>(client.input[3])) +
+                      4U;
+        if (client.input.size() < length) {
+          break;
+        }
+        client.input.erase(0, length);
+        continue;
+      }
+      auto end = client.input.find("\r\n\r\n");
+      if (end == std::string::npos) {
+        return client.input.size() < MAX_REQUEST_BYTES;
+      }
+      auto request = client.input.substr(0, end + 2);
+      client.input.erase(0, end + 4);
+      if (!respond(client, request)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  auto RtspServer::respond(Client &client, std::string_view request) -> bool
+  {
+    auto cseq = header(request, "CSeq");
+
+    std::string status  = "200 OK";
+    std::string headers;
+    std::string body;
+
+    // METHOD url RTSP/1.0
+    auto line = request.substr(0, request.find("\r\n"));
+    auto gap  = line.find(' ');
+    if (gap == std::string_view::npos) {
+      logger->warn("Malformed RTSP request line: {}", line);
+      return reply(client, "400 Bad Request", cseq, headers, body);
+    }
+    auto method = line.substr(0, gap);
+    auto url    = line.substr(gap + 1);
+    url         = url.substr(0, url.find(' '));
+
+    // rtsp://host:port/path[/trackID=0] or just the path
+    auto path = url;
+    if (auto pos = path.find("://"); pos != std::string_view::npos) {
+      path = path.substr(pos + 3);
+      path = path.substr(std::min(path.find('/'), path.size()));
+    }
+    auto knownPath = path.substr(0, mUrl.path.size()) == mUrl.path ||
+                     method == "OPTIONS";
+
+    if (!knownPath) {
+      status = "404 Not Found";
+    } else if (method == "OPTIONS") {
+      headers = "Public: OPTIONS, DESCRIBE, SETUP, PLAY, GET_PARAMETER, "
+                "TEARDOWN\r\n";
+    } else if (method == "DESCRIBE") {
+      body    = describe();
+      headers = "Content-Base: " + std::string(url) + "/\r\n" +
+                "Content-Type: application/sdp\r\n";
+    } else if (method == "SETUP") {
+      auto transport = header(request, "Transport");
+      if (transport.find("RTP/AVP/TCP") != std::string_view::npos) {
+        auto channels      = portRange(transport, "interleaved=");
+        client.interleaved = true;
+        client.channel     = channels ? channels->first : 0;
+        headers = "Transport: RTP/AVP/TCP;unicast;interleaved=" +
+                  std::to_string(client.channel) + "-" +
+                  std::to_string(client.channel + 1) + "\r\n";
+      } else if (auto ports = portRange(transport, "client_port=")) {
+        client.interleaved         = false;
+        client.rtpAddress          = client.address;
+        client.rtpAddress.sin_port = htons(ports->first);
+        headers = "Transport: RTP/AVP;unicast;client_port=" +
+                  std::to_string(ports->first) + "-" +
+                  std::to_string(ports->second) +
+                  ";server_port=" + std::to_string(mUdpPort) + "\r\n";
+      } else {
+        status = "461 Unsupported Transport";
+      }
+      // a rejected transport does not open a session
+      if (status == "200 OK") {
+        client.setUp = true;
+        if (client.session.empty()) {
+          client.session = std::to_string(std::random_device {}());
+        }
+        headers += "Session: " + client.session +
+                   ";timeout=" + std::to_string(SESSION_TIMEOUT) + "\r\n";
+      }
+    } else if (method == "PLAY" && !client.setUp) {
+      status = "455 Method Not Valid in This State";
+    } else if (method == "PLAY" && session(request) != client.session) {
+      status = "454 Session Not Found";
+    } else if (method == "PLAY") {
+      mJoined             = mJoined || !client.playing;
+      client.playing      = true;
+      client.waitKeyframe = true;
+      headers = "Session: " + client.session + "\r\nRange: npt=0.000-\r\n";
+      logger->info("RTSP client {} started playing",
+                   inet_ntoa(client.address.sin_addr));
+    } else if (method == "GET_PARAMETER") {
+      headers = "Session: " + client.session + "\r\n";
+    } else if (method == "TEARDOWN") {
+      client.playing = false;
+      client.closing = true;
+      headers        = "Session: " + client.session + "\r\n";
+    } else {
+      status = "501 Not Implemented";
+    }
+
+    return reply(client, status, cseq, headers, body);
+  }
+
+  auto RtspServer::reply(Client            &client,
+                         std::string_view   status,
+                         std::string_view   cseq,
+                         const std::string &headers,
+                         const std::string &body) -> bool
+  {
+    std::ostringstream response;
+    response << "RTSP/1.0 " << status << "\r\n"
+             << "CSeq: " << cseq << "\r\n"
+             << "Server: ShareMyView\r\n"
+             << headers;
+    if (!body.empty()) {
+      response << "Content-Length: " << body.size() << "\r\n";
+    }
+    response << "\r\n" << body;
+    client.output += response.str();
+    return flush(client);
+  }
+
+  auto RtspServer::describe() const -> std::string
+  {
+    std::ostringstream sdp;
+    sdp << "v=0\r\n"
+        << "o=- 0 0 IN IP4 " << mUrl.host << "\r\n"
+        << "s=ShareMyView\r\n"
+        << "c=IN IP4 0.0.0.0\r\n"
+        << "t=0 0\r\n"
+        << "a=control:*\r\n"
+        << "m=video 0 RTP/AVP " << +H264Packetizer::PAYLOAD_TYPE << "\r\n"
+        << "a=rtpmap:" << +H264Packetizer::PAYLOAD_TYPE << " H264/"
+        << H264Packetizer::CLOCK_RATE << "\r\n"
+        // parameter sets are sent in band, before every keyframe
+        << "a=fmtp:" << +H264Packetizer::PAYLOAD_TYPE
+        << " packetization-mode=1\r\n"
+        << "a=control:trackID=0\r\n";
+    return sdp.str();
+  }
+} // namespace smv::details
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "encoder.hpp"
+#include "net.hpp"
+#include "rtp_h264.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace smv::details {
+  constexpr uint16_t DEFAULT_RTSP_PORT = 8554;
+
+  /**
+   * @brief A minimal RTSP server that publishes a single H.264 stream
+   *
+   * @details Clients are served from one encode: every access unit given to
+   * send is packetized once (see H264Packetizer), and the same RTP packets are
+   * sent to every client that is playing, over UDP or interleaved in the RTSP
+   * connection (RTP/AVP/TCP), whichever the client asks for.
+   * A client that joins, or falls so far behind that its connection buffer
+   * fills up, skips ahead to the next keyframe rather than having frames
+   * queued for it.
+   *
+   * The RTSP connections are handled by TcpServer. Only OPTIONS, DESCRIBE,
+   * SETUP, PLAY, GET_PARAMETER and TEARDOWN are supported, which is enough
+   * for ffplay, VLC and gstreamer's rtspsrc
+   */
+  class RtspServer: public TcpServer
+  {
+  public:
+    explicit RtspServer(ServerUrl url);
+    ~RtspServer() override;
+
+    void stop() override;
+
+    /**
+     * @brief Send an access unit to every client that is playing
+     */
+    void send(const EncodedPacket &packet);
+
+    /**
+     * @brief The number of clients that are playing
+     */
+    auto viewers() const -> std::size_t;
+
+    /**
+     * @brief Called on the server thread when a client starts playing
+     * @details The encoder should produce a keyframe soon, since the client
+     * cannot display anything until it gets one
+     */
+    void onViewerJoined(std::function<void()> callback);
+
+  protected:
+    auto prepare() -> std::optional<std::string> override;
+    auto newClient() -> std::unique_ptr<TcpClient> override;
+    auto handle(TcpClient &client) -> bool override;
+    void polled() override;
+
+  private:
+    struct Client;
+
+    auto respond(Client &client, std::string_view request) -> bool;
+    auto reply(Client            &client,
+               std::string_view   status,
+               std::string_view   cseq,
+               const std::string &headers,
+               const std::string &body) -> bool;
+    auto describe() const -> std::string;
+
+    int                   mUdpFd   = -1;
+    uint16_t              mUdpPort = 0;
+    std::size_t           mViewers = 0;
+    // a client started playing since the last poll
+    bool                  mJoined = false;
+    H264Packetizer        mPacketizer;
+    std::function<void()> mViewerJoined;
+  };
+} // namespace smv::details
@@ -0,0 +1,289 @@
+#include "scale.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include <assert.hpp>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace smv::details {
+  namespace {
+    constexpr auto ROWS_PER_TASK   = 16;
+    constexpr auto BYTES_PER_PIXEL = 4U;
+    // bilinear weights are 8-bit fixed point
+    constexpr auto WEIGHT_ONE = 256U;
+
+    inline auto load32(const uint8_t *pixel) -> uint32_t
+    {
+      uint32_t value = 0;
+      std::memcpy(&value, pixel, sizeof(value));
+      return value;
+    }
+
+    /**
+     * @brief halve both dimensions, which is what most 4K -> 1080p captures
+     * need. The vector path averages 2x2 blocks of 8 pixels at a time
+     */
+    void halveRows(const FrameView &src,
+                   VideoFrame      &dst,
+                   std::size_t      first,
+                   std::size_t      last)
+    {
+      for (auto oy = first; oy < last; oy++) {
+        const auto *rowA = src.row(static_cast<uint32_t>(oy * 2));
+        const auto *rowB = src.row(static_cast<uint32_t>(oy * 2 + 1));
+        auto       *out  = dst.plane(0) + oy * dst.strides[0];
+        uint32_t    ox   = 0;
+#if defined(__SSE2__)
+        for (; ox + 4 <= dst.width; ox += 4) {
+          const auto *inA = reinterpret_cast<const __m128i *>(rowA + ox * 8);
+          const auto *inB = reinterpret_cast<const __m128i *>(rowB + ox * 8);
+          auto v0 = _mm_avg_epu8(_mm_loadu_si128(inA), _mm_loadu_si128(inB));
+          auto v1 =
+            _mm_avg_epu8(_mm_loadu_si128(inA + 1), _mm_loadu_si128(inB + 1));
+          v0 = _mm_avg_epu8(v0, _mm_srli_si128(v0, 4));
+          v1 = _mm_avg_epu8(v1, _mm_srli_si128(v1, 4));
+          v0 = _mm_shuffle_epi32(v0, _MM_SHUFFLE(3, 1, 2, 0));
+          v1 = _mm_shuffle_epi32(v1, _MM_SHUFFLE(3, 1, 2, 0));
+          _mm_storeu_si128(reinterpret_cast<__m128i *>(out + ox * 4),
+                           _mm_unpacklo_epi64(v0, v1));
+        }
+#endif
+        for (; ox < dst.width; ox++) {
+          for (uint32_t c = 0; c < BYTES_PER_PIXEL; c++) {
+            auto sum = rowA[ox * 8 + c] + rowA[ox * 8 + 4 + c] +
+                       rowB[ox * 8 + c] + rowB[ox * 8 + 4 + c];
+            out[ox * 4 + c] = static_cast<uint8_t>((sum + 2) / 4);
+          }
+        }
+      }
+    }
+
+    /**
+     * @brief average every source pixel that falls within an output pixel
+     * @param xStart the first source column of each output column, followed
+     * by the source width
+     */
+    void boxRows(const FrameView             &src,
+                 VideoFrame                  &dst,
+                 const std::vector<uint32_t> &xStart,
+                 std::size_t                  first,
+                 std::size_t                  last)
+    {
+      for (auto oy = first; oy < last; oy++) {
+        auto y0 = static_cast<uint32_t>(oy * src.height / dst.height);
+        auto y1 = std::max(
+          static_cast<uint32_t>((oy + 1) * src.height / dst.height), y0 + 1);
+        auto *out = dst.plane(0) + oy * dst.strides[0];
+
+        for (uint32_t ox = 0; ox < dst.width; ox++) {
+          auto  x0    = xStart[ox];
+          auto  x1    = std::max(xStart[ox + 1], x0 + 1);
+          float scale = 1.0F / static_cast<float>((x1 - x0) * (y1 - y0));
+#if defined(__SSE2__)
+          const auto zero = _mm_setzero_si128();
+          auto       acc  = _mm_setzero_si128();
+          for (auto y = y0; y < y1; y++) {
+            const auto *pixel = src.row(y) + x0 * BYTES_PER_PIXEL;
+            for (auto x = x0; x < x1; x++, pixel += BYTES_PER_PIXEL) {
+              auto px = _mm_cvtsi32_si128(static_cast<int>(load32(pixel)));
+              px      = _mm_unpacklo_epi16(_mm_unpacklo_epi8(px, zero), zero);
+              acc     = _mm_add_epi32(acc, px);
+            }
+          }
+          auto avg = _mm_cvtps_epi32(
+            _mm_mul_ps(_mm_cvtepi32_ps(acc), _mm_set1_ps(scale)));
+          avg = _mm_packs_epi32(avg, avg);
+          avg = _mm_packus_epi16(avg, avg);
+          auto value = static_cast<uint32_t>(_mm_cvtsi128_si32(avg));
+          std::memcpy(out + ox * BYTES_PER_PIXEL, &value, sizeof(value));
+#else
+          uint32_t sums[BYTES_PER_PIXEL] = {}; // NOLINT
+          for (auto y = y0; y < y1; y++) {
+            const auto *pixel = src.row(y) + x0 * BYTES_PER_PIXEL;
+            for (auto x = x0; x < x1; x++, pixel += BYTES_PER_PIXEL) {
+              for (uint32_t c = 0; c < BYTES_PER_PIXEL; c++) {
+                sums[c] += pixel[c];
+              }
+            }
+          }
+          for (uint32_t c = 0; c < BYTES_PER_PIXEL; c++) {
+            out[ox * BYTES_PER_PIXEL + c] =
+              static_cast<uint8_t>(static_cast<float>(sums[c]) * scale + 0.5F);
+          }
+#endif
+        }
+      }
+    }
+
+    struct Sample
+    {
+      uint32_t index;  // the first of the two source pixels
+      uint32_t next;   // the second source pixel, clamped to the edge
+      uint16_t weight; // the weight of the second pixel
+    };
+
+    /**
+     * @brief map each output pixel to the source pixels it interpolates
+     * @details the centers of the pixels are aligned, as most scalers do
+     */
+    auto bilinearSamples(uint32_t srcLength, uint32_t dstLength)
+      -> std::vector<Sample>
+    {
+      std::vector<Sample> samples(dstLength);
+      const auto          step =
+        (static_cast<uint64_t>(srcLength) << 16) / dstLength; // 16.16
+      for (uint32_t i = 0; i < dstLength; i++) {
+        auto pos =
+          static_cast<int64_t>(i * step + step / 2) - (int64_t { 1 } << 15);
+        pos        = std::max<int64_t>(pos, 0);
+        auto index = std::min(static_cast<uint32_t>(pos >> 16), srcLength - 1);
+        samples[i] = { index,
+                       std::min(index + 1, srcLength - 1),
+                       static_cast<uint16_t>((pos & 0xFFFF) >> 8) };
+      }
+      return samples;
+    }
+
+    void bilinearRows(const FrameView           &src,
+                      VideoFrame                &dst,
+                      const std::vector<Sample> &xSamples,
+                      const std::vector<Sample> &ySamples,
+                      std::size_t                first,
+                      std::size_t                last)
+    {
+      for (auto oy = first; oy < last; oy++) {
+        const auto &ys  = ySamples[oy];
+        const auto *top = src.row(ys.index);
+        const auto *bot = src.row(ys.next);
+        auto       *out = dst.plane(0) + oy * dst.strides[0];
+        uint32_t    ox  = 0;
+#if defined(__SSE2__)
+        const auto zero = _mm_setzero_si128();
+        const auto wy   = _mm_set1_epi16(static_cast<int16_t>(ys.weight));
+        const auto iwy  = _mm_set1_epi16(
+          static_cast<int16_t>(WEIGHT_ONE - ys.weight));
+        // load the given source pixel for two adjacent output pixels
+        auto pair = [zero](const uint8_t *row, uint32_t a, uint32_t b) {
+          auto px = _mm_unpacklo_epi32(
+            _mm_cvtsi32_si128(
+              static_cast<int>(load32(row + a * BYTES_PER_PIXEL))),
+            _mm_cvtsi32_si128(
+              static_cast<int>(load32(row + b * BYTES_PER_PIXEL))));
+          return _mm_unpacklo_epi8(px, zero);
+        };
+        // (a * (256 - w) + b * w) / 256 always fits in unsigned 16 bits
+        auto lerp = [](__m128i a, __m128i b, __m128i weight, __m128i inverse) {
+          return _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(a, inverse),
+                                              _mm_mullo_epi16(b, weight)),
+                                8);
+        };
+        for (; ox + 2 <= dst.width; ox += 2) {
+          const auto &s0 = xSamples[ox];
+          const auto &s1 = xSamples[ox + 1];
+          auto        wx = _mm_set_epi16(static_cast<int16_t>(s1.weight),
+                                  static_cast<int16_t>(s1.weight),
+                                  static_cast<int16_t>(s1.weight),
+                                  static_cast<int16_t>(s1.weight),
+                                  static_cast<int16_t>(s0.weight),
+                                  static_cast<int16_t>(s0.weight),
+                                  static_cast<int16_t>(s0.weight),
+                                  static_cast<int16_t>(s0.weight));
+          auto        iwx = _mm_sub_epi16(
+            _mm_set1_epi16(static_cast<int16_t>(WEIGHT_ONE)), wx);
+
+          auto upper = lerp(pair(top, s0.index, s1.index),
+                            pair(top, s0.next, s1.next),
+                            wx,
+                            iwx);
+          auto lower = lerp(pair(bot, s0.index, s1.index),
+                            pair(bot, s0.next, s1.next),
+                            wx,
+                            iwx);
+          auto value = lerp(upper, lower, wy, iwy);
+          _mm_storel_epi64(
+            reinterpret_cast<__m128i *>(out + ox * BYTES_PER_PIXEL),
+            _mm_packus_epi16(value, value));
+        }
+#endif
+        for (; ox < dst.width; ox++) {
+          const auto &xs = xSamples[ox];
+          for (uint32_t c = 0; c < BYTES_PER_PIXEL; c++) {
+            auto upper = (top[xs.index * BYTES_PER_PIXEL + c] *
+                            (WEIGHT_ONE - xs.weight) +
+                          top[xs.next * BYTES_PER_PIXEL + c] * xs.weight) >>
+                         8;
+            auto lower = (bot[xs.index * BYTES_PER_PIXEL + c] *
+                            (WEIGHT_ONE - xs.weight) +
+                          bot[xs.next * BYTES_PER_PIXEL + c] * xs.weight) >>
+                         8;
+            out[ox * BYTES_PER_PIXEL + c] = static_cast<uint8_t>(
+              (upper * (WEIGHT_ONE - ys.weight) + lower * ys.weight) >> 8);
+          }
+        }
+      }
+    }
+  } // namespace
+
+  auto scaleFrame(const FrameView &src,
+                  Size             size,
+                  ScaleFilter      filter,
+                  VideoFrame      &dst,
+                  ThreadPool      &pool) -> FrameView
+  {
+    ASSERT(/* NOLINT */
+           size.w > 0 && size.h > 0 && size.w <= src.width &&
+             size.h <= src.height,
+           "only downscaling is supported",
+           size.w,
+           size.h);
+
+    dst.resize(PixelLayout::BGRX, size.w, size.h);
+
+    if (filter == ScaleFilter::Box && src.width == size.w * 2 &&
+        src.height == size.h * 2) {
+      pool.parallelFor(
+        0,
+        size.h,
+        [&](std::size_t first, std::size_t last) {
+        halveRows(src, dst, first, last);
+      },
+        ROWS_PER_TASK);
+    } else if (filter == ScaleFilter::Box) {
+      std::vector<uint32_t> xStart(size.w + 1);
+      for (uint32_t ox = 0; ox <= size.w; ox++) {
+        xStart[ox] = static_cast<uint32_t>(static_cast<uint64_t>(ox) *
+                                           src.width / size.w);
+      }
+      pool.parallelFor(
+        0,
+        size.h,
+        [&](std::size_t first, std::size_t last) {
+        boxRows(src, dst, xStart, first, last);
+      },
+        ROWS_PER_TASK);
+    } else {
+      auto xSamples = bilinearSamples(src.width, size.w);
+      auto ySamples = bilinearSamples(src.height, size.h);
+      pool.parallelFor(
+        0,
+        size.h,
+        [&](std::size_t first, std::size_t last) {
+        bilinearRows(src, dst, xSamples, ySamples, first, last);
+      },
+        ROWS_PER_TASK);
+    }
+
+    return { dst.bytes.data(),
+             size.w,
+             size.h,
+             dst.strides[0],
+             src.msbFirst,
+             src.hasAlpha };
+  }
+} // namespace smv::details
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "frame.hpp"
+#include "smv/record.hpp"
+#include "thread_pool.hpp"
+
+namespace smv::details {
+  /**
+   * @brief Scale a raw capture down to the given size
+   *
+   * @details The output keeps the 32-bit pixel layout (and byte order) of the
+   * source, so it can be handed to anything that accepts a raw capture. Rows
+   * of the output are spread over the thread pool, and the source is read in
+   * place, so it can be the capture buffer itself.
+   *
+   * @param src the raw capture
+   * @param size the size of the output. Must not be larger than src
+   * @param filter how the source pixels are combined
+   * @param dst where the scaled pixels are stored. It is resized as needed
+   * @param pool the thread pool to run the scaling on
+   * @return FrameView a view of the scaled pixels in dst
+   */
+  auto scaleFrame(const FrameView &src,
+                  Size             size,
+                  ScaleFilter      filter,
+                  VideoFrame      &dst,
+                  ThreadPool      &pool = ThreadPool::shared()) -> FrameView;
+} // namespace smv::details
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+namespace smv::details {
+  /**
+   * @brief A fixed size, lock-free ring buffer for one producer and one
+   * consumer thread
+   *
+   * @details Meant to move samples off a real-time audio thread: all the
+   * memory is allocated up front, and neither side ever blocks or allocates.
+   * When the ring is full, write accepts fewer items than it was given, and
+   * it is up to the producer to count them as lost.
+   * The read and write positions live on separate cache lines, so the two
+   * threads do not slow each other down
+   */
+  template<typename T>
+  class SpscRing
+  {
+  public:
+    /**
+     * @param capacity the minimum number of items the ring holds. Rounded up
+     * to a power of two
+     */
+    explicit SpscRing(std::size_t capacity)
+    {
+      std::size_t size = 1;
+      while (size < capacity) {
+        size <<= 1;
+      }
+      mBuffer.resize(size);
+      mMask = size - 1;
+    }
+
+    /**
+     * @brief Append items. Only call from the producer thread
+     * @return the number of items written
+     */
+    auto write(const T *data, std::size_t count) noexcept -> std::size_t
+    {
+      auto head = mHead.load(std::memory_order_relaxed);
+      auto tail = mTail.load(std::memory_order_acquire);
+      count      = std::min(count, mBuffer.size() - (head - tail));
+      auto pos   = head & mMask;
+      auto first = std::min(count, mBuffer.size() - pos);
+      std::copy(data, data + first, mBuffer.begin() + pos);
+      std::copy(data + first, data + count, mBuffer.begin());
+      mHead.store(head + count, std::memory_order_release);
+      return count;
+    }
+
+    /**
+     * @brief Take items out. Only call from the consumer thread
+     * @return the number of items read
+     */
+    auto read(T *data, std::size_t count) noexcept -> std::size_t
+    {
+      auto tail = mTail.load(std::memory_order_relaxed);
+      auto head = mHead.load(std::memory_order_acquire);
+      count      = std::min(count, head - tail);
+      auto pos   = tail & mMask;
+      auto first = std::min(count, mBuffer.size() - pos);
+      std::copy(mBuffer.begin() + pos, mBuffer.begin() + pos + first, data);
+      std::copy(
+        mBuffer.begin(), mBuffer.begin() + (count - first), data + first);
+      mTail.store(tail + count, std::memory_order_release);
+      return count;
+    }
+
+    /**
+     * @brief the number of items waiting to be read
+     */
+    auto readable() const noexcept -> std::size_t
+    {
+      return mHead.load(std::memory_order_acquire) -
+             mTail.load(std::memory_order_acquire);
+    }
+
+    auto capacity() const noexcept -> std::size_t { return mBuffer.size(); }
+
+  private:
+    static constexpr std::size_t CACHE_LINE = 64;
+
+    std::vector<T> mBuffer;
+    std::size_t    mMask = 0;
+    // total items ever written/read. Only the producer stores to mHead, and
+    // only the consumer to mTail
+    alignas(CACHE_LINE) std::atomic_size_t mHead { 0 };
+    alignas(CACHE_LINE) std::atomic_size_t mTail { 0 };
+  };
+} // namespace smv::details
@@ -0,0 +1,136 @@
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <utility>
+
+namespace smv::details {
+  namespace {
+    struct RangeState
+    {
+      std::size_t                  begin, end, chunk, chunkCount;
+      const ThreadPool::RangeFunc *func;
+      std::atomic_size_t           nextChunk { 0 };
+      std::size_t                  doneChunks = 0;
+      std::mutex                   doneMutex;
+      std::condition_variable      doneCond;
+
+      /**
+       * @brief claim and process chunks until none are left
+       */
+      void drain()
+      {
+        for (auto index = nextChunk++; index < chunkCount;
+             index      = nextChunk++) {
+          auto first = begin + index * chunk;
+          (*func)(first, std::min(first + chunk, end));
+          std::lock_guard _(doneMutex);
+          if (++doneChunks == chunkCount) {
+            doneCond.notify_all();
+          }
+        }
+      }
+    };
+  } // namespace
+
+  ThreadPool::ThreadPool(std::size_t threadCount)
+  {
+    mWorkers.reserve(threadCount);
+    for (std::size_t i = 0; i < threadCount; i++) {
+      mWorkers.emplace_back(&ThreadPool::work, this);
+    }
+  }
+
+  ThreadPool::~ThreadPool()
+  {
+    {
+      std::lock_guard _(mMutex);
+      mStopping = true;
+    }
+    mCond.notify_all();
+    for (auto &worker : mWorkers) {
+      worker.join();
+    }
+  }
+
+  void ThreadPool::submit(std::function<void()> task)
+  {
+    {
+      std::lock_guard _(mMutex);
+      mTasks.push_back(std::move(task));
+    }
+    mCond.notify_one();
+  }
+
+  void ThreadPool::parallelFor(std::size_t      begin,
+                               std::size_t      end,
+                               const RangeFunc &func,
+                               std::size_t      minChunk)
+  {
+    if (begin >= end) {
+      return;
+    }
+    auto count = end - begin;
+    auto parts = std::min(mWorkers.size() + 1,
+                          (count + minChunk - 1) / std::max<std::size_t>(
+                                                     minChunk, 1));
+    if (parts <= 1) {
+      func(begin, end);
+      return;
+    }
+
+    // the state is shared because helpers may only get to run after we have
+    // returned, in which case they find no chunks left and exit
+    auto state        = std::make_shared<RangeState>();
+    state->begin      = begin;
+    state->end        = end;
+    state->chunk      = (count + parts - 1) / parts;
+    state->chunkCount = (count + state->chunk - 1) / state->chunk;
+    state->func       = &func;
+
+    for (std::size_t i = 1; i < state->chunkCount; i++) {
+      submit([state]() {
+        state->drain();
+      });
+    }
+    state->drain();
+
+    std::unique_lock lock(state->doneMutex);
+    state->doneCond.wait(lock, [&state] {
+      return state->doneChunks == state->chunkCount;
+    });
+  }
+
+  auto ThreadPool::size() const noexcept -> std::size_t
+  {
+    return mWorkers.size();
+  }
+
+  auto ThreadPool::shared() -> ThreadPool &
+  {
+    // leave one core for the thread that is driving the capture
+    static ThreadPool pool(
+      std::max(std::thread::hardware_concurrency(), 2U) - 1);
+    return pool;
+  }
+
+  void ThreadPool::work()
+  {
+    for (;;) {
+      std::function<void()> task;
+      {
+        std::unique_lock lock(mMutex);
+        mCond.wait(lock, [this] {
+          return mStopping || !mTasks.empty();
+        });
+        if (mStopping && mTasks.empty()) {
+          return;
+        }
+        task = std::move(mTasks.front());
+        mTasks.pop_front();
+      }
+      task();
+    }
+  }
+} // namespace smv::details
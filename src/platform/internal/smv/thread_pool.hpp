@@ -0,0 +1,72 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace smv::details {
+  /**
+   * @brief A fixed size pool of worker threads
+   * @details Used to spread row oriented pixel work (color conversion,
+   * scaling, hashing) over the available cores, so that a single capture does
+   * not have to be processed on one thread.
+   */
+  class ThreadPool
+  {
+  public:
+    using RangeFunc = std::function<void(std::size_t, std::size_t)>;
+
+    explicit ThreadPool(std::size_t threadCount);
+    ThreadPool(const ThreadPool &)                     = delete;
+    auto operator=(const ThreadPool &) -> ThreadPool & = delete;
+    ThreadPool(ThreadPool &&)                          = delete;
+    auto operator=(ThreadPool &&) -> ThreadPool      & = delete;
+    ~ThreadPool();
+
+    /**
+     * @brief queue a task to be run by one of the workers
+     *
+     * @param task the task to run
+     */
+    void submit(std::function<void()> task);
+
+    /**
+     * @brief Call func over [begin, end) split into contiguous chunks
+     *
+     * @details Blocks until every chunk has been processed. The calling
+     * thread also processes chunks, so this is safe to call from within one of
+     * the workers.
+     *
+     * @param begin the first index
+     * @param end one past the last index
+     * @param func called with a [first, last) sub range
+     * @param minChunk the smallest range handed to a single call of func
+     */
+    void parallelFor(std::size_t      begin,
+                     std::size_t      end,
+                     const RangeFunc &func,
+                     std::size_t      minChunk = 1);
+
+    auto size() const noexcept -> std::size_t;
+
+    /**
+     * @brief returns the pool shared by the capture pipeline
+     *
+     * @return ThreadPool&
+     */
+    static auto shared() -> ThreadPool &;
+
+  private:
+    void work();
+
+    std::vector<std::thread>          mWorkers;
+    std::deque<std::function<void()>> mTasks;
+    std::mutex                        mMutex;
+    std::condition_variable           mCond;
+    bool                              mStopping = false;
+  };
+} // namespace smv::details
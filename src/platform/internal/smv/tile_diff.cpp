@@ -0,0 +1,158 @@
+#include "tile_diff.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace smv::details {
+  namespace {
+    constexpr auto BYTES_PER_PIXEL = 4U;
+
+    /**
+     * @brief memcmp that only answers "equal or not", 64 bytes at a time
+     */
+    inline auto bytesEqual(const uint8_t *a, const uint8_t *b, std::size_t size)
+      -> bool
+    {
+      std::size_t i = 0;
+#if defined(__SSE2__)
+      for (; i + 64 <= size; i += 64) {
+        const auto *va = reinterpret_cast<const __m128i *>(a + i);
+        const auto *vb = reinterpret_cast<const __m128i *>(b + i);
+        auto        eq = _mm_and_si128(
+          _mm_and_si128(
+            _mm_cmpeq_epi8(_mm_loadu_si128(va), _mm_loadu_si128(vb)),
+            _mm_cmpeq_epi8(_mm_loadu_si128(va + 1), _mm_loadu_si128(vb + 1))),
+          _mm_and_si128(
+            _mm_cmpeq_epi8(_mm_loadu_si128(va + 2), _mm_loadu_si128(vb + 2)),
+            _mm_cmpeq_epi8(_mm_loadu_si128(va + 3), _mm_loadu_si128(vb + 3))));
+        if (_mm_movemask_epi8(eq) != 0xFFFF) {
+          return false;
+        }
+      }
+      for (; i + 16 <= size; i += 16) {
+        auto eq = _mm_cmpeq_epi8(
+          _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i)),
+          _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i)));
+        if (_mm_movemask_epi8(eq) != 0xFFFF) {
+          return false;
+        }
+      }
+#endif
+      return std::memcmp(a + i, b + i, size - i) == 0;
+    }
+  } // namespace
+
+  auto TileDiff::update(const FrameView &frame, ThreadPool &pool)
+    -> const std::vector<DirtyRect> &
+  {
+    const auto rowBytes =
+      static_cast<std::size_t>(frame.width) * BYTES_PER_PIXEL;
+
+    if (frame.width != mWidth || frame.height != mHeight || mPrevious.empty()) {
+      mWidth   = frame.width;
+      mHeight  = frame.height;
+      mColumns = (mWidth + TILE_SIZE - 1) / TILE_SIZE;
+      mRows    = (mHeight + TILE_SIZE - 1) / TILE_SIZE;
+      mPrevious.resize(rowBytes * mHeight);
+      mDirty.assign(static_cast<std::size_t>(mColumns) * mRows, 1);
+      for (uint32_t y = 0; y < mHeight; y++) {
+        std::memcpy(mPrevious.data() + y * rowBytes, frame.row(y), rowBytes);
+      }
+      mRects.assign({ DirtyRect { 0,
+                                  0,
+                                  static_cast<uint16_t>(mWidth),
+                                  static_cast<uint16_t>(mHeight) } });
+      return mRects;
+    }
+
+    pool.parallelFor(0, mRows, [&](std::size_t first, std::size_t last) {
+      for (auto tileRow = first; tileRow < last; tileRow++) {
+        auto y0 = static_cast<uint32_t>(tileRow * TILE_SIZE);
+        auto y1 = std::min(y0 + TILE_SIZE, mHeight);
+        for (uint32_t column = 0; column < mColumns; column++) {
+          auto offset = static_cast<std::size_t>(column) * TILE_SIZE *
+                        BYTES_PER_PIXEL;
+          auto size =
+            static_cast<std::size_t>(
+              std::min(TILE_SIZE, mWidth - column * TILE_SIZE)) *
+            BYTES_PER_PIXEL;
+          auto &dirty = mDirty[tileRow * mColumns + column];
+
+          dirty = 0;
+          for (auto y = y0; y < y1; y++) {
+            auto *previous = mPrevious.data() + y * rowBytes + offset;
+            if (dirty != 0) {
+              std::memcpy(previous, frame.row(y) + offset, size);
+            } else if (!bytesEqual(frame.row(y) + offset, previous, size)) {
+              // the rows above this one are unchanged, so only copy from here
+              dirty = 1;
+              std::memcpy(previous, frame.row(y) + offset, size);
+            }
+          }
+        }
+      }
+    });
+
+    mergeTiles();
+    return mRects;
+  }
+
+  void TileDiff::reset()
+  {
+    mWidth = mHeight = mColumns = mRows = 0;
+    mPrevious.clear();
+    mDirty.clear();
+    mRects.clear();
+  }
+
+  void TileDiff::mergeTiles()
+  {
+    mRects.clear();
+    // the rectangles that ended on the previous row of tiles, which may still
+    // be extended downwards
+    std::vector<std::size_t> open, nextOpen;
+
+    for (uint32_t row = 0; row < mRows; row++) {
+      const auto *dirty =
+        mDirty.data() + static_cast<std::size_t>(row) * mColumns;
+      auto y = row * TILE_SIZE;
+      auto h = std::min(y + TILE_SIZE, mHeight) - y;
+
+      nextOpen.clear();
+      for (uint32_t column = 0; column < mColumns;) {
+        if (dirty[column] == 0) {
+          column++;
+          continue;
+        }
+        auto end = column;
+        while (end < mColumns && dirty[end] != 0) {
+          end++;
+        }
+        auto x = column * TILE_SIZE;
+        auto w = std::min(end * TILE_SIZE, mWidth) - x;
+
+        auto above = std::find_if(open.begin(), open.end(), [&](auto index) {
+          return mRects[index].x == static_cast<int16_t>(x) &&
+                 mRects[index].width == static_cast<uint16_t>(w);
+        });
+        if (above != open.end()) {
+          mRects[*above].height += static_cast<uint16_t>(h);
+          nextOpen.push_back(*above);
+        } else {
+          mRects.push_back({ static_cast<int16_t>(x),
+                             static_cast<int16_t>(y),
+                             static_cast<uint16_t>(w),
+                             static_cast<uint16_t>(h) });
+          nextOpen.push_back(mRects.size() - 1);
+        }
+        column = end;
+      }
+      std::swap(open, nextOpen);
+    }
+  }
+} // namespace smv::details
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "frame.hpp"
+#include "thread_pool.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace smv::details {
+  /**
+   * @brief Software change detection between consecutive captures
+   *
+   * @details Splits the frame in square tiles and compares each tile against
+   * the same tile of the previous frame. The tiles that differ are merged into
+   * rectangles, like the ones the X Damage extension reports, so that
+   * consumers only need to process what changed, whether or not the X server
+   * can tell us.
+   * A copy of the last frame is kept, and only the tiles that changed are
+   * copied into it.
+   */
+  class TileDiff
+  {
+  public:
+    static constexpr uint32_t TILE_SIZE = 64;
+
+    /**
+     * @brief Compare the frame against the previous frame
+     *
+     * @details The first frame, or a frame whose size differs from the
+     * previous one, is reported as entirely dirty
+     *
+     * @param frame the new frame
+     * @param pool the thread pool to run the comparison on
+     * @return const std::vector<DirtyRect>& the parts of the frame that
+     * changed. Valid until the next call
+     */
+    auto update(const FrameView &frame, ThreadPool &pool = ThreadPool::shared())
+      -> const std::vector<DirtyRect> &;
+
+    /**
+     * @brief forget the previous frame
+     */
+    void reset();
+
+  private:
+    void mergeTiles();
+
+    uint32_t               mWidth   = 0;
+    uint32_t               mHeight  = 0;
+    uint32_t               mColumns = 0;
+    uint32_t               mRows    = 0;
+    std::vector<uint8_t>   mPrevious;
+    std::vector<uint8_t>   mDirty;
+    std::vector<DirtyRect> mRects;
+  };
+} // namespace smv::details
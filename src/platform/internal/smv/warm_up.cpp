@@ -0,0 +1,191 @@
+#include "capture_impl.hpp"
+#include "convert.hpp"
+#include "encoder_mjpeg.hpp"
+#include "encoder_x264.hpp"
+#include "frame_hash.hpp"
+#include "smv/log.hpp"
+#include "smv/record.hpp"
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <variant>
+#include <vector>
+
+namespace smv::details {
+  using smv::log::logger;
+
+  namespace {
+    using Clock = std::chrono::steady_clock;
+
+    // grabs timed after the first one, to find the steady state
+    constexpr auto STEADY_SAMPLES = 5U;
+    // the first screenshot is scaled down by this much, so the scaler and
+    // the encoders get exercised without spending long on them
+    constexpr auto PREVIEW_DIVISOR = 4U;
+    constexpr auto ENCODER_FRAME   = 64U;
+
+    enum class WarmUpState
+    {
+      Cold,
+      Running,
+      Done,
+    };
+
+    using WarmUpCb = std::function<void(const WarmUpReport &)>;
+
+    std::mutex            warmUpMutex;
+    WarmUpState           warmUpState = WarmUpState::Cold;
+    WarmUpReport          warmUpReport;
+    std::vector<WarmUpCb> warmUpCallbacks;
+
+    auto elapsed(Clock::time_point since) -> std::chrono::microseconds
+    {
+      return std::chrono::duration_cast<std::chrono::microseconds>(
+        Clock::now() - since);
+    }
+
+    /**
+     * @brief grab the whole screen and push it through the video path
+     * @return how long it took
+     */
+    auto grabScreen(Size screen, VideoFrame &frame)
+      -> std::variant<std::chrono::microseconds, std::string>
+    {
+      auto start = Clock::now();
+      auto err   = grabFrame(Region(screen.w, screen.h, 0, 0),
+                           [&](const FrameView &view) {
+        hashFrame(view);
+        convertFrame(view, PixelLayout::I420, YuvMatrix::BT709, frame);
+      });
+      if (err) {
+        return std::move(*err);
+      }
+      return elapsed(start);
+    }
+
+    /**
+     * @brief encode one small frame with each encoder, so that their code
+     * and tables are loaded before the first capture needs them
+     */
+    void primeEncoders(Size screen)
+    {
+      auto config       = ScreenshotConfig { Region(screen.w, screen.h, 0, 0) };
+      config.outputSize = Size { std::max(screen.w / PREVIEW_DIVISOR, 1U),
+                                 std::max(screen.h / PREVIEW_DIVISOR, 1U) };
+      if (auto source = createScreenshotCaptureSource(config);
+          source && !source->error()) {
+        ScreenshotSource::toPNG(*source);
+        ScreenshotSource::toJPG(*source, DEFAULT_JPEG_QUALITY);
+      }
+
+      VideoFrame frame;
+      if (X264Encoder::available()) {
+        frame.resize(PixelLayout::I420, ENCODER_FRAME, ENCODER_FRAME);
+        X264Encoder(DEFAULT_FPS).encode(frame);
+      }
+      frame.resize(PixelLayout::RGB, ENCODER_FRAME, ENCODER_FRAME);
+      MjpegEncoder().encode(frame);
+    }
+
+    auto runWarmUp() -> WarmUpReport
+    {
+      WarmUpReport report;
+      auto         start  = Clock::now();
+      auto         screen = prepareCapture();
+      report.prepare      = elapsed(start);
+      if (!screen) {
+        report.error = "Capture module has not been initialized";
+        return report;
+      }
+      probeCapturePaths();
+      ThreadPool::shared();
+
+      VideoFrame frame;
+      auto       first = grabScreen(*screen, frame);
+      if (std::holds_alternative<std::string>(first)) {
+        report.error = std::get<std::string>(std::move(first));
+        return report;
+      }
+      report.firstFrame = std::get<std::chrono::microseconds>(first);
+
+      std::array<std::chrono::microseconds, STEADY_SAMPLES> samples {};
+      for (auto &sample : samples) {
+        auto took = grabScreen(*screen, frame);
+        if (std::holds_alternative<std::string>(took)) {
+          report.error = std::get<std::string>(std::move(took));
+          return report;
+        }
+        sample = std::get<std::chrono::microseconds>(took);
+      }
+      std::nth_element(
+        samples.begin(), samples.begin() + samples.size() / 2, samples.end());
+      report.steadyFrame = samples[samples.size() / 2];
+
+      primeEncoders(*screen);
+      report.total = elapsed(start);
+      return report;
+    }
+
+    void startWarmUp(WarmUpCb callback)
+    {
+      std::unique_lock lock(warmUpMutex);
+      if (warmUpState == WarmUpState::Done) {
+        lock.unlock();
+        if (callback) {
+          callback(warmUpReport);
+        }
+        return;
+      }
+      if (callback) {
+        warmUpCallbacks.push_back(std::move(callback));
+      }
+      if (warmUpState == WarmUpState::Running) {
+        return;
+      }
+      warmUpState = WarmUpState::Running;
+
+      std::thread([] {
+        auto report = runWarmUp();
+        if (report.error) {
+          logger->warn("Capture warm-up failed: {}", *report.error);
+        } else {
+          logger->info("Capture warmed up in {}us. Prepare={}us, "
+                       "FirstFrame={}us, SteadyFrame={}us",
+                       report.total.count(),
+                       report.prepare.count(),
+                       report.firstFrame.count(),
+                       report.steadyFrame.count());
+        }
+
+        std::vector<WarmUpCb> callbacks;
+        {
+          std::lock_guard _(warmUpMutex);
+          // a failed warm-up is tried again on the next call
+          warmUpState  = report.error ? WarmUpState::Cold : WarmUpState::Done;
+          warmUpReport = report;
+          callbacks    = std::exchange(warmUpCallbacks, {});
+        }
+        for (const auto &callback : callbacks) {
+          callback(report);
+        }
+      }).detach();
+    }
+  } // namespace
+} // namespace smv::details
+
+namespace smv {
+  void warmUp(std::function<void(const WarmUpReport &)> callback)
+  {
+    details::startWarmUp(std::move(callback));
+  }
+
+  auto capturePaths() -> CapturePathReport
+  {
+    return details::capturePathReport();
+  }
+} // namespace smv
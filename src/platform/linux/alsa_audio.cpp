@@ -0,0 +1,114 @@
+#include "alsa_audio.hpp"
+#include "smv/capture_impl.hpp"
+#include "smv/log.hpp"
+
+#include <alsa/asoundlib.h>
+
+namespace smv::details {
+  using smv::log::logger;
+
+  namespace {
+    // asks ALSA to buffer about two periods
+    constexpr auto LATENCY_US = 20'000U;
+    // the first card number used by AudioCaptureConfig::sourceId
+    constexpr auto FIRST_CARD_SOURCE = 2U;
+  } // namespace
+
+  AlsaAudioBackend::AlsaAudioBackend(std::string device, AudioFormat format)
+    : mDevice(std::move(device))
+    , mFormat(format)
+  {
+  }
+
+  AlsaAudioBackend::~AlsaAudioBackend()
+  {
+    stop();
+  }
+
+  auto AlsaAudioBackend::format() const noexcept -> AudioFormat
+  {
+    return mFormat;
+  }
+
+  auto AlsaAudioBackend::name() const noexcept -> std::string_view
+  {
+    return "alsa";
+  }
+
+  auto AlsaAudioBackend::start(Callback callback)
+    -> std::optional<std::string>
+  {
+    if (mPcm) {
+      return "Already started";
+    }
+    if (auto err =
+          snd_pcm_open(&mPcm, mDevice.c_str(), SND_PCM_STREAM_CAPTURE, 0);
+        err < 0) {
+      mPcm = nullptr;
+      return "Failed to open " + mDevice + ": " + snd_strerror(err);
+    }
+    if (auto err = snd_pcm_set_params(mPcm,
+                                      SND_PCM_FORMAT_FLOAT_LE,
+                                      SND_PCM_ACCESS_RW_INTERLEAVED,
+                                      mFormat.channels,
+                                      mFormat.sampleRate,
+                                      1,
+                                      LATENCY_US);
+        err < 0) {
+      snd_pcm_close(mPcm);
+      mPcm = nullptr;
+      return "Failed to configure " + mDevice + ": " + snd_strerror(err);
+    }
+    mPeriod.resize(static_cast<std::size_t>(mFormat.periodFrames) *
+                   mFormat.channels);
+    mRunning = true;
+    mThread  = std::thread(&AlsaAudioBackend::run, this, std::move(callback));
+    return std::nullopt;
+  }
+
+  void AlsaAudioBackend::stop()
+  {
+    mRunning = false;
+    if (mThread.joinable()) {
+      mThread.join();
+    }
+    if (mPcm) {
+      snd_pcm_close(mPcm);
+      mPcm = nullptr;
+    }
+  }
+
+  void AlsaAudioBackend::run(const Callback &callback)
+  {
+    while (mRunning) {
+      auto frames = snd_pcm_readi(mPcm, mPeriod.data(), mFormat.periodFrames);
+      if (frames < 0) {
+        // overruns and suspends are recoverable, anything else is not
+        frames = snd_pcm_recover(mPcm, static_cast<int>(frames), 1);
+        if (frames < 0) {
+          logger->error("Audio capture from {} failed: {}",
+                        mDevice,
+                        snd_strerror(static_cast<int>(frames)));
+          break;
+        }
+        continue;
+      }
+      if (frames > 0) {
+        callback(mPeriod.data(), static_cast<std::size_t>(frames));
+      }
+    }
+  }
+
+  auto createPlatformAudioBackend(const AudioCaptureConfig &config)
+    -> std::unique_ptr<AudioBackend>
+  {
+    if (config.sourceId == AudioCaptureConfig::DEFAULT_SOURCE) {
+      return std::make_unique<AlsaAudioBackend>("default");
+    }
+    if (config.sourceId >= FIRST_CARD_SOURCE) {
+      return std::make_unique<AlsaAudioBackend>(
+        "plughw:" + std::to_string(config.sourceId - FIRST_CARD_SOURCE));
+    }
+    return nullptr;
+  }
+} // namespace smv::details
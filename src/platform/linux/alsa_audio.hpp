@@ -0,0 +1,45 @@
+#pragma once
+
+#include "smv/audio_backend.hpp"
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+using snd_pcm_t = struct _snd_pcm;
+
+namespace smv::details {
+  /**
+   * @brief Captures from an ALSA device
+   * @details The device is read one period at a time on a dedicated thread,
+   * into a buffer allocated when the device is opened. Overruns are recovered
+   * from, losing the samples in between
+   */
+  class AlsaAudioBackend: public AudioBackend
+  {
+  public:
+    /**
+     * @param device the ALSA device name, e.g "default" or "plughw:1"
+     * @param format the format to ask the device for. ALSA converts to it if
+     * needed
+     */
+    AlsaAudioBackend(std::string device, AudioFormat format = {});
+    ~AlsaAudioBackend() override;
+
+    auto format() const noexcept -> AudioFormat override;
+    auto name() const noexcept -> std::string_view override;
+    auto start(Callback callback) -> std::optional<std::string> override;
+    void stop() override;
+
+  private:
+    void run(const Callback &callback);
+
+    const std::string  mDevice;
+    const AudioFormat  mFormat;
+    snd_pcm_t         *mPcm = nullptr;
+    std::vector<float> mPeriod;
+    std::atomic_bool   mRunning = false;
+    std::thread        mThread;
+  };
+} // namespace smv::details
@@ -1,8 +1,13 @@
 #include "xcapture.hpp"
 #include "smv/capture_impl.hpp"
+#include "smv/convert_rgb.hpp"
+#include "smv/frame.hpp"
 #include "smv/log.hpp"
+#include "smv/pixel_format.hpp"
 #include "smv/record.hpp"
+#include "smv/scale.hpp"
 #include "xtools.hpp"
+#include "xprobe.hpp"
 #include "xutils.hpp"
 #include "xwindow.hpp"
 
@@ -11,14 +16,19 @@
 #include <cerrno>
 #include <cstdint>
 #include <cstring>
-#include <iterator>
+#include <functional>
 #include <memory>
 #include <mutex>
+#include <optional>
+#include <string>
 #include <sys/mman.h>
+#include <unordered_map>
 #include <variant>
+#include <vector>
 
-#include <assert.hpp>
 #include <spdlog/fmt/fmt.h>
+#include <xcb/composite.h>
+#include <xcb/randr.h>
 #include <xcb/shm.h>
 #include <xcb/xcb.h>
 #include <xcb/xcb_image.h>
@@ -29,45 +39,118 @@ constexpr auto SHM_CREATE_ERROR = "Failed to create shared memory segment";
 constexpr auto CAPTURE_MODULE_UNINITIALIZED =
   "Capture module has not been initialized";
 constexpr auto MAX_BYTES_PER_PIXEL = 4U;
+// the size of a GetImage reply header, in units of 4 bytes
+constexpr auto REPLY_HEADER_UNITS = 8U;
 
 namespace smv::details {
   using smv::utils::res, smv::log::logger;
+  using GrabFunc = std::function<void(const FrameView &)>;
   namespace {
-    std::atomic_bool  captureReady = false;
-    xcb_image_order_t imageOrder   = XCB_IMAGE_ORDER_LSB_FIRST;
+    std::atomic_bool captureReady = false;
+    // -1 when the server does not have RandR
+    std::atomic_int  randrBase    = -1;
+    std::atomic_bool composite    = false;
 
-    auto pixelsToVector(const uint8_t *bytes, size_t size)
-      -> std::vector<uint8_t>
+    /**
+     * @brief the formats of the TrueColor and DirectColor visuals of every
+     * screen. Filled once, when the capture module is initialized
+     */
+    std::unordered_map<xcb_visualid_t, PixelFormat> visualFormats;
+    // the pixmap format of each depth, for drawables without a visual
+    std::unordered_map<uint8_t, PixelFormat> depthFormats;
+    // the format of the first screen's root window, which gives pixmaps their
+    // masks
+    std::optional<PixelFormat> rootFormat;
+
+    void loadPixelFormats(const xcb_setup_t *setup)
     {
-      ASSERT(/* NOLINT */
-             size % MAX_BYTES_PER_PIXEL == 0,
-             "size must be a multiple of 4",
-             size);
-      std::vector<uint8_t> captureBytes {};
-      captureBytes.reserve(size);
-
-      for (size_t i = 0; i + MAX_BYTES_PER_PIXEL < size;
-           i += MAX_BYTES_PER_PIXEL) {
-        // reverse the bytes so that they are in the order blue, green, red
-        captureBytes.insert(captureBytes.end(),
-                            std::reverse_iterator(&bytes[i + 3]),
-                            std::reverse_iterator(&bytes[i]));
+      auto msbFirst = setup->image_byte_order == XCB_IMAGE_ORDER_MSB_FIRST;
+      for (auto formats = xcb_setup_pixmap_formats_iterator(setup);
+           formats.rem > 0;
+           xcb_format_next(&formats)) {
+        PixelFormat format;
+        format.depth        = formats.data->depth;
+        format.bitsPerPixel = formats.data->bits_per_pixel;
+        format.scanlinePad  = formats.data->scanline_pad;
+        format.msbFirst     = msbFirst;
+        depthFormats[format.depth] = format;
       }
-
-      // highly unlikely branch
-      if (imageOrder == XCB_IMAGE_ORDER_MSB_FIRST) {
-        for (size_t i = 0; i + 3 < captureBytes.size(); i += 3) {
-          // swap red and blue so that red is always first
-          std::reverse(&captureBytes[i], &captureBytes[i + 3]);
+      for (auto roots = xcb_setup_roots_iterator(setup); roots.rem > 0;
+           xcb_screen_next(&roots)) {
+        for (auto depths = xcb_screen_allowed_depths_iterator(roots.data);
+             depths.rem > 0;
+             xcb_depth_next(&depths)) {
+          auto found = depthFormats.find(depths.data->depth);
+          if (found == depthFormats.end()) {
+            continue;
+          }
+          for (auto visuals = xcb_depth_visuals_iterator(depths.data);
+               visuals.rem > 0;
+               xcb_visualtype_next(&visuals)) {
+            const auto *visual = visuals.data;
+            if (visual->_class != XCB_VISUAL_CLASS_TRUE_COLOR &&
+                visual->_class != XCB_VISUAL_CLASS_DIRECT_COLOR) {
+              continue;
+            }
+            auto format      = found->second;
+            format.redMask   = visual->red_mask;
+            format.greenMask = visual->green_mask;
+            format.blueMask  = visual->blue_mask;
+            visualFormats[visual->visual_id] = format;
+          }
         }
       }
-      return captureBytes;
+      if (auto roots = xcb_setup_roots_iterator(setup); roots.rem > 0) {
+        if (auto found = visualFormats.find(roots.data->root_visual);
+            found != visualFormats.end()) {
+          rootFormat = found->second;
+        }
+      }
+    }
+
+    /**
+     * @brief the format of the pixels in a GetImage reply
+     * @details Pixmaps have no visual. Their pixels are assumed to have the
+     * same masks as the root window, with whatever is left of the depth
+     * holding alpha. That only works for depths stored like the root's
+     * pixels, other pixmaps cannot be described
+     *
+     * @return std::nullopt if the pixels cannot be described
+     */
+    auto formatOf(uint8_t depth, xcb_visualid_t visual)
+      -> std::optional<PixelFormat>
+    {
+      if (auto found = visualFormats.find(visual);
+          found != visualFormats.end()) {
+        return found->second;
+      }
+      auto found = depthFormats.find(depth);
+      if (found == depthFormats.end() || !rootFormat ||
+          found->second.bitsPerPixel != rootFormat->bitsPerPixel) {
+        return std::nullopt;
+      }
+      auto format      = found->second;
+      format.redMask   = rootFormat->redMask;
+      format.greenMask = rootFormat->greenMask;
+      format.blueMask  = rootFormat->blueMask;
+      auto colorMask   = format.redMask | format.greenMask | format.blueMask;
+      if (depth < 32 && (colorMask >> depth) != 0) {
+        return std::nullopt;
+      }
+      return format;
     }
 
-    auto capturePixels(xcb_drawable_t                drawable,
-                       const Region *const           region,
-                       const xcb_shm_segment_info_t &shmInfo)
-      -> std::variant<std::vector<uint8_t>, std::string>
+    auto unsupportedDepth(uint8_t depth) -> std::string
+    {
+      return fmt::format(
+        "{}: Unsupported pixel format (depth {})", SCREENSHOT_ERROR, depth);
+    }
+
+    auto grabPixels(xcb_drawable_t                drawable,
+                    const Region *const           region,
+                    const xcb_shm_segment_info_t &shmInfo,
+                    const GrabFunc               &func)
+      -> std::optional<std::string>
     {
       xcb_generic_error_t                       *err = nullptr;
       std::shared_ptr<xcb_shm_get_image_reply_t> image(xcb_shm_get_image_reply(
@@ -89,95 +172,358 @@ namespace smv::details {
         return fmt::format(
           "{}: {}", SCREENSHOT_ERROR, getErrorCodeName(err->error_code));
       }
-      return pixelsToVector(shmInfo.shmaddr, image->size);
+      auto format = formatOf(image->depth, image->visual);
+      if (!format) {
+        return unsupportedDepth(image->depth);
+      }
+      if (format->isNative()) {
+        func(FrameView { shmInfo.shmaddr,
+                         region->width(),
+                         region->height(),
+                         image->size / region->height(),
+                         format->msbFirst,
+                         format->alphaMask() != 0 });
+        return std::nullopt;
+      }
+      // reused by every converted grab of this thread
+      thread_local VideoFrame converted;
+      func(convertToBgrx(shmInfo.shmaddr,
+                         region->width(),
+                         region->height(),
+                         image->size / region->height(),
+                         *format,
+                         converted));
+      return std::nullopt;
     }
 
-    auto capturePixels(xcb_drawable_t drawable, const Region *const region)
-      -> std::variant<std::vector<uint8_t>, std::string>
+    /**
+     * @brief the number of rows of the given width that fit in one reply
+     * @details Sized from the maximum request length, which the server
+     * also expects replies to stay within
+     */
+    auto stripRows(uint32_t width) -> uint32_t
     {
-      xcb_generic_error_t                   *err = nullptr;
-      std::shared_ptr<xcb_get_image_reply_t> image(xcb_get_image_reply(
-        res::connection.get(),
-        xcb_get_image_unchecked(res::connection.get(),
-                                XCB_IMAGE_FORMAT_Z_PIXMAP,
-                                drawable,
-                                static_cast<int16_t>(region->x()),
-                                static_cast<int16_t>(region->y()),
-                                region->width(),
-                                region->height(),
-                                ~0),
-        &err));
-      std::shared_ptr<xcb_generic_error_t>   _ { err };
-      if (err != nullptr) {
-        return fmt::format(
-          "{}: {}", SCREENSHOT_ERROR, getErrorCodeName(err->error_code));
+      // the length is in units of 4 bytes, some of them taken by the header
+      static const auto maxBytes =
+        (static_cast<uint64_t>(
+           xcb_get_maximum_request_length(res::connection.get())) -
+         REPLY_HEADER_UNITS) *
+        4;
+      auto rowBytes = static_cast<uint64_t>(width) * MAX_BYTES_PER_PIXEL;
+      return static_cast<uint32_t>(std::max<uint64_t>(maxBytes / rowBytes, 1));
+    }
+
+    /**
+     * @brief grab without shared memory
+     * @details The region is split into horizontal strips that each fit in
+     * one reply. Every strip is requested up front, and each one is copied
+     * into place as soon as its reply arrives, while the next ones are still
+     * on their way
+     */
+    auto grabPixels(xcb_drawable_t      drawable,
+                    const Region *const region,
+                    const GrabFunc     &func) -> std::optional<std::string>
+    {
+      auto *connection = res::connection.get();
+      auto  width      = region->width();
+      auto  height     = region->height();
+      auto  rows       = stripRows(width);
+      auto  stride     = width * MAX_BYTES_PER_PIXEL;
+
+      std::vector<xcb_get_image_cookie_t> strips;
+      strips.reserve((height + rows - 1) / rows);
+      for (uint32_t y = 0; y < height; y += rows) {
+        strips.push_back(
+          xcb_get_image_unchecked(connection,
+                                  XCB_IMAGE_FORMAT_Z_PIXMAP,
+                                  drawable,
+                                  static_cast<int16_t>(region->x()),
+                                  static_cast<int16_t>(region->y() + y),
+                                  width,
+                                  std::min(rows, height - y),
+                                  ~0));
       }
-      auto *data = xcb_get_image_data(image.get());
-      auto  size = xcb_get_image_data_length(image.get());
-      return pixelsToVector(data, size);
+
+      // reused by every fallback grab of this thread
+      thread_local std::vector<uint8_t> pixels;
+      pixels.resize(static_cast<std::size_t>(stride) * height);
+      PixelFormat  format;
+      RowConverter convert = nullptr;
+      for (std::size_t i = 0; i < strips.size(); i++) {
+        xcb_generic_error_t                   *err = nullptr;
+        std::shared_ptr<xcb_get_image_reply_t> image(
+          xcb_get_image_reply(connection, strips[i], &err));
+        std::shared_ptr<xcb_generic_error_t> _ { err };
+        if (err != nullptr || image == nullptr) {
+          for (auto j = i + 1; j < strips.size(); j++) {
+            xcb_discard_reply(connection, strips[j].sequence);
+          }
+          return fmt::format("{}: {}",
+                             SCREENSHOT_ERROR,
+                             err ? getErrorCodeName(err->error_code)
+                                 : "No reply");
+        }
+        auto  first     = static_cast<uint32_t>(i) * rows;
+        auto  count     = std::min(rows, height - first);
+        auto *data      = xcb_get_image_data(image.get());
+        auto  srcStride = static_cast<uint32_t>(
+                           xcb_get_image_data_length(image.get())) /
+                         count;
+        auto *dst = pixels.data() + static_cast<std::size_t>(first) * stride;
+        if (i == 0) {
+          auto found = formatOf(image->depth, image->visual);
+          if (!found) {
+            for (auto j = i + 1; j < strips.size(); j++) {
+              xcb_discard_reply(connection, strips[j].sequence);
+            }
+            return unsupportedDepth(image->depth);
+          }
+          format = *found;
+          if (!format.isNative()) {
+            convert = bgrxConverter(format);
+          }
+        }
+        if (convert != nullptr) {
+          for (uint32_t row = 0; row < count; row++) {
+            convert(data + static_cast<std::size_t>(row) * srcStride,
+                    dst + static_cast<std::size_t>(row) * stride,
+                    width,
+                    format);
+          }
+        } else if (srcStride == stride) {
+          std::memcpy(dst, data, static_cast<std::size_t>(stride) * count);
+        } else {
+          for (uint32_t row = 0; row < count; row++) {
+            std::memcpy(dst + static_cast<std::size_t>(row) * stride,
+                        data + static_cast<std::size_t>(row) * srcStride,
+                        std::min(stride, srcStride));
+          }
+        }
+      }
+      // converted pixels are always BGRX
+      func(FrameView { pixels.data(),
+                       width,
+                       height,
+                       stride,
+                       convert == nullptr && format.msbFirst,
+                       format.alphaMask() != 0 });
+      return std::nullopt;
     }
-  } // namespace
 
-  XRecord::XRecord()
-  {
-    const auto *setup = xcb_get_setup(res::connection.get());
-    auto        roots = xcb_setup_roots_iterator(setup);
+    auto screenSize(xcb_window_t root) -> Size
+    {
+      auto geometry = std::unique_ptr<xcb_get_geometry_reply_t>(
+        xcb_get_geometry_reply(res::connection.get(),
+                               xcb_get_geometry(res::connection.get(), root),
+                               nullptr));
+      if (!geometry) {
+        return {};
+      }
+      return { geometry->width, geometry->height };
+    }
 
-    xcb_shm_seg_t shmseg = xcb_generate_id(res::connection.get());
-    // TODO: Initialize for multiple screens or use a value big enough for all
-    // screens
-    auto shmSize = roots.data->width_in_pixels * roots.data->height_in_pixels *
-                   MAX_BYTES_PER_PIXEL;
+    /**
+     * @param prefault whether to fault the pages in now, rather than during
+     * the first grab
+     */
+    auto createSegment(xcb_window_t root, Size area, bool prefault)
+      -> std::unique_ptr<ShmSegment>
+    {
+      auto shmSize = area.w * area.h * MAX_BYTES_PER_PIXEL;
+      if (shmSize == 0) {
+        return nullptr;
+      }
+      xcb_shm_seg_t shmseg    = xcb_generate_id(res::connection.get());
+      auto          shm_reply = std::unique_ptr<xcb_shm_create_segment_reply_t>(
+        xcb_shm_create_segment_reply(
+          res::connection.get(),
+          xcb_shm_create_segment_unchecked(
+            res::connection.get(), shmseg, shmSize, 0U),
+          nullptr));
 
-    auto shm_reply = std::unique_ptr<xcb_shm_create_segment_reply_t>(
-      xcb_shm_create_segment_reply(
-        res::connection.get(),
-        xcb_shm_create_segment_unchecked(
-          res::connection.get(), shmseg, shmSize, 0U),
-        nullptr));
+      if (!shm_reply) {
+        logger->error("[XRecord]: {}. Size={}", SHM_CREATE_ERROR, shmSize);
+        return nullptr;
+      }
 
-    if (!shm_reply) {
-      logger->error("[XRecord]: {}. Size={}", SHM_CREATE_ERROR, shmSize);
-      return;
+      if (shm_reply->nfd != 1) {
+        logger->error("[XRecord]: {}. Invalid number of fds: {}",
+                      SHM_CREATE_ERROR,
+                      shm_reply->nfd);
+        return nullptr;
+      }
+
+      auto *fds = xcb_shm_create_segment_reply_fds(res::connection.get(),
+                                                   shm_reply.get());
+
+      auto *buffer = mmap(nullptr,
+                          shmSize,
+                          PROT_READ | PROT_WRITE,
+                          MAP_SHARED | (prefault ? MAP_POPULATE : 0),
+                          *fds,
+                          0);
+      close(*fds);
+      if (buffer == MAP_FAILED) {
+        logger->error("[XRecord]: {}. MMAP failed: {}",
+                      SHM_CREATE_ERROR,
+                      std::strerror(errno));
+        xcb_shm_detach(res::connection.get(), shmseg);
+        return nullptr;
+      }
+      xcb_shm_segment_info_t shmInfo {};
+      shmInfo.shmseg  = shmseg;
+      shmInfo.shmaddr = static_cast<uint8_t *>(buffer);
+      logger->debug("[XRecord]: Created segment for screen {:#x}. Size={}",
+                    root,
+                    shmSize);
+      auto segment  = std::make_unique<ShmSegment>();
+      segment->root = root;
+      segment->info = shmInfo;
+      segment->size = shmSize;
+      return segment;
     }
 
-    if (shm_reply->nfd != 1) {
-      logger->error("[XRecord]: {}. Invalid number of fds: {}",
-                    SHM_CREATE_ERROR,
-                    shm_reply->nfd);
-      return;
+    void destroySegment(ShmSegment &segment)
+    {
+      // the connection may already be gone when the process exits
+      if (res::connection) {
+        xcb_shm_detach(res::connection.get(), segment.info.shmseg);
+      }
+      munmap(segment.info.shmaddr, segment.size);
+    }
+
+    auto atomName(xcb_atom_t atom) -> std::string
+    {
+      auto reply = std::unique_ptr<xcb_get_atom_name_reply_t>(
+        xcb_get_atom_name_reply(res::connection.get(),
+                                xcb_get_atom_name(res::connection.get(), atom),
+                                nullptr));
+      if (!reply) {
+        return {};
+      }
+      return { xcb_get_atom_name_name(reply.get()),
+               static_cast<std::size_t>(
+                 xcb_get_atom_name_name_length(reply.get())) };
     }
 
-    auto *fds =
-      xcb_shm_create_segment_reply_fds(res::connection.get(), shm_reply.get());
+    auto queryMonitors(xcb_window_t root) -> std::vector<Monitor>
+    {
+      std::vector<Monitor> monitors;
+      // requests of a missing extension would close the connection
+      if (randrBase >= 0) {
+        auto reply = std::unique_ptr<xcb_randr_get_monitors_reply_t>(
+          xcb_randr_get_monitors_reply(
+            res::connection.get(),
+            xcb_randr_get_monitors(res::connection.get(), root, 1),
+            nullptr));
+        for (auto it = reply ? xcb_randr_get_monitors_monitors_iterator(
+                                 reply.get())
+                             : xcb_randr_monitor_info_iterator_t {};
+             it.rem > 0;
+             xcb_randr_monitor_info_next(&it)) {
+          const auto *info = it.data;
+          monitors.push_back({ atomName(info->name),
+                               Region(info->width, info->height, info->x,
+                                      info->y),
+                               info->primary != 0 });
+        }
+      }
+      if (monitors.empty()) {
+        auto size = screenSize(root);
+        monitors.push_back({ fmt::format("screen-{:x}", root),
+                             Region(size.w, size.h, 0, 0),
+                             true });
+      }
+      return monitors;
+    }
+
+    auto sameSize(Size a, Size b) -> bool
+    {
+      return a.w == b.w && a.h == b.h;
+    }
+  } // namespace
 
-    auto *buffer =
-      mmap(nullptr, shmSize, PROT_READ | PROT_WRITE, MAP_SHARED, *fds, 0);
-    close(*fds);
-    if (buffer == MAP_FAILED) {
-      logger->error("[XRecord]: {}. MMAP failed: {}",
-                    SHM_CREATE_ERROR,
-                    std::strerror(errno));
+  XRecord::XRecord()
+  {
+    const auto *setup = xcb_get_setup(res::connection.get());
+    for (auto roots = xcb_setup_roots_iterator(setup); roots.rem > 0;
+         xcb_screen_next(&roots)) {
+      createSegments(roots.data->root, screenSize(roots.data->root));
+    }
+  }
+
+  void XRecord::createSegments(xcb_window_t root, Size screen)
+  {
+    if (auto segment = createSegment(root, screen, true)) {
+      segments.push_back(std::move(segment));
+    }
+    for (const auto &monitor : queryMonitors(root)) {
+      auto size = Size { monitor.area.width(), monitor.area.height() };
+      if (!sameSize(size, screen)) {
+        monitorSegments.emplace_back(root, size);
+      }
+    }
+  }
+
+  void XRecord::createMonitorSegment(Size size)
+  {
+    std::unique_lock _(captureLock);
+    auto             found = std::find_if(
+      monitorSegments.begin(), monitorSegments.end(), [&](const auto &entry) {
+      return sameSize(entry.second, size);
+    });
+    // another grab of the same size may have created it first
+    if (found == monitorSegments.end()) {
       return;
     }
-    xcb_shm_segment_info_t shmInfo {};
-    shmInfo.shmseg  = shmseg;
-    shmInfo.shmaddr = static_cast<uint8_t *>(buffer);
-    this->shmInfo   = shmInfo;
-    this->shmSize   = shmSize;
+    if (auto segment = createSegment(found->first, size, false)) {
+      segments.push_back(std::move(segment));
+    }
+    monitorSegments.erase(found);
   }
 
   XRecord::~XRecord()
   {
-    if (shmInfo) {
-      munmap(shmInfo->shmaddr, shmSize);
-      shmInfo = std::nullopt;
-      shmSize = 0;
+    for (auto &segment : segments) {
+      destroySegment(*segment);
     }
+    segments.clear();
   }
 
-  auto XRecord::screenshot(const decltype(ScreenshotConfig::area) &area)
-    -> ScreenshotSource
+  auto XRecord::screenshot(const ScreenshotConfig &config) -> ScreenshotSource
+  {
+    std::vector<uint8_t> pixels;
+    Size                 size;
+    uint8_t              channels = 3;
+    auto                 err      = grab(config.area, [&](FrameView view) {
+      VideoFrame scaled;
+      if (auto outputSize = config.outputSizeFor({ view.width, view.height });
+          outputSize.w != view.width || outputSize.h != view.height) {
+        // scale straight out of the capture buffer, so that only the scaled
+        // pixels get copied
+        view = scaleFrame(view, outputSize, config.scaleFilter, scaled);
+      }
+      view.hasAlpha = view.hasAlpha && config.keepAlpha;
+      VideoFrame converted;
+      if (isOpaque(view)) {
+        convertToRgb(view, converted);
+      } else {
+        convertToRgba(view, converted);
+        channels = 4;
+      }
+      pixels = std::move(converted.bytes);
+      size   = { view.width, view.height };
+    });
+    if (err) {
+      return { std::move(*err), size };
+    }
+    return { std::move(pixels), size, channels, 1, 0 };
+  }
+
+  auto XRecord::grab(const decltype(ScreenshotConfig::area) &area,
+                     const GrabFunc                         &func,
+                     std::optional<CapturePath>             *path)
+    -> std::optional<std::string>
   {
     xcb_drawable_t root   = 0;
     const Region  *region = nullptr;
@@ -193,11 +539,123 @@ namespace smv::details {
       region                 = &std::get<Region>(area);
     }
 
-    if (shmInfo) {
-      std::lock_guard _(captureLock);
-      return { capturePixels(root, region, *shmInfo), region->size() };
+    auto isWindow = std::holds_alternative<Window *>(area);
+    auto pixels   = static_cast<uint64_t>(region->width()) * region->height();
+    std::optional<CapturePath> chosen;
+    if (path == nullptr) {
+      path = &chosen;
+    }
+    // stays unset until the paths have been probed
+    if (!*path) {
+      *path = fastestPath(isWindow, pixels);
+    }
+    if (*path == CapturePath::Composite) {
+      auto err = isWindow ? grabThrough(CapturePath::Composite,
+                                        root,
+                                        Region(region->width(),
+                                               region->height(),
+                                               0,
+                                               0),
+                                        func)
+                          : std::optional<std::string>("Not a window");
+      if (!err) {
+        return std::nullopt;
+      }
+      // e.g. the window is not redirected. The capture goes on through the
+      // next fastest path, rather than failing the same way on every grab
+      logger->debug("[XRecord]: Composite grab failed: {}", *err);
+      *path = fastestPath(isWindow, pixels, CapturePath::Composite)
+                .value_or(CapturePath::Shm);
+    }
+    return grabThrough(path->value_or(CapturePath::Shm), root, *region, func);
+  }
+
+  auto XRecord::grabThrough(CapturePath     path,
+                            xcb_drawable_t  drawable,
+                            const Region   &region,
+                            const GrabFunc &func) -> std::optional<std::string>
+  {
+    if (path == CapturePath::Composite) {
+      if (!compositeAvailable()) {
+        return "Composite is not available";
+      }
+      auto *connection = res::connection.get();
+      // the id is freed with the pixmap after each grab, so each thread
+      // takes one id for all of its grabs
+      thread_local const auto pixmap = xcb_generate_id(connection);
+      auto                    cookie =
+        xcb_composite_name_window_pixmap_checked(connection, drawable, pixmap);
+      std::unique_ptr<xcb_generic_error_t> err(
+        xcb_request_check(connection, cookie));
+      if (err) {
+        return fmt::format(
+          "{}: {}", SCREENSHOT_ERROR, getErrorCodeName(err->error_code));
+      }
+      auto result = grabThrough(CapturePath::Shm, pixmap, region, func);
+      xcb_free_pixmap(connection, pixmap);
+      return result;
+    }
+    if (path == CapturePath::GetImage) {
+      return grabPixels(drawable, &region, func);
+    }
+
+    auto size = Size { region.width(), region.height() };
+    auto needed =
+      static_cast<uint64_t>(size.w) * size.h * MAX_BYTES_PER_PIXEL;
+    std::shared_lock shared(captureLock);
+    if (std::any_of(
+          monitorSegments.begin(),
+          monitorSegments.end(),
+          [&](const auto &entry) { return sameSize(entry.second, size); })) {
+      shared.unlock();
+      createMonitorSegment(size);
+      shared.lock();
     }
-    return { capturePixels(root, region), region->size() };
+    // any segment can hold any drawable. The smallest free one that fits is
+    // used, so that grabs of different monitors do not wait on each other
+    std::vector<ShmSegment *> fits;
+    for (const auto &segment : segments) {
+      if (segment->size >= needed) {
+        fits.push_back(segment.get());
+      }
+    }
+    std::sort(fits.begin(), fits.end(), [](auto *a, auto *b) {
+      return a->size < b->size;
+    });
+    for (auto *segment : fits) {
+      if (segment->inUse.try_lock()) {
+        std::lock_guard held(segment->inUse, std::adopt_lock);
+        return grabPixels(drawable, &region, segment->info, func);
+      }
+    }
+    if (!fits.empty()) {
+      std::lock_guard held(fits.front()->inUse);
+      return grabPixels(drawable, &region, fits.front()->info, func);
+    }
+    return grabPixels(drawable, &region, func);
+  }
+
+  void XRecord::onScreenChanged(xcb_window_t root,
+                                uint16_t     width,
+                                uint16_t     height)
+  {
+    std::unique_lock _(captureLock);
+    auto             removed =
+      std::remove_if(segments.begin(), segments.end(), [&](auto &segment) {
+      if (segment->root != root) {
+        return false;
+      }
+      destroySegment(*segment);
+      return true;
+    });
+    segments.erase(removed, segments.end());
+    monitorSegments.erase(
+      std::remove_if(monitorSegments.begin(),
+                     monitorSegments.end(),
+                     [&](const auto &entry) { return entry.first == root; }),
+      monitorSegments.end());
+    logger->info("[XRecord]: Screen {:#x} is now {}x{}", root, width, height);
+    createSegments(root, { width, height });
   }
 
   auto XRecord::instance() -> XRecord &
@@ -212,12 +670,79 @@ namespace smv::details {
     // we need to use the correct root window
     // @see xscreen from xutils.hpp
     const auto *setup = xcb_get_setup(res::connection.get());
-    imageOrder        = static_cast<xcb_image_order_t>(setup->image_byte_order);
+    loadPixelFormats(setup);
+
+    // be told when a screen changes size, so its segment can follow
+    const auto *randr =
+      xcb_get_extension_data(res::connection.get(), &xcb_randr_id);
+    if (randr != nullptr && randr->present) {
+      for (auto roots = xcb_setup_roots_iterator(setup); roots.rem > 0;
+           xcb_screen_next(&roots)) {
+        xcb_randr_select_input(res::connection.get(),
+                               roots.data->root,
+                               XCB_RANDR_NOTIFY_MASK_SCREEN_CHANGE);
+      }
+      xcb_flush(res::connection.get());
+      randrBase = randr->first_event;
+    } else {
+      logger->warn("RandR is not available, screen changes will be missed");
+    }
+
+    // the version has to be negotiated before any other request
+    const auto *compositeExt =
+      xcb_get_extension_data(res::connection.get(), &xcb_composite_id);
+    if (compositeExt != nullptr && compositeExt->present) {
+      auto version = std::unique_ptr<xcb_composite_query_version_reply_t>(
+        xcb_composite_query_version_reply(
+          res::connection.get(),
+          xcb_composite_query_version(res::connection.get(), 0, 2),
+          nullptr));
+      composite = version && (version->major_version > 0 ||
+                              version->minor_version >= 2);
+    }
 
     captureReady = true;
     return true;
   }
 
+  auto prepareCapture() -> std::optional<Size>
+  {
+    if (!captureReady) {
+      return std::nullopt;
+    }
+    XRecord::instance();
+    const auto *setup = xcb_get_setup(res::connection.get());
+    return screenSize(xcb_setup_roots_iterator(setup).data->root);
+  }
+
+  auto compositeAvailable() -> bool
+  {
+    return composite;
+  }
+
+  auto randrEventBase() -> std::optional<uint8_t>
+  {
+    if (auto base = randrBase.load(); base >= 0) {
+      return static_cast<uint8_t>(base);
+    }
+    return std::nullopt;
+  }
+
+  auto listMonitors() -> std::vector<Monitor>
+  {
+    std::vector<Monitor> monitors;
+    if (!captureReady) {
+      return monitors;
+    }
+    const auto *setup = xcb_get_setup(res::connection.get());
+    for (auto roots = xcb_setup_roots_iterator(setup); roots.rem > 0;
+         xcb_screen_next(&roots)) {
+      auto found = queryMonitors(roots.data->root);
+      monitors.insert(monitors.end(), found.begin(), found.end());
+    }
+    return monitors;
+  }
+
   void deinitCapture()
   {
     captureReady = false;
@@ -232,26 +757,43 @@ namespace smv::details {
     }
 
     auto &instance = XRecord::instance();
-    return std::make_shared<ScreenshotSource>(instance.screenshot(config.area));
+    return std::make_shared<ScreenshotSource>(instance.screenshot(config));
+  }
+
+  auto grabFrame(const decltype(ScreenshotConfig::area) &area,
+                 const GrabFunc                         &func,
+                 std::optional<CapturePath>             *path)
+    -> std::optional<std::string>
+  {
+    if (!captureReady) {
+      return CAPTURE_MODULE_UNINITIALIZED;
+    }
+    return XRecord::instance().grab(area, func, path);
   }
 
-  auto createAudioCaptureSource(const AudioCaptureConfig & /*unused*/)
+  auto createAudioCaptureSource(const AudioCaptureConfig &config)
     -> std::shared_ptr<AudioCaptureSource>
   {
     if (!captureReady) {
       logger->warn(CAPTURE_MODULE_UNINITIALIZED);
       return nullptr;
     }
-    return nullptr;
+    auto backend = createAudioBackend(config);
+    if (!backend) {
+      logger->error("No audio backend for source {}", config.sourceId);
+      return nullptr;
+    }
+    return std::make_shared<AudioCaptureSource>(config, std::move(backend));
   }
 
-  auto createVideoCaptureSource(const VideoCaptureConfig & /*unused*/)
+  auto createVideoCaptureSource(const VideoCaptureConfig &config,
+                                PixelLayout               layout)
     -> std::shared_ptr<VideoCaptureSource>
   {
     if (!captureReady) {
       logger->warn(CAPTURE_MODULE_UNINITIALIZED);
       return nullptr;
     }
-    return nullptr;
+    return std::make_shared<VideoCaptureSource>(config, layout);
   }
 } // namespace smv::details
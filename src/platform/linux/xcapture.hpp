@@ -1,33 +1,132 @@
 #pragma once
 
 #include "smv/capture_screenshot.hpp"
+#include "smv/frame.hpp"
 #include "smv/record.hpp"
 
 #include <cstdint>
+#include <functional>
+#include <memory>
 #include <mutex>
-
 #include <optional>
+#include <shared_mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
 #include <xcb/xcb_image.h>
 
 namespace smv::details {
+  /**
+   * @brief A shared memory segment attached to the X server
+   */
+  struct ShmSegment
+  {
+    // the screen this segment was sized for
+    xcb_window_t           root;
+    xcb_shm_segment_info_t info;
+    uint32_t               size;
+    // held by the grab using the segment
+    std::mutex inUse;
+  };
+
+  /**
+   * @brief Grabs pixels from the X server
+   *
+   * @details Each screen gets its own shared memory segment, sized to hold
+   * the whole screen, and so does each of its monitors, the first time that
+   * monitor is grabbed. Only the screen segments are faulted in up front. A
+   * grab goes through the smallest free segment it fits in, so captures of
+   * different monitors run side by side instead of waiting on each other.
+   * Grabs only fall back to copying the pixels over the connection when they
+   * fit in no segment.
+   * The segments of a screen are rebuilt when RandR reports that the screen
+   * changed, e.g. when a monitor is plugged in.
+   *
+   * Once the capture paths have been probed (see probeCapturePaths), each
+   * capture goes through the path that was fastest for its kind of source and
+   * size, chosen on its first grab
+   */
   class XRecord
   {
     explicit XRecord();
 
   public:
-    auto screenshot(const decltype(ScreenshotConfig::area) &area)
-      -> ScreenshotSource;
+    auto screenshot(const ScreenshotConfig &config) -> ScreenshotSource;
+
+    /**
+     * @brief Grab the pixels of the area without copying them
+     *
+     * @details The view handed to func points straight into the capture
+     * buffer, so it is only valid until func returns. Other captures that
+     * need the same buffer are blocked while func runs
+     *
+     * @param area the window/region to capture
+     * @param func receives the raw pixels
+     * @param path the capture path of the capture, see grabFrame
+     * @return std::optional<std::string> an error message if the grab failed
+     */
+    auto grab(const decltype(ScreenshotConfig::area)       &area,
+              const std::function<void(const FrameView &)> &func,
+              std::optional<CapturePath> *path = nullptr)
+      -> std::optional<std::string>;
+
+    /**
+     * @brief Grab a part of a drawable through the given path
+     * @details CapturePath::Shm falls back to CapturePath::GetImage when the
+     * area fits in no segment. CapturePath::Composite only works on windows
+     * that a compositor redirected, and always starts from the top left
+     * corner of the window
+     *
+     * @return std::optional<std::string> an error message if the grab failed
+     */
+    auto grabThrough(CapturePath                                   path,
+                     xcb_drawable_t                                drawable,
+                     const Region                                 &region,
+                     const std::function<void(const FrameView &)> &func)
+      -> std::optional<std::string>;
 
     ~XRecord();
 
+    /**
+     * @brief Rebuild the segments of a screen for its new size and monitors
+     * @details Called when RandR reports a screen change. Waits for the
+     * current grabs to finish
+     */
+    void onScreenChanged(xcb_window_t root, uint16_t width, uint16_t height);
+
     static auto instance() -> XRecord &;
 
   private:
-    std::mutex                            captureLock;
-    std::optional<xcb_shm_segment_info_t> shmInfo = std::nullopt;
-    uint32_t                              shmSize = 0;
+    /**
+     * @brief create the segment of a screen, and note the sizes of its
+     * monitors that are smaller than that. Called while no grab runs
+     */
+    void createSegments(xcb_window_t root, Size screen);
+
+    /**
+     * @brief create the segment of a monitor of the given size, unless
+     * another grab already did
+     */
+    void createMonitorSegment(Size size);
+
+    // held exclusively while the segments are changed
+    std::shared_mutex                        captureLock;
+    std::vector<std::unique_ptr<ShmSegment>> segments;
+    // the screen and size of the monitors that have no segment yet
+    std::vector<std::pair<xcb_window_t, Size>> monitorSegments;
   };
 
+  /**
+   * @brief the first event code of the RandR extension, if the server has it
+   */
+  auto randrEventBase() -> std::optional<uint8_t>;
+
+  /**
+   * @brief whether the server can hand out the pixmaps of redirected windows
+   */
+  auto compositeAvailable() -> bool;
+
   /**
    * @brief Initialize capture
    *
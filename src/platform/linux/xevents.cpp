@@ -1,4 +1,5 @@
 #include "xevents.hpp"
+#include "smv/capture_impl.hpp"
 #include "smv/common/fmt.hpp" // IWYU pragma: keep
 #include "smv/events.hpp"
 #include "smv/log.hpp"
@@ -439,6 +440,11 @@ namespace smv::details {
     // }).join();
   }
 
+  void publishEvent(const EventDataCaptureAdjusted &data)
+  {
+    enqueueNotification<EventType::CaptureAdjusted>(data);
+  }
+
   auto isEventInteresting(EventType type) -> bool
   {
     std::shared_lock _ { listenerMutx };
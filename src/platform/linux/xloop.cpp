@@ -1,5 +1,6 @@
 #include "xloop.hpp"
 #include "smv/log.hpp"
+#include "xcapture.hpp"
 #include "xevents.hpp"
 #include "xmonitor.hpp"
 #include "xtools.hpp"
@@ -9,6 +10,7 @@
 #include <memory>
 #include <optional>
 
+#include <xcb/randr.h>
 #include <xcb/xcb_event.h>
 #include <xcb/xcb_ewmh.h>
 #include <xcb/xproto.h>
@@ -116,6 +118,20 @@ namespace smv::details {
             break;
           }
           default:
+            if (auto base = randrEventBase();
+                base &&
+                XCB_EVENT_RESPONSE_TYPE(event) ==
+                  *base + XCB_RANDR_SCREEN_CHANGE_NOTIFY) {
+              auto change = std::reinterpret_pointer_cast<
+                xcb_randr_screen_change_notify_event_t>(event);
+              // the size is reported before rotation
+              auto rotated = change->rotation & (XCB_RANDR_ROTATION_ROTATE_90 |
+                                                 XCB_RANDR_ROTATION_ROTATE_270);
+              XRecord::instance().onScreenChanged(
+                change->root,
+                rotated ? change->height : change->width,
+                rotated ? change->width : change->height);
+            }
             break;
         }
       }
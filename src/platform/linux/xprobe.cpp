@@ -0,0 +1,306 @@
+#include "xprobe.hpp"
+#include "smv/capture_impl.hpp"
+#include "smv/log.hpp"
+#include "xcapture.hpp"
+#include "xutils.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <initializer_list>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <spdlog/fmt/fmt.h>
+#include <xcb/xcb.h>
+#include <xcb/xcb_ewmh.h>
+
+namespace fs = std::filesystem;
+
+namespace smv::details {
+  using smv::utils::res, smv::log::logger;
+
+  namespace {
+    using Clock = std::chrono::steady_clock;
+
+    // grabs per measure. The median is kept
+    constexpr auto PROBE_GRABS = 5U;
+    // the sides of the square regions measured, besides the whole screen
+    constexpr std::array<uint32_t, 2> PROBE_SIDES { 64, 512 };
+    // bumped whenever the cache format or the probes change
+    constexpr auto CACHE_VERSION = 1;
+
+    std::mutex        probeMutex;
+    CapturePathReport probeReport;
+
+    auto cacheFile() -> fs::path
+    {
+      const auto *cache = std::getenv("XDG_CACHE_HOME");
+      const auto *home  = std::getenv("HOME");
+      if (cache != nullptr && *cache != '\0') {
+        return fs::path(cache) / "ShareMyView" / "capture-paths";
+      }
+      if (home != nullptr && *home != '\0') {
+        return fs::path(home) / ".cache" / "ShareMyView" / "capture-paths";
+      }
+      return {};
+    }
+
+    /**
+     * @brief what the measures depend on. Measures taken with another key
+     * are not reused
+     */
+    auto serverKey(Size screen) -> std::string
+    {
+      const auto *setup = xcb_get_setup(res::connection.get());
+      return fmt::format("v{} {} {} {}x{} composite={}",
+                         CACHE_VERSION,
+                         std::string_view(xcb_setup_vendor(setup),
+                                          xcb_setup_vendor_length(setup)),
+                         setup->release_number,
+                         screen.w,
+                         screen.h,
+                         compositeAvailable());
+    }
+
+    auto loadCache(const fs::path &file, const std::string &key)
+      -> std::optional<std::vector<CapturePathProbe>>
+    {
+      std::ifstream input(file);
+      std::string   line;
+      if (!std::getline(input, line) || line != key) {
+        return std::nullopt;
+      }
+      std::vector<CapturePathProbe> probes;
+      int                           path      = 0;
+      int                           window    = 0;
+      uint64_t                      pixels    = 0;
+      int64_t                       time      = 0;
+      int                           available = 0;
+      while (input >> path >> window >> pixels >> time >> available) {
+        if (path != static_cast<int>(CapturePath::GetImage) &&
+            path != static_cast<int>(CapturePath::Shm) &&
+            path != static_cast<int>(CapturePath::Composite)) {
+          logger->warn("Ignoring the corrupt capture path cache {}",
+                       file.string());
+          return std::nullopt;
+        }
+        probes.push_back({ static_cast<CapturePath>(path),
+                           window != 0,
+                           pixels,
+                           std::chrono::microseconds(time),
+                           available != 0 });
+      }
+      if (probes.empty()) {
+        return std::nullopt;
+      }
+      return probes;
+    }
+
+    void saveCache(const fs::path                      &file,
+                   const std::string                   &key,
+                   const std::vector<CapturePathProbe> &probes)
+    {
+      std::error_code err;
+      fs::create_directories(file.parent_path(), err);
+      std::ofstream output(file, std::ios::trunc);
+      output << key << '\n';
+      for (const auto &probe : probes) {
+        output << static_cast<int>(probe.path) << ' ' << probe.window << ' '
+               << probe.pixels << ' ' << probe.time.count() << ' '
+               << probe.available << '\n';
+      }
+      if (!output) {
+        logger->warn("Failed to cache the capture paths in {}",
+                     file.string());
+      }
+    }
+
+    auto measure(CapturePath path, xcb_drawable_t drawable, Region region)
+      -> std::optional<std::chrono::microseconds>
+    {
+      std::array<std::chrono::microseconds, PROBE_GRABS> times {};
+      for (auto &time : times) {
+        auto start = Clock::now();
+        if (XRecord::instance().grabThrough(
+              path, drawable, region, [](const FrameView &) {})) {
+          return std::nullopt;
+        }
+        time = std::chrono::duration_cast<std::chrono::microseconds>(
+          Clock::now() - start);
+      }
+      std::nth_element(
+        times.begin(), times.begin() + times.size() / 2, times.end());
+      return times[times.size() / 2];
+    }
+
+    void measureAll(std::vector<CapturePathProbe>     &probes,
+                    std::initializer_list<CapturePath> paths,
+                    xcb_drawable_t                     drawable,
+                    Region                             region,
+                    bool                               window)
+    {
+      auto pixels = static_cast<uint64_t>(region.width()) * region.height();
+      for (auto path : paths) {
+        auto time = measure(path, drawable, region);
+        probes.push_back({ path,
+                           window,
+                           pixels,
+                           time.value_or(std::chrono::microseconds {}),
+                           time.has_value() });
+      }
+    }
+
+    /**
+     * @brief the window the user is working in, to measure window grabs on
+     */
+    auto activeWindow() -> std::optional<xcb_window_t>
+    {
+      if (!res::ewm_connection) {
+        return std::nullopt;
+      }
+      xcb_window_t window = XCB_NONE;
+      if (!xcb_ewmh_get_active_window_reply(
+            res::ewm_connection.get(),
+            xcb_ewmh_get_active_window(res::ewm_connection.get(), 0),
+            &window,
+            nullptr) ||
+          window == XCB_NONE) {
+        return std::nullopt;
+      }
+      return window;
+    }
+
+    auto runProbes(xcb_window_t root, Size screen)
+      -> std::vector<CapturePathProbe>
+    {
+      std::vector<CapturePathProbe> probes;
+      for (auto side : PROBE_SIDES) {
+        measureAll(probes,
+                   { CapturePath::GetImage, CapturePath::Shm },
+                   root,
+                   Region(std::min(side, screen.w),
+                          std::min(side, screen.h),
+                          0,
+                          0),
+                   false);
+      }
+      measureAll(probes,
+                 { CapturePath::GetImage, CapturePath::Shm },
+                 root,
+                 Region(screen.w, screen.h, 0, 0),
+                 false);
+
+      if (auto window = activeWindow()) {
+        auto geometry = std::unique_ptr<xcb_get_geometry_reply_t>(
+          xcb_get_geometry_reply(
+            res::connection.get(),
+            xcb_get_geometry(res::connection.get(), *window),
+            nullptr));
+        if (geometry && geometry->width > 0 && geometry->height > 0) {
+          measureAll(probes,
+                     { CapturePath::GetImage,
+                       CapturePath::Shm,
+                       CapturePath::Composite },
+                     *window,
+                     Region(geometry->width, geometry->height, 0, 0),
+                     true);
+        }
+      }
+      return probes;
+    }
+  } // namespace
+
+  void probeCapturePaths()
+  {
+    auto screen = prepareCapture();
+    if (!screen) {
+      return;
+    }
+    const auto *setup = xcb_get_setup(res::connection.get());
+    auto        root  = xcb_setup_roots_iterator(setup).data->root;
+    auto        key   = serverKey(*screen);
+    auto        file  = cacheFile();
+
+    CapturePathReport report;
+    report.cachePath = file.string();
+    if (auto cached = file.empty() ? std::nullopt : loadCache(file, key)) {
+      report.probes = std::move(*cached);
+      report.cached = true;
+    } else {
+      report.probes = runProbes(root, *screen);
+      if (!file.empty()) {
+        saveCache(file, key, report.probes);
+      }
+    }
+    for (const auto &probe : report.probes) {
+      logger->debug("Capture path {} on {} of {} pixels: {}us{}",
+                    static_cast<int>(probe.path),
+                    probe.window ? "a window" : "a region",
+                    probe.pixels,
+                    probe.time.count(),
+                    probe.available ? "" : " (unavailable)");
+    }
+    logger->info("Capture paths {}. Probes={}",
+                 report.cached ? "loaded from " + report.cachePath
+                               : std::string("measured"),
+                 report.probes.size());
+
+    std::lock_guard _(probeMutex);
+    probeReport = std::move(report);
+  }
+
+  auto capturePathReport() -> CapturePathReport
+  {
+    std::lock_guard _(probeMutex);
+    return probeReport;
+  }
+
+  auto fastestPath(bool                       window,
+                   uint64_t                   pixels,
+                   std::optional<CapturePath> skip)
+    -> std::optional<CapturePath>
+  {
+    std::lock_guard _(probeMutex);
+    const auto     &probes = probeReport.probes;
+    auto usable = [skip](const CapturePathProbe &probe, bool kind) {
+      return probe.available && probe.window == kind && probe.path != skip;
+    };
+    // windows are grabbed like regions when no window could be measured
+    auto kind =
+      window && std::any_of(probes.begin(), probes.end(), [&](auto &probe) {
+      return usable(probe, true);
+    });
+
+    // the largest size measured that is not larger than the grab, or the
+    // smallest size if they all are
+    std::optional<uint64_t> below;
+    std::optional<uint64_t> above;
+    for (const auto &probe : probes) {
+      if (!usable(probe, kind)) {
+        continue;
+      }
+      if (probe.pixels <= pixels) {
+        below = std::max(below.value_or(0), probe.pixels);
+      } else {
+        above = std::min(above.value_or(probe.pixels), probe.pixels);
+      }
+    }
+    auto nearest = below ? below : above;
+    if (!nearest) {
+      return std::nullopt;
+    }
+    const CapturePathProbe *best = nullptr;
+    for (const auto &probe : probes) {
+      if (usable(probe, kind) && probe.pixels == *nearest &&
+          (!best || probe.time < best->time)) {
+        best = &probe;
+      }
+    }
+    return best->path;
+  }
+} // namespace smv::details
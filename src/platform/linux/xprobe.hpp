@@ -0,0 +1,22 @@
+#pragma once
+
+#include "smv/record.hpp"
+
+#include <cstdint>
+#include <optional>
+
+namespace smv::details {
+  /**
+   * @brief the path that grabbed the nearest size of the same kind of source
+   * the fastest
+   *
+   * @param window whether a window is being grabbed
+   * @param pixels the number of pixels being grabbed
+   * @param skip a path not to return, e.g. one that failed on this source
+   * @return std::nullopt until the capture paths have been probed
+   */
+  auto fastestPath(bool                       window,
+                   uint64_t                   pixels,
+                   std::optional<CapturePath> skip = std::nullopt)
+    -> std::optional<CapturePath>;
+} // namespace smv::details
@@ -1,5 +1,6 @@
 #include "smv/client.hpp"
 #include "smv/events.hpp"
+#include "smv/record.hpp"
 #include "xcapture.hpp"
 #include "xevents.hpp"
 #include "xmonitor.hpp"
@@ -48,6 +49,7 @@ namespace smv {
 
     logger->info("X11 connection established");
     waitListenCond.notify_all();
+    warmUp();
   }
 
   void deinit() noexcept
@@ -1,9 +1,26 @@
+add_requires("xxhash 0.8.x")
+-- x264 is GPL-2.0, which is not compatible with this project's CC BY-NC 4.0
+-- license, so H.264 encoding is opt-in. Binaries built with it fall under the
+-- GPL, and cannot be distributed under CC BY-NC 4.0
+option("x264")
+    set_default(false)
+    set_showmenu(true)
+    set_description("Encode H.264 with x264 (GPL-2.0, see README.adoc)")
+    add_defines("SMV_WITH_X264")
+option_end()
+
+if has_config("x264") then
+    add_requires("x264")
+end
+add_requires("libopus")
+add_requires("lz4")
 if is_plat("linux") then
     add_requires("xcb", {system = true, configs = {shared = true}})
     add_requires("xcb-util", {system = true, configs = {shared = true}})
     add_requires("xcb-util-wm", {system = true, configs = {shared = true}})
     add_requires("xcb-util-errors", {system = false, configs = {shared = true}})
     add_requires("xmake::stb 2023.12.15")
+    add_requires("alsa-lib", {system = true})
 end
 
 target("smvnative")
@@ -12,7 +29,15 @@ target("smvnative")
     add_includedirs("$(projectdir)/include", "./internal")
     add_files("./$(host)/**.cpp", "./internal/**.cpp")
     -- add_files("common/**/*.cpp")
-    add_packages("spdlog", "stb", "libassert")
+    add_packages("spdlog", "stb", "libassert", "xxhash", "libopus", "lz4")
+    if has_config("x264") then
+        add_options("x264")
+        add_packages("x264")
+    end
+    -- the pixel conversion kernels use SSE2 intrinsics, with a scalar fallback
+    if is_arch("x86_64", "x64", "i386") then
+        add_vectorexts("sse2")
+    end
     if is_plat("linux") then
-        add_packages("xcb", "xcb-util", "xcb-util-wm", "xcb-util-errors")
+        add_packages("xcb", "xcb-util", "xcb-util-wm", "xcb-util-errors", "alsa-lib")
     end